@@ -71,6 +71,7 @@
 #include "libavutil/bprint.h"
 #include "libavutil/dict.h"
 #include "libavutil/mem.h"
+#include "libavutil/thread.h"
 #include "libavutil/time.h"
 
 #include "libavformat/avformat.h"
@@ -113,6 +114,15 @@ int        nb_filtergraphs;
 Decoder     **decoders;
 int        nb_decoders;
 
+typedef struct MemAccount {
+    char            *name;
+    AVBufferAccount *account;
+} MemAccount;
+
+static MemAccount     *mem_accounts;
+static int          nb_mem_accounts;
+static pthread_mutex_t mem_accounts_lock = PTHREAD_MUTEX_INITIALIZER;
+
 #if HAVE_TERMIOS_H
 
 /* init terminal so that we can grab keys */
@@ -337,6 +347,13 @@ static void ffmpeg_cleanup(int ret)
 
     hw_device_free_all();
 
+    for (int i = 0; i < nb_mem_accounts; i++) {
+        av_freep(&mem_accounts[i].name);
+        av_buffer_account_unref(&mem_accounts[i].account);
+    }
+    av_freep(&mem_accounts);
+    nb_mem_accounts = 0;
+
     av_freep(&filter_nbthreads);
 
     av_freep(&input_files);
@@ -514,6 +531,74 @@ void update_benchmark(const char *fmt, ...)
     }
 }
 
+AVBufferAccount *mem_account_get(const char *fmt, ...)
+{
+    AVBufferAccount *account = NULL;
+    MemAccount *ma;
+    va_list va;
+    char name[128];
+
+    if (!do_mem_stats)
+        return NULL;
+
+    va_start(va, fmt);
+    vsnprintf(name, sizeof(name), fmt, va);
+    va_end(va);
+
+    pthread_mutex_lock(&mem_accounts_lock);
+
+    /* filtergraphs are reconfigured with new filter instances, which keep
+     * accumulating into the same account */
+    for (int i = 0; i < nb_mem_accounts; i++) {
+        if (!strcmp(mem_accounts[i].name, name)) {
+            account = av_buffer_account_ref(mem_accounts[i].account);
+            goto finish;
+        }
+    }
+
+    ma = av_dynarray2_add((void **)&mem_accounts, &nb_mem_accounts,
+                          sizeof(*mem_accounts), NULL);
+    if (!ma)
+        goto finish;
+    ma->name    = av_strdup(name);
+    ma->account = av_buffer_account_alloc();
+    if (!ma->name || !ma->account) {
+        av_freep(&ma->name);
+        av_buffer_account_unref(&ma->account);
+        nb_mem_accounts--;
+        goto finish;
+    }
+    account = av_buffer_account_ref(ma->account);
+
+finish:
+    pthread_mutex_unlock(&mem_accounts_lock);
+    return account;
+}
+
+static void print_mem_stats(void)
+{
+    int64_t total_live = 0, total_peak = 0;
+
+    if (!nb_mem_accounts)
+        return;
+
+    av_log(NULL, AV_LOG_INFO, "Memory usage (KiB):\n");
+    av_log(NULL, AV_LOG_INFO, "  %-40s %10s %10s\n", "component", "live", "peak");
+    for (int i = 0; i < nb_mem_accounts; i++) {
+        int64_t live, peak;
+
+        av_buffer_account_get(mem_accounts[i].account, &live, &peak);
+        av_log(NULL, AV_LOG_INFO, "  %-40s %10"PRId64" %10"PRId64"\n",
+               mem_accounts[i].name, live >> 10, peak >> 10);
+        total_live += live;
+        total_peak += peak;
+    }
+    /* the peaks of the components are not simultaneous in general, so
+     * their sum is an upper bound of the overall peak */
+    av_log(NULL, AV_LOG_INFO, "  %-40s %10"PRId64" %10"PRId64"\n",
+           "total", total_live >> 10, total_peak >> 10);
+}
+
 static void print_report(int is_last_report, int64_t timer_start, int64_t cur_time, int64_t pts)
 {
     AVBPrint buf, buf_script;
@@ -863,6 +948,9 @@ static int transcode(Scheduler *sch)
     /* dump report by using the first video and audio streams */
     print_report(1, timer_start, av_gettime_relative(), transcode_ts);
 
+    if (do_mem_stats)
+        print_mem_stats();
+
     return ret;
 }
 
@@ -672,6 +672,7 @@ extern enum VideoSyncMethod video_sync_method;
 extern float frame_drop_threshold;
 extern int do_benchmark;
 extern int do_benchmark_all;
+extern int do_mem_stats;
 extern int do_hex_dump;
 extern int do_pkt_dump;
 extern int copy_ts;
@@ -846,6 +847,13 @@ OutputStream *ost_iter(OutputStream *prev);
 
 void update_benchmark(const char *fmt, ...);
 
+/**
+ * Get a new reference to the memory account with the given printf-style
+ * name, creating it on first use. Returns NULL when -mem_stats is not
+ * enabled, or on allocation failure.
+ */
+AVBufferAccount *mem_account_get(const char *fmt, ...) av_printf_format(1, 2);
+
 #define SPECIFIER_OPT_FMT_str  "%s"
 #define SPECIFIER_OPT_FMT_i    "%i"
 #define SPECIFIER_OPT_FMT_i64  "%"PRId64
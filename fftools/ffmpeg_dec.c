@@ -1185,6 +1185,8 @@ static int dec_open(DecoderPriv *dp, AVDictionary **dec_opts,
     dp->dec_ctx = avcodec_alloc_context3(codec);
     if (!dp->dec_ctx)
         return AVERROR(ENOMEM);
+    dp->dec_ctx->mem_account = mem_account_get("dec#%s/%s", dp->parent_name,
+                                               codec->name);
 
     ret = avcodec_parameters_to_context(dp->dec_ctx, o->par);
     if (ret < 0) {
@@ -1915,6 +1915,13 @@ static int configure_filtergraph(FilterGraph *fg, FilterGraphThread *fgt)
     if ((ret = avfilter_graph_config(fgt->graph, NULL)) < 0)
         goto fail;
 
+    if (do_mem_stats) {
+        for (unsigned i = 0; i < fgt->graph->nb_filters; i++) {
+            AVFilterContext *f = fgt->graph->filters[i];
+            f->mem_account = mem_account_get("%s/%s", fgp->log_name, f->name);
+        }
+    }
+
     fgp->is_meta = graph_is_meta(fgt->graph);
 
     /* limit the lists of allowed formats to the ones selected, to
@@ -1123,6 +1123,8 @@ static int ost_add(Muxer *mux, const OptionsContext *o, enum AVMediaType type,
 
         av_strlcat(ms->log_name, "/",       sizeof(ms->log_name));
         av_strlcat(ms->log_name, enc->name, sizeof(ms->log_name));
+
+        ost->enc_ctx->mem_account = mem_account_get("%s", ms->log_name);
     } else {
         if (ofilter) {
             av_log(ost, AV_LOG_ERROR,
@@ -61,6 +61,7 @@ enum VideoSyncMethod video_sync_method = VSYNC_AUTO;
 float frame_drop_threshold = 0;
 int do_benchmark      = 0;
 int do_benchmark_all  = 0;
+int do_mem_stats      = 0;
 int do_hex_dump       = 0;
 int do_pkt_dump       = 0;
 int copy_ts           = 0;
@@ -487,6 +488,32 @@ static int opt_sdp_file(void *optctx, const char *opt, const char *arg)
     return sch_sdp_filename(sch, arg);
 }
 
+static int opt_max_active_tasks(void *optctx, const char *opt, const char *arg)
+{
+    Scheduler *sch = optctx;
+    double num;
+    int ret;
+
+    ret = parse_number(opt, arg, OPT_TYPE_INT, -1, INT_MAX, &num);
+    if (ret < 0)
+        return ret;
+
+    return sch_max_active_tasks(sch, num);
+}
+
+static int opt_thread_queue_lockless(void *optctx, const char *opt, const char *arg)
+{
+    Scheduler *sch = optctx;
+    double num;
+    int ret;
+
+    ret = parse_number(opt, arg, OPT_TYPE_INT, 0, 1, &num);
+    if (ret < 0)
+        return ret;
+
+    return sch_thread_queue_lockless(sch, num);
+}
+
 #if CONFIG_VAAPI
 static int opt_vaapi_device(void *optctx, const char *opt, const char *arg)
 {
@@ -1446,6 +1473,9 @@ const OptionDef options[] = {
     { "benchmark_all",          OPT_TYPE_BOOL, OPT_EXPERT,
         { &do_benchmark_all },
       "add timings for each task" },
+    { "mem_stats",              OPT_TYPE_BOOL, OPT_EXPERT,
+        { &do_mem_stats },
+      "print the memory used by each demuxer, decoder, filter and encoder" },
     { "progress",               OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
         { .func_arg = opt_progress },
       "write program-readable progress information", "url" },
@@ -1556,6 +1586,14 @@ const OptionDef options[] = {
     { "filter_complex_threads", OPT_TYPE_INT, OPT_EXPERT,
         { &filter_complex_nbthreads },
         "number of threads for -filter_complex" },
+    { "max_active_tasks",       OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
+        { .func_arg = opt_max_active_tasks },
+        "maximum number of decoders, filtergraphs and encoders running concurrently "
+        "(0: unlimited, -1: number of CPUs)", "number" },
+    { "thread_queue_lockless",  OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
+        { .func_arg = opt_thread_queue_lockless },
+        "use lock-free queues between the threads (1, the default) "
+        "or mutex-protected ones (0)", "0|1" },
     { "lavfi",               OPT_TYPE_FUNC, OPT_FUNC_ARG | OPT_EXPERT,
         { .func_arg = opt_filter_complex },
         "create a complex filtergraph", "graph_description" },
@@ -32,6 +32,7 @@
 #include "libavcodec/packet.h"
 
 #include "libavutil/avassert.h"
+#include "libavutil/cpu.h"
 #include "libavutil/error.h"
 #include "libavutil/fifo.h"
 #include "libavutil/frame.h"
@@ -69,6 +70,9 @@ typedef struct SchTask {
 
     pthread_t           thread;
     int                 thread_running;
+
+    // this task competes for Scheduler.run_slots while running
+    int                 needs_run_slot;
 } SchTask;
 
 typedef struct SchDec {
@@ -305,8 +309,55 @@ struct Scheduler {
     pthread_mutex_t     schedule_lock;
 
     atomic_int_least64_t last_dts;
+
+    /* Run slots limiting the number of concurrently active compute tasks,
+     * see sch_max_active_tasks(). 0 means no limit. */
+    unsigned            nb_run_slots;
+    unsigned            run_slots_free;
+    pthread_mutex_t     run_slots_lock;
+    pthread_cond_t      run_slots_cond;
+
+    // flags of the ThreadQueues, see sch_thread_queue_lockless()
+    int                 tq_flags;
 };
 
+/**
+ * Wait until a run slot is available and take it. Called by compute tasks
+ * before they start doing work outside of the scheduler.
+ */
+static void run_slot_acquire(Scheduler *sch)
+{
+    if (!sch->nb_run_slots)
+        return;
+
+    pthread_mutex_lock(&sch->run_slots_lock);
+
+    while (!sch->run_slots_free)
+        pthread_cond_wait(&sch->run_slots_cond, &sch->run_slots_lock);
+    sch->run_slots_free--;
+
+    pthread_mutex_unlock(&sch->run_slots_lock);
+}
+
+/**
+ * Give up a run slot taken with run_slot_acquire(). Called by compute tasks
+ * whenever they enter the scheduler, i.e. whenever they may block waiting for
+ * input or for space in their destination queues.
+ */
+static void run_slot_release(Scheduler *sch)
+{
+    if (!sch->nb_run_slots)
+        return;
+
+    pthread_mutex_lock(&sch->run_slots_lock);
+
+    av_assert0(sch->run_slots_free < sch->nb_run_slots);
+    sch->run_slots_free++;
+    pthread_cond_signal(&sch->run_slots_cond);
+
+    pthread_mutex_unlock(&sch->run_slots_lock);
+}
+
 /**
  * Wait until this task is allowed to proceed.
  *
@@ -365,7 +416,8 @@ static void waiter_uninit(SchWaiter *w)
     pthread_cond_destroy(&w->cond);
 }
 
-static int queue_alloc(ThreadQueue **ptq, unsigned nb_streams, unsigned queue_size,
+static int queue_alloc(const Scheduler *sch, ThreadQueue **ptq,
+                       unsigned nb_streams, unsigned queue_size,
                        enum QueueType type)
 {
     ThreadQueue *tq;
@@ -393,7 +445,8 @@ static int queue_alloc(ThreadQueue **ptq, unsigned nb_streams, unsigned queue_si
         return AVERROR(ENOMEM);
 
     tq = tq_alloc(nb_streams, queue_size, op,
-                  (type == QUEUE_PACKETS) ? pkt_move : frame_move);
+                  (type == QUEUE_PACKETS) ? pkt_move : frame_move,
+                  sch->tq_flags);
     if (!tq) {
         objpool_free(&op);
         return AVERROR(ENOMEM);
@@ -434,6 +487,12 @@ static void task_init(Scheduler *sch, SchTask *task, enum SchedulerNodeType type
 
     task->func      = func;
     task->func_arg  = func_arg;
+
+    // demuxers and muxers are mostly I/O-bound and may sleep outside of the
+    // scheduler (e.g. -readrate), so they are never throttled
+    task->needs_run_slot = type == SCH_NODE_TYPE_DEC ||
+                           type == SCH_NODE_TYPE_ENC ||
+                           type == SCH_NODE_TYPE_FILTER_IN;
 }
 
 static int64_t trailing_dts(const Scheduler *sch, int count_finished)
@@ -562,6 +621,9 @@ void sch_free(Scheduler **psch)
     pthread_mutex_destroy(&sch->mux_done_lock);
     pthread_cond_destroy(&sch->mux_done_cond);
 
+    pthread_mutex_destroy(&sch->run_slots_lock);
+    pthread_cond_destroy(&sch->run_slots_cond);
+
     av_freep(psch);
 }
 
@@ -581,6 +643,8 @@ Scheduler *sch_alloc(void)
 
     sch->class    = &scheduler_class;
     sch->sdp_auto = 1;
+    // every queue is read by exactly one task
+    sch->tq_flags = THREAD_QUEUE_LOCKLESS;
 
     ret = pthread_mutex_init(&sch->schedule_lock, NULL);
     if (ret)
@@ -598,6 +662,14 @@ Scheduler *sch_alloc(void)
     if (ret)
         goto fail;
 
+    ret = pthread_mutex_init(&sch->run_slots_lock, NULL);
+    if (ret)
+        goto fail;
+
+    ret = pthread_cond_init(&sch->run_slots_cond, NULL);
+    if (ret)
+        goto fail;
+
     return sch;
 fail:
     sch_free(&sch);
@@ -611,6 +683,29 @@ int sch_sdp_filename(Scheduler *sch, const char *sdp_filename)
     return sch->sdp_filename ? 0 : AVERROR(ENOMEM);
 }
 
+int sch_max_active_tasks(Scheduler *sch, int nb_tasks)
+{
+    av_assert0(sch->state == SCH_STATE_UNINIT);
+
+    if (nb_tasks < 0)
+        nb_tasks = av_cpu_count();
+
+    sch->nb_run_slots   = nb_tasks;
+    sch->run_slots_free = nb_tasks;
+
+    return 0;
+}
+
+int sch_thread_queue_lockless(Scheduler *sch, int lockless)
+{
+    av_assert0(sch->state == SCH_STATE_UNINIT);
+    av_assert0(!sch->nb_dec && !sch->nb_enc && !sch->nb_filters && !sch->nb_mux);
+
+    sch->tq_flags = lockless ? THREAD_QUEUE_LOCKLESS : 0;
+
+    return 0;
+}
+
 static const AVClass sch_mux_class = {
     .class_name                = "SchMux",
     .version                   = LIBAVUTIL_VERSION_INT,
@@ -739,7 +834,7 @@ int sch_add_dec(Scheduler *sch, SchThreadFunc func, void *ctx,
     if (!dec->send_frame)
         return AVERROR(ENOMEM);
 
-    ret = queue_alloc(&dec->queue, 1, 0, QUEUE_PACKETS);
+    ret = queue_alloc(sch, &dec->queue, 1, 0, QUEUE_PACKETS);
     if (ret < 0)
         return ret;
 
@@ -783,7 +878,7 @@ int sch_add_enc(Scheduler *sch, SchThreadFunc func, void *ctx,
     if (!enc->send_pkt)
         return AVERROR(ENOMEM);
 
-    ret = queue_alloc(&enc->queue, 1, 0, QUEUE_FRAMES);
+    ret = queue_alloc(sch, &enc->queue, 1, 0, QUEUE_FRAMES);
     if (ret < 0)
         return ret;
 
@@ -831,7 +926,7 @@ int sch_add_filtergraph(Scheduler *sch, unsigned nb_inputs, unsigned nb_outputs,
     if (ret < 0)
         return ret;
 
-    ret = queue_alloc(&fg->queue, fg->nb_inputs + 1, 0, QUEUE_FRAMES);
+    ret = queue_alloc(sch, &fg->queue, fg->nb_inputs + 1, 0, QUEUE_FRAMES);
     if (ret < 0)
         return ret;
 
@@ -1475,7 +1570,7 @@ static int start_prepare(Scheduler *sch)
             }
         }
 
-        ret = queue_alloc(&mux->queue, mux->nb_streams, mux->queue_size,
+        ret = queue_alloc(sch, &mux->queue, mux->nb_streams, mux->queue_size,
                           QUEUE_PACKETS);
         if (ret < 0)
             return ret;
@@ -2095,7 +2190,7 @@ static int mux_done(Scheduler *sch, unsigned mux_idx)
     return 0;
 }
 
-int sch_dec_receive(Scheduler *sch, unsigned dec_idx, AVPacket *pkt)
+static int dec_receive(Scheduler *sch, unsigned dec_idx, AVPacket *pkt)
 {
     SchDec *dec;
     int ret, dummy;
@@ -2124,6 +2219,17 @@ int sch_dec_receive(Scheduler *sch, unsigned dec_idx, AVPacket *pkt)
     return ret;
 }
 
+int sch_dec_receive(Scheduler *sch, unsigned dec_idx, AVPacket *pkt)
+{
+    int ret;
+
+    run_slot_release(sch);
+    ret = dec_receive(sch, dec_idx, pkt);
+    run_slot_acquire(sch);
+
+    return ret;
+}
+
 static int send_to_filter(Scheduler *sch, SchFilterGraph *fg,
                           unsigned in_idx, AVFrame *frame)
 {
@@ -2171,7 +2277,7 @@ finish:
     return AVERROR_EOF;
 }
 
-int sch_dec_send(Scheduler *sch, unsigned dec_idx, AVFrame *frame)
+static int dec_send(Scheduler *sch, unsigned dec_idx, AVFrame *frame)
 {
     SchDec *dec;
     int ret = 0;
@@ -2211,6 +2317,17 @@ int sch_dec_send(Scheduler *sch, unsigned dec_idx, AVFrame *frame)
     return (nb_done == dec->nb_dst) ? AVERROR_EOF : 0;
 }
 
+int sch_dec_send(Scheduler *sch, unsigned dec_idx, AVFrame *frame)
+{
+    int ret;
+
+    run_slot_release(sch);
+    ret = dec_send(sch, dec_idx, frame);
+    run_slot_acquire(sch);
+
+    return ret;
+}
+
 static int dec_done(Scheduler *sch, unsigned dec_idx)
 {
     SchDec *dec = &sch->dec[dec_idx];
@@ -2240,7 +2357,9 @@ int sch_enc_receive(Scheduler *sch, unsigned enc_idx, AVFrame *frame)
     av_assert0(enc_idx < sch->nb_enc);
     enc = &sch->enc[enc_idx];
 
+    run_slot_release(sch);
     ret = tq_receive(enc->queue, &dummy, frame);
+    run_slot_acquire(sch);
     av_assert0(dummy <= 0);
 
     return ret;
@@ -2276,7 +2395,7 @@ finish:
     return AVERROR_EOF;
 }
 
-int sch_enc_send(Scheduler *sch, unsigned enc_idx, AVPacket *pkt)
+static int enc_send(Scheduler *sch, unsigned enc_idx, AVPacket *pkt)
 {
     SchEnc *enc;
     int ret;
@@ -2309,6 +2428,17 @@ int sch_enc_send(Scheduler *sch, unsigned enc_idx, AVPacket *pkt)
     return 0;
 }
 
+int sch_enc_send(Scheduler *sch, unsigned enc_idx, AVPacket *pkt)
+{
+    int ret;
+
+    run_slot_release(sch);
+    ret = enc_send(sch, enc_idx, pkt);
+    run_slot_acquire(sch);
+
+    return ret;
+}
+
 static int enc_done(Scheduler *sch, unsigned enc_idx)
 {
     SchEnc *enc = &sch->enc[enc_idx];
@@ -2325,8 +2455,8 @@ static int enc_done(Scheduler *sch, unsigned enc_idx)
     return ret;
 }
 
-int sch_filter_receive(Scheduler *sch, unsigned fg_idx,
-                       unsigned *in_idx, AVFrame *frame)
+static int filter_receive(Scheduler *sch, unsigned fg_idx,
+                          unsigned *in_idx, AVFrame *frame)
 {
     SchFilterGraph *fg;
 
@@ -2369,6 +2499,18 @@ int sch_filter_receive(Scheduler *sch, unsigned fg_idx,
     }
 }
 
+int sch_filter_receive(Scheduler *sch, unsigned fg_idx,
+                       unsigned *in_idx, AVFrame *frame)
+{
+    int ret;
+
+    run_slot_release(sch);
+    ret = filter_receive(sch, fg_idx, in_idx, frame);
+    run_slot_acquire(sch);
+
+    return ret;
+}
+
 void sch_filter_receive_finish(Scheduler *sch, unsigned fg_idx, unsigned in_idx)
 {
     SchFilterGraph *fg;
@@ -2394,6 +2536,7 @@ int sch_filter_send(Scheduler *sch, unsigned fg_idx, unsigned out_idx, AVFrame *
 {
     SchFilterGraph *fg;
     SchedulerNode  dst;
+    int ret;
 
     av_assert0(fg_idx < sch->nb_filters);
     fg = &sch->filters[fg_idx];
@@ -2401,9 +2544,13 @@ int sch_filter_send(Scheduler *sch, unsigned fg_idx, unsigned out_idx, AVFrame *
     av_assert0(out_idx < fg->nb_outputs);
     dst = fg->outputs[out_idx].dst;
 
-    return (dst.type == SCH_NODE_TYPE_ENC)                                    ?
-           send_to_enc   (sch, &sch->enc[dst.idx],                     frame) :
-           send_to_filter(sch, &sch->filters[dst.idx], dst.idx_stream, frame);
+    run_slot_release(sch);
+    ret = (dst.type == SCH_NODE_TYPE_ENC)                                    ?
+          send_to_enc   (sch, &sch->enc[dst.idx],                     frame) :
+          send_to_filter(sch, &sch->filters[dst.idx], dst.idx_stream, frame);
+    run_slot_acquire(sch);
+
+    return ret;
 }
 
 static int filter_done(Scheduler *sch, unsigned fg_idx)
@@ -2464,7 +2611,14 @@ static void *task_wrapper(void *arg)
     int ret;
     int err = 0;
 
+    if (task->needs_run_slot)
+        run_slot_acquire(sch);
+
     ret = task->func(task->func_arg);
+
+    if (task->needs_run_slot)
+        run_slot_release(sch);
+
     if (ret < 0)
         av_log(task->func_arg, AV_LOG_ERROR,
                "Task finished with error code: %d (%s)\n", ret, av_err2str(ret));
@@ -288,6 +288,35 @@ int sch_mux_stream_ready(Scheduler *sch, unsigned mux_idx, unsigned stream_idx);
  */
 int sch_sdp_filename(Scheduler *sch, const char *sdp_filename);
 
+/**
+ * Limit the number of compute tasks (decoders, filtergraphs and encoders) that
+ * may run concurrently.
+ *
+ * Every component still runs in its own thread, but a compute task must own
+ * one of nb_tasks run slots while it is doing work outside of the scheduler.
+ * The slot is given up whenever the task calls into the scheduler, i.e.
+ * whenever it may block waiting for input or for space in its output queues,
+ * and taken again before the call returns. This keeps the number of runnable
+ * threads close to the number of CPUs in transcodes with many components.
+ * Demuxers and muxers are never throttled.
+ *
+ * Must be called before sch_start().
+ *
+ * @param nb_tasks maximum number of concurrently active compute tasks;
+ *                 0 means unlimited (the default), a negative value selects
+ *                 the number of CPUs
+ */
+int sch_max_active_tasks(Scheduler *sch, int nb_tasks);
+
+/**
+ * Select the implementation of the queues between the tasks: the lock-free
+ * ring buffer (the default) or the mutex-protected FIFO, e.g. for comparing
+ * them or bisecting a problem to one of them.
+ *
+ * Must be called before any component is added.
+ */
+int sch_thread_queue_lockless(Scheduler *sch, int lockless);
+
 /**
  * Add an encoder to the scheduler.
  *
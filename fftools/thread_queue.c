@@ -16,6 +16,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <string.h>
 
@@ -23,6 +25,7 @@
 #include "libavutil/error.h"
 #include "libavutil/fifo.h"
 #include "libavutil/intreadwrite.h"
+#include "libavutil/macros.h"
 #include "libavutil/mem.h"
 #include "libavutil/thread.h"
 
@@ -39,6 +42,39 @@ typedef struct FifoElem {
     unsigned int stream_idx;
 } FifoElem;
 
+/**
+ * A slot of the lock-free ring (THREAD_QUEUE_LOCKLESS).
+ *
+ * The ring is a bounded multi-producer/single-consumer queue, where every slot
+ * carries a sequence number telling which lap of the ring it belongs to:
+ * - seq == 2 * pos:     the slot is free for the producer writing position pos
+ * - seq == 2 * pos + 1: the slot holds the item written at position pos
+ *
+ * Positions and sequence numbers are compared modulo SIZE_MAX + 1. The number
+ * of slots is a power of two, so that a position keeps mapping to the same slot
+ * when the counters wrap around, and the positions in flight are always much
+ * closer to each other than the half range where 2 * pos aliases.
+ */
+typedef struct RingSlot {
+    atomic_size_t   seq;
+    // preallocated object, owned by whoever owns the slot
+    void           *obj;
+    unsigned int    stream_idx;
+} RingSlot;
+
+/**
+ * A condition threads using the lock-free ring block on in ring_wait(), until
+ * some other thread changes the queue state and calls ring_wake().
+ */
+typedef struct RingEvent {
+    pthread_cond_t  cond;
+    // number of threads in ring_wait()
+    atomic_uint     nb_waiters;
+    // bumped by ring_wake() with ThreadQueue.lock held whenever there are
+    // waiters
+    atomic_uint     seq;
+} RingEvent;
+
 struct ThreadQueue {
     int              *finished;
     unsigned int    nb_streams;
@@ -50,6 +86,20 @@ struct ThreadQueue {
 
     pthread_mutex_t lock;
     pthread_cond_t  cond;
+
+    // the following are only used with THREAD_QUEUE_LOCKLESS
+    atomic_int      *finished_atomic;
+
+    RingSlot        *ring;
+    size_t           ring_mask;
+    atomic_size_t    ring_tail;
+    // only accessed by the consumer
+    size_t           ring_head;
+
+    // the consumer waits for items or EOF
+    RingEvent        ev_recv;
+    // producers wait for free slots
+    RingEvent        ev_send;
 };
 
 void tq_free(ThreadQueue **ptq)
@@ -66,9 +116,19 @@ void tq_free(ThreadQueue **ptq)
     }
     av_fifo_freep2(&tq->fifo);
 
+    if (tq->ring) {
+        for (size_t i = 0; i <= tq->ring_mask; i++)
+            objpool_release(tq->obj_pool, &tq->ring[i].obj);
+
+        pthread_cond_destroy(&tq->ev_recv.cond);
+        pthread_cond_destroy(&tq->ev_send.cond);
+    }
+    av_freep(&tq->ring);
+
     objpool_free(&tq->obj_pool);
 
     av_freep(&tq->finished);
+    av_freep(&tq->finished_atomic);
 
     pthread_cond_destroy(&tq->cond);
     pthread_mutex_destroy(&tq->lock);
@@ -76,8 +136,61 @@ void tq_free(ThreadQueue **ptq)
     av_freep(ptq);
 }
 
+static int ring_alloc(ThreadQueue *tq, size_t queue_size)
+{
+    RingEvent *ev[] = { &tq->ev_recv, &tq->ev_send };
+    RingSlot *ring;
+    size_t nb_ring = 1;
+    int ret;
+
+    while (nb_ring < queue_size) {
+        if (nb_ring > SIZE_MAX / 4)
+            return AVERROR(EINVAL);
+        nb_ring <<= 1;
+    }
+
+    ring = av_calloc(nb_ring, sizeof(*ring));
+    if (!ring)
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(ev); i++) {
+        ret = pthread_cond_init(&ev[i]->cond, NULL);
+        if (ret) {
+            if (i)
+                pthread_cond_destroy(&ev[0]->cond);
+            av_freep(&ring);
+            return AVERROR(ret);
+        }
+        atomic_init(&ev[i]->nb_waiters, 0);
+        atomic_init(&ev[i]->seq,        0);
+    }
+
+    tq->ring    = ring;
+    tq->ring_mask = nb_ring - 1;
+
+    tq->finished_atomic = av_calloc(tq->nb_streams, sizeof(*tq->finished_atomic));
+    if (!tq->finished_atomic)
+        return AVERROR(ENOMEM);
+    for (unsigned int i = 0; i < tq->nb_streams; i++)
+        atomic_init(&tq->finished_atomic[i], 0);
+
+    // every slot owns an object, so that producers never need to touch the
+    // (non-thread-safe) object pool
+    for (size_t i = 0; i < nb_ring; i++) {
+        ret = objpool_get(tq->obj_pool, &tq->ring[i].obj);
+        if (ret < 0)
+            return ret;
+        atomic_init(&tq->ring[i].seq, 2 * i);
+    }
+
+    atomic_init(&tq->ring_tail, 0);
+
+    return 0;
+}
+
 ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
-                      ObjPool *obj_pool, void (*obj_move)(void *dst, void *src))
+                      ObjPool *obj_pool, void (*obj_move)(void *dst, void *src),
+                      unsigned flags)
 {
     ThreadQueue *tq;
     int ret;
@@ -104,25 +217,214 @@ ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
         goto fail;
     tq->nb_streams = nb_streams;
 
+    tq->obj_pool = obj_pool;
+    tq->obj_move = obj_move;
+
+    if (flags & THREAD_QUEUE_LOCKLESS) {
+        ret = ring_alloc(tq, queue_size);
+        if (ret < 0)
+            goto fail;
+
+        return tq;
+    }
+
     tq->fifo = av_fifo_alloc2(queue_size, sizeof(FifoElem), 0);
     if (!tq->fifo)
         goto fail;
 
-    tq->obj_pool = obj_pool;
-    tq->obj_move = obj_move;
-
     return tq;
 fail:
+    // the caller retains ownership of the pool on failure
+    for (size_t i = 0; tq->ring && i <= tq->ring_mask; i++)
+        objpool_release(obj_pool, &tq->ring[i].obj);
+    tq->obj_pool = NULL;
+
     tq_free(&tq);
     return NULL;
 }
 
+/**
+ * Wake up threads blocked in ring_wait() on the given event, if any. Must be
+ * called after every change to the queue state that they may be waiting for.
+ *
+ * @param all wake up all waiters rather than just one
+ */
+static void ring_wake(ThreadQueue *tq, RingEvent *ev, int all)
+{
+    // pairs with the fence in ring_wait(): either the waiter observes our
+    // state change when re-checking, or we observe the waiter here
+    atomic_thread_fence(memory_order_seq_cst);
+
+    if (!atomic_load_explicit(&ev->nb_waiters, memory_order_relaxed))
+        return;
+
+    pthread_mutex_lock(&tq->lock);
+    atomic_fetch_add(&ev->seq, 1);
+    if (all)
+        pthread_cond_broadcast(&ev->cond);
+    else
+        pthread_cond_signal(&ev->cond);
+    pthread_mutex_unlock(&tq->lock);
+}
+
+/**
+ * Block on ev until try_op() returns something other than AVERROR(EAGAIN).
+ */
+static int ring_wait(ThreadQueue *tq, RingEvent *ev,
+                     int (*try_op)(ThreadQueue *tq, int *stream_idx, void *data),
+                     int *stream_idx, void *data)
+{
+    int ret;
+
+    while (1) {
+        unsigned seq;
+
+        ret = try_op(tq, stream_idx, data);
+        if (ret != AVERROR(EAGAIN))
+            return ret;
+
+        atomic_fetch_add(&ev->nb_waiters, 1);
+        atomic_thread_fence(memory_order_seq_cst);
+
+        // re-check after announcing ourselves: a state change made before
+        // ring_wake() read nb_waiters is seen here, any later one bumps seq
+        seq = atomic_load(&ev->seq);
+        ret = try_op(tq, stream_idx, data);
+        if (ret == AVERROR(EAGAIN)) {
+            pthread_mutex_lock(&tq->lock);
+            while (atomic_load(&ev->seq) == seq)
+                pthread_cond_wait(&ev->cond, &tq->lock);
+            pthread_mutex_unlock(&tq->lock);
+        }
+
+        atomic_fetch_sub(&ev->nb_waiters, 1);
+
+        if (ret != AVERROR(EAGAIN))
+            return ret;
+    }
+}
+
+static int ring_try_send(ThreadQueue *tq, int *pstream_idx, void *data)
+{
+    const unsigned int stream_idx = *pstream_idx;
+    size_t pos = atomic_load_explicit(&tq->ring_tail, memory_order_relaxed);
+    RingSlot *slot;
+
+    if (atomic_load(&tq->finished_atomic[stream_idx]) & FINISHED_RECV) {
+        atomic_fetch_or(&tq->finished_atomic[stream_idx], FINISHED_SEND);
+        return AVERROR_EOF;
+    }
+
+    while (1) {
+        size_t seq;
+
+        slot = &tq->ring[pos & tq->ring_mask];
+        seq  = atomic_load_explicit(&slot->seq, memory_order_acquire);
+
+        if (seq == 2 * pos) {
+            // the slot is free, try to claim it
+            if (atomic_compare_exchange_weak_explicit(&tq->ring_tail, &pos, pos + 1,
+                                                      memory_order_relaxed,
+                                                      memory_order_relaxed))
+                break;
+        } else if ((ptrdiff_t)(seq - 2 * pos) < 0) {
+            // the slot still holds an item from the previous lap - queue full
+            return AVERROR(EAGAIN);
+        } else
+            pos = atomic_load_explicit(&tq->ring_tail, memory_order_relaxed);
+    }
+
+    tq->obj_move(slot->obj, data);
+    slot->stream_idx = stream_idx;
+    atomic_store_explicit(&slot->seq, 2 * pos + 1, memory_order_release);
+
+    ring_wake(tq, &tq->ev_recv, 0);
+
+    return 0;
+}
+
+static int ring_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
+{
+    int idx = stream_idx;
+
+    if (atomic_load(&tq->finished_atomic[stream_idx]) & FINISHED_SEND)
+        return AVERROR(EINVAL);
+
+    return ring_wait(tq, &tq->ev_send, ring_try_send, &idx, data);
+}
+
+static int ring_try_receive(ThreadQueue *tq, int *stream_idx, void *data)
+{
+    unsigned int nb_finished = 0;
+
+    // items sent before a stream was marked as finished must be visible once
+    // we have seen the flag, so any EOF decision below is only made after
+    // observing an empty ring *after* loading the flags
+    for (unsigned int i = 0; i < tq->nb_streams; i++)
+        tq->finished[i] = atomic_load(&tq->finished_atomic[i]);
+
+    while (1) {
+        RingSlot *slot = &tq->ring[tq->ring_head & tq->ring_mask];
+        size_t     seq = atomic_load_explicit(&slot->seq, memory_order_acquire);
+        int      drop;
+
+        if (seq != 2 * tq->ring_head + 1)
+            break;
+
+        drop = atomic_load_explicit(&tq->finished_atomic[slot->stream_idx],
+                                    memory_order_relaxed) & FINISHED_RECV;
+        if (drop) {
+            objpool_release(tq->obj_pool, &slot->obj);
+            // cannot fail, the pool now contains at least one object
+            objpool_get(tq->obj_pool, &slot->obj);
+        } else {
+            tq->obj_move(data, slot->obj);
+            *stream_idx = slot->stream_idx;
+        }
+
+        atomic_store_explicit(&slot->seq, 2 * (tq->ring_head + tq->ring_mask + 1),
+                              memory_order_release);
+        tq->ring_head++;
+
+        ring_wake(tq, &tq->ev_send, 0);
+
+        if (!drop)
+            return 0;
+    }
+
+    for (unsigned int i = 0; i < tq->nb_streams; i++) {
+        if (!tq->finished[i])
+            continue;
+
+        /* return EOF to the consumer at most once for each stream */
+        if (!(tq->finished[i] & FINISHED_RECV)) {
+            atomic_fetch_or(&tq->finished_atomic[i], FINISHED_RECV);
+            *stream_idx   = i;
+            return AVERROR_EOF;
+        }
+
+        nb_finished++;
+    }
+
+    return nb_finished == tq->nb_streams ? AVERROR_EOF : AVERROR(EAGAIN);
+}
+
+static void ring_set_finished(ThreadQueue *tq, unsigned int stream_idx, int flag)
+{
+    atomic_fetch_or(&tq->finished_atomic[stream_idx], flag);
+    ring_wake(tq, (flag & FINISHED_SEND) ? &tq->ev_recv : &tq->ev_send, 1);
+}
+
 int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
 {
     int *finished;
     int ret;
 
     av_assert0(stream_idx < tq->nb_streams);
+
+    if (tq->ring)
+        return ring_send(tq, stream_idx, data);
+
     finished = &tq->finished[stream_idx];
 
     pthread_mutex_lock(&tq->lock);
@@ -199,6 +501,9 @@ int tq_receive(ThreadQueue *tq, int *stream_idx, void *data)
 
     *stream_idx = -1;
 
+    if (tq->ring)
+        return ring_wait(tq, &tq->ev_recv, ring_try_receive, stream_idx, data);
+
     pthread_mutex_lock(&tq->lock);
 
     while (1) {
@@ -227,6 +532,11 @@ void tq_send_finish(ThreadQueue *tq, unsigned int stream_idx)
 {
     av_assert0(stream_idx < tq->nb_streams);
 
+    if (tq->ring) {
+        ring_set_finished(tq, stream_idx, FINISHED_SEND);
+        return;
+    }
+
     pthread_mutex_lock(&tq->lock);
 
     /* mark the stream as send-finished;
@@ -242,6 +552,11 @@ void tq_receive_finish(ThreadQueue *tq, unsigned int stream_idx)
 {
     av_assert0(stream_idx < tq->nb_streams);
 
+    if (tq->ring) {
+        ring_set_finished(tq, stream_idx, FINISHED_RECV);
+        return;
+    }
+
     pthread_mutex_lock(&tq->lock);
 
     /* mark the stream as recv-finished;
@@ -25,6 +25,19 @@
 
 typedef struct ThreadQueue ThreadQueue;
 
+enum ThreadQueueFlags {
+    /**
+     * Use a lock-free ring buffer instead of a mutex-protected FIFO. Sending
+     * and receiving then only take a lock when they need to block, i.e. when
+     * the queue is full or empty, respectively.
+     *
+     * Any number of threads may send to such a queue, but tq_receive() must
+     * only ever be called from a single thread. The queue size is rounded up
+     * to a power of two.
+     */
+    THREAD_QUEUE_LOCKLESS = (1 << 0),
+};
+
 /**
  * Allocate a queue for sending data between threads.
  *
@@ -35,9 +48,11 @@ typedef struct ThreadQueue ThreadQueue;
  * @param obj_pool object pool that will be used to allocate items stored in the
  *                 queue; the pool becomes owned by the queue
  * @param callback that moves the contents between two data pointers
+ * @param flags a combination of ThreadQueueFlags
  */
 ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
-                      ObjPool *obj_pool, void (*obj_move)(void *dst, void *src));
+                      ObjPool *obj_pool, void (*obj_move)(void *dst, void *src),
+                      unsigned flags);
 void         tq_free(ThreadQueue **tq);
 
 /**
@@ -373,6 +373,11 @@ typedef struct RcOverride{
  * Discard cropping information from SPS.
  */
 #define AV_CODEC_FLAG2_IGNORE_CROP    (1 << 16)
+/**
+ * Allocate the buffers of the default get_buffer2() implementation for video
+ * with av_buffer_alloc_hugepages().
+ */
+#define AV_CODEC_FLAG2_HUGEPAGES      (1 << 17)
 
 /**
  * Show all frames before the first keyframe
@@ -2076,6 +2081,21 @@ typedef struct AVCodecContext {
      */
     AVFrameSideData  **decoded_side_data;
     int             nb_decoded_side_data;
+
+    /**
+     * Account charged with the memory allocated on behalf of this codec
+     * context: the frame pools of the default get_buffer2() implementation
+     * and the buffers of the frames or packets returned to the caller, unless
+     * those are charged to another account already. See AVBufferAccount.
+     *
+     * May be set by the caller before avcodec_open2() to a reference to an
+     * account, the reference is owned and released by libavcodec in
+     * avcodec_free_context() afterwards.
+     *
+     * - encoding: may be set by user
+     * - decoding: may be set by user
+     */
+    AVBufferAccount *mem_account;
 } AVCodecContext;
 
 /**
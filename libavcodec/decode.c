@@ -788,6 +788,13 @@ int ff_decode_receive_frame(AVCodecContext *avctx, AVFrame *frame)
             goto fail;
     }
 
+    if (avctx->mem_account) {
+        for (int i = 0; i < FF_ARRAY_ELEMS(frame->buf) && frame->buf[i]; i++)
+            av_buffer_account_add(frame->buf[i], avctx->mem_account);
+        for (int i = 0; i < frame->nb_extended_buf; i++)
+            av_buffer_account_add(frame->extended_buf[i], avctx->mem_account);
+    }
+
     avctx->frame_num++;
 
 #if FF_API_DROPCHANGED
@@ -556,6 +556,9 @@ int attribute_align_arg avcodec_receive_packet(AVCodecContext *avctx, AVPacket *
             return ret;
     }
 
+    if (avpkt->buf)
+        av_buffer_account_add(avpkt->buf, avctx->mem_account);
+
     return 0;
 }
 
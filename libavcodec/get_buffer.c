@@ -19,6 +19,7 @@
  */
 
 #include <stdint.h>
+#include <string.h>
 
 #include "libavutil/avassert.h"
 #include "libavutil/avutil.h"
@@ -62,6 +63,15 @@ static void frame_pool_free(FFRefStructOpaque unused, void *obj)
         av_buffer_pool_uninit(&pool->pools[i]);
 }
 
+static AVBufferRef *alloc_hugepages(size_t size)
+{
+    AVBufferRef *buf = av_buffer_alloc_hugepages(size);
+    /* the mappings come zeroed, poison them like av_buffer_alloc() does */
+    if (CONFIG_MEMORY_POISONING && buf)
+        memset(buf->data, 0x2a, size);
+    return buf;
+}
+
 static int update_frame_pool(AVCodecContext *avctx, AVFrame *frame)
 {
     FramePool *pool = avctx->internal->pool;
@@ -125,6 +135,8 @@ static int update_frame_pool(AVCodecContext *avctx, AVFrame *frame)
                     goto fail;
                 }
                 pool->pools[i] = av_buffer_pool_init(size[i] + 16 + STRIDE_ALIGN - 1,
+                                                     avctx->flags2 & AV_CODEC_FLAG2_HUGEPAGES ?
+                                                        alloc_hugepages :
                                                      CONFIG_MEMORY_POISONING ?
                                                         NULL :
                                                         av_buffer_allocz);
@@ -132,6 +144,7 @@ static int update_frame_pool(AVCodecContext *avctx, AVFrame *frame)
                     ret = AVERROR(ENOMEM);
                     goto fail;
                 }
+                av_buffer_pool_set_account(pool->pools[i], avctx->mem_account);
             }
         }
         pool->format = frame->format;
@@ -151,6 +164,7 @@ static int update_frame_pool(AVCodecContext *avctx, AVFrame *frame)
             ret = AVERROR(ENOMEM);
             goto fail;
         }
+        av_buffer_pool_set_account(pool->pools[0], avctx->mem_account);
 
         pool->format     = frame->format;
         pool->planes     = planes;
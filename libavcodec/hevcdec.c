@@ -28,12 +28,14 @@
 #include "libavutil/attributes.h"
 #include "libavutil/avstring.h"
 #include "libavutil/common.h"
+#include "libavutil/executor.h"
 #include "libavutil/film_grain_params.h"
 #include "libavutil/internal.h"
 #include "libavutil/md5.h"
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/pixdesc.h"
+#include "libavutil/thread.h"
 #include "libavutil/timecode.h"
 
 #include "aom_film_grain.h"
@@ -2595,10 +2597,81 @@ static int hls_slice_data(HEVCContext *s)
     s->avctx->execute(s->avctx, hls_decode_entry, NULL, &ret , 1, 0);
     return ret;
 }
-static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *hevc_lclist,
-                                int job, int self_id)
+/**
+ * With frame threading, the rows of WPP slices are decoded as tasks on an
+ * executor owned by the frame thread. Rows only ever wait for the row above,
+ * which was dequeued before them, so the row tasks cannot deadlock as long as
+ * the executor runs them in order.
+ */
+typedef struct HEVCWPPTask {
+    AVTask task;
+    int    ctb_row;
+    int    qp_y;    ///< slice QP, read before row 0 starts updating it
+    int    ret;
+} HEVCWPPTask;
+
+typedef struct HEVCWPPProgress {
+    AVMutex lock;
+    AVCond  cond;
+} HEVCWPPProgress;
+
+typedef struct HEVCWPPContext {
+    AVExecutor *executor;
+
+    // per thread, protects the entries of the rows decoded by it
+    HEVCWPPProgress *progress;
+    int nb_progress;
+
+    int *entries;
+    unsigned int entries_size;
+
+    HEVCWPPTask *tasks;
+    unsigned int tasks_size;
+
+    // protected by lock
+    int nb_pending;
+    AVMutex lock;
+    AVCond  cond;
+} HEVCWPPContext;
+
+static void wpp_report_progress(const HEVCContext *s, int field, int thread, int n)
+{
+    HEVCWPPContext *wpp = s->wpp;
+    HEVCWPPProgress *progress;
+
+    if (!wpp) {
+        ff_thread_report_progress2(s->avctx, field, thread, n);
+        return;
+    }
+
+    progress = &wpp->progress[thread];
+    ff_mutex_lock(&progress->lock);
+    wpp->entries[field] += n;
+    ff_cond_broadcast(&progress->cond);
+    ff_mutex_unlock(&progress->lock);
+}
+
+static void wpp_await_progress(const HEVCContext *s, int field, int thread, int shift)
+{
+    HEVCWPPContext *wpp = s->wpp;
+    HEVCWPPProgress *progress;
+
+    if (!wpp) {
+        ff_thread_await_progress2(s->avctx, field, thread, shift);
+        return;
+    }
+    if (!field)
+        return;
+
+    progress = &wpp->progress[thread ? thread - 1 : wpp->nb_progress - 1];
+    ff_mutex_lock(&progress->lock);
+    while (wpp->entries[field - 1] - wpp->entries[field] < shift)
+        ff_cond_wait(&progress->cond, &progress->lock);
+    ff_mutex_unlock(&progress->lock);
+}
+
+static int decode_entry_wpp(HEVCLocalContext *lc, int job)
 {
-    HEVCLocalContext *lc = ((HEVCLocalContext**)hevc_lclist)[self_id];
     const HEVCContext *const s = lc->parent;
     int ctb_size    = 1 << s->ps.sps->log2_ctb_size;
     int more_data   = 1;
@@ -2621,13 +2694,13 @@ static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *hevc_lclist,
 
         hls_decode_neighbour(lc, x_ctb, y_ctb, ctb_addr_ts);
 
-        ff_thread_await_progress2(s->avctx, ctb_row, thread, SHIFT_CTB_WPP);
+        wpp_await_progress(s, ctb_row, thread, SHIFT_CTB_WPP);
 
         /* atomic_load's prototype requires a pointer to non-const atomic variable
          * (due to implementations via mutexes, where reads involve writes).
          * Of course, casting const away here is nevertheless safe. */
         if (atomic_load((atomic_int*)&s->wpp_err)) {
-            ff_thread_report_progress2(s->avctx, ctb_row , thread, SHIFT_CTB_WPP);
+            wpp_report_progress(s, ctb_row, thread, SHIFT_CTB_WPP);
             return 0;
         }
 
@@ -2645,19 +2718,19 @@ static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *hevc_lclist,
         ctb_addr_ts++;
 
         ff_hevc_save_states(lc, ctb_addr_ts);
-        ff_thread_report_progress2(s->avctx, ctb_row, thread, 1);
+        wpp_report_progress(s, ctb_row, thread, 1);
         ff_hevc_hls_filters(lc, x_ctb, y_ctb, ctb_size);
 
         if (!more_data && (x_ctb+ctb_size) < s->ps.sps->width && ctb_row != s->sh.num_entry_point_offsets) {
             /* Casting const away here is safe, because it is an atomic operation. */
             atomic_store((atomic_int*)&s->wpp_err, 1);
-            ff_thread_report_progress2(s->avctx, ctb_row ,thread, SHIFT_CTB_WPP);
+            wpp_report_progress(s, ctb_row, thread, SHIFT_CTB_WPP);
             return 0;
         }
 
         if ((x_ctb+ctb_size) >= s->ps.sps->width && (y_ctb+ctb_size) >= s->ps.sps->height ) {
             ff_hevc_hls_filter(lc, x_ctb, y_ctb, ctb_size);
-            ff_thread_report_progress2(s->avctx, ctb_row , thread, SHIFT_CTB_WPP);
+            wpp_report_progress(s, ctb_row, thread, SHIFT_CTB_WPP);
             return ctb_addr_ts;
         }
         ctb_addr_rs       = s->ps.pps->ctb_addr_ts_to_rs[ctb_addr_ts];
@@ -2667,17 +2740,167 @@ static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *hevc_lclist,
             break;
         }
     }
-    ff_thread_report_progress2(s->avctx, ctb_row ,thread, SHIFT_CTB_WPP);
+    wpp_report_progress(s, ctb_row, thread, SHIFT_CTB_WPP);
 
     return 0;
 error:
     s->tab_slice_address[ctb_addr_rs] = -1;
     /* Casting const away here is safe, because it is an atomic operation. */
     atomic_store((atomic_int*)&s->wpp_err, 1);
-    ff_thread_report_progress2(s->avctx, ctb_row ,thread, SHIFT_CTB_WPP);
+    wpp_report_progress(s, ctb_row, thread, SHIFT_CTB_WPP);
     return ret;
 }
 
+static int hls_decode_entry_wpp(AVCodecContext *avctxt, void *hevc_lclist,
+                                int job, int self_id)
+{
+    return decode_entry_wpp(((HEVCLocalContext**)hevc_lclist)[self_id], job);
+}
+
+static int wpp_task_priority_higher(const AVTask *_a, const AVTask *_b)
+{
+    const HEVCWPPTask *a = (const HEVCWPPTask*)_a;
+    const HEVCWPPTask *b = (const HEVCWPPTask*)_b;
+
+    return a->ctb_row < b->ctb_row;
+}
+
+static int wpp_task_ready(const AVTask *t, void *user_data)
+{
+    return 1;
+}
+
+static int wpp_task_run(AVTask *_t, void *local_context, void *user_data)
+{
+    HEVCWPPTask *t     = (HEVCWPPTask*)_t;
+    HEVCContext *s     = user_data;
+    HEVCWPPContext *wpp = s->wpp;
+    HEVCLocalContext *lc;
+
+    // the first row continues the CABAC state of the slice header
+    if (t->ctb_row) {
+        lc = local_context;
+        lc->logctx             = s->avctx;
+        lc->parent             = s;
+        lc->common_cabac_state = &s->cabac;
+        lc->first_qp_group     = 1;
+        lc->qp_y               = t->qp_y;
+    } else {
+        lc = s->HEVClc;
+    }
+
+    t->ret = decode_entry_wpp(lc, t->ctb_row);
+
+    ff_mutex_lock(&wpp->lock);
+    if (!--wpp->nb_pending)
+        ff_cond_signal(&wpp->cond);
+    ff_mutex_unlock(&wpp->lock);
+
+    return 0;
+}
+
+static int wpp_execute(HEVCContext *s, int *ret, int nb_rows)
+{
+    HEVCWPPContext *wpp = s->wpp;
+    const int qp_y = s->HEVClc->qp_y;
+
+    av_fast_malloc(&wpp->entries, &wpp->entries_size, nb_rows * sizeof(*wpp->entries));
+    av_fast_malloc(&wpp->tasks, &wpp->tasks_size, nb_rows * sizeof(*wpp->tasks));
+    if (!wpp->entries || !wpp->tasks)
+        return AVERROR(ENOMEM);
+    memset(wpp->entries, 0, nb_rows * sizeof(*wpp->entries));
+
+    wpp->nb_pending = nb_rows;
+    for (int i = 0; i < nb_rows; i++) {
+        HEVCWPPTask *t = &wpp->tasks[i];
+
+        memset(t, 0, sizeof(*t));
+        t->ctb_row = i;
+        t->qp_y    = qp_y;
+        av_executor_execute(wpp->executor, &t->task);
+    }
+
+    ff_mutex_lock(&wpp->lock);
+    while (wpp->nb_pending)
+        ff_cond_wait(&wpp->cond, &wpp->lock);
+    ff_mutex_unlock(&wpp->lock);
+
+    for (int i = 0; i < nb_rows; i++)
+        ret[i] = wpp->tasks[i].ret;
+
+    return 0;
+}
+
+static void wpp_free(HEVCContext *s)
+{
+    HEVCWPPContext *wpp = s->wpp;
+
+    if (!wpp)
+        return;
+
+    av_executor_free(&wpp->executor);
+    for (int i = 0; i < wpp->nb_progress; i++) {
+        ff_mutex_destroy(&wpp->progress[i].lock);
+        ff_cond_destroy(&wpp->progress[i].cond);
+    }
+    av_freep(&wpp->progress);
+    if (wpp->nb_pending >= 0) {
+        ff_mutex_destroy(&wpp->lock);
+        ff_cond_destroy(&wpp->cond);
+    }
+    av_freep(&wpp->entries);
+    av_freep(&wpp->tasks);
+    av_freep(&s->wpp);
+}
+
+static av_cold int wpp_init(HEVCContext *s)
+{
+    const AVTaskCallbacks callbacks = {
+        s,
+        sizeof(HEVCLocalContext),
+        wpp_task_priority_higher,
+        wpp_task_ready,
+        wpp_task_run,
+    };
+    HEVCWPPContext *wpp;
+
+    wpp = s->wpp = av_mallocz(sizeof(*s->wpp));
+    if (!wpp)
+        return AVERROR(ENOMEM);
+
+    wpp->nb_pending = -1;
+    if (ff_mutex_init(&wpp->lock, NULL))
+        goto fail;
+    if (ff_cond_init(&wpp->cond, NULL)) {
+        ff_mutex_destroy(&wpp->lock);
+        goto fail;
+    }
+    wpp->nb_pending = 0;
+
+    wpp->progress = av_calloc(s->threads_number, sizeof(*wpp->progress));
+    if (!wpp->progress)
+        goto fail;
+    for (; wpp->nb_progress < s->threads_number; wpp->nb_progress++) {
+        HEVCWPPProgress *progress = &wpp->progress[wpp->nb_progress];
+
+        if (ff_mutex_init(&progress->lock, NULL))
+            goto fail;
+        if (ff_cond_init(&progress->cond, NULL)) {
+            ff_mutex_destroy(&progress->lock);
+            goto fail;
+        }
+    }
+
+    wpp->executor = av_executor_alloc(&callbacks, s->threads_number);
+    if (!wpp->executor)
+        goto fail;
+
+    return 0;
+fail:
+    wpp_free(s);
+    return AVERROR(ENOMEM);
+}
+
 static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
 {
     const uint8_t *data = nal->data;
@@ -2696,7 +2919,7 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
         return AVERROR_INVALIDDATA;
     }
 
-    for (i = 1; i < s->threads_number; i++) {
+    for (i = 1; i < s->threads_number && !s->wpp; i++) {
         if (s->HEVClcList[i])
             continue;
         s->HEVClcList[i] = av_mallocz(sizeof(HEVCLocalContext));
@@ -2741,7 +2964,7 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
     }
     s->data = data;
 
-    for (i = 1; i < s->threads_number; i++) {
+    for (i = 1; i < s->threads_number && !s->wpp; i++) {
         s->HEVClcList[i]->first_qp_group = 1;
         s->HEVClcList[i]->qp_y = s->HEVClc->qp_y;
     }
@@ -2755,8 +2978,16 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
     if (!ret)
         return AVERROR(ENOMEM);
 
-    if (s->ps.pps->entropy_coding_sync_enabled_flag)
-        s->avctx->execute2(s->avctx, hls_decode_entry_wpp, s->HEVClcList, ret, s->sh.num_entry_point_offsets + 1);
+    if (s->ps.pps->entropy_coding_sync_enabled_flag) {
+        if (s->wpp) {
+            res = wpp_execute(s, ret, s->sh.num_entry_point_offsets + 1);
+            if (res < 0) {
+                av_free(ret);
+                return res;
+            }
+        } else
+            s->avctx->execute2(s->avctx, hls_decode_entry_wpp, s->HEVClcList, ret, s->sh.num_entry_point_offsets + 1);
+    }
 
     for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
         res += ret[i];
@@ -3450,6 +3681,8 @@ static av_cold int hevc_decode_free(AVCodecContext *avctx)
 
     pic_arrays_free(s);
 
+    wpp_free(s);
+
     ff_dovi_ctx_unref(&s->dovi_ctx);
     av_buffer_unref(&s->rpu_buf);
 
@@ -3634,10 +3867,19 @@ static av_cold int hevc_decode_init(AVCodecContext *avctx)
     else
         s->threads_type = FF_THREAD_SLICE;
 
+    if (s->threads_type == FF_THREAD_FRAME && s->wpp_threads > 1)
+        s->threads_number = s->wpp_threads;
+
     ret = hevc_init_context(avctx);
     if (ret < 0)
         return ret;
 
+    if (s->threads_number > 1 && s->threads_type == FF_THREAD_FRAME) {
+        ret = wpp_init(s);
+        if (ret < 0)
+            return ret;
+    }
+
     s->enable_parallel_tiles = 0;
     s->sei.picture_timing.picture_struct = 0;
     s->eos = 1;
@@ -3688,6 +3930,8 @@ static const AVOption options[] = {
         AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
     { "strict-displaywin", "stricly apply default display window size", OFFSET(apply_defdispwin),
         AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
+    { "wpp_threads", "threads per frame thread for decoding WPP rows in parallel", OFFSET(wpp_threads),
+        AV_OPT_TYPE_INT, {.i64 = 0}, 0, UINT8_MAX, PAR },
     { NULL },
 };
 
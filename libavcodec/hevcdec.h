@@ -532,6 +532,8 @@ typedef struct HEVCContext {
 
     int enable_parallel_tiles;
     atomic_int wpp_err;
+    /** executor state for decoding WPP rows in parallel with frame threads */
+    struct HEVCWPPContext *wpp;
 
     const uint8_t *data;
 
@@ -542,6 +544,7 @@ typedef struct HEVCContext {
     int is_nalff;           ///< this flag is != 0 if bitstream is encapsulated
                             ///< as a format defined in 14496-15
     int apply_defdispwin;
+    int wpp_threads;        ///< threads per frame thread for WPP rows, 0/1 to disable
 
     int nal_length_size;    ///< Number of bytes used for nal length (1, 2 or 4)
     int nuh_layer_id;
@@ -177,6 +177,7 @@ void avcodec_free_context(AVCodecContext **pavctx)
     av_freep(&avctx->inter_matrix);
     av_freep(&avctx->rc_override);
     av_channel_layout_uninit(&avctx->ch_layout);
+    av_buffer_account_unref(&avctx->mem_account);
 
     av_freep(pavctx);
 }
@@ -26,6 +26,7 @@
 #include "libavcodec/refstruct.h"
 #include "libavutil/cpu.h"
 #include "libavutil/mem.h"
+#include "libavutil/opt.h"
 #include "libavutil/thread.h"
 
 #include "dec.h"
@@ -988,7 +989,7 @@ static av_cold int vvc_decode_free(AVCodecContext *avctx)
 
     ff_cbs_fragment_free(&s->current_frame);
     vvc_decode_flush(avctx);
-    ff_vvc_executor_free(&s->executor);
+    ff_vvc_executor_free(s);
     if (s->fcs) {
         for (int i = 0; i < s->nb_fcs; i++)
             frame_context_free(s->fcs + i);
@@ -1050,6 +1051,23 @@ static av_cold int vvc_decode_init(AVCodecContext *avctx)
     return 0;
 }
 
+#define OFFSET(x) offsetof(VVCContext, x)
+#define PAR (AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_VIDEO_PARAM)
+
+static const AVOption options[] = {
+    { "shared_executor", "Run on worker threads shared by all decoders in the process "
+        "instead of creating private ones", OFFSET(shared_executor),
+        AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, PAR },
+    { NULL },
+};
+
+static const AVClass vvc_decoder_class = {
+    .class_name = "VVC decoder",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 const FFCodec ff_vvc_decoder = {
     .p.name         = "vvc",
     .p.long_name    = NULL_IF_CONFIG_SMALL("VVC (Versatile Video Coding)"),
@@ -1065,4 +1083,5 @@ const FFCodec ff_vvc_decoder = {
     .caps_internal  = FF_CODEC_CAP_EXPORTS_CROPPING | FF_CODEC_CAP_INIT_CLEANUP |
                       FF_CODEC_CAP_AUTO_THREADS,
     .p.profiles     = NULL_IF_CONFIG_SMALL(ff_vvc_profiles),
+    .p.priv_class   = &vvc_decoder_class,
 };
@@ -193,6 +193,7 @@ typedef struct VVCFrameContext {
 } VVCFrameContext;
 
 typedef struct VVCContext {
+    const AVClass *c;  // needed by private avoptions
     struct AVCodecContext *avctx;
 
     CodedBitstreamContext *cbc;
@@ -218,6 +219,7 @@ typedef struct VVCContext {
     uint16_t seq_output;
 
     struct AVExecutor *executor;
+    int shared_executor;    ///< run tasks on the process-wide executor
 
     VVCFrameContext *fcs;
     int nb_fcs;
@@ -22,6 +22,7 @@
 
 #include <stdatomic.h>
 
+#include "libavutil/cpu.h"
 #include "libavutil/executor.h"
 #include "libavutil/mem.h"
 #include "libavutil/thread.h"
@@ -96,6 +97,9 @@ typedef struct VVCFrameThread {
     atomic_int nb_scheduled_tasks;
     atomic_int nb_scheduled_listeners;
 
+    // the output is waiting for this frame, its tasks are on the critical path
+    atomic_int blocking;
+
     int row_progress[VVC_PROGRESS_LAST];
 
     AVMutex lock;
@@ -108,7 +112,8 @@ static void add_task(VVCContext *s, VVCTask *t)
 
     atomic_fetch_add(&ft->nb_scheduled_tasks, 1);
 
-    av_executor_execute(s->executor, &t->u.task);
+    av_executor_execute_priority(s->executor, &t->u.task,
+        atomic_load(&ft->blocking) ? AV_EXECUTOR_PRIORITY_HIGH : AV_EXECUTOR_PRIORITY_NORMAL);
 }
 
 static void task_init(VVCTask *t, VVCTaskStage stage, VVCFrameContext *fc, const int rx, const int ry)
@@ -617,6 +622,42 @@ static int task_run(AVTask *_t, void *local_context, void *user_data)
     return 0;
 }
 
+// process-wide executor for decoders with shared_executor set
+static AVMutex     shared_executor_lock = AV_MUTEX_INITIALIZER;
+static AVExecutor *shared_executor;
+static unsigned    shared_executor_users;
+
+static AVExecutor *shared_executor_attach(const AVTaskCallbacks *callbacks)
+{
+    AVExecutor *e = NULL;
+
+    ff_mutex_lock(&shared_executor_lock);
+
+    if (!shared_executor)
+        shared_executor = av_executor_alloc_shared(av_cpu_count());
+    if (shared_executor)
+        e = av_executor_attach(shared_executor, callbacks);
+    if (e)
+        shared_executor_users++;
+    else if (!shared_executor_users)
+        av_executor_free(&shared_executor);
+
+    ff_mutex_unlock(&shared_executor_lock);
+
+    return e;
+}
+
+static void shared_executor_detach(AVExecutor **e)
+{
+    ff_mutex_lock(&shared_executor_lock);
+
+    av_executor_free(e);
+    if (!--shared_executor_users)
+        av_executor_free(&shared_executor);
+
+    ff_mutex_unlock(&shared_executor_lock);
+}
+
 AVExecutor* ff_vvc_executor_alloc(VVCContext *s, const int thread_count)
 {
     AVTaskCallbacks callbacks = {
@@ -626,12 +667,19 @@ AVExecutor* ff_vvc_executor_alloc(VVCContext *s, const int thread_count)
         task_ready,
         task_run,
     };
+    if (s->shared_executor)
+        return shared_executor_attach(&callbacks);
     return av_executor_alloc(&callbacks, thread_count);
 }
 
-void ff_vvc_executor_free(AVExecutor **e)
+void ff_vvc_executor_free(VVCContext *s)
 {
-    av_executor_free(e);
+    if (!s->executor)
+        return;
+    if (s->shared_executor)
+        shared_executor_detach(&s->executor);
+    else
+        av_executor_free(&s->executor);
 }
 
 void ff_vvc_frame_thread_free(VVCFrameContext *fc)
@@ -713,6 +761,7 @@ int ff_vvc_frame_thread_init(VVCFrameContext *fc)
     }
     fc->ft = ft;
     ft->ret = 0;
+    atomic_store(&ft->blocking, 0);
     for (int y = 0; y < ft->ctu_height; y++) {
         VVCRowThread *row = ft->rows + y;
         memset(row->col_progress, 0, sizeof(row->col_progress));
@@ -799,6 +848,9 @@ int ff_vvc_frame_wait(VVCContext *s, VVCFrameContext *fc)
 {
     VVCFrameThread *ft = fc->ft;
 
+    // tasks scheduled from now on jump ahead of those of later frames
+    atomic_store(&ft->blocking, 1);
+
     ff_mutex_lock(&ft->lock);
 
     while (atomic_load(&ft->nb_scheduled_tasks) || atomic_load(&ft->nb_scheduled_listeners))
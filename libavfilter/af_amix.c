@@ -35,7 +35,6 @@
 #include "libavutil/channel_layout.h"
 #include "libavutil/common.h"
 #include "libavutil/eval.h"
-#include "libavutil/float_dsp.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
@@ -53,6 +52,8 @@
 #define DURATION_SHORTEST 1
 #define DURATION_FIRST    2
 
+#define MIN_JOB_SIZE   16384
+
 
 typedef struct FrameInfo {
     int nb_samples;
@@ -157,7 +158,6 @@ static int frame_list_add_frame(FrameList *frame_list, int nb_samples, int64_t p
 
 typedef struct MixContext {
     const AVClass *class;       /**< class for AVOptions */
-    AVFloatDSPContext *fdsp;
 
     int nb_inputs;              /**< number of inputs */
     int active_inputs;          /**< number of input currently active */
@@ -177,6 +177,11 @@ typedef struct MixContext {
     float *scale_norm;          /**< normalization factor for every input */
     int64_t next_pts;           /**< calculated pts for next output frame */
     FrameList *frame_list;      /**< list of frame info for the first input */
+
+    AVFrame **in_bufs;          /**< samples read from the FIFO of each active input */
+    float *mix_scale;           /**< scale factor of each active input */
+    const void **mix_src;       /**< per job source plane pointers */
+    int nb_mix_inputs;          /**< number of inputs being mixed */
 } MixContext;
 
 #define OFFSET(x) offsetof(MixContext, x)
@@ -276,7 +281,12 @@ static int config_output(AVFilterLink *outlink)
 
     s->input_scale = av_calloc(s->nb_inputs, sizeof(*s->input_scale));
     s->scale_norm  = av_calloc(s->nb_inputs, sizeof(*s->scale_norm));
-    if (!s->input_scale || !s->scale_norm)
+    s->in_bufs     = av_calloc(s->nb_inputs, sizeof(*s->in_bufs));
+    s->mix_scale   = av_calloc(s->nb_inputs, sizeof(*s->mix_scale));
+    s->mix_src     = av_calloc(s->nb_inputs * ff_filter_get_nb_threads(ctx),
+                               sizeof(*s->mix_src));
+    if (!s->input_scale || !s->scale_norm || !s->in_bufs ||
+        !s->mix_scale || !s->mix_src)
         return AVERROR(ENOMEM);
     for (i = 0; i < s->nb_inputs; i++)
         s->scale_norm[i] = s->weight_sum / FFABS(s->weights[i]);
@@ -291,6 +301,111 @@ static int config_output(AVFilterLink *outlink)
     return 0;
 }
 
+/**
+ * Compute dst[i] = sum(src[k][i] * scale[k]) over all nb_src inputs,
+ * accumulating the inputs in order. len must be a positive multiple of 4.
+ */
+static void mix_float(float *dst, const float *const *src,
+                      const float *scale, int nb_src, ptrdiff_t len)
+{
+    /* keep the partial sums of 4 samples in registers while going through
+     * all the inputs, so that the output is written only once */
+    for (ptrdiff_t i = 0; i < len; i += 4) {
+        float s0 = src[0][i    ] * scale[0];
+        float s1 = src[0][i + 1] * scale[0];
+        float s2 = src[0][i + 2] * scale[0];
+        float s3 = src[0][i + 3] * scale[0];
+
+        for (int k = 1; k < nb_src; k++) {
+            const float *s = src[k] + i;
+            const float mul = scale[k];
+
+            s0 += s[0] * mul;
+            s1 += s[1] * mul;
+            s2 += s[2] * mul;
+            s3 += s[3] * mul;
+        }
+
+        dst[i    ] = s0;
+        dst[i + 1] = s1;
+        dst[i + 2] = s2;
+        dst[i + 3] = s3;
+    }
+}
+
+static void mix_double(double *dst, const double *const *src,
+                       const float *scale, int nb_src, ptrdiff_t len)
+{
+    for (ptrdiff_t i = 0; i < len; i += 4) {
+        double s0 = src[0][i    ] * scale[0];
+        double s1 = src[0][i + 1] * scale[0];
+        double s2 = src[0][i + 2] * scale[0];
+        double s3 = src[0][i + 3] * scale[0];
+
+        for (int k = 1; k < nb_src; k++) {
+            const double *s = src[k] + i;
+            const double mul = scale[k];
+
+            s0 += s[0] * mul;
+            s1 += s[1] * mul;
+            s2 += s[2] * mul;
+            s3 += s[3] * mul;
+        }
+
+        dst[i    ] = s0;
+        dst[i + 1] = s1;
+        dst[i + 2] = s2;
+        dst[i + 3] = s3;
+    }
+}
+
+/**
+ * Mix the samples read from the active inputs into a range of the output
+ * planes, or into a range of the samples for packed formats.
+ */
+static int mix_channels(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    MixContext *s = ctx->priv;
+    AVFrame *out_buf = arg;
+    const void **src = s->mix_src + jobnr * s->nb_inputs;
+    const int is_float = out_buf->format == AV_SAMPLE_FMT_FLT ||
+                         out_buf->format == AV_SAMPLE_FMT_FLTP;
+    const int bps = is_float ? sizeof(float) : sizeof(double);
+    int start, end, offset, len;
+
+    if (s->planar) {
+        start  = (s->nb_channels *  jobnr     ) / nb_jobs;
+        end    = (s->nb_channels * (jobnr + 1)) / nb_jobs;
+        offset = 0;
+        len    = FFALIGN(out_buf->nb_samples, 16);
+    } else {
+        const int64_t size = FFALIGN(out_buf->nb_samples * s->nb_channels, 16) >> 4;
+
+        start  = 0;
+        end    = 1;
+        offset = ((size *  jobnr     ) / nb_jobs) << 4;
+        len    = ((size * (jobnr + 1)) / nb_jobs << 4) - offset;
+        if (!len)
+            return 0;
+    }
+
+    for (int p = start; p < end; p++) {
+        uint8_t *dst = out_buf->extended_data[p] + offset * bps;
+
+        for (int i = 0; i < s->nb_mix_inputs; i++)
+            src[i] = s->in_bufs[i]->extended_data[p] + offset * bps;
+
+        if (is_float)
+            mix_float((float *)dst, (const float *const *)src,
+                      s->mix_scale, s->nb_mix_inputs, len);
+        else
+            mix_double((double *)dst, (const double *const *)src,
+                       s->mix_scale, s->nb_mix_inputs, len);
+    }
+
+    return 0;
+}
+
 /**
  * Read samples from the input FIFOs, mix, and write to the output link.
  */
@@ -298,7 +413,7 @@ static int output_frame(AVFilterLink *outlink)
 {
     AVFilterContext *ctx = outlink->src;
     MixContext      *s = ctx->priv;
-    AVFrame *out_buf, *in_buf;
+    AVFrame *out_buf;
     int nb_samples, ns, i;
 
     if (s->input_state[0] & INPUT_ON) {
@@ -344,40 +459,39 @@ static int output_frame(AVFilterLink *outlink)
     if (!out_buf)
         return AVERROR(ENOMEM);
 
-    in_buf = ff_get_audio_buffer(outlink, nb_samples);
-    if (!in_buf) {
-        av_frame_free(&out_buf);
-        return AVERROR(ENOMEM);
-    }
-
+    s->nb_mix_inputs = 0;
     for (i = 0; i < s->nb_inputs; i++) {
         if (s->input_state[i] & INPUT_ON) {
-            int planes, plane_size, p;
+            AVFrame **in_buf = &s->in_bufs[s->nb_mix_inputs];
+
+            if (!*in_buf || (*in_buf)->nb_samples < nb_samples) {
+                av_frame_free(in_buf);
+                *in_buf = ff_get_audio_buffer(outlink, nb_samples);
+                if (!*in_buf) {
+                    av_frame_free(&out_buf);
+                    return AVERROR(ENOMEM);
+                }
+            }
+            s->mix_scale[s->nb_mix_inputs++] = s->input_scale[i];
 
-            av_audio_fifo_read(s->fifos[i], (void **)in_buf->extended_data,
+            av_audio_fifo_read(s->fifos[i], (void **)(*in_buf)->extended_data,
                                nb_samples);
+        }
+    }
 
-            planes     = s->planar ? s->nb_channels : 1;
-            plane_size = nb_samples * (s->planar ? 1 : s->nb_channels);
-            plane_size = FFALIGN(plane_size, 16);
+    if (s->nb_mix_inputs) {
+        const int planes = s->planar ? s->nb_channels : 1;
+        const int64_t work = (int64_t)nb_samples * s->nb_channels * s->nb_mix_inputs;
+        int nb_jobs;
 
-            if (out_buf->format == AV_SAMPLE_FMT_FLT ||
-                out_buf->format == AV_SAMPLE_FMT_FLTP) {
-                for (p = 0; p < planes; p++) {
-                    s->fdsp->vector_fmac_scalar((float *)out_buf->extended_data[p],
-                                                (float *) in_buf->extended_data[p],
-                                                s->input_scale[i], plane_size);
-                }
-            } else {
-                for (p = 0; p < planes; p++) {
-                    s->fdsp->vector_dmac_scalar((double *)out_buf->extended_data[p],
-                                                (double *) in_buf->extended_data[p],
-                                                s->input_scale[i], plane_size);
-                }
-            }
-        }
+        /* give every job at least MIN_JOB_SIZE multiply-adds */
+        nb_jobs = FFMAX(1, work / MIN_JOB_SIZE);
+        if (planes > 1)
+            nb_jobs = FFMIN(nb_jobs, planes);
+        nb_jobs = FFMIN(nb_jobs, ff_filter_get_nb_threads(ctx));
+
+        ff_filter_execute(ctx, mix_channels, out_buf, NULL, nb_jobs);
     }
-    av_frame_free(&in_buf);
 
     out_buf->pts = s->next_pts;
     out_buf->duration = av_rescale_q(out_buf->nb_samples, av_make_q(1, outlink->sample_rate),
@@ -559,10 +673,6 @@ static av_cold int init(AVFilterContext *ctx)
             return ret;
     }
 
-    s->fdsp = avpriv_float_dsp_alloc(0);
-    if (!s->fdsp)
-        return AVERROR(ENOMEM);
-
     s->weights = av_calloc(s->nb_inputs, sizeof(*s->weights));
     if (!s->weights)
         return AVERROR(ENOMEM);
@@ -588,7 +698,13 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_freep(&s->input_scale);
     av_freep(&s->scale_norm);
     av_freep(&s->weights);
-    av_freep(&s->fdsp);
+    if (s->in_bufs) {
+        for (i = 0; i < s->nb_inputs; i++)
+            av_frame_free(&s->in_bufs[i]);
+        av_freep(&s->in_bufs);
+    }
+    av_freep(&s->mix_scale);
+    av_freep(&s->mix_src);
 }
 
 static int process_command(AVFilterContext *ctx, const char *cmd, const char *args,
@@ -630,5 +746,6 @@ const AVFilter ff_af_amix = {
     FILTER_SAMPLEFMTS(AV_SAMPLE_FMT_FLT, AV_SAMPLE_FMT_FLTP,
                       AV_SAMPLE_FMT_DBL, AV_SAMPLE_FMT_DBLP),
     .process_command = process_command,
-    .flags          = AVFILTER_FLAG_DYNAMIC_INPUTS,
+    .flags          = AVFILTER_FLAG_DYNAMIC_INPUTS |
+                      AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -348,10 +348,10 @@ static int yae_update(AVFilterContext *ctx)
  */
 #define yae_init_xdat(scalar_type, scalar_max)                          \
     do {                                                                \
-        const uint8_t *src_end = src +                                  \
-            frag->nsamples * atempo->channels * sizeof(scalar_type);    \
+        const uint8_t *src = frag->data + start * atempo->stride;       \
+        const uint8_t *src_end = frag->data + end * atempo->stride;     \
                                                                         \
-        float *xdat = frag->xdat_in;                                    \
+        float *xdat = frag->xdat_in + start;                            \
         scalar_type tmp;                                                \
                                                                         \
         if (atempo->channels == 1) {                                    \
@@ -393,16 +393,27 @@ static int yae_update(AVFilterContext *ctx)
     } while (0)
 
 /**
- * Initialize complex data buffer of a given audio fragment
- * with down-mixed mono data of appropriate scalar type.
+ * Number of jobs for processing nsamples samples of all the channels,
+ * so that each thread gets enough work to be worth waking it up.
  */
-static void yae_downmix(ATempoContext *atempo, AudioFragment *frag)
+static int yae_nb_jobs(AVFilterContext *ctx, int64_t nsamples)
 {
-    // shortcuts:
-    const uint8_t *src = frag->data;
+    ATempoContext *atempo = ctx->priv;
+    const int64_t nb_jobs = nsamples * atempo->channels / 4096;
 
-    // init complex data buffer used for FFT and Correlation:
-    memset(frag->xdat_in, 0, sizeof(AVComplexFloat) * (atempo->window + 1));
+    return av_clip64(nb_jobs, 1, ff_filter_get_nb_threads(ctx));
+}
+
+/**
+ * Down-mix a range of samples of the fragment passed as arg.
+ */
+static int yae_downmix_slice(AVFilterContext *ctx, void *arg,
+                             int jobnr, int nb_jobs)
+{
+    ATempoContext *atempo = ctx->priv;
+    AudioFragment *frag = arg;
+    const int start = (int64_t)frag->nsamples *  jobnr      / nb_jobs;
+    const int end   = (int64_t)frag->nsamples * (jobnr + 1) / nb_jobs;
 
     if (atempo->format == AV_SAMPLE_FMT_U8) {
         yae_init_xdat(uint8_t, 127);
@@ -415,6 +426,23 @@ static void yae_downmix(ATempoContext *atempo, AudioFragment *frag)
     } else if (atempo->format == AV_SAMPLE_FMT_DBL) {
         yae_init_xdat(double, 1);
     }
+
+    return 0;
+}
+
+/**
+ * Initialize complex data buffer of a given audio fragment
+ * with down-mixed mono data of appropriate scalar type.
+ */
+static void yae_downmix(AVFilterContext *ctx, AudioFragment *frag)
+{
+    ATempoContext *atempo = ctx->priv;
+
+    // init complex data buffer used for FFT and Correlation:
+    memset(frag->xdat_in, 0, sizeof(AVComplexFloat) * (atempo->window + 1));
+
+    ff_filter_execute(ctx, yae_downmix_slice, frag, NULL,
+                      yae_nb_jobs(ctx, frag->nsamples));
 }
 
 /**
@@ -721,6 +749,14 @@ static int yae_adjust_position(ATempoContext *atempo)
     return correction;
 }
 
+typedef struct ThreadData {
+    const AudioFragment *frag;
+    const uint8_t *a, *b;
+    const float *wa, *wb;
+    uint8_t *dst;
+    int64_t nsamples;
+} ThreadData;
+
 /**
  * A helper macro for blending the overlap region of previous
  * and current audio fragment.
@@ -730,12 +766,10 @@ static int yae_adjust_position(ATempoContext *atempo)
         const scalar_type *aaa = (const scalar_type *)a;                \
         const scalar_type *bbb = (const scalar_type *)b;                \
                                                                         \
-        scalar_type *out     = (scalar_type *)dst;                      \
-        scalar_type *out_end = (scalar_type *)dst_end;                  \
+        scalar_type *out = (scalar_type *)dst;                          \
         int64_t i;                                                      \
                                                                         \
-        for (i = 0; i < overlap && out < out_end;                       \
-             i++, atempo->position[1]++, wa++, wb++) {                  \
+        for (i = start; i < end; i++, wa++, wb++) {                     \
             float w0 = *wa;                                             \
             float w1 = *wb;                                             \
             int j;                                                      \
@@ -751,9 +785,41 @@ static int yae_adjust_position(ATempoContext *atempo)
                     (scalar_type)(t0 * w0 + t1 * w1);                   \
             }                                                           \
         }                                                               \
-        dst = (uint8_t *)out;                                           \
     } while (0)
 
+/**
+ * Blend a range of samples of the overlap region.
+ */
+static int yae_blend_slice(AVFilterContext *ctx, void *arg,
+                           int jobnr, int nb_jobs)
+{
+    ATempoContext *atempo = ctx->priv;
+    const ThreadData *td = arg;
+    const AudioFragment *frag = td->frag;
+    const int64_t start = td->nsamples *  jobnr      / nb_jobs;
+    const int64_t end   = td->nsamples * (jobnr + 1) / nb_jobs;
+
+    const float *wa = td->wa + start;
+    const float *wb = td->wb + start;
+    const uint8_t *a = td->a + start * atempo->stride;
+    const uint8_t *b = td->b + start * atempo->stride;
+    uint8_t *dst = td->dst + start * atempo->stride;
+
+    if (atempo->format == AV_SAMPLE_FMT_U8) {
+        yae_blend(uint8_t);
+    } else if (atempo->format == AV_SAMPLE_FMT_S16) {
+        yae_blend(int16_t);
+    } else if (atempo->format == AV_SAMPLE_FMT_S32) {
+        yae_blend(int);
+    } else if (atempo->format == AV_SAMPLE_FMT_FLT) {
+        yae_blend(float);
+    } else if (atempo->format == AV_SAMPLE_FMT_DBL) {
+        yae_blend(double);
+    }
+
+    return 0;
+}
+
 /**
  * Blend the overlap region of previous and current audio fragment
  * and output the results to the given destination buffer.
@@ -762,11 +828,12 @@ static int yae_adjust_position(ATempoContext *atempo)
  *   0 if the overlap region was completely stored in the dst buffer,
  *   AVERROR(EAGAIN) if more destination buffer space is required.
  */
-static int yae_overlap_add(ATempoContext *atempo,
+static int yae_overlap_add(AVFilterContext *ctx,
                            uint8_t **dst_ref,
                            uint8_t *dst_end)
 {
     // shortcuts:
+    ATempoContext *atempo = ctx->priv;
     const AudioFragment *prev = yae_prev_frag(atempo);
     const AudioFragment *frag = yae_curr_frag(atempo);
 
@@ -781,32 +848,28 @@ static int yae_overlap_add(ATempoContext *atempo,
     const int64_t ia = start_here - prev->position[1];
     const int64_t ib = start_here - frag->position[1];
 
-    const float *wa = atempo->hann + ia;
-    const float *wb = atempo->hann + ib;
-
-    const uint8_t *a = prev->data + ia * atempo->stride;
-    const uint8_t *b = frag->data + ib * atempo->stride;
-
-    uint8_t *dst = *dst_ref;
+    ThreadData td;
 
     av_assert0(start_here <= stop_here &&
                frag->position[1] <= start_here &&
                overlap <= frag->nsamples);
 
-    if (atempo->format == AV_SAMPLE_FMT_U8) {
-        yae_blend(uint8_t);
-    } else if (atempo->format == AV_SAMPLE_FMT_S16) {
-        yae_blend(int16_t);
-    } else if (atempo->format == AV_SAMPLE_FMT_S32) {
-        yae_blend(int);
-    } else if (atempo->format == AV_SAMPLE_FMT_FLT) {
-        yae_blend(float);
-    } else if (atempo->format == AV_SAMPLE_FMT_DBL) {
-        yae_blend(double);
-    }
+    td.frag     = frag;
+    td.wa       = atempo->hann + ia;
+    td.wb       = atempo->hann + ib;
+    td.a        = prev->data + ia * atempo->stride;
+    td.b        = frag->data + ib * atempo->stride;
+    td.dst      = *dst_ref;
+    td.nsamples = FFMIN(overlap, (dst_end - td.dst) / atempo->stride);
+
+    if (td.nsamples > 0)
+        ff_filter_execute(ctx, yae_blend_slice, &td, NULL,
+                          yae_nb_jobs(ctx, td.nsamples));
+
+    atempo->position[1] += td.nsamples;
 
     // pass-back the updated destination buffer pointer:
-    *dst_ref = dst;
+    *dst_ref = td.dst + td.nsamples * atempo->stride;
 
     return atempo->position[1] == stop_here ? 0 : AVERROR(EAGAIN);
 }
@@ -817,12 +880,14 @@ static int yae_overlap_add(ATempoContext *atempo,
  * as it is able to produce or store.
  */
 static void
-yae_apply(ATempoContext *atempo,
+yae_apply(AVFilterContext *ctx,
           const uint8_t **src_ref,
           const uint8_t *src_end,
           uint8_t **dst_ref,
           uint8_t *dst_end)
 {
+    ATempoContext *atempo = ctx->priv;
+
     while (1) {
         if (atempo->state == YAE_LOAD_FRAGMENT) {
             // load additional data for the current fragment:
@@ -831,7 +896,7 @@ yae_apply(ATempoContext *atempo,
             }
 
             // down-mix to mono:
-            yae_downmix(atempo, yae_curr_frag(atempo));
+            yae_downmix(ctx, yae_curr_frag(atempo));
 
             // apply rDFT:
             atempo->r2c_fn(atempo->real_to_complex, yae_curr_frag(atempo)->xdat, yae_curr_frag(atempo)->xdat_in, sizeof(float));
@@ -863,7 +928,7 @@ yae_apply(ATempoContext *atempo,
             }
 
             // down-mix to mono:
-            yae_downmix(atempo, yae_curr_frag(atempo));
+            yae_downmix(ctx, yae_curr_frag(atempo));
 
             // apply rDFT:
             atempo->r2c_fn(atempo->real_to_complex, yae_curr_frag(atempo)->xdat, yae_curr_frag(atempo)->xdat_in, sizeof(float));
@@ -873,7 +938,7 @@ yae_apply(ATempoContext *atempo,
 
         if (atempo->state == YAE_OUTPUT_OVERLAP_ADD) {
             // overlap-add and output the result:
-            if (yae_overlap_add(atempo, dst_ref, dst_end) != 0) {
+            if (yae_overlap_add(ctx, dst_ref, dst_end) != 0) {
                 break;
             }
 
@@ -891,10 +956,11 @@ yae_apply(ATempoContext *atempo,
  *   0 if all data was completely stored in the dst buffer,
  *   AVERROR(EAGAIN) if more destination buffer space is required.
  */
-static int yae_flush(ATempoContext *atempo,
+static int yae_flush(AVFilterContext *ctx,
                      uint8_t **dst_ref,
                      uint8_t *dst_end)
 {
+    ATempoContext *atempo = ctx->priv;
     AudioFragment *frag = yae_curr_frag(atempo);
     int64_t overlap_end;
     int64_t start_here;
@@ -927,7 +993,7 @@ static int yae_flush(ATempoContext *atempo,
 
         if (atempo->nfrag) {
             // down-mix to mono:
-            yae_downmix(atempo, frag);
+            yae_downmix(ctx, frag);
 
             // apply rDFT:
             atempo->r2c_fn(atempo->real_to_complex, frag->xdat, frag->xdat_in, sizeof(float));
@@ -945,7 +1011,7 @@ static int yae_flush(ATempoContext *atempo,
                                             frag->nsamples);
 
     while (atempo->position[1] < overlap_end) {
-        if (yae_overlap_add(atempo, dst_ref, dst_end) != 0) {
+        if (yae_overlap_add(ctx, dst_ref, dst_end) != 0) {
             return AVERROR(EAGAIN);
         }
     }
@@ -1077,7 +1143,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *src_buffer)
             atempo->dst_end = atempo->dst + n_out * atempo->stride;
         }
 
-        yae_apply(atempo, &src, src_end, &atempo->dst, atempo->dst_end);
+        yae_apply(ctx, &src, src_end, &atempo->dst, atempo->dst_end);
 
         if (atempo->dst == atempo->dst_end) {
             int n_samples = ((atempo->dst - atempo->dst_buffer->data[0]) /
@@ -1118,7 +1184,7 @@ static int request_frame(AVFilterLink *outlink)
                 atempo->dst_end = atempo->dst + n_max * atempo->stride;
             }
 
-            err = yae_flush(atempo, &atempo->dst, atempo->dst_end);
+            err = yae_flush(ctx, &atempo->dst, atempo->dst_end);
 
             n_out = ((atempo->dst - atempo->dst_buffer->data[0]) /
                      atempo->stride);
@@ -1183,4 +1249,5 @@ const AVFilter ff_af_atempo = {
     FILTER_INPUTS(atempo_inputs),
     FILTER_OUTPUTS(atempo_outputs),
     FILTER_SAMPLEFMTS_ARRAY(sample_fmts),
+    .flags           = AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -153,6 +153,10 @@ typedef struct BiquadsContext {
 
     void (*filter)(struct BiquadsContext *s, const void *ibuf, void *obuf, int len,
                    void *cache, int *clip, int disabled);
+    /* filters nb_lanes channels at once, optional */
+    void (*filter_multi)(struct BiquadsContext *s, const void *const *ibuf,
+                         void *const *obuf, int len, void *const *cache,
+                         int nb_lanes);
 } BiquadsContext;
 
 static int query_formats(AVFilterContext *ctx)
@@ -280,6 +284,90 @@ BIQUAD_FILTER(s32, int32_t, double, INT32_MIN, INT32_MAX, 1)
 BIQUAD_FILTER(flt, float,   float,  -1.f, 1.f, 0)
 BIQUAD_FILTER(dbl, double,  double, -1.,  1.,  0)
 
+/* Number of channels filtered together by the multichannel kernels. The
+ * recursion of a channel cannot be split along time, but the recursions of
+ * different channels are independent, so running them side by side hides
+ * their latency. */
+#define MAX_LANES 4
+
+#define BIQUAD_LANES_FILTER(name, type)                                       \
+static av_always_inline void biquad_lanes_## name (BiquadsContext *s,         \
+                                    const void *const *input,                 \
+                                    void *const *output, int len,             \
+                                    void *const *cache, const int nb_lanes)   \
+{                                                                             \
+    const type *ibuf[MAX_LANES];                                              \
+    type *obuf[MAX_LANES];                                                    \
+    type i1[MAX_LANES], i2[MAX_LANES], o1[MAX_LANES], o2[MAX_LANES];          \
+    type *a = s->a_##type;                                                    \
+    type *b = s->b_##type;                                                    \
+    type a1 = -a[1];                                                          \
+    type a2 = -a[2];                                                          \
+    type b0 = b[0];                                                           \
+    type b1 = b[1];                                                           \
+    type b2 = b[2];                                                           \
+    type wet = s->mix;                                                        \
+    type dry = 1. - wet;                                                      \
+    int i, l;                                                                 \
+                                                                              \
+    for (l = 0; l < nb_lanes; l++) {                                          \
+        const type *fcache = cache[l];                                        \
+        ibuf[l] = input[l];                                                   \
+        obuf[l] = output[l];                                                  \
+        i1[l] = fcache[0];                                                    \
+        i2[l] = fcache[1];                                                    \
+        o1[l] = fcache[2];                                                    \
+        o2[l] = fcache[3];                                                    \
+    }                                                                         \
+                                                                              \
+    for (i = 0; i+1 < len; i += 2) {                                          \
+        for (l = 0; l < nb_lanes; l++) {                                      \
+            o2[l] = i2[l] * b2 + i1[l] * b1 + ibuf[l][i] * b0 + o2[l] * a2 + o1[l] * a1; \
+            i2[l] = ibuf[l][i];                                               \
+            obuf[l][i] = o2[l] * wet + i2[l] * dry;                           \
+        }                                                                     \
+        for (l = 0; l < nb_lanes; l++) {                                      \
+            o1[l] = i1[l] * b2 + i2[l] * b1 + ibuf[l][i+1] * b0 + o1[l] * a2 + o2[l] * a1; \
+            i1[l] = ibuf[l][i+1];                                             \
+            obuf[l][i+1] = o1[l] * wet + i1[l] * dry;                         \
+        }                                                                     \
+    }                                                                         \
+    if (i < len) {                                                            \
+        for (l = 0; l < nb_lanes; l++) {                                      \
+            type o0 = ibuf[l][i] * b0 + i1[l] * b1 + i2[l] * b2 + o1[l] * a1 + o2[l] * a2; \
+            i2[l] = i1[l];                                                    \
+            i1[l] = ibuf[l][i];                                               \
+            o2[l] = o1[l];                                                    \
+            o1[l] = o0;                                                       \
+            obuf[l][i] = o0 * wet + i1[l] * dry;                              \
+        }                                                                     \
+    }                                                                         \
+                                                                              \
+    for (l = 0; l < nb_lanes; l++) {                                          \
+        type *fcache = cache[l];                                              \
+        fcache[0] = i1[l];                                                    \
+        fcache[1] = i2[l];                                                    \
+        fcache[2] = o1[l];                                                    \
+        fcache[3] = o2[l];                                                    \
+    }                                                                         \
+}                                                                             \
+                                                                              \
+static void biquad_multi_## name (BiquadsContext *s,                          \
+                                  const void *const *input,                   \
+                                  void *const *output, int len,               \
+                                  void *const *cache, int nb_lanes)           \
+{                                                                             \
+    switch (nb_lanes) {                                                       \
+    case 4: biquad_lanes_## name (s, input, output, len, cache, 4); break;    \
+    case 3: biquad_lanes_## name (s, input, output, len, cache, 3); break;    \
+    case 2: biquad_lanes_## name (s, input, output, len, cache, 2); break;    \
+    case 1: biquad_lanes_## name (s, input, output, len, cache, 1); break;    \
+    }                                                                         \
+}
+
+BIQUAD_LANES_FILTER(flt, float)
+BIQUAD_LANES_FILTER(dbl, double)
+
 #define BIQUAD_DII_FILTER(name, type, ftype, min, max, need_clipping)         \
 static void biquad_dii_## name (BiquadsContext *s,                            \
                             const void *input, void *output, int len,         \
@@ -1048,6 +1136,7 @@ static int config_filter(AVFilterLink *outlink, int reset)
         }
     }
 
+    s->filter_multi = NULL;
     switch (s->transform_type) {
     case DI:
         switch (inlink->format) {
@@ -1059,9 +1148,11 @@ static int config_filter(AVFilterLink *outlink, int reset)
             break;
         case AV_SAMPLE_FMT_FLTP:
             s->filter = biquad_flt;
+            s->filter_multi = biquad_multi_flt;
             break;
         case AV_SAMPLE_FMT_DBLP:
             s->filter = biquad_dbl;
+            s->filter_multi = biquad_multi_dbl;
             break;
         default: av_assert0(0);
         }
@@ -1245,7 +1336,10 @@ static int filter_channel(AVFilterContext *ctx, void *arg, int jobnr, int nb_job
     BiquadsContext *s = ctx->priv;
     const int start = (buf->ch_layout.nb_channels * jobnr) / nb_jobs;
     const int end = (buf->ch_layout.nb_channels * (jobnr+1)) / nb_jobs;
-    int ch;
+    const int multi = s->filter_multi && !s->block_samples && !ctx->is_disabled;
+    const void *ibufs[MAX_LANES];
+    void *obufs[MAX_LANES], *caches[MAX_LANES];
+    int ch, nb_lanes = 0;
 
     for (ch = start; ch < end; ch++) {
         enum AVChannel channel = av_channel_layout_channel_from_index(&inlink->ch_layout, ch);
@@ -1257,7 +1351,15 @@ static int filter_channel(AVFilterContext *ctx, void *arg, int jobnr, int nb_job
             continue;
         }
 
-        if (!s->block_samples) {
+        if (multi) {
+            ibufs[nb_lanes]  = buf->extended_data[ch];
+            obufs[nb_lanes]  = out_buf->extended_data[ch];
+            caches[nb_lanes] = s->cache[0]->extended_data[ch];
+            if (++nb_lanes == MAX_LANES) {
+                s->filter_multi(s, ibufs, obufs, buf->nb_samples, caches, nb_lanes);
+                nb_lanes = 0;
+            }
+        } else if (!s->block_samples) {
             s->filter(s, buf->extended_data[ch], out_buf->extended_data[ch], buf->nb_samples,
                       s->cache[0]->extended_data[ch], s->clip+ch, ctx->is_disabled);
         } else if (td->eof) {
@@ -1290,6 +1392,9 @@ static int filter_channel(AVFilterContext *ctx, void *arg, int jobnr, int nb_job
         }
     }
 
+    if (nb_lanes)
+        s->filter_multi(s, ibufs, obufs, buf->nb_samples, caches, nb_lanes);
+
     return 0;
 }
 
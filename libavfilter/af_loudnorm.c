@@ -765,6 +765,9 @@ static int config_input(AVFilterLink *inlink)
     if (!s->r128_out)
         return AVERROR(ENOMEM);
 
+    ff_ebur128_set_thread_context(s->r128_in,  ctx);
+    ff_ebur128_set_thread_context(s->r128_out, ctx);
+
     if (inlink->ch_layout.nb_channels == 1 && s->dual_mono) {
         ff_ebur128_set_channel(s->r128_in,  0, FF_EBUR128_DUAL_MONO);
         ff_ebur128_set_channel(s->r128_out, 0, FF_EBUR128_DUAL_MONO);
@@ -936,6 +939,7 @@ const AVFilter ff_af_loudnorm = {
     .init          = init,
     .activate      = activate,
     .uninit        = uninit,
+    .flags         = AVFILTER_FLAG_SLICE_THREADS,
     FILTER_INPUTS(avfilter_af_loudnorm_inputs),
     FILTER_OUTPUTS(ff_audio_default_filterpad),
     FILTER_QUERY_FUNC(query_formats),
@@ -807,6 +807,7 @@ void avfilter_free(AVFilterContext *filter)
         av_opt_free(filter->priv);
 
     av_buffer_unref(&filter->hw_device_ctx);
+    av_buffer_account_unref(&filter->mem_account);
 
     av_freep(&filter->name);
     av_freep(&filter->input_pads);
@@ -1049,6 +1050,13 @@ int ff_filter_frame(AVFilterLink *link, AVFrame *frame)
                                        link->time_base);
     }
 
+    if (link->src->mem_account) {
+        for (int i = 0; i < FF_ARRAY_ELEMS(frame->buf) && frame->buf[i]; i++)
+            av_buffer_account_add(frame->buf[i], link->src->mem_account);
+        for (int i = 0; i < frame->nb_extended_buf; i++)
+            av_buffer_account_add(frame->extended_buf[i], link->src->mem_account);
+    }
+
     li->frame_blocked_in = link->frame_wanted_out = 0;
     link->frame_count_in++;
     link->sample_count_in += frame->nb_samples;
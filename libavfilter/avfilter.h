@@ -490,6 +490,18 @@ struct AVFilterContext {
      * configured.
      */
     int extra_hw_frames;
+
+    /**
+     * Account charged with the memory of the frames output by this filter,
+     * for as long as they are referenced, unless they are charged to another
+     * account already, e.g. frames passed through from an input. See
+     * AVBufferAccount.
+     *
+     * May be set by the caller to a reference to an account before any frame
+     * is sent through the filter. The reference is owned and released by
+     * libavfilter in avfilter_free() afterwards.
+     */
+    AVBufferAccount *mem_account;
 };
 
 /**
@@ -34,6 +34,10 @@ typedef struct FilterLinkInternal {
     AVFilterLink l;
 
     struct FFFramePool *frame_pool;
+    /**
+     * Allocator the video frame_pool was created with.
+     */
+    AVBufferRef *(*frame_pool_alloc)(size_t size);
 
     /**
      * Queue of frames waiting to be filtered.
@@ -103,6 +107,12 @@ typedef struct FFFilterGraph {
 
     unsigned disable_auto_convert;
 
+    /**
+     * Allocate the default video frame pools of the links with
+     * av_buffer_alloc_hugepages().
+     */
+    int hugepages;
+
     void *thread;
     avfilter_execute_func *thread_execute;
     FFFrameQueueGlobal frame_queues;
@@ -47,12 +47,16 @@
 #include <limits.h>
 #include <math.h>               /* You may have to define _USE_MATH_DEFINES if you use MSVC */
 
+#include "libavutil/attributes.h"
 #include "libavutil/error.h"
 #include "libavutil/macros.h"
 #include "libavutil/mem.h"
 #include "libavutil/mem_internal.h"
 #include "libavutil/thread.h"
 
+#include "avfilter.h"
+#include "internal.h"
+
 #define CHECK_ERROR(condition, errorcode, goto_point)                          \
     if ((condition)) {                                                         \
         errcode = (errorcode);                                                 \
@@ -66,11 +70,12 @@
 #define MINUS_20DB            pow(10.0, -20.0 / 10.0)
 
 struct FFEBUR128StateInternal {
-    /** Filtered audio data (used as ring buffer). */
+    /** Filtered audio data, one ring buffer of audio_data_frames samples per
+     *  channel. */
     double *audio_data;
-    /** Size of audio_data array. */
+    /** Size of the ring buffer of each channel. */
     size_t audio_data_frames;
-    /** Current index for audio_data. */
+    /** Current index for audio_data, in frames. */
     size_t audio_data_index;
     /** How many frames are needed for a gating block. Will correspond to 400ms
      *  of audio at initialization, and 100ms after the first block (75% overlap
@@ -84,8 +89,8 @@ struct FFEBUR128StateInternal {
     double b[5];
     /** BS.1770 filter coefficients (denominator). */
     double a[5];
-    /** BS.1770 filter state. */
-    double v[5][5];
+    /** BS.1770 filter state, one per channel. */
+    double (*v)[4];
     /** Histograms, used to calculate LRA. */
     unsigned long *block_energy_histogram;
     unsigned long *short_term_block_energy_histogram;
@@ -95,8 +100,15 @@ struct FFEBUR128StateInternal {
     double *sample_peak;
     /** The maximum window duration in ms. */
     unsigned long window;
-    /** Data pointer array for interleaved data */
-    void **data_ptrs;
+    /** Energy sums of the last gating and short term blocks, one per channel. */
+    double *block_sums;
+    double *short_term_sums;
+    /** Energy of the short term block ending at the current position, valid
+     *  if short_term_energy_valid is set. */
+    double short_term_energy;
+    int short_term_energy_valid;
+    /** Filter instance whose threads process the channels, or NULL. */
+    struct AVFilterContext *thread_ctx;
 };
 
 static AVOnce histogram_init = AV_ONCE_INIT;
@@ -146,8 +158,8 @@ static void ebur128_init_filter(FFEBUR128State * st)
     st->d->a[3] = pa[1] * ra[2] + pa[2] * ra[1];
     st->d->a[4] = pa[2] * ra[2];
 
-    for (i = 0; i < 5; ++i) {
-        for (j = 0; j < 5; ++j) {
+    for (i = 0; i < st->channels; ++i) {
+        for (j = 0; j < 4; ++j) {
             st->d->v[i][j] = 0.0;
         }
     }
@@ -226,7 +238,7 @@ FFEBUR128State *ff_ebur128_init(unsigned int channels,
     st = (FFEBUR128State *) av_malloc(sizeof(*st));
     CHECK_ERROR(!st, 0, exit)
     st->d = (struct FFEBUR128StateInternal *)
-        av_malloc(sizeof(*st->d));
+        av_mallocz(sizeof(*st->d));
     CHECK_ERROR(!st->d, 0, free_state)
     st->channels = channels;
     errcode = ebur128_init_channel_map(st);
@@ -258,11 +270,13 @@ FFEBUR128State *ff_ebur128_init(unsigned int channels,
                              st->channels * sizeof(*st->d->audio_data));
     CHECK_ERROR(!st->d->audio_data, 0, free_sample_peak)
 
+    st->d->v = av_malloc_array(channels, sizeof(*st->d->v));
+    CHECK_ERROR(!st->d->v, 0, free_audio_data)
     ebur128_init_filter(st);
 
     st->d->block_energy_histogram =
         av_mallocz(1000 * sizeof(*st->d->block_energy_histogram));
-    CHECK_ERROR(!st->d->block_energy_histogram, 0, free_audio_data)
+    CHECK_ERROR(!st->d->block_energy_histogram, 0, free_filter_state)
     st->d->short_term_block_energy_histogram =
         av_mallocz(1000 * sizeof(*st->d->short_term_block_energy_histogram));
     CHECK_ERROR(!st->d->short_term_block_energy_histogram, 0,
@@ -277,16 +291,22 @@ FFEBUR128State *ff_ebur128_init(unsigned int channels,
     if (ff_thread_once(&histogram_init, &init_histogram) != 0)
         goto free_short_term_block_energy_histogram;
 
-    st->d->data_ptrs = av_malloc_array(channels, sizeof(*st->d->data_ptrs));
-    CHECK_ERROR(!st->d->data_ptrs, 0,
+    st->d->block_sums = av_calloc(channels, sizeof(*st->d->block_sums));
+    CHECK_ERROR(!st->d->block_sums, 0,
                 free_short_term_block_energy_histogram);
+    st->d->short_term_sums = av_calloc(channels, sizeof(*st->d->short_term_sums));
+    CHECK_ERROR(!st->d->short_term_sums, 0, free_block_sums);
 
     return st;
 
+free_block_sums:
+    av_free(st->d->block_sums);
 free_short_term_block_energy_histogram:
     av_free(st->d->short_term_block_energy_histogram);
 free_block_energy_histogram:
     av_free(st->d->block_energy_histogram);
+free_filter_state:
+    av_free(st->d->v);
 free_audio_data:
     av_free(st->d->audio_data);
 free_sample_peak:
@@ -308,62 +328,193 @@ void ff_ebur128_destroy(FFEBUR128State ** st)
     av_free((*st)->d->audio_data);
     av_free((*st)->d->channel_map);
     av_free((*st)->d->sample_peak);
-    av_free((*st)->d->data_ptrs);
+    av_free((*st)->d->v);
+    av_free((*st)->d->block_sums);
+    av_free((*st)->d->short_term_sums);
     av_free((*st)->d);
     av_free(*st);
     *st = NULL;
 }
 
-#define EBUR128_FILTER(type, scaling_factor)                                       \
-static void ebur128_filter_##type(FFEBUR128State* st, const type** srcs,           \
-                                  size_t src_index, size_t frames,                 \
-                                  int stride) {                                    \
-    double* audio_data = st->d->audio_data + st->d->audio_data_index;              \
-    size_t i, c;                                                                   \
-                                                                                   \
-    if ((st->mode & FF_EBUR128_MODE_SAMPLE_PEAK) == FF_EBUR128_MODE_SAMPLE_PEAK) { \
-        for (c = 0; c < st->channels; ++c) {                                       \
-            double max = 0.0;                                                      \
-            for (i = 0; i < frames; ++i) {                                         \
-                type v = srcs[c][src_index + i * stride];                          \
-                if (v > max) {                                                     \
-                    max =        v;                                                \
-                } else if (-v > max) {                                             \
-                    max = -1.0 * v;                                                \
-                }                                                                  \
-            }                                                                      \
-            max /= scaling_factor;                                                 \
-            if (max > st->d->sample_peak[c]) st->d->sample_peak[c] = max;          \
-        }                                                                          \
-    }                                                                              \
-    for (c = 0; c < st->channels; ++c) {                                           \
-        int ci = st->d->channel_map[c] - 1;                                        \
-        if (ci < 0) continue;                                                      \
-        else if (ci == FF_EBUR128_DUAL_MONO - 1) ci = 0; /*dual mono */            \
-        for (i = 0; i < frames; ++i) {                                             \
-            st->d->v[ci][0] = (double) (srcs[c][src_index + i * stride] / scaling_factor) \
-                         - st->d->a[1] * st->d->v[ci][1]                           \
-                         - st->d->a[2] * st->d->v[ci][2]                           \
-                         - st->d->a[3] * st->d->v[ci][3]                           \
-                         - st->d->a[4] * st->d->v[ci][4];                          \
-            audio_data[i * st->channels + c] =                                     \
-                           st->d->b[0] * st->d->v[ci][0]                           \
-                         + st->d->b[1] * st->d->v[ci][1]                           \
-                         + st->d->b[2] * st->d->v[ci][2]                           \
-                         + st->d->b[3] * st->d->v[ci][3]                           \
-                         + st->d->b[4] * st->d->v[ci][4];                          \
-            st->d->v[ci][4] = st->d->v[ci][3];                                     \
-            st->d->v[ci][3] = st->d->v[ci][2];                                     \
-            st->d->v[ci][2] = st->d->v[ci][1];                                     \
-            st->d->v[ci][1] = st->d->v[ci][0];                                     \
-        }                                                                          \
-        st->d->v[ci][4] = fabs(st->d->v[ci][4]) < DBL_MIN ? 0.0 : st->d->v[ci][4]; \
-        st->d->v[ci][3] = fabs(st->d->v[ci][3]) < DBL_MIN ? 0.0 : st->d->v[ci][3]; \
-        st->d->v[ci][2] = fabs(st->d->v[ci][2]) < DBL_MIN ? 0.0 : st->d->v[ci][2]; \
-        st->d->v[ci][1] = fabs(st->d->v[ci][1]) < DBL_MIN ? 0.0 : st->d->v[ci][1]; \
-    }                                                                              \
+/* Number of channels filtered together. The filters of the channels are
+ * independent, so interleaving them hides the latency of their recursion. */
+#define MAX_LANES 4
+
+typedef struct EBUR128ThreadData {
+    FFEBUR128State *st;
+    const double *src;
+    size_t frames;
+    /** Sizes of the gating and short term blocks ending after the filtered
+     *  frames whose energy is wanted, 0 if none. */
+    size_t block_frames;
+    size_t short_term_frames;
+} EBUR128ThreadData;
+
+static av_always_inline void filter_lanes(FFEBUR128State *st, const int *ch,
+                                          const int nb_lanes, const double *src,
+                                          size_t frames)
+{
+    struct FFEBUR128StateInternal *d = st->d;
+    const double a1 = d->a[1], a2 = d->a[2], a3 = d->a[3], a4 = d->a[4];
+    const double b0 = d->b[0], b1 = d->b[1], b2 = d->b[2], b3 = d->b[3], b4 = d->b[4];
+    const int stride = st->channels;
+    double v1[MAX_LANES], v2[MAX_LANES], v3[MAX_LANES], v4[MAX_LANES];
+    double *dst[MAX_LANES];
+    const double *in[MAX_LANES];
+    size_t i;
+    int l;
+
+    for (l = 0; l < nb_lanes; l++) {
+        v1[l]  = d->v[ch[l]][0];
+        v2[l]  = d->v[ch[l]][1];
+        v3[l]  = d->v[ch[l]][2];
+        v4[l]  = d->v[ch[l]][3];
+        in[l]  = src + ch[l];
+        dst[l] = d->audio_data + ch[l] * d->audio_data_frames + d->audio_data_index;
+    }
+
+    for (i = 0; i < frames; i++) {
+        for (l = 0; l < nb_lanes; l++) {
+            const double v0 = in[l][i * stride] - a1 * v1[l] - a2 * v2[l]
+                                                - a3 * v3[l] - a4 * v4[l];
+            dst[l][i] = b0 * v0 + b1 * v1[l] + b2 * v2[l] + b3 * v3[l] + b4 * v4[l];
+            v4[l] = v3[l];
+            v3[l] = v2[l];
+            v2[l] = v1[l];
+            v1[l] = v0;
+        }
+    }
+
+    for (l = 0; l < nb_lanes; l++) {
+        d->v[ch[l]][0] = fabs(v1[l]) < DBL_MIN ? 0.0 : v1[l];
+        d->v[ch[l]][1] = fabs(v2[l]) < DBL_MIN ? 0.0 : v2[l];
+        d->v[ch[l]][2] = fabs(v3[l]) < DBL_MIN ? 0.0 : v3[l];
+        d->v[ch[l]][3] = fabs(v4[l]) < DBL_MIN ? 0.0 : v4[l];
+    }
+}
+
+static av_always_inline void sum_squares_lanes(const double *const *data,
+                                               const int nb_lanes,
+                                               size_t start, size_t end,
+                                               double *sums)
+{
+    size_t i;
+    int l;
+
+    for (i = start; i < end; i++)
+        for (l = 0; l < nb_lanes; l++)
+            sums[l] += data[l][i] * data[l][i];
+}
+
+/* The sums are done in the same order as with a single channel, so that the
+ * result does not depend on how the channels are grouped. */
+static av_always_inline void energy_lanes(FFEBUR128State *st, const int *ch,
+                                          const int nb_lanes, size_t index,
+                                          size_t frames_per_block, double *out)
+{
+    struct FFEBUR128StateInternal *d = st->d;
+    const double *data[MAX_LANES];
+    double sums[MAX_LANES];
+    int l;
+
+    for (l = 0; l < nb_lanes; l++) {
+        data[l] = d->audio_data + ch[l] * d->audio_data_frames;
+        sums[l] = 0.0;
+    }
+
+    if (index < frames_per_block) {
+        sum_squares_lanes(data, nb_lanes, 0, index, sums);
+        sum_squares_lanes(data, nb_lanes,
+                          d->audio_data_frames - (frames_per_block - index),
+                          d->audio_data_frames, sums);
+    } else {
+        sum_squares_lanes(data, nb_lanes, index - frames_per_block, index, sums);
+    }
+
+    for (l = 0; l < nb_lanes; l++)
+        out[ch[l]] = sums[l];
+}
+
+static void filter_group(FFEBUR128State *st, const int *ch, int nb_lanes,
+                         const double *src, size_t frames)
+{
+    switch (nb_lanes) {
+    case 4: filter_lanes(st, ch, 4, src, frames); break;
+    case 3: filter_lanes(st, ch, 3, src, frames); break;
+    case 2: filter_lanes(st, ch, 2, src, frames); break;
+    case 1: filter_lanes(st, ch, 1, src, frames); break;
+    }
+}
+
+static void energy_group(FFEBUR128State *st, const int *ch, int nb_lanes,
+                         size_t index, size_t frames_per_block, double *out)
+{
+    switch (nb_lanes) {
+    case 4: energy_lanes(st, ch, 4, index, frames_per_block, out); break;
+    case 3: energy_lanes(st, ch, 3, index, frames_per_block, out); break;
+    case 2: energy_lanes(st, ch, 2, index, frames_per_block, out); break;
+    case 1: energy_lanes(st, ch, 1, index, frames_per_block, out); break;
+    }
+}
+
+static void sample_peak(FFEBUR128State *st, int c, const double *src,
+                        size_t frames)
+{
+    double max = 0.0;
+    size_t i;
+
+    for (i = 0; i < frames; ++i) {
+        double v = src[i * st->channels + c];
+        if (v > max) {
+            max =        v;
+        } else if (-v > max) {
+            max = -1.0 * v;
+        }
+    }
+    if (max > st->d->sample_peak[c])
+        st->d->sample_peak[c] = max;
+}
+
+/**
+ * Filter a range of channels and compute the energies of the blocks ending
+ * after the filtered frames.
+ */
+static int ebur128_filter_channels(struct AVFilterContext *ctx, void *arg,
+                                   int jobnr, int nb_jobs)
+{
+    EBUR128ThreadData *td = arg;
+    FFEBUR128State *st = td->st;
+    const int start = st->channels *  jobnr      / nb_jobs;
+    const int end   = st->channels * (jobnr + 1) / nb_jobs;
+    const size_t index = st->d->audio_data_index + td->frames;
+    int ch[MAX_LANES];
+    int c = start;
+
+    if ((st->mode & FF_EBUR128_MODE_SAMPLE_PEAK) == FF_EBUR128_MODE_SAMPLE_PEAK) {
+        for (c = start; c < end; c++)
+            sample_peak(st, c, td->src, td->frames);
+    }
+
+    for (c = start; c < end;) {
+        int nb_lanes = 0;
+
+        for (; c < end && nb_lanes < MAX_LANES; c++)
+            if (st->d->channel_map[c] != FF_EBUR128_UNUSED)
+                ch[nb_lanes++] = c;
+        if (!nb_lanes)
+            break;
+
+        filter_group(st, ch, nb_lanes, td->src, td->frames);
+        if (td->block_frames)
+            energy_group(st, ch, nb_lanes, index, td->block_frames,
+                         st->d->block_sums);
+        if (td->short_term_frames)
+            energy_group(st, ch, nb_lanes, index, td->short_term_frames,
+                         st->d->short_term_sums);
+    }
+
+    return 0;
 }
-EBUR128_FILTER(double, 1.0)
 
 static double ebur128_energy_to_loudness(double energy)
 {
@@ -388,40 +539,17 @@ static size_t find_histogram_index(double energy)
     return index_min;
 }
 
-static void ebur128_calc_gating_block(FFEBUR128State * st,
-                                      size_t frames_per_block,
-                                      double *optional_output)
+static double ebur128_weighted_energy(FFEBUR128State * st,
+                                      const double *channel_sums,
+                                      size_t frames_per_block)
 {
-    size_t i, c;
+    size_t c;
     double sum = 0.0;
     double channel_sum;
     for (c = 0; c < st->channels; ++c) {
         if (st->d->channel_map[c] == FF_EBUR128_UNUSED)
             continue;
-        channel_sum = 0.0;
-        if (st->d->audio_data_index < frames_per_block * st->channels) {
-            for (i = 0; i < st->d->audio_data_index / st->channels; ++i) {
-                channel_sum += st->d->audio_data[i * st->channels + c] *
-                    st->d->audio_data[i * st->channels + c];
-            }
-            for (i = st->d->audio_data_frames -
-                 (frames_per_block -
-                  st->d->audio_data_index / st->channels);
-                 i < st->d->audio_data_frames; ++i) {
-                channel_sum += st->d->audio_data[i * st->channels + c] *
-                    st->d->audio_data[i * st->channels + c];
-            }
-        } else {
-            for (i =
-                 st->d->audio_data_index / st->channels - frames_per_block;
-                 i < st->d->audio_data_index / st->channels; ++i) {
-                channel_sum +=
-                    st->d->audio_data[i * st->channels +
-                                      c] * st->d->audio_data[i *
-                                                             st->channels +
-                                                             c];
-            }
-        }
+        channel_sum = channel_sums[c];
         if (st->d->channel_map[c] == FF_EBUR128_Mp110 ||
             st->d->channel_map[c] == FF_EBUR128_Mm110 ||
             st->d->channel_map[c] == FF_EBUR128_Mp060 ||
@@ -434,12 +562,13 @@ static void ebur128_calc_gating_block(FFEBUR128State * st,
         }
         sum += channel_sum;
     }
-    sum /= (double) frames_per_block;
-    if (optional_output) {
-        *optional_output = sum;
-    } else if (sum >= histogram_energy_boundaries[0]) {
-        ++st->d->block_energy_histogram[find_histogram_index(sum)];
-    }
+    return sum / (double) frames_per_block;
+}
+
+static void ebur128_add_block_energy(unsigned long *histogram, double energy)
+{
+    if (energy >= histogram_energy_boundaries[0])
+        ++histogram[find_histogram_index(energy)];
 }
 
 int ff_ebur128_set_channel(FFEBUR128State * st,
@@ -456,61 +585,72 @@ int ff_ebur128_set_channel(FFEBUR128State * st,
     return 0;
 }
 
-static int ebur128_energy_shortterm(FFEBUR128State * st, double *out);
-#define EBUR128_ADD_FRAMES_PLANAR(type)                                                \
-static void ebur128_add_frames_planar_##type(FFEBUR128State* st, const type** srcs,    \
-                                 size_t frames, int stride) {                          \
-    size_t src_index = 0;                                                              \
-    while (frames > 0) {                                                               \
-        if (frames >= st->d->needed_frames) {                                          \
-            ebur128_filter_##type(st, srcs, src_index, st->d->needed_frames, stride);  \
-            src_index += st->d->needed_frames * stride;                                \
-            frames -= st->d->needed_frames;                                            \
-            st->d->audio_data_index += st->d->needed_frames * st->channels;            \
-            /* calculate the new gating block */                                       \
-            if ((st->mode & FF_EBUR128_MODE_I) == FF_EBUR128_MODE_I) {                 \
-                ebur128_calc_gating_block(st, st->d->samples_in_100ms * 4, NULL);      \
-            }                                                                          \
-            if ((st->mode & FF_EBUR128_MODE_LRA) == FF_EBUR128_MODE_LRA) {             \
-                st->d->short_term_frame_counter += st->d->needed_frames;               \
-                if (st->d->short_term_frame_counter == st->d->samples_in_100ms * 30) { \
-                    double st_energy;                                                  \
-                    ebur128_energy_shortterm(st, &st_energy);                          \
-                    if (st_energy >= histogram_energy_boundaries[0]) {                 \
-                        ++st->d->short_term_block_energy_histogram[                    \
-                                                    find_histogram_index(st_energy)];  \
-                    }                                                                  \
-                    st->d->short_term_frame_counter = st->d->samples_in_100ms * 20;    \
-                }                                                                      \
-            }                                                                          \
-            /* 100ms are needed for all blocks besides the first one */                \
-            st->d->needed_frames = st->d->samples_in_100ms;                            \
-            /* reset audio_data_index when buffer full */                              \
-            if (st->d->audio_data_index == st->d->audio_data_frames * st->channels) {  \
-                st->d->audio_data_index = 0;                                           \
-            }                                                                          \
-        } else {                                                                       \
-            ebur128_filter_##type(st, srcs, src_index, frames, stride);                \
-            st->d->audio_data_index += frames * st->channels;                          \
-            if ((st->mode & FF_EBUR128_MODE_LRA) == FF_EBUR128_MODE_LRA) {             \
-                st->d->short_term_frame_counter += frames;                             \
-            }                                                                          \
-            st->d->needed_frames -= frames;                                            \
-            frames = 0;                                                                \
-        }                                                                              \
-    }                                                                                  \
+void ff_ebur128_set_thread_context(FFEBUR128State * st,
+                                   struct AVFilterContext *ctx)
+{
+    st->d->thread_ctx = ctx;
 }
-EBUR128_ADD_FRAMES_PLANAR(double)
-#define FF_EBUR128_ADD_FRAMES(type)                                            \
-void ff_ebur128_add_frames_##type(FFEBUR128State* st, const type* src,         \
-                                    size_t frames) {                           \
-  int i;                                                                       \
-  const type **buf = (const type**)st->d->data_ptrs;                           \
-  for (i = 0; i < st->channels; i++)                                           \
-    buf[i] = src + i;                                                          \
-  ebur128_add_frames_planar_##type(st, buf, frames, st->channels);             \
+
+void ff_ebur128_add_frames_double(FFEBUR128State * st, const double *src,
+                                  size_t frames)
+{
+    struct FFEBUR128StateInternal *d = st->d;
+    const int lra = (st->mode & FF_EBUR128_MODE_LRA) == FF_EBUR128_MODE_LRA;
+    EBUR128ThreadData td = { .st = st };
+
+    while (frames > 0) {
+        const int block_done = frames >= d->needed_frames;
+
+        td.src               = src;
+        td.frames            = block_done ? d->needed_frames : frames;
+        td.block_frames      = 0;
+        td.short_term_frames = 0;
+        if (block_done) {
+            if ((st->mode & FF_EBUR128_MODE_I) == FF_EBUR128_MODE_I)
+                td.block_frames = d->samples_in_100ms * 4;
+            if (lra && d->short_term_frame_counter + td.frames ==
+                       d->samples_in_100ms * 30)
+                td.short_term_frames = d->samples_in_100ms * 30;
+        }
+
+        d->short_term_energy_valid = 0;
+        if (d->thread_ctx)
+            ff_filter_execute(d->thread_ctx, ebur128_filter_channels, &td, NULL,
+                              FFMIN(st->channels,
+                                    ff_filter_get_nb_threads(d->thread_ctx)));
+        else
+            ebur128_filter_channels(NULL, &td, 0, 1);
+
+        src    += td.frames * st->channels;
+        frames -= td.frames;
+        d->audio_data_index += td.frames;
+        if (lra)
+            d->short_term_frame_counter += td.frames;
+
+        if (block_done) {
+            /* calculate the new gating block */
+            if (td.block_frames)
+                ebur128_add_block_energy(d->block_energy_histogram,
+                    ebur128_weighted_energy(st, d->block_sums, td.block_frames));
+            if (td.short_term_frames) {
+                d->short_term_energy =
+                    ebur128_weighted_energy(st, d->short_term_sums,
+                                            td.short_term_frames);
+                d->short_term_energy_valid = 1;
+                ebur128_add_block_energy(d->short_term_block_energy_histogram,
+                                         d->short_term_energy);
+                d->short_term_frame_counter = d->samples_in_100ms * 20;
+            }
+            /* 100ms are needed for all blocks besides the first one */
+            d->needed_frames = d->samples_in_100ms;
+            /* reset audio_data_index when buffer full */
+            if (d->audio_data_index == d->audio_data_frames)
+                d->audio_data_index = 0;
+        } else {
+            d->needed_frames -= td.frames;
+        }
+    }
 }
-FF_EBUR128_ADD_FRAMES(double)
 
 static int ebur128_calc_relative_threshold(FFEBUR128State **sts, size_t size,
                                            double *relative_threshold)
@@ -601,10 +741,28 @@ int ff_ebur128_loudness_global(FFEBUR128State * st, double *out)
 static int ebur128_energy_in_interval(FFEBUR128State * st,
                                       size_t interval_frames, double *out)
 {
+    int ch[MAX_LANES];
+    size_t c = 0;
+
     if (interval_frames > st->d->audio_data_frames) {
         return AVERROR(EINVAL);
     }
-    ebur128_calc_gating_block(st, interval_frames, out);
+    if (st->d->short_term_energy_valid &&
+        interval_frames == st->d->samples_in_100ms * 30) {
+        *out = st->d->short_term_energy;
+        return 0;
+    }
+
+    while (c < st->channels) {
+        int nb_lanes = 0;
+
+        for (; c < st->channels && nb_lanes < MAX_LANES; c++)
+            if (st->d->channel_map[c] != FF_EBUR128_UNUSED)
+                ch[nb_lanes++] = c;
+        energy_group(st, ch, nb_lanes, st->d->audio_data_index,
+                     interval_frames, st->d->short_term_sums);
+    }
+    *out = ebur128_weighted_energy(st, st->d->short_term_sums, interval_frames);
     return 0;
 }
 
@@ -94,6 +94,7 @@ enum mode {
 };
 
 /** forward declaration of FFEBUR128StateInternal */
+struct AVFilterContext;
 struct FFEBUR128StateInternal;
 
 /** \brief Contains information about the state of a loudness measurement.
@@ -145,6 +146,19 @@ void ff_ebur128_destroy(FFEBUR128State ** st);
 int ff_ebur128_set_channel(FFEBUR128State * st,
                            unsigned int channel_number, int value);
 
+/** \brief Process the channels in parallel.
+ *
+ *  The channels added by ff_ebur128_add_frames_double() are filtered by the
+ *  slice threads of a filter instance. The results do not depend on the
+ *  number of threads.
+ *
+ *  @param st library state.
+ *  @param ctx filter instance whose threads are used, NULL to process the
+ *             channels in the calling thread.
+ */
+void ff_ebur128_set_thread_context(FFEBUR128State * st,
+                                   struct AVFilterContext *ctx);
+
 /** \brief Add frames to be processed.
  *
  *  @param st library state.
@@ -55,24 +55,18 @@ void ff_me_init_context(AVMotionEstContext *me_ctx, int mb_size, int search_para
     me_ctx->x_max = x_max;
     me_ctx->y_min = y_min;
     me_ctx->y_max = y_max;
+
+    /* pixelutils provides 2x2 to 32x32 */
+    for (int n = 1; n < FF_ARRAY_ELEMS(me_ctx->sad); n++)
+        me_ctx->sad[n] = av_pixelutils_get_sad_fn(n, n, 0, NULL);
 }
 
 uint64_t ff_me_cmp_sad(AVMotionEstContext *me_ctx, int x_mb, int y_mb, int x_mv, int y_mv)
 {
     const int linesize = me_ctx->linesize;
-    uint8_t *data_ref = me_ctx->data_ref;
-    uint8_t *data_cur = me_ctx->data_cur;
-    uint64_t sad = 0;
-    int i, j;
-
-    data_ref += y_mv * linesize;
-    data_cur += y_mb * linesize;
-
-    for (j = 0; j < me_ctx->mb_size; j++)
-        for (i = 0; i < me_ctx->mb_size; i++)
-            sad += FFABS(data_ref[x_mv + i + j * linesize] - data_cur[x_mb + i + j * linesize]);
 
-    return sad;
+    return ff_me_block_sad(me_ctx, me_ctx->data_ref + x_mv + y_mv * linesize,
+                           me_ctx->data_cur + x_mb + y_mb * linesize, me_ctx->mb_size);
 }
 
 uint64_t ff_me_search_esa(AVMotionEstContext *me_ctx, int x_mb, int y_mb, int *mv)
@@ -23,6 +23,10 @@
 
 #include <stdint.h>
 
+#include "libavutil/attributes.h"
+#include "libavutil/common.h"
+#include "libavutil/pixelutils.h"
+
 #define AV_ME_METHOD_ESA        1
 #define AV_ME_METHOD_TSS        2
 #define AV_ME_METHOD_TDLS       3
@@ -59,11 +63,39 @@ typedef struct AVMotionEstContext {
 
     uint64_t (*get_cost)(struct AVMotionEstContext *me_ctx, int x_mb, int y_mb,
                          int mv_x, int mv_y);
+
+    /**
+     * SAD of square blocks of 1 << n pixels, indexed by n, NULL if not
+     * available. The blocks have no particular alignment.
+     */
+    av_pixelutils_sad_fn sad[6];
 } AVMotionEstContext;
 
 void ff_me_init_context(AVMotionEstContext *me_ctx, int mb_size, int search_param,
                         int width, int height, int x_min, int x_max, int y_min, int y_max);
 
+/**
+ * SAD between two square blocks of size pixels, both using the linesize of
+ * the context.
+ */
+static av_always_inline uint64_t ff_me_block_sad(const AVMotionEstContext *me_ctx,
+                                                 const uint8_t *a, const uint8_t *b,
+                                                 int size)
+{
+    const int linesize = me_ctx->linesize;
+    const int n = av_log2(size);
+    uint64_t sad = 0;
+
+    if (n < FF_ARRAY_ELEMS(me_ctx->sad) && size == 1 << n && me_ctx->sad[n])
+        return me_ctx->sad[n](a, linesize, b, linesize);
+
+    for (int j = 0; j < size; j++)
+        for (int i = 0; i < size; i++)
+            sad += FFABS(a[i + j * linesize] - b[i + j * linesize]);
+
+    return sad;
+}
+
 uint64_t ff_me_cmp_sad(AVMotionEstContext *me_ctx, int x_mb, int y_mb, int x_mv, int y_mv);
 
 uint64_t ff_me_search_esa(AVMotionEstContext *me_ctx, int x_mb, int y_mb, int *mv);
@@ -23,8 +23,11 @@
  * Ported from MPlayer libmpcodecs/vf_cropdetect.c.
  */
 
+#include "config.h"
+
 #include "libavutil/imgutils.h"
 #include "libavutil/internal.h"
+#include "libavutil/intreadwrite.h"
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/motion_vector.h"
@@ -35,6 +38,11 @@
 #include "video.h"
 #include "edge_common.h"
 
+/* number of lines summed at once when scanning for the borders, the first
+ * blocks of a scan are smaller as it usually stops at the first lines */
+#define LINE_BLOCK 32
+#define LINE_BLOCK_MIN 4
+
 typedef struct CropDetectContext {
     const AVClass *class;
     int x1, y1, x2, y2;
@@ -57,8 +65,21 @@ typedef struct CropDetectContext {
     uint16_t *gradients;
     char     *directions;
     int      *bboxes[4];
+    int       nb_bboxes;
+    int       interval;
+    int       subsample;
+    int       nb_threads;
+
+    int64_t  *line_sums;    ///< sums of the lines block_start to block_end - 1
+    int64_t  *col_sums;     ///< partial sums of the byte or word columns of each job
+    int       block_start, block_end, block_size;
 } CropDetectContext;
 
+typedef struct ThreadData {
+    const AVFrame *frame;
+    int start, nb_lines;
+} ThreadData;
+
 static const enum AVPixelFormat pix_fmts[] = {
     AV_PIX_FMT_YUV420P, AV_PIX_FMT_YUVJ420P,
     AV_PIX_FMT_YUV422P, AV_PIX_FMT_YUVJ422P,
@@ -87,56 +108,267 @@ static int comp(const int *a,const int *b)
     return FFDIFFSIGN(*a, *b);
 }
 
-static int checkline(void *ctx, const unsigned char *src, int stride, int len, int bpp)
+/* add the bytes 16 at once in 16-bit lanes, without the alpha of 4 bytes pixels */
+static int64_t sum_bytes(const uint8_t *src, int len, int skip_alpha)
+{
+    const uint64_t mask     = 0x00ff00ff00ff00ffULL;
+    const uint64_t mask_odd = skip_alpha ? 0x000000ff000000ffULL : mask;
+    const int len16 = len & ~15;
+    int64_t total = 0;
+    int x = 0;
+
+    while (x < len16) {
+        // the lanes of acc0 + acc1 get 4 bytes per iteration, 64 of them fit
+        const int end = FFMIN(x + 16 * 64, len16);
+        uint64_t acc0 = 0, acc1 = 0;
+
+        for (; x < end; x += 16) {
+            const uint64_t v0 = AV_RL64(src + x);
+            const uint64_t v1 = AV_RL64(src + x + 8);
+            acc0 += (v0 & mask) + (v1 & mask);
+            acc1 += ((v0 >> 8) & mask_odd) + ((v1 >> 8) & mask_odd);
+        }
+        acc0 += acc1;
+        acc0  = (acc0 & 0x0000ffff0000ffffULL) + ((acc0 >> 16) & 0x0000ffff0000ffffULL);
+        total += (acc0 & 0xffffffff) + (acc0 >> 32);
+    }
+    for (; x < len; x++)
+        if (!skip_alpha || (x & 3) != 3)
+            total += src[x];
+
+    return total;
+}
+
+/* add the words 8 at once in 32-bit lanes */
+static int64_t sum_words(const uint16_t *src, int len)
+{
+    const uint64_t mask = 0x0000ffff0000ffffULL;
+    const int len8 = len & ~7;
+    int64_t total = 0;
+    int x = 0;
+
+    while (x < len8) {
+        // the lanes of acc0 + acc1 get 4 words per iteration, 16384 of them fit
+        const int end = FFMIN(x + 8 * 16384, len8);
+        uint64_t acc0 = 0, acc1 = 0;
+
+        for (; x < end; x += 8) {
+            const uint64_t v0 = AV_RN64(src + x);
+            const uint64_t v1 = AV_RN64(src + x + 4);
+            acc0 += (v0 & mask) + (v1 & mask);
+            acc1 += ((v0 >> 16) & mask) + ((v1 >> 16) & mask);
+        }
+        acc0 += acc1;
+        total += (acc0 & 0xffffffff) + (acc0 >> 32);
+    }
+    for (; x < len; x++)
+        total += src[x];
+
+    return total;
+}
+
+static int64_t row_sum(const CropDetectContext *s, const uint8_t *src, int len, int bpp)
 {
-    int total = 0;
-    int div = len;
     const uint16_t *src16 = (const uint16_t *)src;
+    const int step = s->subsample;
+    int64_t total = 0;
+
+    if (step == 1) {
+        if (bpp == 2)
+            return sum_words(src16, len);
+
+        // the sum of all the components is the sum of all the bytes of packed RGB
+        return sum_bytes(src, len * bpp, bpp == 4);
+    }
 
     switch (bpp) {
     case 1:
-        while (len >= 8) {
-            total += src[       0] + src[  stride] + src[2*stride] + src[3*stride]
-                  +  src[4*stride] + src[5*stride] + src[6*stride] + src[7*stride];
-            src += 8*stride;
-            len -= 8;
-        }
-        while (--len >= 0) {
-            total += src[0];
-            src += stride;
-        }
+        for (int x = 0; x < len; x += step)
+            total += src[x];
         break;
     case 2:
-        stride >>= 1;
-        while (len >= 8) {
-            total += src16[       0] + src16[  stride] + src16[2*stride] + src16[3*stride]
-                  +  src16[4*stride] + src16[5*stride] + src16[6*stride] + src16[7*stride];
-            src16 += 8*stride;
-            len -= 8;
-        }
-        while (--len >= 0) {
-            total += src16[0];
-            src16 += stride;
-        }
+        for (int x = 0; x < len; x += step)
+            total += src16[x];
         break;
     case 3:
     case 4:
-        while (len >= 4) {
-            total += src[0]        + src[1         ] + src[2         ]
-                  +  src[  stride] + src[1+  stride] + src[2+  stride]
-                  +  src[2*stride] + src[1+2*stride] + src[2+2*stride]
-                  +  src[3*stride] + src[1+3*stride] + src[2+3*stride];
-            src += 4*stride;
-            len -= 4;
+        for (int x = 0; x < len * bpp; x += step * bpp)
+            total += src[x] + src[x + 1] + src[x + 2];
+        break;
+    }
+
+    return total;
+}
+
+static int sum_rows(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    CropDetectContext *s = ctx->priv;
+    const ThreadData *td = arg;
+    const AVFrame *frame = td->frame;
+    const int start = (td->nb_lines *  jobnr     ) / nb_jobs;
+    const int end   = (td->nb_lines * (jobnr + 1)) / nb_jobs;
+
+    for (int i = start; i < end; i++)
+        s->line_sums[i] = row_sum(s, frame->data[0] + (td->start + i) * frame->linesize[0],
+                                  frame->width, s->max_pixsteps[0]);
+
+    return 0;
+}
+
+/* add up to LINE_BLOCK * 4 byte columns, 8 of them at once in 16-bit lanes */
+static void sum_byte_columns(int64_t *sums, const uint8_t *src, ptrdiff_t linesize,
+                             int nb_rows, int len)
+{
+    const uint64_t mask = 0x00ff00ff00ff00ffULL;
+    const int len8 = len & ~7;
+    uint64_t acc[LINE_BLOCK];
+
+    while (nb_rows > 0) {
+        // the 16-bit lanes cannot overflow with 257 rows
+        const int rows = FFMIN(nb_rows, 256);
+
+        memset(acc, 0, len8 / 4 * sizeof(*acc));
+        for (int y = 0; y < rows; y++) {
+            for (int x = 0; x < len8; x += 8) {
+                const uint64_t v = AV_RL64(src + x);
+                acc[x / 4    ] +=  v       & mask;
+                acc[x / 4 + 1] += (v >> 8) & mask;
+            }
+            for (int x = len8; x < len; x++)
+                sums[x] += src[x];
+            src += linesize;
         }
-        while (--len >= 0) {
-            total += src[0] + src[1] + src[2];
-            src += stride;
+        for (int x = 0; x < len8; x += 8) {
+            for (int k = 0; k < 4; k++) {
+                sums[x + 2 * k    ] += (acc[x / 4    ] >> (16 * k)) & 0xffff;
+                sums[x + 2 * k + 1] += (acc[x / 4 + 1] >> (16 * k)) & 0xffff;
+            }
         }
-        div *= 3;
-        break;
+        nb_rows -= rows;
+    }
+}
+
+#if HAVE_BIGENDIAN
+#define WORD_LANE(k, odd) (3 - 2 * (k) - (odd))
+#else
+#define WORD_LANE(k, odd) (2 * (k) + (odd))
+#endif
+
+/* add up to LINE_BLOCK word columns, 4 of them at once in 32-bit lanes */
+static void sum_word_columns(int64_t *sums, const uint8_t *src, ptrdiff_t linesize,
+                             int nb_rows, int len)
+{
+    const uint64_t mask = 0x0000ffff0000ffffULL;
+    const int len4 = len & ~3;
+    uint64_t acc[LINE_BLOCK / 2];
+
+    while (nb_rows > 0) {
+        // the 32-bit lanes cannot overflow with 65537 rows
+        const int rows = FFMIN(nb_rows, 65536);
+
+        memset(acc, 0, len4 / 2 * sizeof(*acc));
+        for (int y = 0; y < rows; y++) {
+            const uint16_t *src16 = (const uint16_t *)src;
+
+            for (int x = 0; x < len4; x += 4) {
+                const uint64_t v = AV_RN64(src16 + x);
+                acc[x / 2    ] +=  v        & mask;
+                acc[x / 2 + 1] += (v >> 16) & mask;
+            }
+            for (int x = len4; x < len; x++)
+                sums[x] += src16[x];
+            src += linesize;
+        }
+        for (int x = 0; x < len4; x += 4) {
+            for (int k = 0; k < 2; k++) {
+                sums[x + WORD_LANE(k, 0)] += (acc[x / 2    ] >> (32 * k)) & 0xffffffff;
+                sums[x + WORD_LANE(k, 1)] += (acc[x / 2 + 1] >> (32 * k)) & 0xffffffff;
+            }
+        }
+        nb_rows -= rows;
+    }
+}
+
+/* sum the columns row by row, each job over its own range of rows */
+static int sum_columns(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    CropDetectContext *s = ctx->priv;
+    const ThreadData *td = arg;
+    const AVFrame *frame = td->frame;
+    const int bpp  = s->max_pixsteps[0];
+    const int step = s->subsample;
+    const int nb_rows = (frame->height + step - 1) / step;
+    const int start = (nb_rows *  jobnr     ) / nb_jobs;
+    const int end   = (nb_rows * (jobnr + 1)) / nb_jobs;
+    const ptrdiff_t linesize = step * frame->linesize[0];
+    const uint8_t *src = frame->data[0] + start * linesize + td->start * bpp;
+    int64_t *sums = s->col_sums + jobnr * LINE_BLOCK * 4;
+
+    if (bpp == 2) {
+        memset(sums, 0, td->nb_lines * sizeof(*sums));
+        sum_word_columns(sums, src, linesize, end - start, td->nb_lines);
+    } else {
+        memset(sums, 0, td->nb_lines * bpp * sizeof(*sums));
+        sum_byte_columns(sums, src, linesize, end - start, td->nb_lines * bpp);
     }
-    total /= div;
+
+    return 0;
+}
+
+static void sum_lines(AVFilterContext *ctx, const AVFrame *frame, int columns,
+                      int start, int nb_lines)
+{
+    CropDetectContext *s = ctx->priv;
+    ThreadData td = { .frame = frame, .start = start, .nb_lines = nb_lines };
+
+    if (columns) {
+        const int nb_jobs  = FFMIN(s->nb_threads, (frame->height + s->subsample - 1) / s->subsample);
+        const int bpp      = s->max_pixsteps[0];
+        const int nb_comps = bpp >= 3 ? 3 : 1;
+        // the partial sums are per word for 16 bits formats, per byte otherwise
+        const int stride   = bpp == 2 ? 1 : bpp;
+
+        ff_filter_execute(ctx, sum_columns, &td, NULL, nb_jobs);
+        for (int x = 0; x < nb_lines; x++) {
+            int64_t total = 0;
+            for (int j = 0; j < nb_jobs; j++)
+                for (int c = 0; c < nb_comps; c++)
+                    total += s->col_sums[j * LINE_BLOCK * 4 + x * stride + c];
+            s->line_sums[x] = total;
+        }
+    } else {
+        ff_filter_execute(ctx, sum_rows, &td, NULL, FFMIN(s->nb_threads, nb_lines));
+    }
+
+    s->block_start = start;
+    s->block_end   = start + nb_lines;
+}
+
+/**
+ * Return the average value of a row or column, the lines following it in
+ * the scanning direction are summed along with it.
+ */
+static int checkline(AVFilterContext *ctx, const AVFrame *frame, int columns, int y, int inc)
+{
+    CropDetectContext *s = ctx->priv;
+    const int len = columns ? frame->height : frame->width;
+    const int nb  = columns ? frame->width  : frame->height;
+    int div = (len + s->subsample - 1) / s->subsample;
+    int total;
+
+    if (y < s->block_start || y >= s->block_end) {
+        if (inc > 0) {
+            sum_lines(ctx, frame, columns, y, FFMIN(s->block_size, nb - y));
+        } else {
+            const int start = FFMAX(y - s->block_size + 1, 0);
+            sum_lines(ctx, frame, columns, start, y - start + 1);
+        }
+        s->block_size = FFMIN(2 * s->block_size, LINE_BLOCK);
+    }
+
+    if (s->max_pixsteps[0] >= 3)
+        div *= 3;
+    total = s->line_sums[y - s->block_start] / div;
 
     av_log(ctx, AV_LOG_DEBUG, "total:%d\n", total);
     return total;
@@ -198,6 +430,8 @@ static av_cold void uninit(AVFilterContext *ctx)
     av_freep(&s->bboxes[1]);
     av_freep(&s->bboxes[2]);
     av_freep(&s->bboxes[3]);
+    av_freep(&s->line_sums);
+    av_freep(&s->col_sums);
 }
 
 static int config_input(AVFilterLink *inlink)
@@ -210,6 +444,7 @@ static int config_input(AVFilterLink *inlink)
     av_image_fill_max_pixsteps(s->max_pixsteps, NULL, desc);
 
     s->bitdepth = desc->comp[0].depth;
+    s->nb_threads = ff_filter_get_nb_threads(ctx);
 
     if (s->limit < 1.0)
         s->limit_upscaled = s->limit * ((1 << s->bitdepth) - 1);
@@ -230,9 +465,12 @@ static int config_input(AVFilterLink *inlink)
     s->bboxes[1]   = av_malloc(s->window_size * sizeof(*s->bboxes[1]));
     s->bboxes[2]   = av_malloc(s->window_size * sizeof(*s->bboxes[2]));
     s->bboxes[3]   = av_malloc(s->window_size * sizeof(*s->bboxes[3]));
+    s->line_sums   = av_malloc_array(LINE_BLOCK, sizeof(*s->line_sums));
+    s->col_sums    = av_malloc_array(s->nb_threads * LINE_BLOCK * 4, sizeof(*s->col_sums));
 
     if (!s->tmpbuf    || !s->filterbuf || !s->gradients || !s->directions ||
-        !s->bboxes[0] || !s->bboxes[1] || !s->bboxes[2] || !s->bboxes[3])
+        !s->bboxes[0] || !s->bboxes[1] || !s->bboxes[2] || !s->bboxes[3] ||
+        !s->line_sums || !s->col_sums)
         return AVERROR(ENOMEM);
 
     return 0;
@@ -259,7 +497,7 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
     uint16_t *gradients = s->gradients;
     int8_t *directions  = s->directions;
     const AVFrameSideData *sd = NULL;
-    int scan_w, scan_h, bboff;
+    int scan_w, scan_h, bboff, analyze;
 
     void (*sobel)(int w, int h, uint16_t *dst, int dst_linesize,
                   int8_t *dir, int dir_linesize,
@@ -280,12 +518,18 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
             s->x2 = 0;
             s->y2 = 0;
             s->frame_nb = 1;
+            s->nb_bboxes = 0;
         }
 
-#define FIND(DST, FROM, NOEND, INC, STEP0, STEP1, LEN) \
+        // analyze one frame out of interval, the others get the last result
+        analyze = !((s->frame_nb - 1) % s->interval);
+
+#define FIND(DST, FROM, NOEND, INC, COLUMNS) \
         outliers = 0;\
+        s->block_start = s->block_end = 0;\
+        s->block_size  = LINE_BLOCK_MIN;\
         for (last_y = y = FROM; NOEND; y = y INC) {\
-            if (checkline(ctx, frame->data[0] + STEP0 * y, STEP1, LEN, bpp) > limit_upscaled) {\
+            if (checkline(ctx, frame, COLUMNS, y, INC) > limit_upscaled) {\
                 if (++outliers > s->max_outliers) { \
                     DST = last_y;\
                     break;\
@@ -294,11 +538,13 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
                 last_y = y INC;\
         }
 
-        if (s->mode == MODE_BLACK) {
-            FIND(s->y1,                 0,               y < s->y1, +1, frame->linesize[0], bpp, frame->width);
-            FIND(s->y2, frame->height - 1, y > FFMAX(s->y2, s->y1), -1, frame->linesize[0], bpp, frame->width);
-            FIND(s->x1,                 0,               y < s->x1, +1, bpp, frame->linesize[0], frame->height);
-            FIND(s->x2,  frame->width - 1, y > FFMAX(s->x2, s->x1), -1, bpp, frame->linesize[0], frame->height);
+        if (!analyze) {
+            // keep the crop area of the last analyzed frame
+        } else if (s->mode == MODE_BLACK) {
+            FIND(s->y1,                 0,               y < s->y1, +1, 0);
+            FIND(s->y2, frame->height - 1, y > FFMAX(s->y2, s->y1), -1, 0);
+            FIND(s->x1,                 0,               y < s->x1, +1, 1);
+            FIND(s->x2,  frame->width - 1, y > FFMAX(s->x2, s->x1), -1, 1);
         } else { // MODE_MV_EDGES
             sd = av_frame_get_side_data(frame, AV_FRAME_DATA_MOTION_VECTORS);
             s->x1 = 0;
@@ -377,14 +623,14 @@ static int filter_frame(AVFilterLink *inlink, AVFrame *frame)
                 FIND_EDGE(s->x2, s->x2, y < inw, +1, bpp, inw, scan_h);
 
                 // queue bboxes
-                bboff = (s->frame_nb - 1) % s->window_size;
+                bboff = s->nb_bboxes++ % s->window_size;
                 s->bboxes[0][bboff] = s->x1;
                 s->bboxes[1][bboff] = s->x2;
                 s->bboxes[2][bboff] = s->y1;
                 s->bboxes[3][bboff] = s->y2;
 
                 // sort queue
-                bboff = FFMIN(s->frame_nb, s->window_size);
+                bboff = FFMIN(s->nb_bboxes, s->window_size);
                 AV_QSORT(s->bboxes[0], bboff, int, comp);
                 AV_QSORT(s->bboxes[1], bboff, int, comp);
                 AV_QSORT(s->bboxes[2], bboff, int, comp);
@@ -481,6 +727,8 @@ static const AVOption cropdetect_options[] = {
     { "high", "Set high threshold for edge detection",                OFFSET(high),        AV_OPT_TYPE_FLOAT, {.dbl=25/255.}, 0, 1, FLAGS },
     { "low", "Set low threshold for edge detection",                  OFFSET(low),         AV_OPT_TYPE_FLOAT, {.dbl=15/255.}, 0, 1, FLAGS },
     { "mv_threshold", "motion vector threshold when estimating video window size", OFFSET(mv_threshold), AV_OPT_TYPE_INT, {.i64=8}, 0, 100, FLAGS},
+    { "interval",  "Analyze one frame out of this many",              OFFSET(interval),    AV_OPT_TYPE_INT, { .i64 = 1 },  1, INT_MAX, FLAGS },
+    { "subsample", "Use one pixel out of this many along the scanned lines", OFFSET(subsample), AV_OPT_TYPE_INT, { .i64 = 1 }, 1, 64, FLAGS },
     { NULL }
 };
 
@@ -505,6 +753,7 @@ const AVFilter ff_vf_cropdetect = {
     FILTER_INPUTS(avfilter_vf_cropdetect_inputs),
     FILTER_OUTPUTS(ff_video_default_filterpad),
     FILTER_PIXFMTS_ARRAY(pix_fmts),
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_METADATA_ONLY,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC | AVFILTER_FLAG_METADATA_ONLY |
+                     AVFILTER_FLAG_SLICE_THREADS,
     .process_command = process_command,
 };
@@ -194,6 +194,7 @@ typedef struct GlyphInfo {
     int y;                          ///< the y position of the glyph
     int shift_x64;                  ///< the horizontal shift of the glyph in 26.6 units
     int shift_y64;                  ///< the vertical shift of the glyph in 26.6 units
+    struct Glyph *glyph;            ///< the cached glyph, with the bitmap for this shift
 } GlyphInfo;
 
 /** Information about a single line of text */
@@ -245,6 +246,16 @@ typedef struct TextMetrics {
     int rect_y;                     ///< y position of the box
 } TextMetrics;
 
+typedef struct ThreadData {
+    AVFrame *frame;
+    TextMetrics *metrics;
+    FFDrawColor *fontcolor;
+    FFDrawColor *shadowcolor;
+    FFDrawColor *bordercolor;
+    FFDrawColor *boxcolor;
+    int start, end;                 ///< first and last + 1 frame rows drawn to
+} ThreadData;
+
 typedef struct DrawTextContext {
     const AVClass *class;
     int exp_mode;                   ///< expansion mode to use for the text
@@ -1267,20 +1278,25 @@ static void update_alpha(DrawTextContext *s)
         s->alpha = 256 * alpha;
 }
 
-static int draw_glyphs(DrawTextContext *s, AVFrame *frame,
-                       FFDrawColor *color,
-                       TextMetrics *metrics,
-                       int x, int y, int borderw)
+/**
+ * Draw the glyphs clipped to the rows from slice_start to slice_end,
+ * dst points to the row slice_start of the frame.
+ */
+static void draw_glyphs(DrawTextContext *s, uint8_t *dst[], int dst_linesize[],
+                        int width, int slice_start, int slice_end,
+                        FFDrawColor *color,
+                        TextMetrics *metrics,
+                        int x, int y, int borderw)
 {
     int g, l, x1, y1, w1, h1, idx;
     int dx = 0, dy = 0, pdx = 0;
     GlyphInfo *info;
-    Glyph dummy = { 0 }, *glyph;
+    Glyph *glyph;
     FT_Bitmap bitmap;
     FT_BitmapGlyph b_glyph;
     uint8_t j_left = 0, j_right = 0, j_top = 0, j_bottom = 0;
     int line_w, offset_y = 0;
-    int clip_x = 0, clip_y = 0;
+    int clip_x = 0, clip_y = 0, clip_top;
 
     j_left = !!(s->text_align & TA_LEFT);
     j_right = !!(s->text_align & TA_RIGHT);
@@ -1293,25 +1309,16 @@ static int draw_glyphs(DrawTextContext *s, AVFrame *frame,
         offset_y = s->box_height - metrics->height;
     }
 
-    if ((!j_left || j_right) && !s->tab_warning_printed && s->tab_count > 0) {
-        s->tab_warning_printed = 1;
-        av_log(s, AV_LOG_WARNING, "Tab characters are only supported with left horizontal alignment\n");
-    }
-
-    clip_x = FFMIN(metrics->rect_x + s->box_width + s->bb_right, frame->width);
-    clip_y = FFMIN(metrics->rect_y + s->box_height + s->bb_bottom, frame->height);
+    clip_x = FFMIN(metrics->rect_x + s->box_width + s->bb_right, width);
+    clip_y = FFMIN(metrics->rect_y + s->box_height + s->bb_bottom, slice_end);
+    clip_top = FFMAX(metrics->rect_y - s->bb_top, slice_start);
 
     for (l = 0; l < s->line_count; ++l) {
         TextLine *line = &s->lines[l];
         line_w = POS_CEIL(line->width64, 64);
         for (g = 0; g < line->hb_data.glyph_count; ++g) {
             info = &line->glyphs[g];
-            dummy.fontsize = s->fontsize;
-            dummy.code = info->code;
-            glyph = av_tree_find(s->glyphs, &dummy, glyph_cmp, NULL);
-            if (!glyph) {
-                return AVERROR(EINVAL);
-            }
+            glyph = info->glyph;
 
             idx = get_subpixel_idx(info->shift_x64, info->shift_y64);
             b_glyph = borderw ? glyph->border_bglyph[idx] : glyph->bglyph[idx];
@@ -1333,9 +1340,9 @@ static int draw_glyphs(DrawTextContext *s, AVFrame *frame,
                 dx = metrics->rect_x - s->bb_left - x1;
                 x1 = metrics->rect_x - s->bb_left;
             }
-            if (y1 < metrics->rect_y - s->bb_top) {
-                dy = metrics->rect_y - s->bb_top - y1;
-                y1 = metrics->rect_y - s->bb_top;
+            if (y1 < clip_top) {
+                dy = clip_top - y1;
+                y1 = clip_top;
             }
 
             // check if the glyph is empty or out of the clipping region
@@ -1347,10 +1354,51 @@ static int draw_glyphs(DrawTextContext *s, AVFrame *frame,
             w1 = FFMIN(clip_x - x1, w1 - dx);
             h1 = FFMIN(clip_y - y1, h1 - dy);
 
-            ff_blend_mask(&s->dc, color, frame->data, frame->linesize, clip_x, clip_y,
-                bitmap.buffer + pdx, bitmap.pitch, w1, h1, 3, 0, x1, y1);
+            ff_blend_mask(&s->dc, color, dst, dst_linesize, clip_x, clip_y - slice_start,
+                bitmap.buffer + pdx, bitmap.pitch, w1, h1, 3, 0, x1, y1 - slice_start);
         }
     }
+}
+
+static int draw_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs)
+{
+    DrawTextContext *s = ctx->priv;
+    ThreadData *td = arg;
+    AVFrame *frame = td->frame;
+    TextMetrics *metrics = td->metrics;
+    // keep the slices aligned to chroma rows, so that no chroma sample is
+    // blended from two slices
+    const int align = 1 << s->dc.vsub_max;
+    const int h = td->end - td->start;
+    const int slice_start = (td->start + h *  jobnr      / nb_jobs) & ~(align - 1);
+    const int slice_end   = jobnr == nb_jobs - 1 ? td->end :
+                            (td->start + h * (jobnr + 1) / nb_jobs) & ~(align - 1);
+    uint8_t *dst[4];
+
+    if (slice_start >= slice_end)
+        return 0;
+
+    for (int p = 0; p < s->dc.nb_planes; p++)
+        dst[p] = frame->data[p] + (slice_start >> s->dc.vsub[p]) * frame->linesize[p];
+
+    if (s->draw_box)
+        ff_blend_rectangle(&s->dc, td->boxcolor, dst, frame->linesize,
+                           frame->width, slice_end - slice_start,
+                           metrics->rect_x - s->bb_left,
+                           metrics->rect_y - s->bb_top - slice_start,
+                           s->box_width + s->bb_right + s->bb_left,
+                           s->box_height + s->bb_bottom + s->bb_top);
+
+    if (s->shadowx || s->shadowy)
+        draw_glyphs(s, dst, frame->linesize, frame->width, slice_start, slice_end,
+                    td->shadowcolor, metrics, s->shadowx, s->shadowy, s->borderw);
+
+    if (s->borderw)
+        draw_glyphs(s, dst, frame->linesize, frame->width, slice_start, slice_end,
+                    td->bordercolor, metrics, 0, 0, s->borderw);
+
+    draw_glyphs(s, dst, frame->linesize, frame->width, slice_start, slice_end,
+                td->fontcolor, metrics, 0, 0, 0);
 
     return 0;
 }
@@ -1569,7 +1617,6 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame)
 
     int width = frame->width;
     int height = frame->height;
-    int rec_x = 0, rec_y = 0, rec_width = 0, rec_height = 0;
     int is_outside = 0;
     int last_tab_idx = 0;
 
@@ -1742,6 +1789,7 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame)
             g_info->y = ((y64 + true_y) >> 6) + (shift_y64 > 0 ? 1 : 0);
             g_info->shift_x64 = shift_x64;
             g_info->shift_y64 = shift_y64;
+            g_info->glyph = glyph;
 
             if (!is_tab) {
                 x += hb->glyph_pos[t].x_advance;
@@ -1783,35 +1831,28 @@ static int draw_text(AVFilterContext *ctx, AVFrame *frame)
                     metrics.rect_y + s->box_height + s->bb_bottom <= 0;
 
     if (!is_outside) {
-        /* draw box */
-        if (s->draw_box) {
-            rec_x = metrics.rect_x - s->bb_left;
-            rec_y = metrics.rect_y - s->bb_top;
-            rec_width = s->box_width + s->bb_right + s->bb_left;
-            rec_height = s->box_height + s->bb_bottom + s->bb_top;
-            ff_blend_rectangle(&s->dc, &boxcolor,
-                frame->data, frame->linesize, width, height,
-                rec_x, rec_y, rec_width, rec_height);
-        }
-
-        if (s->shadowx || s->shadowy) {
-            if ((ret = draw_glyphs(s, frame, &shadowcolor, &metrics,
-                    s->shadowx, s->shadowy, s->borderw)) < 0) {
-                return ret;
-            }
+        const int align = 1 << s->dc.vsub_max;
+        ThreadData td = {
+            .frame       = frame,
+            .metrics     = &metrics,
+            .fontcolor   = &fontcolor,
+            .shadowcolor = &shadowcolor,
+            .bordercolor = &bordercolor,
+            .boxcolor    = &boxcolor,
+            .start       = FFMAX(metrics.rect_y - s->bb_top, 0),
+            .end         = FFMIN(metrics.rect_y + s->box_height + s->bb_bottom, height),
+        };
+        int nb_jobs;
+
+        if ((!(s->text_align & TA_LEFT) || (s->text_align & TA_RIGHT)) &&
+            !s->tab_warning_printed && s->tab_count > 0) {
+            s->tab_warning_printed = 1;
+            av_log(s, AV_LOG_WARNING, "Tab characters are only supported with left horizontal alignment\n");
         }
 
-        if (s->borderw) {
-            if ((ret = draw_glyphs(s, frame, &bordercolor, &metrics,
-                    0, 0, s->borderw)) < 0) {
-                return ret;
-            }
-        }
-
-        if ((ret = draw_glyphs(s, frame, &fontcolor, &metrics, 0,
-                0, 0)) < 0) {
-            return ret;
-        }
+        nb_jobs = FFMAX(1, FFMIN((td.end - td.start) / align,
+                                 ff_filter_get_nb_threads(ctx)));
+        ff_filter_execute(ctx, draw_slice, &td, NULL, nb_jobs);
     }
 
     // FREE data structures
@@ -1915,5 +1956,6 @@ const AVFilter ff_vf_drawtext = {
     FILTER_OUTPUTS(ff_video_default_filterpad),
     FILTER_QUERY_FUNC(query_formats),
     .process_command = command,
-    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC,
+    .flags         = AVFILTER_FLAG_SUPPORT_TIMELINE_GENERIC |
+                     AVFILTER_FLAG_SLICE_THREADS,
 };
@@ -28,6 +28,7 @@
 
 #include "libavutil/csp.h"
 #include "libavutil/imgutils.h"
+#include "libavutil/intfloat.h"
 #include "libavutil/internal.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/opt.h"
@@ -38,6 +39,20 @@
 #include "internal.h"
 #include "video.h"
 
+/**
+ * The tone curve lookup table is indexed by the upper bits of the IEEE-754
+ * representation of the signal, which gives 2^LUT_BITS entries per octave
+ * between 2^LUT_MIN_EXP and 2^LUT_MAX_EXP. The remaining mantissa bits are
+ * used to interpolate linearly between entries. Signals of 2^LUT_MAX_EXP or
+ * more are not covered by the table and take the exact tone curve.
+ */
+#define LUT_BITS    7
+#define LUT_MIN_EXP (-20)
+#define LUT_MAX_EXP 12
+#define LUT_SHIFT   (23 - LUT_BITS)
+#define LUT_SIZE    ((LUT_MAX_EXP - LUT_MIN_EXP) << LUT_BITS)
+#define LUT_BASE    ((127 + LUT_MIN_EXP) << 23)
+
 enum TonemapAlgorithm {
     TONEMAP_NONE,
     TONEMAP_LINEAR,
@@ -56,8 +71,12 @@ typedef struct TonemapContext {
     double param;
     double desat;
     double peak;
+    int use_lut;
 
     const AVLumaCoefficients *coeffs;
+
+    float lut[LUT_SIZE + 1];
+    double lut_peak;
 } TonemapContext;
 
 static av_cold int init(AVFilterContext *ctx)
@@ -104,6 +123,64 @@ static float mobius(float in, float j, double peak)
     return (b * b + 2.0f * b * j + j * j) / (b - a) * (in + a) / (in + b);
 }
 
+static float tonemap_curve(const TonemapContext *s, float sig, double peak)
+{
+    switch(s->tonemap) {
+    default:
+    case TONEMAP_NONE:
+        // do nothing
+        break;
+    case TONEMAP_LINEAR:
+        sig = sig * s->param / peak;
+        break;
+    case TONEMAP_GAMMA:
+        sig = sig > 0.05f ? pow(sig / peak, 1.0f / s->param)
+                          : sig * pow(0.05f / peak, 1.0f / s->param) / 0.05f;
+        break;
+    case TONEMAP_CLIP:
+        sig = av_clipf(sig * s->param, 0, 1.0f);
+        break;
+    case TONEMAP_HABLE:
+        sig = hable(sig) / hable(peak);
+        break;
+    case TONEMAP_REINHARD:
+        sig = sig / (sig + s->param) * (peak + s->param) / peak;
+        break;
+    case TONEMAP_MOBIUS:
+        sig = mobius(sig, s->param, peak);
+        break;
+    }
+
+    return sig;
+}
+
+/**
+ * Sample the ratio between the tone mapped and the original signal at the
+ * signal values whose float representation starts each table entry.
+ * Returns the largest error of the interpolated curve, estimated from the
+ * middle of every entry.
+ */
+static float build_lut(const TonemapContext *s, float *lut, double peak)
+{
+    float max_err = 0.f;
+
+    for (int i = 0; i <= LUT_SIZE; i++) {
+        const float sig = av_int2float(LUT_BASE + (i << LUT_SHIFT));
+        lut[i] = tonemap_curve(s, sig, peak) / sig;
+    }
+
+    for (int i = 0; i < LUT_SIZE; i++) {
+        const float sig = av_int2float(LUT_BASE + (i << LUT_SHIFT) +
+                                       (1 << (LUT_SHIFT - 1)));
+        const float err = fabsf((lut[i] + lut[i + 1]) * 0.5f * sig -
+                                tonemap_curve(s, sig, peak));
+        if (err > max_err)
+            max_err = err;
+    }
+
+    return max_err;
+}
+
 #define MIX(x,y,a) (x) * (1 - (a)) + (y) * (a)
 static void tonemap(TonemapContext *s, AVFrame *out, const AVFrame *in,
                     const AVPixFmtDescriptor *desc, int x, int y, double peak)
@@ -136,32 +213,7 @@ static void tonemap(TonemapContext *s, AVFrame *out, const AVFrame *in,
      * out-of-bounds clipping */
     sig = FFMAX(FFMAX3(*r_out, *g_out, *b_out), 1e-6);
     sig_orig = sig;
-
-    switch(s->tonemap) {
-    default:
-    case TONEMAP_NONE:
-        // do nothing
-        break;
-    case TONEMAP_LINEAR:
-        sig = sig * s->param / peak;
-        break;
-    case TONEMAP_GAMMA:
-        sig = sig > 0.05f ? pow(sig / peak, 1.0f / s->param)
-                          : sig * pow(0.05f / peak, 1.0f / s->param) / 0.05f;
-        break;
-    case TONEMAP_CLIP:
-        sig = av_clipf(sig * s->param, 0, 1.0f);
-        break;
-    case TONEMAP_HABLE:
-        sig = hable(sig) / hable(peak);
-        break;
-    case TONEMAP_REINHARD:
-        sig = sig / (sig + s->param) * (peak + s->param) / peak;
-        break;
-    case TONEMAP_MOBIUS:
-        sig = mobius(sig, s->param, peak);
-        break;
-    }
+    sig = tonemap_curve(s, sig, peak);
 
     /* apply the computed scale factor to the color,
      * linearly to prevent discoloration */
@@ -170,6 +222,56 @@ static void tonemap(TonemapContext *s, AVFrame *out, const AVFrame *in,
     *b_out *= sig / sig_orig;
 }
 
+/**
+ * Tone map one row through the lookup table, with the same desaturation
+ * as tonemap().
+ */
+static void tonemap_lut_row(TonemapContext *s, AVFrame *out, const AVFrame *in,
+                            const AVPixFmtDescriptor *desc, int y, double peak)
+{
+    int map[3] = { desc->comp[0].plane, desc->comp[1].plane, desc->comp[2].plane };
+    const float *r_in = (const float *)(in->data[map[0]] + y * in->linesize[map[0]]);
+    const float *g_in = (const float *)(in->data[map[1]] + y * in->linesize[map[1]]);
+    const float *b_in = (const float *)(in->data[map[2]] + y * in->linesize[map[2]]);
+    float *r_out = (float *)(out->data[map[0]] + y * out->linesize[map[0]]);
+    float *g_out = (float *)(out->data[map[1]] + y * out->linesize[map[1]]);
+    float *b_out = (float *)(out->data[map[2]] + y * out->linesize[map[2]]);
+    const float desat = s->desat;
+    const float cr = desat > 0 ? av_q2d(s->coeffs->cr) : 0.f;
+    const float cg = desat > 0 ? av_q2d(s->coeffs->cg) : 0.f;
+    const float cb = desat > 0 ? av_q2d(s->coeffs->cb) : 0.f;
+
+    for (int x = 0; x < out->width; x++) {
+        float r = r_in[x], g = g_in[x], b = b_in[x];
+        float sig, scale;
+        int idx;
+
+        if (desat > 0) {
+            float luma = cr * r + cg * g + cb * b;
+            float overbright = FFMAX(luma - desat, 1e-6f) / FFMAX(luma, 1e-6f);
+            r = MIX(r, luma, overbright);
+            g = MIX(g, luma, overbright);
+            b = MIX(b, luma, overbright);
+        }
+
+        /* the minimum signal of 1e-6 is above 2^LUT_MIN_EXP, so idx is only
+         * out of the table for signals of 2^LUT_MAX_EXP or more */
+        sig = FFMAX(FFMAX3(r, g, b), 1e-6f);
+        idx = (int)av_float2int(sig) - LUT_BASE;
+        if (idx < (LUT_SIZE << LUT_SHIFT)) {
+            const int i = idx >> LUT_SHIFT;
+            const float frac = (idx & ((1 << LUT_SHIFT) - 1)) * (1.f / (1 << LUT_SHIFT));
+            scale = s->lut[i] + (s->lut[i + 1] - s->lut[i]) * frac;
+        } else {
+            scale = tonemap_curve(s, sig, peak) / sig;
+        }
+
+        r_out[x] = r * scale;
+        g_out[x] = g * scale;
+        b_out[x] = b * scale;
+    }
+}
+
 typedef struct ThreadData {
     AVFrame *in, *out;
     const AVPixFmtDescriptor *desc;
@@ -187,6 +289,13 @@ static int tonemap_slice(AVFilterContext *ctx, void *arg, int jobnr, int nb_jobs
     const int slice_end = (in->height * (jobnr+1)) / nb_jobs;
     double peak = td->peak;
 
+    if (s->use_lut) {
+        for (int y = slice_start; y < slice_end; y++)
+            tonemap_lut_row(s, out, in, desc, y, peak);
+
+        return 0;
+    }
+
     for (int y = slice_start; y < slice_end; y++)
         for (int x = 0; x < out->width; x++)
             tonemap(s, out, in, desc, x, y, peak);
@@ -249,6 +358,13 @@ static int filter_frame(AVFilterLink *link, AVFrame *in)
         s->desat = 0;
     }
 
+    if (s->use_lut && s->lut_peak != peak) {
+        float err = build_lut(s, s->lut, peak);
+        av_log(s, AV_LOG_VERBOSE, "Tone curve table for peak %f, "
+               "estimated maximum error %g\n", peak, err);
+        s->lut_peak = peak;
+    }
+
     /* do the tone map */
     td.out = out;
     td.in = in;
@@ -292,6 +408,7 @@ static const AVOption tonemap_options[] = {
     { "param",        "tonemap parameter", OFFSET(param), AV_OPT_TYPE_DOUBLE, {.dbl = NAN}, DBL_MIN, DBL_MAX, FLAGS },
     { "desat",        "desaturation strength", OFFSET(desat), AV_OPT_TYPE_DOUBLE, {.dbl = 2}, 0, DBL_MAX, FLAGS },
     { "peak",         "signal peak override", OFFSET(peak), AV_OPT_TYPE_DOUBLE, {.dbl = 0}, 0, DBL_MAX, FLAGS },
+    { "lut",          "use a lookup table for the tone curve", OFFSET(use_lut), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, FLAGS },
     { NULL }
 };
 
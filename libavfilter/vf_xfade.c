@@ -327,67 +327,53 @@ static void fade##name##_transition(AVFilterContext *ctx,
 FADE_TRANSITION(8, uint8_t, 1)
 FADE_TRANSITION(16, uint16_t, 2)
 
-#define WIPELEFT_TRANSITION(name, type, div)                                         \
-static void wipeleft##name##_transition(AVFilterContext *ctx,                        \
-                                const AVFrame *a, const AVFrame *b, AVFrame *out,    \
-                                float progress,                                      \
-                                int slice_start, int slice_end, int jobnr)           \
-{                                                                                    \
-    XFadeContext *s = ctx->priv;                                                     \
-    const int height = slice_end - slice_start;                                      \
-    const int width = out->width;                                                    \
-    const int z = width * progress;                                                  \
-                                                                                     \
-    for (int p = 0; p < s->nb_planes; p++) {                                         \
-        const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
-        const type *xf1 = (const type *)(b->data[p] + slice_start * b->linesize[p]); \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
-                                                                                     \
-        for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < width; x++) {                                        \
-                dst[x] = x > z ? xf1[x] : xf0[x];                                    \
-            }                                                                        \
-                                                                                     \
-            dst += out->linesize[p] / div;                                           \
-            xf0 += a->linesize[p] / div;                                             \
-            xf1 += b->linesize[p] / div;                                             \
-        }                                                                            \
-    }                                                                                \
+/**
+ * Copy the columns [0, split) of each row from a and the remaining ones
+ * from b.
+ */
+static void wipe_planes(XFadeContext *s, const AVFrame *a, const AVFrame *b,
+                        AVFrame *out, int split, int slice_start, int slice_end)
+{
+    const int bpc = 1 + (s->depth > 8);
+    const int width = out->width;
+
+    split = av_clip(split, 0, width);
+
+    for (int p = 0; p < s->nb_planes; p++) {
+        const uint8_t *xf0 = a->data[p] + slice_start * a->linesize[p];
+        const uint8_t *xf1 = b->data[p] + slice_start * b->linesize[p];
+        uint8_t *dst = out->data[p] + slice_start * out->linesize[p];
+
+        for (int y = slice_start; y < slice_end; y++) {
+            memcpy(dst, xf0, split * bpc);
+            memcpy(dst + split * bpc, xf1 + split * bpc, (width - split) * bpc);
+
+            dst += out->linesize[p];
+            xf0 += a->linesize[p];
+            xf1 += b->linesize[p];
+        }
+    }
 }
 
-WIPELEFT_TRANSITION(8, uint8_t, 1)
-WIPELEFT_TRANSITION(16, uint16_t, 2)
+static void wipeleft_transition(AVFilterContext *ctx,
+                                const AVFrame *a, const AVFrame *b, AVFrame *out,
+                                float progress,
+                                int slice_start, int slice_end, int jobnr)
+{
+    const int z = out->width * progress;
 
-#define WIPERIGHT_TRANSITION(name, type, div)                                        \
-static void wiperight##name##_transition(AVFilterContext *ctx,                       \
-                                 const AVFrame *a, const AVFrame *b, AVFrame *out,   \
-                                 float progress,                                     \
-                                 int slice_start, int slice_end, int jobnr)          \
-{                                                                                    \
-    XFadeContext *s = ctx->priv;                                                     \
-    const int height = slice_end - slice_start;                                      \
-    const int width = out->width;                                                    \
-    const int z = width * (1.f - progress);                                          \
-                                                                                     \
-    for (int p = 0; p < s->nb_planes; p++) {                                         \
-        const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
-        const type *xf1 = (const type *)(b->data[p] + slice_start * b->linesize[p]); \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
-                                                                                     \
-        for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < width; x++) {                                        \
-                dst[x] = x > z ? xf0[x] : xf1[x];                                    \
-            }                                                                        \
-                                                                                     \
-            dst += out->linesize[p] / div;                                           \
-            xf0 += a->linesize[p] / div;                                             \
-            xf1 += b->linesize[p] / div;                                             \
-        }                                                                            \
-    }                                                                                \
+    wipe_planes(ctx->priv, a, b, out, z + 1, slice_start, slice_end);
 }
 
-WIPERIGHT_TRANSITION(8, uint8_t, 1)
-WIPERIGHT_TRANSITION(16, uint16_t, 2)
+static void wiperight_transition(AVFilterContext *ctx,
+                                 const AVFrame *a, const AVFrame *b, AVFrame *out,
+                                 float progress,
+                                 int slice_start, int slice_end, int jobnr)
+{
+    const int z = out->width * (1.f - progress);
+
+    wipe_planes(ctx->priv, b, a, out, z + 1, slice_start, slice_end);
+}
 
 #define WIPEUP_TRANSITION(name, type, div)                                           \
 static void wipeup##name##_transition(AVFilterContext *ctx,                          \
@@ -451,135 +437,99 @@ static void wipedown##name##_transition(AVFilterContext *ctx,
 WIPEDOWN_TRANSITION(8, uint8_t, 1)
 WIPEDOWN_TRANSITION(16, uint16_t, 2)
 
-#define SLIDELEFT_TRANSITION(name, type, div)                                        \
-static void slideleft##name##_transition(AVFilterContext *ctx,                       \
-                                 const AVFrame *a, const AVFrame *b, AVFrame *out,   \
-                                 float progress,                                     \
-                                 int slice_start, int slice_end, int jobnr)          \
-{                                                                                    \
-    XFadeContext *s = ctx->priv;                                                     \
-    const int height = slice_end - slice_start;                                      \
-    const int width = out->width;                                                    \
-    const int z = -progress * width;                                                 \
-                                                                                     \
-    for (int p = 0; p < s->nb_planes; p++) {                                         \
-        const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
-        const type *xf1 = (const type *)(b->data[p] + slice_start * b->linesize[p]); \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
-                                                                                     \
-        for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < width; x++) {                                        \
-                const int zx = z + x;                                                \
-                const int zz = zx % width + width * (zx < 0);                        \
-                dst[x] = (zx >= 0) && (zx < width) ? xf1[zz] : xf0[zz];              \
-            }                                                                        \
-                                                                                     \
-            dst += out->linesize[p] / div;                                           \
-            xf0 += a->linesize[p] / div;                                             \
-            xf1 += b->linesize[p] / div;                                             \
-        }                                                                            \
-    }                                                                                \
+/**
+ * Shift the rows of b left by z columns and fill the right side with the
+ * first z columns of a.
+ */
+static void slideh_planes(XFadeContext *s, const AVFrame *a, const AVFrame *b,
+                          AVFrame *out, int z, int slice_start, int slice_end)
+{
+    const int bpc = 1 + (s->depth > 8);
+    const int width = out->width;
+    const int n = width - z;
+
+    for (int p = 0; p < s->nb_planes; p++) {
+        const uint8_t *xf0 = a->data[p] + slice_start * a->linesize[p];
+        const uint8_t *xf1 = b->data[p] + slice_start * b->linesize[p];
+        uint8_t *dst = out->data[p] + slice_start * out->linesize[p];
+
+        for (int y = slice_start; y < slice_end; y++) {
+            memcpy(dst, xf1 + z * bpc, n * bpc);
+            memcpy(dst + n * bpc, xf0, z * bpc);
+
+            dst += out->linesize[p];
+            xf0 += a->linesize[p];
+            xf1 += b->linesize[p];
+        }
+    }
 }
 
-SLIDELEFT_TRANSITION(8, uint8_t, 1)
-SLIDELEFT_TRANSITION(16, uint16_t, 2)
+static void slideleft_transition(AVFilterContext *ctx,
+                                 const AVFrame *a, const AVFrame *b, AVFrame *out,
+                                 float progress,
+                                 int slice_start, int slice_end, int jobnr)
+{
+    const int width = out->width;
+    const int z = -progress * width;
 
-#define SLIDERIGHT_TRANSITION(name, type, div)                                       \
-static void slideright##name##_transition(AVFilterContext *ctx,                      \
-                                  const AVFrame *a, const AVFrame *b, AVFrame *out,  \
-                                  float progress,                                    \
-                                  int slice_start, int slice_end, int jobnr)         \
-{                                                                                    \
-    XFadeContext *s = ctx->priv;                                                     \
-    const int height = slice_end - slice_start;                                      \
-    const int width = out->width;                                                    \
-    const int z = progress * width;                                                  \
-                                                                                     \
-    for (int p = 0; p < s->nb_planes; p++) {                                         \
-        const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
-        const type *xf1 = (const type *)(b->data[p] + slice_start * b->linesize[p]); \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
-                                                                                     \
-        for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < width; x++) {                                        \
-                const int zx = z + x;                                                \
-                const int zz = zx % width + width * (zx < 0);                        \
-                dst[x] = (zx >= 0) && (zx < width) ? xf1[zz] : xf0[zz];              \
-            }                                                                        \
-                                                                                     \
-            dst += out->linesize[p] / div;                                           \
-            xf0 += a->linesize[p] / div;                                             \
-            xf1 += b->linesize[p] / div;                                             \
-        }                                                                            \
-    }                                                                                \
+    slideh_planes(ctx->priv, b, a, out, width + z, slice_start, slice_end);
 }
 
-SLIDERIGHT_TRANSITION(8, uint8_t, 1)
-SLIDERIGHT_TRANSITION(16, uint16_t, 2)
+static void slideright_transition(AVFilterContext *ctx,
+                                  const AVFrame *a, const AVFrame *b, AVFrame *out,
+                                  float progress,
+                                  int slice_start, int slice_end, int jobnr)
+{
+    const int z = progress * out->width;
 
-#define SLIDEUP_TRANSITION(name, type, div)                                         \
-static void slideup##name##_transition(AVFilterContext *ctx,                        \
-                               const AVFrame *a, const AVFrame *b, AVFrame *out,    \
-                               float progress,                                      \
-                               int slice_start, int slice_end, int jobnr)           \
-{                                                                                   \
-    XFadeContext *s = ctx->priv;                                                    \
-    const int height = out->height;                                                 \
-    const int width = out->width;                                                   \
-    const int z = -progress * height;                                               \
-                                                                                    \
-    for (int p = 0; p < s->nb_planes; p++) {                                        \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);        \
-                                                                                    \
-        for (int y = slice_start; y < slice_end; y++) {                             \
-            const int zy = z + y;                                                   \
-            const int zz = zy % height + height * (zy < 0);                         \
-            const type *xf0 = (const type *)(a->data[p] + zz * a->linesize[p]);     \
-            const type *xf1 = (const type *)(b->data[p] + zz * b->linesize[p]);     \
-                                                                                    \
-            for (int x = 0; x < width; x++) {                                       \
-                dst[x] = (zy >= 0) && (zy < height) ? xf1[x] : xf0[x];              \
-            }                                                                       \
-                                                                                    \
-            dst += out->linesize[p] / div;                                          \
-        }                                                                           \
-    }                                                                               \
+    slideh_planes(ctx->priv, a, b, out, z, slice_start, slice_end);
 }
 
-SLIDEUP_TRANSITION(8, uint8_t, 1)
-SLIDEUP_TRANSITION(16, uint16_t, 2)
+/**
+ * Take row y + z of b, or the wrapped around row of a if that is outside
+ * of the frame.
+ */
+static void slidev_planes(XFadeContext *s, const AVFrame *a, const AVFrame *b,
+                          AVFrame *out, int z, int slice_start, int slice_end)
+{
+    const int bpc = 1 + (s->depth > 8);
+    const int height = out->height;
+    const int width = out->width;
 
-#define SLIDEDOWN_TRANSITION(name, type, div)                                       \
-static void slidedown##name##_transition(AVFilterContext *ctx,                      \
-                                 const AVFrame *a, const AVFrame *b, AVFrame *out,  \
-                                 float progress,                                    \
-                                 int slice_start, int slice_end, int jobnr)         \
-{                                                                                   \
-    XFadeContext *s = ctx->priv;                                                    \
-    const int height = out->height;                                                 \
-    const int width = out->width;                                                   \
-    const int z = progress * height;                                                \
-                                                                                    \
-    for (int p = 0; p < s->nb_planes; p++) {                                        \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);        \
-                                                                                    \
-        for (int y = slice_start; y < slice_end; y++) {                             \
-            const int zy = z + y;                                                   \
-            const int zz = zy % height + height * (zy < 0);                         \
-            const type *xf0 = (const type *)(a->data[p] + zz * a->linesize[p]);     \
-            const type *xf1 = (const type *)(b->data[p] + zz * b->linesize[p]);     \
-                                                                                    \
-            for (int x = 0; x < width; x++) {                                       \
-                dst[x] = (zy >= 0) && (zy < height) ? xf1[x] : xf0[x];              \
-            }                                                                       \
-                                                                                    \
-            dst += out->linesize[p] / div;                                          \
-        }                                                                           \
-    }                                                                               \
+    for (int p = 0; p < s->nb_planes; p++) {
+        uint8_t *dst = out->data[p] + slice_start * out->linesize[p];
+
+        for (int y = slice_start; y < slice_end; y++) {
+            const int zy = z + y;
+            const int zz = zy < 0 ? zy + height : zy % height;
+            const AVFrame *src = (zy >= 0) && (zy < height) ? b : a;
+
+            memcpy(dst, src->data[p] + zz * src->linesize[p], width * bpc);
+
+            dst += out->linesize[p];
+        }
+    }
 }
 
-SLIDEDOWN_TRANSITION(8, uint8_t, 1)
-SLIDEDOWN_TRANSITION(16, uint16_t, 2)
+static void slideup_transition(AVFilterContext *ctx,
+                               const AVFrame *a, const AVFrame *b, AVFrame *out,
+                               float progress,
+                               int slice_start, int slice_end, int jobnr)
+{
+    const int z = -progress * out->height;
+
+    slidev_planes(ctx->priv, a, b, out, z, slice_start, slice_end);
+}
+
+static void slidedown_transition(AVFilterContext *ctx,
+                                 const AVFrame *a, const AVFrame *b, AVFrame *out,
+                                 float progress,
+                                 int slice_start, int slice_end, int jobnr)
+{
+    const int z = progress * out->height;
+
+    slidev_planes(ctx->priv, a, b, out, z, slice_start, slice_end);
+}
 
 #define CIRCLECROP_TRANSITION(name, type, div)                                      \
 static void circlecrop##name##_transition(AVFilterContext *ctx,                     \
@@ -684,28 +634,28 @@ static void distance##name##_transition(AVFilterContext *ctx,
 DISTANCE_TRANSITION(8, uint8_t, 1)
 DISTANCE_TRANSITION(16, uint16_t, 2)
 
-#define FADEBLACK_TRANSITION(name, type, div)                                        \
-static void fadeblack##name##_transition(AVFilterContext *ctx,                       \
+#define FADECOLOR_TRANSITION(name, type, div)                                        \
+static void fadecolor##name##_transition(AVFilterContext *ctx,                       \
                             const AVFrame *a, const AVFrame *b, AVFrame *out,        \
-                            float progress,                                          \
-                            int slice_start, int slice_end, int jobnr)               \
+                            float progress, const uint16_t *color,                   \
+                            int slice_start, int slice_end)                          \
 {                                                                                    \
     XFadeContext *s = ctx->priv;                                                     \
     const int height = slice_end - slice_start;                                      \
     const int width = out->width;                                                    \
     const float phase = 0.2f;                                                        \
+    const float s0 = smoothstep(1.f-phase, 1.f, progress);                           \
+    const float s1 = smoothstep(phase, 1.f, progress);                               \
                                                                                      \
     for (int p = 0; p < s->nb_planes; p++) {                                         \
         const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
         const type *xf1 = (const type *)(b->data[p] + slice_start * b->linesize[p]); \
         type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
-        const int bg = s->black[p];                                                  \
+        const int bg = color[p];                                                     \
                                                                                      \
         for (int y = 0; y < height; y++) {                                           \
             for (int x = 0; x < width; x++) {                                        \
-                dst[x] = mix(mix(xf0[x], bg, smoothstep(1.f-phase, 1.f, progress)),  \
-                         mix(bg, xf1[x], smoothstep(phase, 1.f, progress)),          \
-                             progress);                                              \
+                dst[x] = mix(mix(xf0[x], bg, s0), mix(bg, xf1[x], s1), progress);    \
             }                                                                        \
                                                                                      \
             dst += out->linesize[p] / div;                                           \
@@ -713,44 +663,32 @@ static void fadeblack##name##_transition(AVFilterContext *ctx,
             xf1 += b->linesize[p] / div;                                             \
         }                                                                            \
     }                                                                                \
-}
-
-FADEBLACK_TRANSITION(8, uint8_t, 1)
-FADEBLACK_TRANSITION(16, uint16_t, 2)
-
-#define FADEWHITE_TRANSITION(name, type, div)                                        \
-static void fadewhite##name##_transition(AVFilterContext *ctx,                       \
+}                                                                                    \
+                                                                                     \
+static void fadeblack##name##_transition(AVFilterContext *ctx,                       \
                             const AVFrame *a, const AVFrame *b, AVFrame *out,        \
                             float progress,                                          \
                             int slice_start, int slice_end, int jobnr)               \
 {                                                                                    \
     XFadeContext *s = ctx->priv;                                                     \
-    const int height = slice_end - slice_start;                                      \
-    const int width = out->width;                                                    \
-    const float phase = 0.2f;                                                        \
                                                                                      \
-    for (int p = 0; p < s->nb_planes; p++) {                                         \
-        const type *xf0 = (const type *)(a->data[p] + slice_start * a->linesize[p]); \
-        const type *xf1 = (const type *)(b->data[p] + slice_start * b->linesize[p]); \
-        type *dst = (type *)(out->data[p] + slice_start * out->linesize[p]);         \
-        const int bg = s->white[p];                                                  \
+    fadecolor##name##_transition(ctx, a, b, out, progress, s->black,                 \
+                                 slice_start, slice_end);                            \
+}                                                                                    \
                                                                                      \
-        for (int y = 0; y < height; y++) {                                           \
-            for (int x = 0; x < width; x++) {                                        \
-                dst[x] = mix(mix(xf0[x], bg, smoothstep(1.f-phase, 1.f, progress)),  \
-                         mix(bg, xf1[x], smoothstep(phase, 1.f, progress)),          \
-                             progress);                                              \
-            }                                                                        \
+static void fadewhite##name##_transition(AVFilterContext *ctx,                       \
+                            const AVFrame *a, const AVFrame *b, AVFrame *out,        \
+                            float progress,                                          \
+                            int slice_start, int slice_end, int jobnr)               \
+{                                                                                    \
+    XFadeContext *s = ctx->priv;                                                     \
                                                                                      \
-            dst += out->linesize[p] / div;                                           \
-            xf0 += a->linesize[p] / div;                                             \
-            xf1 += b->linesize[p] / div;                                             \
-        }                                                                            \
-    }                                                                                \
+    fadecolor##name##_transition(ctx, a, b, out, progress, s->white,                 \
+                                 slice_start, slice_end);                            \
 }
 
-FADEWHITE_TRANSITION(8, uint8_t, 1)
-FADEWHITE_TRANSITION(16, uint16_t, 2)
+FADECOLOR_TRANSITION(8, uint8_t, 1)
+FADECOLOR_TRANSITION(16, uint16_t, 2)
 
 #define RADIAL_TRANSITION(name, type, div)                                           \
 static void radial##name##_transition(AVFilterContext *ctx,                          \
@@ -2103,14 +2041,14 @@ static int config_output(AVFilterLink *outlink)
     switch (s->transition) {
     case CUSTOM:     s->transitionf = s->depth <= 8 ? custom8_transition     : custom16_transition;     break;
     case FADE:       s->transitionf = s->depth <= 8 ? fade8_transition       : fade16_transition;       break;
-    case WIPELEFT:   s->transitionf = s->depth <= 8 ? wipeleft8_transition   : wipeleft16_transition;   break;
-    case WIPERIGHT:  s->transitionf = s->depth <= 8 ? wiperight8_transition  : wiperight16_transition;  break;
+    case WIPELEFT:   s->transitionf = wipeleft_transition; break;
+    case WIPERIGHT:  s->transitionf = wiperight_transition; break;
     case WIPEUP:     s->transitionf = s->depth <= 8 ? wipeup8_transition     : wipeup16_transition;     break;
     case WIPEDOWN:   s->transitionf = s->depth <= 8 ? wipedown8_transition   : wipedown16_transition;   break;
-    case SLIDELEFT:  s->transitionf = s->depth <= 8 ? slideleft8_transition  : slideleft16_transition;  break;
-    case SLIDERIGHT: s->transitionf = s->depth <= 8 ? slideright8_transition : slideright16_transition; break;
-    case SLIDEUP:    s->transitionf = s->depth <= 8 ? slideup8_transition    : slideup16_transition;    break;
-    case SLIDEDOWN:  s->transitionf = s->depth <= 8 ? slidedown8_transition  : slidedown16_transition;  break;
+    case SLIDELEFT:  s->transitionf = slideleft_transition; break;
+    case SLIDERIGHT: s->transitionf = slideright_transition; break;
+    case SLIDEUP:    s->transitionf = slideup_transition; break;
+    case SLIDEDOWN:  s->transitionf = slidedown_transition; break;
     case CIRCLECROP: s->transitionf = s->depth <= 8 ? circlecrop8_transition : circlecrop16_transition; break;
     case RECTCROP:   s->transitionf = s->depth <= 8 ? rectcrop8_transition   : rectcrop16_transition;   break;
     case DISTANCE:   s->transitionf = s->depth <= 8 ? distance8_transition   : distance16_transition;   break;
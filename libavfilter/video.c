@@ -54,6 +54,7 @@ AVFrame *ff_default_get_video_buffer2(AVFilterLink *link, int w, int h, int alig
     int pool_height = 0;
     int pool_align = 0;
     enum AVPixelFormat pool_format = AV_PIX_FMT_NONE;
+    AVBufferRef *(*alloc)(size_t size) = av_buffer_allocz;
 
     if (link->hw_frames_ctx &&
         ((AVHWFramesContext*)link->hw_frames_ctx->data)->format == link->format) {
@@ -70,11 +71,15 @@ AVFrame *ff_default_get_video_buffer2(AVFilterLink *link, int w, int h, int alig
         return frame;
     }
 
+    if (link->graph && fffiltergraph(link->graph)->hugepages)
+        alloc = av_buffer_alloc_hugepages;
+
     if (!li->frame_pool) {
-        li->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, w, h,
+        li->frame_pool = ff_frame_pool_video_init(alloc, w, h,
                                                   link->format, align);
         if (!li->frame_pool)
             return NULL;
+        li->frame_pool_alloc = alloc;
     } else {
         if (ff_frame_pool_get_video_config(li->frame_pool,
                                            &pool_width, &pool_height,
@@ -83,13 +88,15 @@ AVFrame *ff_default_get_video_buffer2(AVFilterLink *link, int w, int h, int alig
         }
 
         if (pool_width != w || pool_height != h ||
-            pool_format != link->format || pool_align != align) {
+            pool_format != link->format || pool_align != align ||
+            li->frame_pool_alloc != alloc) {
 
             ff_frame_pool_uninit(&li->frame_pool);
-            li->frame_pool = ff_frame_pool_video_init(av_buffer_allocz, w, h,
+            li->frame_pool = ff_frame_pool_video_init(alloc, w, h,
                                                       link->format, align);
             if (!li->frame_pool)
                 return NULL;
+            li->frame_pool_alloc = alloc;
         }
     }
 
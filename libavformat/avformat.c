@@ -184,6 +184,7 @@ void avformat_free_context(AVFormatContext *s)
     av_freep(&s->stream_groups);
     ff_flush_packet_queue(s);
     av_freep(&s->url);
+    av_buffer_account_unref(&s->mem_account);
     av_free(s);
 }
 
@@ -1882,6 +1882,17 @@ typedef struct AVFormatContext {
      * @see skip_estimate_duration_from_pts
      */
     int64_t duration_probesize;
+
+    /**
+     * Account charged with the memory of the packets read by the demuxer,
+     * including the ones buffered internally, e.g. while probing the streams
+     * in avformat_find_stream_info(). See AVBufferAccount.
+     *
+     * Demuxing only, may be set by the caller before avformat_open_input() to
+     * a reference to an account. The reference is owned and released by
+     * libavformat in avformat_free_context() afterwards.
+     */
+    AVBufferAccount *mem_account;
 } AVFormatContext;
 
 /**
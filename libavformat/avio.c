@@ -61,6 +61,8 @@ static const AVOption options[] = {
     {"protocol_whitelist", "List of protocols that are allowed to be used", OFFSET(protocol_whitelist), AV_OPT_TYPE_STRING, { .str = NULL },  0, 0, D },
     {"protocol_blacklist", "List of protocols that are not allowed to be used", OFFSET(protocol_blacklist), AV_OPT_TYPE_STRING, { .str = NULL },  0, 0, D },
     {"rw_timeout", "Timeout for IO operations (in microseconds)", offsetof(URLContext, rw_timeout), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, AV_OPT_FLAG_ENCODING_PARAM | AV_OPT_FLAG_DECODING_PARAM },
+    {"readahead_blocks", "Number of blocks to read ahead in a background thread", OFFSET(readahead_blocks), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 256, D },
+    {"max_io_buffer_size", "Maximum size of the read buffer, which grows on sequential access", OFFSET(max_io_buffer_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 64 << 20, D },
     { NULL }
 };
 
@@ -109,8 +111,11 @@ URLContext *ffio_geturlcontext(AVIOContext *s)
     if (!s)
         return NULL;
 
-    if (s->opaque && s->read_packet == ffurl_read2)
+    if (s->opaque && s->read_packet == ffurl_read2) {
+        /* the caller takes over the protocol */
+        ffio_prefetch_free(s);
         return s->opaque;
+    }
     else
         return NULL;
 }
@@ -148,6 +153,7 @@ static int url_alloc_for_protocol(URLContext **puc, const URLProtocol *up,
     uc->flags           = flags;
     uc->is_streamed     = 0; /* default = not streamed */
     uc->max_packet_size = 0; /* default: stream file */
+    atomic_init(&uc->readahead_abort, 0);
     if (up->priv_data_size) {
         uc->priv_data = av_mallocz(up->priv_data_size);
         if (!uc->priv_data) {
@@ -359,6 +365,15 @@ int ffurl_alloc(URLContext **puc, const char *filename, int flags,
     return AVERROR_PROTOCOL_NOT_FOUND;
 }
 
+static int readahead_check_interrupt(void *arg)
+{
+    URLContext *h = arg;
+
+    if (atomic_load(&h->readahead_abort))
+        return 1;
+    return ff_check_interrupt(&h->readahead_interrupt_callback);
+}
+
 int ffurl_open_whitelist(URLContext **puc, const char *filename, int flags,
                          const AVIOInterruptCB *int_cb, AVDictionary **options,
                          const char *whitelist, const char* blacklist,
@@ -400,6 +415,15 @@ int ffurl_open_whitelist(URLContext **puc, const char *filename, int flags,
     if ((ret = av_opt_set_dict(*puc, options)) < 0)
         goto fail;
 
+    /* wrap the interrupt callback before connecting, so that the nested
+     * protocols get the wrapper too and ffio_prefetch_free() can interrupt
+     * a read blocked in any of them */
+    if ((*puc)->readahead_blocks && !parent && !(flags & AVIO_FLAG_WRITE)) {
+        (*puc)->readahead_interrupt_callback = (*puc)->interrupt_callback;
+        (*puc)->interrupt_callback.callback  = readahead_check_interrupt;
+        (*puc)->interrupt_callback.opaque    = *puc;
+    }
+
     ret = ffurl_connect(*puc, options);
 
     if (!ret)
@@ -465,6 +489,23 @@ int ffio_fdopen(AVIOContext **sp, URLContext *h)
     }
     ((FFIOContext*)s)->short_seek_get = ffurl_get_short_seek;
     s->av_class = &ff_avio_class;
+
+    if (!(h->flags & AVIO_FLAG_WRITE) && !max_packet_size) {
+        FFIOContext *const ctx = ffiocontext(s);
+
+        if (h->max_io_buffer_size > buffer_size)
+            ctx->max_buffer_size = h->max_io_buffer_size;
+
+        /* protocols with their own notion of pausing and seeking in time
+         * are driven by the demuxer, leave them alone */
+        if (h->readahead_blocks && !s->direct &&
+            !s->read_pause && !s->read_seek) {
+            int ret = ffio_prefetch_init(s, h->readahead_blocks,
+                                         FFMAX(buffer_size, ctx->max_buffer_size));
+            if (ret < 0)
+                av_log(h, AV_LOG_WARNING, "Not reading ahead: %s\n", av_err2str(ret));
+        }
+    }
     return 0;
 }
 
@@ -623,6 +664,7 @@ int avio_close(AVIOContext *s)
         return 0;
 
     avio_flush(s);
+    ffio_prefetch_free(s);
     h         = s->opaque;
     s->opaque = NULL;
 
@@ -25,6 +25,8 @@
 
 extern const AVClass ff_avio_class;
 
+typedef struct FFIOPrefetch FFIOPrefetch;
+
 typedef struct FFIOContext {
     AVIOContext pub;
     /**
@@ -76,6 +78,27 @@ typedef struct FFIOContext {
      * is updated each time a successful writeout ends up further position-wise
      */
     int64_t written_output_size;
+
+    /**
+     * Maximum size the read buffer grows to on sequential access,
+     * 0 to keep the buffer size fixed
+     */
+    int max_buffer_size;
+
+    /**
+     * Current size of the adaptive read buffer, 0 if it did not grow
+     */
+    int read_buffer_size;
+
+    /**
+     * Number of buffer refills since the last seek
+     */
+    int nb_sequential_fills;
+
+    /**
+     * Background reader, used instead of read_packet() and seek() if set
+     */
+    FFIOPrefetch *prefetch;
 } FFIOContext;
 
 static av_always_inline FFIOContext *ffiocontext(AVIOContext *ctx)
@@ -126,6 +149,44 @@ static av_always_inline void ffio_wfourcc(AVIOContext *pb, const uint8_t *s)
     avio_wl32(pb, MKTAG(s[0], s[1], s[2], s[3]));
 }
 
+/**
+ * Start reading up to nb_blocks blocks of block_size bytes ahead of the
+ * current position of s in a background thread. The read_packet() and seek()
+ * callbacks of s are only called from that thread afterwards, so they must
+ * not be called directly; every seek discards the blocks read ahead.
+ *
+ * @return 0 on success, a negative AVERROR code on failure, in which case
+ *         s is left unchanged
+ */
+int ffio_prefetch_init(AVIOContext *s, int nb_blocks, int block_size);
+
+/**
+ * Stop the background reader of s, if any, and discard the blocks read
+ * ahead. The underlying stream is left at the position the reader reached.
+ */
+void ffio_prefetch_free(AVIOContext *s);
+
+/**
+ * Read from the blocks read ahead, waiting for the next one if none is
+ * available. Same semantics as the read_packet() callback.
+ */
+int ffio_prefetch_read(FFIOPrefetch *p, uint8_t *buf, int size);
+
+/**
+ * Seek the underlying stream, once the read in progress has finished.
+ * Same semantics as the seek() callback.
+ */
+int64_t ffio_prefetch_seek(FFIOPrefetch *p, int64_t offset, int whence);
+
+/**
+ * @return the distance up to which a forward seek is cheaper to do by
+ *         reading: the larger of the bytes which can be read without waiting
+ *         and the short seek threshold of the underlying protocol, which the
+ *         background reader queries after each read, as the protocol must
+ *         not be called from another thread
+ */
+int ffio_prefetch_short_seek(FFIOPrefetch *p);
+
 /**
  * Rewind the AVIOContext using the specified buffer containing the first buf_size bytes of the file.
  * Used after probing to avoid seeking.
@@ -0,0 +1,331 @@
+/*
+ * Background read-ahead for AVIOContext
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Read-ahead thread for AVIOContext, along the lines of the async protocol
+ * but usable with any read context. The thread fills a ring of fixed size
+ * blocks with the read_packet() callback while the demuxer consumes the
+ * previous ones; seeks wait for the read in progress and drop the ring.
+ */
+
+#include "config.h"
+
+#include <limits.h>
+#include <string.h>
+
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+
+#include "avio_internal.h"
+#include "url.h"
+
+#if HAVE_THREADS
+
+struct FFIOPrefetch {
+    void    *opaque;
+    int     (*read_packet)(void *opaque, uint8_t *buf, int buf_size);
+    int64_t (*seek)(void *opaque, int64_t offset, int whence);
+    int     (*short_seek_get)(void *opaque);
+
+    uint8_t *buffer;
+    int     *sizes;
+    int      nb_blocks;
+    int      block_size;
+    URLContext *url;        ///< underlying protocol, if any
+
+    /* the fields below are protected by mutex */
+    int      head;          ///< index of the block being consumed
+    int      head_offset;   ///< bytes already consumed from the head block
+    int      nb_filled;     ///< number of blocks ready to be consumed
+    int      error;         ///< error or EOF met after the filled blocks
+    int      reading;       ///< the thread is calling read_packet()
+    int      short_seek;    ///< short_seek_get() after the last read or seek
+    int      abort;
+    int64_t  pos;           ///< position of the first byte not consumed
+
+    pthread_mutex_t mutex;
+    pthread_cond_t  cond_main;
+    pthread_cond_t  cond_thread;
+    pthread_t       thread;
+};
+
+static void *prefetch_thread(void *arg)
+{
+    FFIOPrefetch *p = arg;
+
+    ff_thread_setname("avio-prefetch");
+
+    pthread_mutex_lock(&p->mutex);
+    while (!p->abort) {
+        int idx, ret, short_seek;
+
+        if (p->error || p->nb_filled == p->nb_blocks) {
+            pthread_cond_wait(&p->cond_thread, &p->mutex);
+            continue;
+        }
+
+        idx = (p->head + p->nb_filled) % p->nb_blocks;
+        p->reading = 1;
+        pthread_mutex_unlock(&p->mutex);
+
+        ret = p->read_packet(p->opaque, p->buffer + (size_t)idx * p->block_size,
+                             p->block_size);
+        /* the protocol may reconnect while reading, so it is asked here
+         * rather than by the thread seeking */
+        short_seek = p->short_seek_get ? p->short_seek_get(p->opaque) : 0;
+
+        pthread_mutex_lock(&p->mutex);
+        p->reading    = 0;
+        p->short_seek = short_seek;
+        if (ret > 0) {
+            p->sizes[idx] = ret;
+            p->nb_filled++;
+        } else {
+            p->error = ret ? ret : AVERROR_EOF;
+        }
+        pthread_cond_signal(&p->cond_main);
+    }
+    pthread_mutex_unlock(&p->mutex);
+
+    return NULL;
+}
+
+int ffio_prefetch_read(FFIOPrefetch *p, uint8_t *buf, int size)
+{
+    int ret;
+
+    pthread_mutex_lock(&p->mutex);
+    while (!p->nb_filled && !p->error)
+        pthread_cond_wait(&p->cond_main, &p->mutex);
+
+    if (p->nb_filled) {
+        const uint8_t *src = p->buffer + (size_t)p->head * p->block_size;
+        int left = p->sizes[p->head] - p->head_offset;
+
+        ret = FFMIN(size, left);
+        memcpy(buf, src + p->head_offset, ret);
+        p->head_offset += ret;
+        p->pos         += ret;
+        if (ret == left) {
+            p->head        = (p->head + 1) % p->nb_blocks;
+            p->head_offset = 0;
+            p->nb_filled--;
+            pthread_cond_signal(&p->cond_thread);
+        }
+    } else {
+        /* report the error once, reading again retries, e.g. for growing
+         * files */
+        ret      = p->error;
+        p->error = 0;
+        pthread_cond_signal(&p->cond_thread);
+    }
+    pthread_mutex_unlock(&p->mutex);
+
+    return ret;
+}
+
+int64_t ffio_prefetch_seek(FFIOPrefetch *p, int64_t offset, int whence)
+{
+    int64_t ret;
+
+    pthread_mutex_lock(&p->mutex);
+    while (p->reading)
+        pthread_cond_wait(&p->cond_main, &p->mutex);
+
+    /* the underlying stream is ahead of the consumer */
+    if (whence == SEEK_CUR) {
+        offset += p->pos;
+        whence  = SEEK_SET;
+    }
+
+    ret = p->seek(p->opaque, offset, whence);
+    if (ret >= 0 && !(whence & AVSEEK_SIZE)) {
+        p->head        = 0;
+        p->head_offset = 0;
+        p->nb_filled   = 0;
+        p->error       = 0;
+        p->pos         = ret;
+        pthread_cond_signal(&p->cond_thread);
+    }
+    if (p->short_seek_get)
+        p->short_seek = p->short_seek_get(p->opaque);
+    pthread_mutex_unlock(&p->mutex);
+
+    return ret;
+}
+
+int ffio_prefetch_short_seek(FFIOPrefetch *p)
+{
+    int64_t available = 0;
+    int short_seek;
+
+    pthread_mutex_lock(&p->mutex);
+    if (p->nb_filled) {
+        available = -p->head_offset;
+        for (int i = 0; i < p->nb_filled; i++)
+            available += p->sizes[(p->head + i) % p->nb_blocks];
+    }
+    short_seek = p->short_seek;
+    pthread_mutex_unlock(&p->mutex);
+
+    return FFMAX(FFMIN(available, INT_MAX), short_seek);
+}
+
+static void prefetch_free(FFIOPrefetch **pp)
+{
+    FFIOPrefetch *p = *pp;
+
+    if (!p)
+        return;
+
+    av_freep(&p->buffer);
+    av_freep(&p->sizes);
+    av_freep(pp);
+}
+
+int ffio_prefetch_init(AVIOContext *s, int nb_blocks, int block_size)
+{
+    FFIOContext *const ctx = ffiocontext(s);
+    FFIOPrefetch *p;
+    int ret;
+
+    if (ctx->prefetch)
+        return AVERROR(EINVAL);
+    if (!s->read_packet || !s->seek || s->write_flag ||
+        nb_blocks <= 0 || block_size <= 0 || nb_blocks > INT_MAX / block_size)
+        return AVERROR(EINVAL);
+
+    p = av_mallocz(sizeof(*p));
+    if (!p)
+        return AVERROR(ENOMEM);
+
+    p->opaque      = s->opaque;
+    p->read_packet = s->read_packet;
+    p->seek        = s->seek;
+    p->short_seek_get = ctx->short_seek_get;
+    p->nb_blocks   = nb_blocks;
+    p->block_size  = block_size;
+    p->pos         = s->pos;
+    /* not ffio_geturlcontext(), which stops the prefetching */
+    p->url         = s->read_packet == ffurl_read2 ? s->opaque : NULL;
+    if (p->short_seek_get)
+        p->short_seek = p->short_seek_get(p->opaque);
+
+    p->buffer = av_malloc((size_t)nb_blocks * block_size);
+    p->sizes  = av_calloc(nb_blocks, sizeof(*p->sizes));
+    if (!p->buffer || !p->sizes) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    ret = pthread_mutex_init(&p->mutex, NULL);
+    if (ret) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    ret = pthread_cond_init(&p->cond_main, NULL);
+    if (ret) {
+        ret = AVERROR(ret);
+        goto cond_main_fail;
+    }
+    ret = pthread_cond_init(&p->cond_thread, NULL);
+    if (ret) {
+        ret = AVERROR(ret);
+        goto cond_thread_fail;
+    }
+    ret = pthread_create(&p->thread, NULL, prefetch_thread, p);
+    if (ret) {
+        ret = AVERROR(ret);
+        goto thread_fail;
+    }
+
+    ctx->prefetch = p;
+    return 0;
+
+thread_fail:
+    pthread_cond_destroy(&p->cond_thread);
+cond_thread_fail:
+    pthread_cond_destroy(&p->cond_main);
+cond_main_fail:
+    pthread_mutex_destroy(&p->mutex);
+fail:
+    prefetch_free(&p);
+    return ret;
+}
+
+void ffio_prefetch_free(AVIOContext *s)
+{
+    FFIOContext *const ctx = ffiocontext(s);
+    FFIOPrefetch *p = ctx->prefetch;
+
+    if (!p)
+        return;
+
+    pthread_mutex_lock(&p->mutex);
+    p->abort = 1;
+    pthread_cond_signal(&p->cond_thread);
+    pthread_mutex_unlock(&p->mutex);
+
+    /* make a read blocked in the protocol return, see
+     * ffurl_open_whitelist() */
+    if (p->url)
+        atomic_store(&p->url->readahead_abort, 1);
+
+    pthread_join(p->thread, NULL);
+
+    if (p->url)
+        atomic_store(&p->url->readahead_abort, 0);
+
+    pthread_cond_destroy(&p->cond_thread);
+    pthread_cond_destroy(&p->cond_main);
+    pthread_mutex_destroy(&p->mutex);
+    prefetch_free(&ctx->prefetch);
+}
+
+#else
+
+int ffio_prefetch_init(AVIOContext *s, int nb_blocks, int block_size)
+{
+    return AVERROR(ENOSYS);
+}
+
+void ffio_prefetch_free(AVIOContext *s)
+{
+}
+
+int ffio_prefetch_read(FFIOPrefetch *p, uint8_t *buf, int size)
+{
+    return AVERROR(ENOSYS);
+}
+
+int64_t ffio_prefetch_seek(FFIOPrefetch *p, int64_t offset, int whence)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ffio_prefetch_short_seek(FFIOPrefetch *p)
+{
+    return 0;
+}
+
+#endif /* HAVE_THREADS */
@@ -43,9 +43,11 @@
 #define SHORT_SEEK_THRESHOLD 32768
 
 static void fill_buffer(AVIOContext *s);
+static int64_t seek_wrapper(AVIOContext *s, int64_t offset, int whence);
 static int url_resetbuf(AVIOContext *s, int flags);
 /** @warning must be called before any I/O */
 static int set_buf_size(AVIOContext *s, int buf_size);
+static int replace_buffer(AVIOContext *s, int buf_size);
 
 void ffio_init_context(FFIOContext *ctx,
                   unsigned char *buffer,
@@ -242,7 +244,7 @@ int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
         return AVERROR(EINVAL);
 
     if ((whence & AVSEEK_SIZE))
-        return s->seek ? s->seek(s->opaque, offset, AVSEEK_SIZE) : AVERROR(ENOSYS);
+        return s->seek ? seek_wrapper(s, offset, AVSEEK_SIZE) : AVERROR(ENOSYS);
 
     buffer_size = s->buf_end - s->buffer;
     // pos is the absolute position that the beginning of s->buffer corresponds to in the file
@@ -263,7 +265,11 @@ int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
         return AVERROR(EINVAL);
 
     short_seek = ctx->short_seek_threshold;
-    if (ctx->short_seek_get) {
+    if (ctx->prefetch) {
+        /* the read-ahead thread may be inside the protocol, which it asks
+         * on our behalf */
+        short_seek = FFMAX(short_seek, ffio_prefetch_short_seek(ctx->prefetch));
+    } else if (ctx->short_seek_get) {
         int tmp = ctx->short_seek_get(s->opaque);
         short_seek = FFMAX(tmp, short_seek);
     }
@@ -288,7 +294,7 @@ int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
         int64_t res;
 
         pos -= FFMIN(buffer_size>>1, pos);
-        if ((res = s->seek(s->opaque, pos, SEEK_SET)) < 0)
+        if ((res = seek_wrapper(s, pos, SEEK_SET)) < 0)
             return res;
         s->buf_end =
         s->buf_ptr = s->buffer;
@@ -303,9 +309,11 @@ int64_t avio_seek(AVIOContext *s, int64_t offset, int whence)
         }
         if (!s->seek)
             return AVERROR(EPIPE);
-        if ((res = s->seek(s->opaque, offset, SEEK_SET)) < 0)
+        if ((res = seek_wrapper(s, offset, SEEK_SET)) < 0)
             return res;
         ctx->seek_count++;
+        ctx->nb_sequential_fills = 0;
+        ctx->read_buffer_size    = 0;
         if (!s->write_flag)
             s->buf_end = s->buffer;
         s->buf_ptr = s->buf_ptr_max = s->buffer;
@@ -333,12 +341,12 @@ int64_t avio_size(AVIOContext *s)
 
     if (!s->seek)
         return AVERROR(ENOSYS);
-    size = s->seek(s->opaque, 0, AVSEEK_SIZE);
+    size = seek_wrapper(s, 0, AVSEEK_SIZE);
     if (size < 0) {
-        if ((size = s->seek(s->opaque, -1, SEEK_END)) < 0)
+        if ((size = seek_wrapper(s, -1, SEEK_END)) < 0)
             return size;
         size++;
-        s->seek(s->opaque, s->pos, SEEK_SET);
+        seek_wrapper(s, s->pos, SEEK_SET);
     }
     return size;
 }
@@ -497,15 +505,27 @@ void avio_write_marker(AVIOContext *s, int64_t time, enum AVIODataMarkerType typ
 
 static int read_packet_wrapper(AVIOContext *s, uint8_t *buf, int size)
 {
+    FFIOPrefetch *const prefetch = ffiocontext(s)->prefetch;
     int ret;
 
     if (!s->read_packet)
         return AVERROR(EINVAL);
+    if (prefetch)
+        return ffio_prefetch_read(prefetch, buf, size);
     ret = s->read_packet(s->opaque, buf, size);
     av_assert2(ret || s->max_packet_size);
     return ret;
 }
 
+static int64_t seek_wrapper(AVIOContext *s, int64_t offset, int whence)
+{
+    FFIOPrefetch *const prefetch = ffiocontext(s)->prefetch;
+
+    if (prefetch)
+        return ffio_prefetch_seek(prefetch, offset, whence);
+    return s->seek(s->opaque, offset, whence);
+}
+
 /* Input stream */
 
 static void fill_buffer(AVIOContext *s)
@@ -516,6 +536,7 @@ static void fill_buffer(AVIOContext *s)
     uint8_t *dst        = s->buf_end - s->buffer + max_buffer_size <= s->buffer_size ?
                           s->buf_end : s->buffer;
     int len             = s->buffer_size - (dst - s->buffer);
+    int read_size;
 
     /* can't fill the buffer without read_packet, just set EOF if appropriate */
     if (!s->read_packet && s->buf_ptr >= s->buf_end)
@@ -532,17 +553,36 @@ static void fill_buffer(AVIOContext *s)
         s->checksum_ptr = s->buffer;
     }
 
+    /* double the read size every other refill of the whole buffer as long
+     * as the data is read sequentially */
+    if (ctx->max_buffer_size && s->read_packet && !s->max_packet_size &&
+        dst == s->buffer && s->buf_ptr != dst && ++ctx->nb_sequential_fills >= 2) {
+        read_size = FFMAX(ctx->read_buffer_size, ctx->orig_buffer_size);
+        if (read_size < ctx->max_buffer_size)
+            ctx->read_buffer_size = FFMIN(2LL * read_size, ctx->max_buffer_size);
+        ctx->nb_sequential_fills = 0;
+    }
+    read_size = FFMAX(ctx->read_buffer_size, ctx->orig_buffer_size);
+
+    if (ctx->read_buffer_size && s->buffer_size < read_size &&
+        dst == s->buffer && s->buf_ptr != dst) {
+        if (replace_buffer(s, read_size) >= 0) {
+            s->checksum_ptr = dst = s->buffer;
+            len = s->buffer_size;
+        }
+    }
+
     /* make buffer smaller in case it ended up large after probing */
     if (s->read_packet && ctx->orig_buffer_size &&
-        s->buffer_size > ctx->orig_buffer_size  && len >= ctx->orig_buffer_size) {
+        s->buffer_size > read_size && len >= read_size) {
         if (dst == s->buffer && s->buf_ptr != dst) {
-            int ret = set_buf_size(s, ctx->orig_buffer_size);
+            int ret = replace_buffer(s, read_size);
             if (ret < 0)
                 av_log(s, AV_LOG_WARNING, "Failed to decrease buffer size\n");
 
             s->checksum_ptr = dst = s->buffer;
         }
-        len = ctx->orig_buffer_size;
+        len = read_size;
     }
 
     len = read_packet_wrapper(s, dst, len);
@@ -991,7 +1031,8 @@ void ffio_write_lines(AVIOContext *s, const unsigned char *buf, int size,
 int ffio_copy_url_options(AVIOContext* pb, AVDictionary** avio_opts)
 {
     const char *opts[] = {
-        "headers", "user_agent", "cookies", "http_proxy", "referer", "rw_timeout", "icy", NULL };
+        "headers", "user_agent", "cookies", "http_proxy", "referer", "rw_timeout", "icy",
+        "connection_pool", NULL };
     const char **opt = opts;
     uint8_t *buf = NULL;
     int ret = 0;
@@ -1084,7 +1125,7 @@ int ffio_limit(AVIOContext *s, int size)
     return size;
 }
 
-static int set_buf_size(AVIOContext *s, int buf_size)
+static int replace_buffer(AVIOContext *s, int buf_size)
 {
     uint8_t *buffer;
     buffer = av_malloc(buf_size);
@@ -1093,13 +1134,21 @@ static int set_buf_size(AVIOContext *s, int buf_size)
 
     av_free(s->buffer);
     s->buffer = buffer;
-    ffiocontext(s)->orig_buffer_size =
     s->buffer_size = buf_size;
     s->buf_ptr = s->buf_ptr_max = buffer;
     url_resetbuf(s, s->write_flag ? AVIO_FLAG_WRITE : AVIO_FLAG_READ);
     return 0;
 }
 
+static int set_buf_size(AVIOContext *s, int buf_size)
+{
+    int ret = replace_buffer(s, buf_size);
+    if (ret < 0)
+        return ret;
+    ffiocontext(s)->orig_buffer_size = buf_size;
+    return 0;
+}
+
 int ffio_realloc_buf(AVIOContext *s, int buf_size)
 {
     uint8_t *buffer;
@@ -1239,7 +1288,7 @@ int64_t avio_seek_time(AVIOContext *s, int stream_index,
     if (ret >= 0) {
         int64_t pos;
         s->buf_ptr = s->buf_end; // Flush buffer
-        pos = s->seek(s->opaque, 0, SEEK_CUR);
+        pos = seek_wrapper(s, 0, SEEK_CUR);
         if (pos >= 0)
             s->pos = pos;
         else if (pos != AVERROR(ENOSYS))
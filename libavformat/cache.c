@@ -23,18 +23,24 @@
 
 /**
  * @TODO
- *      support keeping files
  *      support filling with a background thread
  */
 
+#include "config.h"
+
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
 #include "libavutil/file_open.h"
+#include "libavutil/hash.h"
 #include "libavutil/mem.h"
 #include "libavutil/opt.h"
 #include "libavutil/tree.h"
 #include "avio.h"
 #include <fcntl.h>
+#if HAVE_DIRENT_H
+#include <dirent.h>
+#endif
 #if HAVE_IO_H
 #include <io.h>
 #endif
@@ -42,10 +48,16 @@
 #include <unistd.h>
 #endif
 #include <sys/stat.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include "os_support.h"
 #include "url.h"
 
+/* keeping the cache across runs needs file locking and directory listing */
+#define PERSISTENT_CACHE (HAVE_FCNTL && HAVE_DIRENT_H)
+
+#define INDEX_MAGIC "ffcache 1"
+
 typedef struct CacheEntry {
     int64_t logical_pos;
     int64_t physical_pos;
@@ -65,6 +77,11 @@ typedef struct Context {
     URLContext *inner;
     int64_t cache_hit, cache_miss;
     int read_ahead_limit;
+    char *cache_dir;
+    int64_t cache_max_size;
+    const char *url;
+    char *validator;
+    char *key;          ///< base name of the files of a persistent entry
 } Context;
 
 static int cmp(const void *key, const void *node)
@@ -72,6 +89,515 @@ static int cmp(const void *key, const void *node)
     return FFDIFFSIGN(*(const int64_t *)key, ((const CacheEntry *) node)->logical_pos);
 }
 
+static int enu_free(void *opaque, void *elem)
+{
+    av_free(elem);
+    return 0;
+}
+
+#if PERSISTENT_CACHE
+
+static int insert_entry(Context *c, int64_t logical_pos, int64_t physical_pos, int size)
+{
+    CacheEntry *entry = av_malloc(sizeof(*entry));
+    struct AVTreeNode *node = av_tree_node_alloc();
+    CacheEntry *entry_ret;
+
+    if (!entry || !node) {
+        av_free(entry);
+        av_free(node);
+        return AVERROR(ENOMEM);
+    }
+    entry->logical_pos  = logical_pos;
+    entry->physical_pos = physical_pos;
+    entry->size         = size;
+
+    entry_ret = av_tree_insert(&c->root, entry, cmp, &node);
+    if (entry_ret && entry_ret != entry) {
+        av_free(entry);
+        av_free(node);
+        return AVERROR_BUG;
+    }
+    return 0;
+}
+
+/*
+ * A persistent entry is made of <key>.data, which holds the cached bytes at
+ * their position in the input, and <key>.index, a text file listing the
+ * ranges of <key>.data which are valid. The key is a hash of the URL and of
+ * the validators returned by the protocol, so that a changed resource ends
+ * up in a new entry. The index is rewritten on close, which also marks the
+ * entry as recently used, and the least recently used entries are removed
+ * afterwards to stay under cache_max_size. All index accesses and evictions
+ * are serialized between processes with a lock on <cache_dir>/lock.
+ */
+
+typedef struct CacheRange {
+    int64_t start, end;
+} CacheRange;
+
+typedef struct CacheRanges {
+    CacheRange *ranges;
+    int nb_ranges;
+    int ret;
+} CacheRanges;
+
+typedef struct CacheFile {
+    char *key;
+    int64_t mtime;
+    int64_t bytes;
+} CacheFile;
+
+static char *cache_path(const Context *c, const char *key, const char *suffix)
+{
+    return av_asprintf("%s/%s%s", c->cache_dir, key, suffix);
+}
+
+static int add_range(CacheRanges *r, int64_t start, int64_t end)
+{
+    CacheRange *ranges;
+
+    if (!(r->nb_ranges & (r->nb_ranges - 1))) {
+        ranges = av_realloc_array(r->ranges, r->nb_ranges ? 2 * r->nb_ranges : 1,
+                                  sizeof(*ranges));
+        if (!ranges)
+            return AVERROR(ENOMEM);
+        r->ranges = ranges;
+    }
+    r->ranges[r->nb_ranges].start = start;
+    r->ranges[r->nb_ranges].end   = end;
+    r->nb_ranges++;
+    return 0;
+}
+
+static int cmp_range(const void *a, const void *b)
+{
+    return FFDIFFSIGN(((const CacheRange *)a)->start, ((const CacheRange *)b)->start);
+}
+
+/* sort and merge overlapping and adjacent ranges, returns the total size */
+static int64_t merge_ranges(CacheRanges *r)
+{
+    int64_t bytes = 0;
+    int n = 0;
+
+    if (!r->nb_ranges)
+        return 0;
+
+    qsort(r->ranges, r->nb_ranges, sizeof(*r->ranges), cmp_range);
+    for (int i = 1; i < r->nb_ranges; i++) {
+        if (r->ranges[i].start <= r->ranges[n].end)
+            r->ranges[n].end = FFMAX(r->ranges[n].end, r->ranges[i].end);
+        else
+            r->ranges[++n] = r->ranges[i];
+    }
+    r->nb_ranges = n + 1;
+
+    for (int i = 0; i < r->nb_ranges; i++)
+        bytes += r->ranges[i].end - r->ranges[i].start;
+    return bytes;
+}
+
+static int lock_cache_dir(URLContext *h)
+{
+    Context *c = h->priv_data;
+    struct flock fl = { .l_type = F_WRLCK, .l_whence = SEEK_SET };
+    char *path = cache_path(c, "lock", "");
+    int fd, ret;
+
+    if (!path)
+        return AVERROR(ENOMEM);
+
+    fd = avpriv_open(path, O_RDWR | O_CREAT, 0666);
+    if (fd < 0) {
+        ret = AVERROR(errno);
+        av_log(h, AV_LOG_ERROR, "Could not open %s: %s\n", path, av_err2str(ret));
+        av_free(path);
+        return ret;
+    }
+    av_free(path);
+
+    while ((ret = fcntl(fd, F_SETLKW, &fl)) < 0 && errno == EINTR)
+        ;
+    if (ret < 0) {
+        ret = AVERROR(errno);
+        av_log(h, AV_LOG_ERROR, "Could not lock the cache directory: %s\n",
+               av_err2str(ret));
+        close(fd);
+        return ret;
+    }
+    /* closing the descriptor releases the lock */
+    return fd;
+}
+
+/* returns a NUL terminated copy of the file, NULL with *ret = 0 if it does
+ * not exist */
+static char *read_text_file(const char *path, int *ret)
+{
+    struct stat st;
+    char *buf;
+    int64_t size = 0;
+    int fd = avpriv_open(path, O_RDONLY);
+
+    *ret = 0;
+    if (fd < 0) {
+        if (errno != ENOENT)
+            *ret = AVERROR(errno);
+        return NULL;
+    }
+    if (fstat(fd, &st) < 0 || st.st_size > INT_MAX - 1) {
+        *ret = AVERROR(EINVAL);
+        close(fd);
+        return NULL;
+    }
+
+    buf = av_malloc(st.st_size + 1);
+    if (!buf) {
+        *ret = AVERROR(ENOMEM);
+        close(fd);
+        return NULL;
+    }
+    while (size < st.st_size) {
+        int n = read(fd, buf + size, st.st_size - size);
+        if (n <= 0)
+            break;
+        size += n;
+    }
+    buf[size] = 0;
+    close(fd);
+    return buf;
+}
+
+/* read the ranges of an index, ignoring it if it does not belong to our URL */
+static int read_index(URLContext *h, CacheRanges *r)
+{
+    Context *c = h->priv_data;
+    char *path = cache_path(c, c->key, ".index");
+    char *buf, *line, *next;
+    int matches = 0, ret;
+
+    if (!path)
+        return AVERROR(ENOMEM);
+    buf = read_text_file(path, &ret);
+    av_free(path);
+    if (!buf)
+        return ret;
+
+    for (line = buf; (next = strchr(line, '\n')); line = next) {
+        const char *val;
+        int64_t start, end;
+
+        *next++ = 0;
+        if (line == buf) {
+            if (strcmp(line, INDEX_MAGIC))
+                break;
+        } else if (av_strstart(line, "url ", &val)) {
+            matches += !strcmp(val, c->url);
+        } else if (av_strstart(line, "validator ", &val)) {
+            matches += !strcmp(val, c->validator);
+        } else if (matches == 2 &&
+                   sscanf(line, "%"SCNd64" %"SCNd64, &start, &end) == 2 &&
+                   start >= 0 && start < end) {
+            ret = add_range(r, start, end);
+            if (ret < 0)
+                break;
+        }
+    }
+    av_free(buf);
+    return ret;
+}
+
+static int write_index(URLContext *h, CacheRanges *r)
+{
+    Context *c = h->priv_data;
+    char *path = cache_path(c, c->key, ".index");
+    char *tmp  = cache_path(c, c->key, ".index.tmp");
+    int64_t bytes = merge_ranges(r);
+    AVBPrint bp;
+    int fd = -1, ret = 0;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&bp, INDEX_MAGIC "\nbytes %"PRId64"\nurl %s\nvalidator %s\n",
+               bytes, c->url, c->validator);
+    for (int i = 0; i < r->nb_ranges; i++)
+        av_bprintf(&bp, "%"PRId64" %"PRId64"\n", r->ranges[i].start, r->ranges[i].end);
+
+    if (!path || !tmp || !av_bprint_is_complete(&bp)) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    fd = avpriv_open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd < 0) {
+        ret = AVERROR(errno);
+        goto end;
+    }
+    if (write(fd, bp.str, bp.len) != bp.len) {
+        ret = AVERROR(EIO);
+        goto end;
+    }
+    close(fd);
+    fd = -1;
+
+    /* readers never see a partially written index */
+    if (rename(tmp, path) < 0)
+        ret = AVERROR(errno);
+
+end:
+    if (fd >= 0)
+        close(fd);
+    if (ret < 0 && tmp)
+        unlink(tmp);
+    if (ret < 0)
+        av_log(h, AV_LOG_ERROR, "Could not write the cache index: %s\n", av_err2str(ret));
+    av_bprint_finalize(&bp, NULL);
+    av_free(path);
+    av_free(tmp);
+    return ret;
+}
+
+static int cmp_file(const void *a, const void *b)
+{
+    const CacheFile *fa = a, *fb = b;
+    return fa->mtime != fb->mtime ? FFDIFFSIGN(fa->mtime, fb->mtime) :
+                                    strcmp(fa->key, fb->key);
+}
+
+/* remove the least recently used entries until the cache fits in
+ * cache_max_size, must be called with the cache directory locked */
+static int evict(URLContext *h)
+{
+    Context *c = h->priv_data;
+    CacheFile *files = NULL;
+    int nb_files = 0, ret = 0;
+    int64_t total = 0;
+    struct dirent *de;
+    DIR *dir = opendir(c->cache_dir);
+
+    if (!dir)
+        return AVERROR(errno);
+
+    while ((de = readdir(dir))) {
+        const char *ext = strrchr(de->d_name, '.');
+        CacheFile *f;
+        struct stat st;
+        char *path, *buf;
+        int64_t bytes = 0;
+        int err;
+
+        if (!ext || strcmp(ext, ".index"))
+            continue;
+
+        path = av_asprintf("%s/%s", c->cache_dir, de->d_name);
+        if (!path) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        buf = stat(path, &st) < 0 ? NULL : read_text_file(path, &err);
+        av_free(path);
+        if (!buf)
+            continue;
+        sscanf(buf, INDEX_MAGIC "\nbytes %"SCNd64, &bytes);
+        av_free(buf);
+
+        f = av_dynarray2_add((void **)&files, &nb_files, sizeof(*files), NULL);
+        if (!f) {
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        f->key   = av_strndup(de->d_name, ext - de->d_name);
+        f->mtime = st.st_mtime;
+        f->bytes = bytes;
+        if (!f->key) {
+            nb_files--;
+            ret = AVERROR(ENOMEM);
+            break;
+        }
+        total += bytes;
+    }
+    closedir(dir);
+
+    if (ret >= 0 && nb_files)
+        qsort(files, nb_files, sizeof(*files), cmp_file);
+
+    for (int i = 0; ret >= 0 && i < nb_files && total > c->cache_max_size; i++) {
+        char *data, *index;
+
+        if (!strcmp(files[i].key, c->key))
+            continue;
+
+        data  = cache_path(c, files[i].key, ".data");
+        index = cache_path(c, files[i].key, ".index");
+        if (!data || !index) {
+            ret = AVERROR(ENOMEM);
+        } else {
+            /* a process still reading the entry keeps its open descriptor */
+            unlink(index);
+            unlink(data);
+            total -= files[i].bytes;
+            av_log(h, AV_LOG_VERBOSE, "Evicted %s (%"PRId64" bytes)\n",
+                   files[i].key, files[i].bytes);
+        }
+        av_free(data);
+        av_free(index);
+    }
+
+    for (int i = 0; i < nb_files; i++)
+        av_free(files[i].key);
+    av_free(files);
+    return ret;
+}
+
+static int collect_entry(void *opaque, void *elem)
+{
+    CacheRanges *r = opaque;
+    const CacheEntry *entry = elem;
+
+    if (r->ret >= 0)
+        r->ret = add_range(r, entry->logical_pos, entry->logical_pos + entry->size);
+    return 0;
+}
+
+static int save_persistent(URLContext *h)
+{
+    Context *c = h->priv_data;
+    CacheRanges r = { 0 };
+    struct stat st_fd, st_path;
+    char *data;
+    int lock, ret;
+
+    lock = lock_cache_dir(h);
+    if (lock < 0)
+        return lock;
+
+    data = cache_path(c, c->key, ".data");
+    if (!data) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    /* the entry was evicted while we used it, the data went with it */
+    ret = 0;
+    if (fstat(c->fd, &st_fd) < 0 || stat(data, &st_path) < 0 ||
+        st_fd.st_ino != st_path.st_ino || st_fd.st_dev != st_path.st_dev)
+        goto end;
+
+    /* keep what other processes added in the meantime */
+    ret = read_index(h, &r);
+    if (ret < 0)
+        goto end;
+    av_tree_enumerate(c->root, &r, NULL, collect_entry);
+    ret = r.ret;
+    if (ret < 0)
+        goto end;
+
+    ret = write_index(h, &r);
+    if (ret >= 0 && c->cache_max_size)
+        ret = evict(h);
+
+end:
+    close(lock);
+    av_free(data);
+    av_free(r.ranges);
+    return ret;
+}
+
+static char *get_validator(URLContext *inner)
+{
+    uint8_t *etag = NULL, *last_modified = NULL;
+    int64_t size = ffurl_size(inner);
+    char *validator = NULL;
+
+    av_opt_get(inner, "etag",          AV_OPT_SEARCH_CHILDREN, &etag);
+    av_opt_get(inner, "last_modified", AV_OPT_SEARCH_CHILDREN, &last_modified);
+
+    /* the size alone does not tell a resource rewritten in place apart,
+     * it is only checked in addition to the ETag or Last-Modified date */
+    if ((etag && *etag) || (last_modified && *last_modified))
+        validator = av_asprintf("etag=%s;last-modified=%s;size=%"PRId64,
+                                etag ? (char *)etag : "",
+                                last_modified ? (char *)last_modified : "", size);
+    av_free(etag);
+    av_free(last_modified);
+    return validator;
+}
+
+static int open_persistent(URLContext *h)
+{
+    Context *c = h->priv_data;
+    CacheRanges r = { 0 };
+    struct AVHashContext *hash;
+    uint8_t digest[AV_HASH_MAX_SIZE * 2 + 1];
+    struct stat st;
+    char *data;
+    int lock, ret;
+
+    c->validator = get_validator(c->inner);
+    if (!c->validator) {
+        av_log(h, AV_LOG_WARNING, "No validator for %s, not keeping it in %s\n",
+               c->url, c->cache_dir);
+        return 0;
+    }
+
+    ret = av_hash_alloc(&hash, "SHA256");
+    if (ret < 0)
+        return ret;
+    av_hash_init(hash);
+    av_hash_update(hash, c->url, strlen(c->url) + 1);
+    av_hash_update(hash, c->validator, strlen(c->validator));
+    av_hash_final_hex(hash, digest, sizeof(digest));
+    av_hash_freep(&hash);
+    c->key = av_strdup((char *)digest);
+    if (!c->key)
+        return AVERROR(ENOMEM);
+
+    if (mkdir(c->cache_dir, 0777) < 0 && errno != EEXIST) {
+        ret = AVERROR(errno);
+        av_log(h, AV_LOG_ERROR, "Could not create %s: %s\n", c->cache_dir, av_err2str(ret));
+        return ret;
+    }
+
+    lock = lock_cache_dir(h);
+    if (lock < 0)
+        return lock;
+
+    data = cache_path(c, c->key, ".data");
+    if (!data) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    c->fd = avpriv_open(data, O_RDWR | O_CREAT, 0666);
+    if (c->fd < 0) {
+        ret = AVERROR(errno);
+        av_log(h, AV_LOG_ERROR, "Could not open %s: %s\n", data, av_err2str(ret));
+        goto end;
+    }
+
+    ret = read_index(h, &r);
+    if (ret < 0 || fstat(c->fd, &st) < 0)
+        goto end;
+
+    /* only trust what actually made it to the data file */
+    for (int i = 0; i < r.nb_ranges && ret >= 0; i++) {
+        int64_t start = r.ranges[i].start;
+        int64_t end   = FFMIN(r.ranges[i].end, st.st_size);
+
+        while (start < end && ret >= 0) {
+            int size = FFMIN(end - start, INT_MAX);
+            ret = insert_entry(c, start, start, size);
+            start += size;
+        }
+        c->end = FFMAX(c->end, end);
+    }
+
+end:
+    close(lock);
+    av_free(data);
+    av_free(r.ranges);
+    return ret;
+}
+
+#endif /* PERSISTENT_CACHE */
+
 static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
 {
     int ret;
@@ -80,10 +606,31 @@ static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **
 
     av_strstart(arg, "cache:", &arg);
 
+    c->fd = -1;
+    ret = ffurl_open_whitelist(&c->inner, arg, flags, &h->interrupt_callback,
+                               options, h->protocol_whitelist, h->protocol_blacklist, h);
+    if (ret < 0)
+        return ret;
+
+    if (c->cache_dir) {
+#if PERSISTENT_CACHE
+        c->url = arg;
+        ret = open_persistent(h);
+#else
+        av_log(h, AV_LOG_ERROR, "cache_dir is not supported on this platform\n");
+        ret = AVERROR(ENOSYS);
+#endif
+        if (ret < 0)
+            goto fail;
+        if (c->key)
+            return 0;
+    }
+
     c->fd = avpriv_tempfile("ffcache", &buffername, 0, h);
     if (c->fd < 0){
         av_log(h, AV_LOG_ERROR, "Failed to create tempfile\n");
-        return c->fd;
+        ret = c->fd;
+        goto fail;
     }
 
     ret = unlink(buffername);
@@ -93,8 +640,17 @@ static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **
     else
         c->filename = buffername;
 
-    return ffurl_open_whitelist(&c->inner, arg, flags, &h->interrupt_callback,
-                                options, h->protocol_whitelist, h->protocol_blacklist, h);
+    return 0;
+fail:
+    if (c->fd >= 0)
+        close(c->fd);
+    av_freep(&c->validator);
+    av_freep(&c->key);
+    av_tree_enumerate(c->root, NULL, NULL, enu_free);
+    av_tree_destroy(c->root);
+    c->root = NULL;
+    ffurl_closep(&c->inner);
+    return ret;
 }
 
 static int add_entry(URLContext *h, const unsigned char *buf, int size)
@@ -106,8 +662,12 @@ static int add_entry(URLContext *h, const unsigned char *buf, int size)
     CacheEntry *entry_ret;
     struct AVTreeNode *node = NULL;
 
-    //FIXME avoid lseek
-    pos = lseek(c->fd, 0, SEEK_END);
+    /* a persistent cache keeps the data at its logical position */
+    if (c->key)
+        pos = c->cache_pos == c->logical_pos ? c->cache_pos :
+              lseek(c->fd, c->logical_pos, SEEK_SET);
+    else //FIXME avoid lseek
+        pos = lseek(c->fd, 0, SEEK_END);
     if (pos < 0) {
         ret = AVERROR(errno);
         av_log(h, AV_LOG_ERROR, "seek in cache failed\n");
@@ -130,7 +690,8 @@ static int add_entry(URLContext *h, const unsigned char *buf, int size)
 
     if (!entry ||
         entry->logical_pos  + entry->size != c->logical_pos ||
-        entry->physical_pos + entry->size != pos
+        entry->physical_pos + entry->size != pos ||
+        entry->size > INT_MAX - ret
     ) {
         entry = av_malloc(sizeof(*entry));
         node = av_tree_node_alloc();
@@ -290,12 +851,6 @@ resolve_eof:
     return ret;
 }
 
-static int enu_free(void *opaque, void *elem)
-{
-    av_free(elem);
-    return 0;
-}
-
 static int cache_close(URLContext *h)
 {
     Context *c= h->priv_data;
@@ -304,6 +859,10 @@ static int cache_close(URLContext *h)
     av_log(h, AV_LOG_INFO, "Statistics, cache hits:%"PRId64" cache misses:%"PRId64"\n",
            c->cache_hit, c->cache_miss);
 
+#if PERSISTENT_CACHE
+    if (c->key && save_persistent(h) < 0)
+        av_log(h, AV_LOG_WARNING, "Could not save the cache index of %s\n", c->url);
+#endif
     close(c->fd);
     if (c->filename) {
         ret = unlink(c->filename);
@@ -314,6 +873,8 @@ static int cache_close(URLContext *h)
     ffurl_closep(&c->inner);
     av_tree_enumerate(c->root, NULL, NULL, enu_free);
     av_tree_destroy(c->root);
+    av_freep(&c->validator);
+    av_freep(&c->key);
 
     return 0;
 }
@@ -323,6 +884,8 @@ static int cache_close(URLContext *h)
 
 static const AVOption options[] = {
     { "read_ahead_limit", "Amount in bytes that may be read ahead when seeking isn't supported, -1 for unlimited", OFFSET(read_ahead_limit), AV_OPT_TYPE_INT, { .i64 = 65536 }, -1, INT_MAX, D },
+    { "cache_dir", "Directory in which the cached data is kept across runs", OFFSET(cache_dir), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
+    { "cache_max_size", "Maximum size in bytes of the cache directory, 0 for unlimited", OFFSET(cache_max_size), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D },
     {NULL},
 };
 
@@ -30,6 +30,7 @@
 #include "avio_internal.h"
 #include "dash.h"
 #include "demux.h"
+#include "segment_prefetch.h"
 #include "url.h"
 
 #define INITIAL_BUFFER_SIZE 32768
@@ -118,6 +119,11 @@ struct representation {
     uint32_t init_sec_buf_read_offset;
     int64_t cur_timestamp;
     int is_restart_needed;
+
+    /* downloads of the next fragments, and whether the current fragment is
+     * read from them */
+    FFSegmentPrefetch *prefetch;
+    int reading_prefetched;
 };
 
 typedef struct DASHContext {
@@ -154,6 +160,8 @@ typedef struct DASHContext {
     AVDictionary *avio_opts;
     int max_url_size;
     char *cenc_decryption_key;
+    int prefetch_fragments;
+    int64_t prefetch_max_size;
 
     /* Flags for init section*/
     int is_init_section_common_video;
@@ -357,6 +365,7 @@ static void free_representation(struct representation *pls)
     av_freep(&pls->init_sec_buf);
     av_freep(&pls->pb.pub.buffer);
     ff_format_io_close(pls->parent, &pls->input);
+    ff_segment_prefetch_free(&pls->prefetch);
     if (pls->ctx) {
         pls->ctx->pb = NULL;
         avformat_close_input(&pls->ctx);
@@ -1674,7 +1683,12 @@ static int read_from_url(struct representation *pls, struct fragment *seg,
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, pls->cur_seg_size - pls->cur_seg_offset);
 
-    ret = avio_read(pls->input, buf, buf_size);
+    if (pls->reading_prefetched) {
+        ret = buf_size > 0 ? ff_segment_prefetch_read(pls->prefetch, buf, buf_size)
+                           : AVERROR_EOF;
+    } else {
+        ret = avio_read(pls->input, buf, buf_size);
+    }
     if (ret > 0)
         pls->cur_seg_offset += ret;
 
@@ -1703,6 +1717,13 @@ static int open_input(DASHContext *c, struct representation *pls, struct fragmen
     ff_make_absolute_url(url, c->max_url_size, c->base_url, seg->url);
     av_log(pls->parent, AV_LOG_VERBOSE, "DASH request for url '%s', offset %"PRId64"\n",
            url, seg->url_offset);
+    if (pls->prefetch && seg != pls->init_section &&
+        ff_segment_prefetch_take(pls->prefetch, pls->cur_seq_no, url)) {
+        av_log(pls->parent, AV_LOG_VERBOSE, "DASH fragment %"PRId64" read from the "
+               "prefetched data\n", pls->cur_seq_no);
+        pls->reading_prefetched = 1;
+        goto cleanup;
+    }
     ret = open_url(pls->parent, &pls->input, url, &c->avio_opts, opts, NULL);
 
 cleanup:
@@ -1759,10 +1780,67 @@ static int update_init_section(struct representation *pls)
     return 0;
 }
 
+/* Start the background download of the fragments following the current one,
+ * for the plain HTTP fragments of static manifests. */
+static void prefetch_fragments(DASHContext *c, struct representation *pls)
+{
+    char *url = NULL, *tmpfilename = NULL;
+    int ret;
+
+    if (!c->prefetch_fragments || c->is_live)
+        return;
+
+    if (!pls->prefetch) {
+        ret = ff_segment_prefetch_alloc(&pls->prefetch, pls->parent,
+                                        c->prefetch_fragments, c->prefetch_max_size);
+        if (ret < 0) {
+            av_log(pls->parent, AV_LOG_WARNING,
+                   "Fragment prefetch unavailable: %s\n", av_err2str(ret));
+            c->prefetch_fragments = 0;
+            return;
+        }
+    }
+
+    url         = av_malloc(c->max_url_size);
+    tmpfilename = av_malloc(c->max_url_size);
+    if (!url || !tmpfilename)
+        goto end;
+
+    for (int i = 1; i <= c->prefetch_fragments; i++) {
+        int64_t seq_no = pls->cur_seq_no + i;
+        int64_t offset = 0, size = -1;
+        const char *seg_url;
+
+        if (pls->n_fragments) {
+            if (seq_no >= pls->n_fragments)
+                break;
+            seg_url = pls->fragments[seq_no]->url;
+            offset  = pls->fragments[seq_no]->url_offset;
+            size    = pls->fragments[seq_no]->size;
+        } else if (pls->url_template && seq_no <= pls->last_seq_no) {
+            ff_dash_fill_tmpl_params(tmpfilename, c->max_url_size, pls->url_template, 0, seq_no, 0,
+                                     get_segment_start_time_based_on_timeline(pls, seq_no));
+            seg_url = tmpfilename;
+        } else {
+            break;
+        }
+
+        ff_make_absolute_url(url, c->max_url_size, c->base_url, seg_url);
+        if (!ishttp(url))
+            continue;
+        if (ff_segment_prefetch_start(pls->prefetch, seq_no, url, offset, size, c->avio_opts) < 0)
+            break;
+    }
+
+end:
+    av_free(url);
+    av_free(tmpfilename);
+}
+
 static int64_t seek_data(void *opaque, int64_t offset, int whence)
 {
     struct representation *v = opaque;
-    if (v->n_fragments && !v->init_sec_data_len) {
+    if (v->n_fragments && !v->init_sec_data_len && !v->reading_prefetched) {
         return avio_seek(v->input, offset, whence);
     }
 
@@ -1776,7 +1854,7 @@ static int read_data(void *opaque, uint8_t *buf, int buf_size)
     DASHContext *c = v->parent->priv_data;
 
 restart:
-    if (!v->input) {
+    if (!v->input && !v->reading_prefetched) {
         free_fragment(&v->cur_seg);
         v->cur_seg = get_current_fragment(v);
         if (!v->cur_seg) {
@@ -1799,6 +1877,7 @@ restart:
             v->cur_seq_no++;
             goto restart;
         }
+        prefetch_fragments(c, v);
     }
 
     if (v->init_sec_buf_read_offset < v->init_sec_data_len) {
@@ -2148,6 +2227,8 @@ static void recheck_discard_flags(AVFormatContext *s, struct representation **p,
         } else if (!needed && pls->ctx) {
             close_demux_for_component(pls);
             ff_format_io_close(pls->parent, &pls->input);
+            pls->reading_prefetched = 0;
+            ff_segment_prefetch_cancel(pls->prefetch);
             av_log(s, AV_LOG_INFO, "No longer receiving stream_index %d\n", pls->stream_index);
         }
     }
@@ -2209,6 +2290,10 @@ static int dash_read_packet(AVFormatContext *s, AVPacket *pkt)
             cur->cur_seg_offset = 0;
             cur->init_sec_buf_read_offset = 0;
             ff_format_io_close(cur->parent, &cur->input);
+            if (cur->reading_prefetched) {
+                ff_segment_prefetch_release(cur->prefetch);
+                cur->reading_prefetched = 0;
+            }
             ret = reopen_demux_for_component(s, cur);
             cur->is_restart_needed = 0;
         }
@@ -2248,6 +2333,8 @@ static int dash_seek(AVFormatContext *s, struct representation *pls, int64_t see
     }
 
     ff_format_io_close(pls->parent, &pls->input);
+    pls->reading_prefetched = 0;
+    ff_segment_prefetch_cancel(pls->prefetch);
 
     // find the nearest fragment
     if (pls->n_timelines > 0 && pls->fragment_timescale > 0) {
@@ -2346,6 +2433,10 @@ static const AVOption dash_options[] = {
         {.str = "aac,m4a,m4s,m4v,mov,mp4,webm,ts"},
         INT_MIN, INT_MAX, FLAGS},
     { "cenc_decryption_key", "Media decryption key (hex)", OFFSET(cenc_decryption_key), AV_OPT_TYPE_STRING, {.str = NULL}, INT_MIN, INT_MAX, .flags = FLAGS },
+    {"prefetch_fragments", "Number of fragments to download ahead in background threads",
+        OFFSET(prefetch_fragments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64, FLAGS},
+    {"prefetch_max_size", "Maximum memory used by the fragments downloaded ahead, per representation",
+        OFFSET(prefetch_max_size), AV_OPT_TYPE_INT64, {.i64 = 64 << 20}, 0, INT64_MAX, FLAGS},
     {NULL}
 };
 
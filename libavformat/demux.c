@@ -670,6 +670,7 @@ FF_ENABLE_DEPRECATION_WARNINGS
             av_packet_unref(pkt);
             return err;
         }
+        av_buffer_account_add(pkt->buf, s->mem_account);
 
         err = handle_new_packet(s, pkt, 1);
         if (err <= 0) /* Error or passthrough */
@@ -1203,6 +1204,7 @@ static int parse_packet(AVFormatContext *s, AVPacket *pkt,
             ret = av_packet_make_refcounted(out_pkt);
             if (ret < 0)
                 goto fail;
+            av_buffer_account_add(out_pkt->buf, s->mem_account);
         }
 
         if (pkt->side_data) {
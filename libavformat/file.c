@@ -19,6 +19,8 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#define _GNU_SOURCE /* for O_DIRECT, MAP_ANONYMOUS, MAP_POPULATE and syscall() */
+
 #include "config_components.h"
 
 #include "libavutil/avstring.h"
@@ -39,9 +41,23 @@
 #endif
 #include <sys/stat.h>
 #include <stdlib.h>
+#if HAVE_LINUX_IO_URING_H
+#include <linux/io_uring.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
 #include "os_support.h"
 #include "url.h"
 
+#if HAVE_LINUX_IO_URING_H && defined(__NR_io_uring_setup) && \
+    defined(__NR_io_uring_enter) && defined(__NR_io_uring_register)
+#define USE_IO_URING 1
+#else
+#define USE_IO_URING 0
+#endif
+
 /* Some systems may not have S_ISFIFO */
 #ifndef S_ISFIFO
 #  ifdef S_IFIFO
@@ -89,6 +105,8 @@
 
 /* standard file protocol */
 
+typedef struct FileURing FileURing;
+
 typedef struct FileContext {
     const AVClass *class;
     int fd;
@@ -100,6 +118,12 @@ typedef struct FileContext {
     DIR *dir;
 #endif
     int64_t initial_pos;
+
+    int io_uring;
+    int direct;
+    int uring_depth;
+    int uring_block_size;
+    FileURing *uring;
 } FileContext;
 
 static const AVOption file_options[] = {
@@ -107,6 +131,10 @@ static const AVOption file_options[] = {
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "seekable", "Sets if the file is seekable", offsetof(FileContext, seekable), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 0, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "io_uring", "Read with io_uring and several requests in flight", offsetof(FileContext, io_uring), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "direct", "Bypass the page cache with O_DIRECT, implies io_uring", offsetof(FileContext, direct), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
+    { "uring_depth", "Number of io_uring read requests in flight", offsetof(FileContext, uring_depth), AV_OPT_TYPE_INT, { .i64 = 4 }, 1, 64, AV_OPT_FLAG_DECODING_PARAM },
+    { "uring_block_size", "Size of each io_uring read request", offsetof(FileContext, uring_block_size), AV_OPT_TYPE_INT, { .i64 = 1 << 20 }, 4096, 1 << 26, AV_OPT_FLAG_DECODING_PARAM },
     { NULL }
 };
 
@@ -137,11 +165,432 @@ static const AVClass fd_class = {
     .version    = LIBAVUTIL_VERSION_INT,
 };
 
+#if USE_IO_URING
+/* alignment of the file offsets, sizes and memory of O_DIRECT reads */
+#define DIRECT_ALIGN 4096
+
+enum URingBlockState {
+    BLOCK_IDLE,
+    BLOCK_IN_FLIGHT,
+    BLOCK_DONE,
+};
+
+typedef struct URingBlock {
+    uint8_t *data;
+    int64_t  pos;   ///< file offset the block is read from
+    int      res;   ///< bytes read or negative errno, once done
+    enum URingBlockState state;
+} URingBlock;
+
+/*
+ * Sequential reader submitting reads of consecutive blocks of the file to an
+ * io_uring, so that the next blocks are being read while the current one is
+ * consumed. The blocks are consumed in order as a ring; a consumed block is
+ * resubmitted right away for the block following the last one in flight.
+ */
+struct FileURing {
+    int ring_fd;
+
+    void   *sq_ring, *cq_ring;
+    size_t  sq_ring_size, cq_ring_size;
+    struct io_uring_sqe *sqes;
+    size_t  sqes_size;
+    unsigned *sq_tail, *sq_mask, *sq_array;
+    unsigned *cq_head, *cq_tail, *cq_mask;
+    struct io_uring_cqe *cqes;
+
+    uint8_t    *buf;
+    size_t      buf_size;
+    int         fixed;      ///< buffers are registered, use READ_FIXED
+    URingBlock *blocks;
+    int         nb_blocks;
+    int         block_size;
+    int         nb_in_flight;
+    int         to_submit;
+
+    int         started;
+    int         cur;        ///< block being consumed
+    int         skip;       ///< bytes of the current block already consumed
+    int64_t     pos;        ///< logical position of the protocol
+    int64_t     next_pos;   ///< file offset of the next block to submit
+};
+
+static int uring_enter(FileURing *u, unsigned to_submit, unsigned min_complete)
+{
+    int ret;
+    do {
+        ret = syscall(__NR_io_uring_enter, u->ring_fd, to_submit, min_complete,
+                      min_complete ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+    } while (ret < 0 && errno == EINTR);
+    return ret < 0 ? AVERROR(errno) : ret;
+}
+
+static void uring_queue_block(FileContext *c, int idx)
+{
+    FileURing *u = c->uring;
+    URingBlock *b = &u->blocks[idx];
+    unsigned tail = *u->sq_tail;
+    unsigned i    = tail & *u->sq_mask;
+    struct io_uring_sqe *sqe = &u->sqes[i];
+
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode    = u->fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+    sqe->fd        = c->fd;
+    sqe->off       = u->next_pos;
+    sqe->addr      = (uintptr_t)b->data;
+    sqe->len       = u->block_size;
+    sqe->buf_index = u->fixed ? idx : 0;
+    sqe->user_data = idx;
+    u->sq_array[i] = i;
+    atomic_store_explicit((atomic_uint *)u->sq_tail, tail + 1, memory_order_release);
+
+    b->pos   = u->next_pos;
+    b->state = BLOCK_IN_FLIGHT;
+    u->next_pos += u->block_size;
+    u->nb_in_flight++;
+    u->to_submit++;
+}
+
+static int uring_submit(FileURing *u)
+{
+    while (u->to_submit) {
+        int ret = uring_enter(u, u->to_submit, 0);
+        if (ret <= 0)
+            return ret;
+        u->to_submit -= ret;
+    }
+    return 0;
+}
+
+/* collect the completed reads, waiting for at least one if wait is set */
+static int uring_reap(FileURing *u, int wait)
+{
+    unsigned head = *u->cq_head;
+    unsigned tail = atomic_load_explicit((atomic_uint *)u->cq_tail, memory_order_acquire);
+
+    if (head == tail && wait) {
+        /* also submit what uring_submit() could not */
+        int ret = uring_enter(u, u->to_submit, 1);
+        if (ret < 0)
+            return ret;
+        u->to_submit -= ret;
+        tail = atomic_load_explicit((atomic_uint *)u->cq_tail, memory_order_acquire);
+    }
+
+    for (; head != tail; head++) {
+        const struct io_uring_cqe *cqe = &u->cqes[head & *u->cq_mask];
+        URingBlock *b = &u->blocks[cqe->user_data];
+
+        b->res   = cqe->res;
+        b->state = BLOCK_DONE;
+        u->nb_in_flight--;
+    }
+    atomic_store_explicit((atomic_uint *)u->cq_head, head, memory_order_release);
+
+    return 0;
+}
+
+static int uring_drain(FileURing *u)
+{
+    int ret = uring_submit(u);
+    while (ret >= 0 && u->nb_in_flight)
+        ret = uring_reap(u, 1);
+    return ret;
+}
+
+/* drop the blocks read so far and start reading ahead from pos */
+static int uring_restart(FileContext *c, int64_t pos)
+{
+    FileURing *u = c->uring;
+    int64_t start = c->direct ? pos & ~(int64_t)(DIRECT_ALIGN - 1) : pos;
+    int ret;
+
+    ret = uring_drain(u);
+    if (ret < 0)
+        return ret;
+
+    u->started  = 1;
+    u->cur      = 0;
+    u->skip     = pos - start;
+    u->pos      = pos;
+    u->next_pos = start;
+    for (int i = 0; i < u->nb_blocks; i++)
+        uring_queue_block(c, i);
+
+    return uring_submit(u);
+}
+
+static void uring_free(FileContext *c)
+{
+    FileURing *u = c->uring;
+
+    if (!u)
+        return;
+
+    /* the kernel may still be writing to the buffers */
+    if (u->ring_fd >= 0 && u->nb_in_flight)
+        uring_drain(u);
+
+    if (u->buf)
+        munmap(u->buf, u->buf_size);
+    if (u->sqes)
+        munmap(u->sqes, u->sqes_size);
+    if (u->cq_ring && u->cq_ring != u->sq_ring)
+        munmap(u->cq_ring, u->cq_ring_size);
+    if (u->sq_ring)
+        munmap(u->sq_ring, u->sq_ring_size);
+    if (u->ring_fd >= 0)
+        close(u->ring_fd);
+    av_freep(&u->blocks);
+    av_freep(&c->uring);
+}
+
+static int uring_init(URLContext *h)
+{
+    FileContext *c = h->priv_data;
+    struct io_uring_params p = { 0 };
+    struct iovec *iov;
+    FileURing *u;
+    void *map;
+    int ret;
+
+    u = c->uring = av_mallocz(sizeof(*u));
+    if (!u)
+        return AVERROR(ENOMEM);
+    u->ring_fd = -1;
+
+    u->nb_blocks  = c->uring_depth;
+    u->block_size = FFALIGN(c->uring_block_size, DIRECT_ALIGN);
+    u->blocks     = av_calloc(u->nb_blocks, sizeof(*u->blocks));
+    if (!u->blocks) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    ret = syscall(__NR_io_uring_setup, u->nb_blocks, &p);
+    if (ret < 0) {
+        ret = AVERROR(errno);
+        goto fail;
+    }
+    u->ring_fd = ret;
+
+    u->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    u->cq_ring_size = p.cq_off.cqes  + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+        u->sq_ring_size = u->cq_ring_size = FFMAX(u->sq_ring_size, u->cq_ring_size);
+
+    map = mmap(NULL, u->sq_ring_size, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQ_RING);
+    if (map == MAP_FAILED) {
+        ret = AVERROR(errno);
+        goto fail;
+    }
+    u->sq_ring = map;
+
+    if (p.features & IORING_FEAT_SINGLE_MMAP) {
+        u->cq_ring = u->sq_ring;
+    } else {
+        map = mmap(NULL, u->cq_ring_size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_CQ_RING);
+        if (map == MAP_FAILED) {
+            ret = AVERROR(errno);
+            goto fail;
+        }
+        u->cq_ring = map;
+    }
+
+    u->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    map = mmap(NULL, u->sqes_size, PROT_READ | PROT_WRITE,
+               MAP_SHARED | MAP_POPULATE, u->ring_fd, IORING_OFF_SQES);
+    if (map == MAP_FAILED) {
+        ret = AVERROR(errno);
+        goto fail;
+    }
+    u->sqes = map;
+
+    u->sq_tail  = (unsigned *)((uint8_t *)u->sq_ring + p.sq_off.tail);
+    u->sq_mask  = (unsigned *)((uint8_t *)u->sq_ring + p.sq_off.ring_mask);
+    u->sq_array = (unsigned *)((uint8_t *)u->sq_ring + p.sq_off.array);
+    u->cq_head  = (unsigned *)((uint8_t *)u->cq_ring + p.cq_off.head);
+    u->cq_tail  = (unsigned *)((uint8_t *)u->cq_ring + p.cq_off.tail);
+    u->cq_mask  = (unsigned *)((uint8_t *)u->cq_ring + p.cq_off.ring_mask);
+    u->cqes     = (struct io_uring_cqe *)((uint8_t *)u->cq_ring + p.cq_off.cqes);
+
+    /* page aligned, as needed by O_DIRECT */
+    u->buf_size = (size_t)u->nb_blocks * u->block_size;
+    map = mmap(NULL, u->buf_size, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED) {
+        u->buf = NULL;
+        ret = AVERROR(errno);
+        goto fail;
+    }
+    u->buf = map;
+
+    iov = av_calloc(u->nb_blocks, sizeof(*iov));
+    if (!iov) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    for (int i = 0; i < u->nb_blocks; i++) {
+        u->blocks[i].data = u->buf + (size_t)i * u->block_size;
+        iov[i].iov_base   = u->blocks[i].data;
+        iov[i].iov_len    = u->block_size;
+    }
+    /* registering pins the buffers once instead of on every read, it may
+     * fail because of RLIMIT_MEMLOCK, plain reads work all the same */
+    u->fixed = syscall(__NR_io_uring_register, u->ring_fd,
+                       IORING_REGISTER_BUFFERS, iov, u->nb_blocks) >= 0;
+    av_free(iov);
+    if (!u->fixed)
+        av_log(h, AV_LOG_VERBOSE, "Could not register the io_uring buffers: %s\n",
+               av_err2str(AVERROR(errno)));
+
+    return 0;
+fail:
+    uring_free(c);
+    return ret;
+}
+
+static int uring_read(URLContext *h, unsigned char *buf, int size)
+{
+    FileContext *c = h->priv_data;
+    FileURing *u = c->uring;
+    URingBlock *b;
+    int ret, avail;
+
+    if (!u->started) {
+        ret = uring_restart(c, u->pos);
+        if (ret < 0)
+            return ret;
+    }
+
+    b = &u->blocks[u->cur];
+    while (b->state == BLOCK_IN_FLIGHT) {
+        ret = uring_reap(u, 1);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (b->res < 0) {
+        ret = AVERROR(-b->res);
+        /* retry from the same position on the next call */
+        u->started = 0;
+        uring_drain(u);
+        return ret;
+    }
+
+    avail = b->res - u->skip;
+    if (avail <= 0)
+        return AVERROR_EOF;
+
+    size = FFMIN(size, avail);
+    memcpy(buf, b->data + u->skip, size);
+    u->skip += size;
+    u->pos  += size;
+
+    if (u->skip == b->res) {
+        if (b->res < u->block_size) {
+            /* a short read, normally the end of the file: the blocks after
+             * it are unusable, read again from here to find out */
+            u->started = 0;
+        } else {
+            b->state = BLOCK_IDLE;
+            uring_queue_block(c, u->cur);
+            u->cur  = (u->cur + 1) % u->nb_blocks;
+            u->skip = 0;
+            ret = uring_submit(u);
+            if (ret < 0)
+                return ret;
+        }
+    }
+
+    return size;
+}
+
+/* move to pos if it lies within the blocks read or being read, recycling
+ * the blocks before it; returns 1 on success, 0 if a restart is needed */
+static int uring_seek_window(FileContext *c, int64_t pos)
+{
+    FileURing *u = c->uring;
+    URingBlock *b = &u->blocks[u->cur];
+    int ret;
+
+    if (!u->started || pos < b->pos || pos >= u->next_pos)
+        return 0;
+
+    while (pos >= b->pos + u->block_size) {
+        while (b->state == BLOCK_IN_FLIGHT) {
+            ret = uring_reap(u, 1);
+            if (ret < 0)
+                return ret;
+        }
+        if (b->res < u->block_size)
+            return 0;
+
+        b->state = BLOCK_IDLE;
+        uring_queue_block(c, u->cur);
+        u->cur = (u->cur + 1) % u->nb_blocks;
+        b = &u->blocks[u->cur];
+    }
+
+    u->skip = pos - b->pos;
+    u->pos  = pos;
+    ret = uring_submit(u);
+    return ret < 0 ? ret : 1;
+}
+
+static int64_t uring_seek(URLContext *h, int64_t pos, int whence)
+{
+    FileContext *c = h->priv_data;
+    FileURing *u = c->uring;
+    int64_t size;
+
+    switch (whence) {
+    case SEEK_SET:
+        break;
+    case SEEK_CUR:
+        pos += u->pos;
+        break;
+    case SEEK_END:
+        /* st_size is 0 for block devices; the reads use explicit offsets,
+         * so moving the file offset here does not disturb them */
+        size = lseek(c->fd, 0, SEEK_END);
+        if (size < 0)
+            return AVERROR(errno);
+        pos += size;
+        break;
+    default:
+        return AVERROR(EINVAL);
+    }
+    if (pos < 0)
+        return AVERROR(EINVAL);
+
+    if (pos != u->pos) {
+        int ret = uring_seek_window(c, pos);
+        if (ret < 0)
+            return ret;
+        if (!ret) {
+            ret = uring_drain(u);
+            if (ret < 0)
+                return ret;
+            u->started = 0;
+            u->pos     = pos;
+        }
+    }
+    return pos;
+}
+#endif /* USE_IO_URING */
+
 static int file_read(URLContext *h, unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+#if USE_IO_URING
+    if (c->uring)
+        return uring_read(h, buf, size);
+#endif
     ret = read(c->fd, buf, size);
     if (ret == 0 && c->follow)
         return AVERROR(EAGAIN);
@@ -225,6 +674,9 @@ static int file_close(URLContext *h)
     if (c->initial_pos >= 0 && !h->is_streamed)
         lseek(c->fd, c->initial_pos, SEEK_SET);
 
+#if USE_IO_URING
+    uring_free(c);
+#endif
     ret = close(c->fd);
     return (ret == -1) ? AVERROR(errno) : 0;
 }
@@ -241,6 +693,10 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
         return ret < 0 ? AVERROR(errno) : (S_ISFIFO(st.st_mode) ? 0 : st.st_size);
     }
 
+#if USE_IO_URING
+    if (c->uring)
+        return uring_seek(h, pos, whence);
+#endif
     ret = lseek(c->fd, pos, whence);
 
     return ret < 0 ? AVERROR(errno) : ret;
@@ -323,6 +779,29 @@ static int file_open(URLContext *h, const char *filename, int flags)
     if (c->seekable >= 0)
         h->is_streamed = !c->seekable;
 
+    if ((c->io_uring || c->direct) && !(flags & AVIO_FLAG_WRITE)) {
+#if USE_IO_URING
+        int ret = AVERROR(ENOSYS);
+
+        /* positioned reads need a regular file or a block device */
+        if (!c->follow && !fstat(fd, &st) &&
+            (S_ISREG(st.st_mode) || S_ISBLK(st.st_mode)))
+            ret = uring_init(h);
+        if (ret < 0) {
+            av_log(h, AV_LOG_WARNING, "Not using io_uring: %s\n", av_err2str(ret));
+        } else if (c->direct) {
+#ifdef O_DIRECT
+            int fl = fcntl(fd, F_GETFL);
+            if (fl == -1 || fcntl(fd, F_SETFL, fl | O_DIRECT) == -1)
+#endif
+                av_log(h, AV_LOG_WARNING, "Could not enable O_DIRECT, "
+                       "reading through the page cache\n");
+        }
+#else
+        av_log(h, AV_LOG_WARNING, "io_uring is not supported on this platform\n");
+#endif
+    }
+
     return 0;
 }
 
@@ -44,6 +44,7 @@
 #include "internal.h"
 #include "avio_internal.h"
 #include "id3v2.h"
+#include "segment_prefetch.h"
 #include "url.h"
 
 #include "hls_sample_encryption.h"
@@ -84,6 +85,12 @@ struct segment {
     uint8_t iv[16];
     /* associated Media Initialization Section, treated as a segment */
     struct segment *init_section;
+
+    /* LL-HLS partial segments only: media sequence number of the parent
+     * segment and index of the part in it */
+    int64_t seq_no;
+    int part_no;
+    int independent;
 };
 
 struct rendition;
@@ -173,6 +180,23 @@ struct playlist {
      * playlist, if any. */
     int n_init_sections;
     struct segment **init_sections;
+
+    /* Low latency HLS: partial segments (EXT-X-PART) listed in the playlist,
+     * the hinted next part (EXT-X-PRELOAD-HINT), and the next part of
+     * cur_seq_no to read. */
+    int64_t part_target;
+    int can_block_reload;
+    int n_parts;
+    struct segment **parts;
+    struct segment *preload_hint;
+    int cur_part;
+    int last_part;
+    int reading_part;
+
+    /* Segments downloaded in the background, and whether the current
+     * segment is read from them. */
+    FFSegmentPrefetch *prefetch;
+    int reading_prefetched;
 };
 
 /*
@@ -228,6 +252,9 @@ typedef struct HLSContext {
     int http_multiple;
     int http_seekable;
     int seg_max_retry;
+    int low_latency;
+    int prefetch_segments;
+    int64_t prefetch_max_size;
     AVIOContext *playlist_pb;
     HLSCryptoContext  crypto_ctx;
 } HLSContext;
@@ -249,6 +276,15 @@ static void free_segment_list(struct playlist *pls)
     pls->n_segments = 0;
 }
 
+static void free_part_list(struct playlist *pls)
+{
+    free_segment_dynarray(pls->parts, pls->n_parts);
+    av_freep(&pls->parts);
+    pls->n_parts = 0;
+    if (pls->preload_hint)
+        free_segment_dynarray(&pls->preload_hint, 1);
+}
+
 static void free_init_section_list(struct playlist *pls)
 {
     int i;
@@ -267,6 +303,7 @@ static void free_playlist_list(HLSContext *c)
     for (i = 0; i < c->n_playlists; i++) {
         struct playlist *pls = c->playlists[i];
         free_segment_list(pls);
+        free_part_list(pls);
         free_init_section_list(pls);
         av_freep(&pls->main_streams);
         av_freep(&pls->renditions);
@@ -280,6 +317,7 @@ static void free_playlist_list(HLSContext *c)
         pls->input_read_done = 0;
         ff_format_io_close(c->ctx, &pls->input_next);
         pls->input_next_requested = 0;
+        ff_segment_prefetch_free(&pls->prefetch);
         if (pls->ctx) {
             pls->ctx->pb = NULL;
             avformat_close_input(&pls->ctx);
@@ -471,6 +509,72 @@ static void handle_init_section_args(struct init_section_info *info, const char
     }
 }
 
+struct part_info {
+    char uri[MAX_URL_SIZE];
+    char duration[32];
+    char independent[4];
+    char byterange[32];
+    char type[16];
+    char byterange_start[32];
+};
+
+static struct segment *new_part(struct part_info *info, const char *url_base)
+{
+    struct segment *part;
+    char tmp_str[MAX_URL_SIZE], *ptr;
+
+    if (!info->uri[0])
+        return NULL;
+
+    ff_make_absolute_url(tmp_str, sizeof(tmp_str), url_base, info->uri);
+    if (!tmp_str[0])
+        return NULL;
+
+    part = av_mallocz(sizeof(*part));
+    if (!part)
+        return NULL;
+    part->url = av_strdup(tmp_str);
+    if (!part->url) {
+        av_free(part);
+        return NULL;
+    }
+
+    part->duration    = atof(info->duration) * AV_TIME_BASE;
+    part->independent = !strcmp(info->independent, "YES");
+    part->size        = -1;
+    if (info->byterange[0]) {
+        part->size = strtoll(info->byterange, NULL, 10);
+        ptr = strchr(info->byterange, '@');
+        part->url_offset = ptr ? strtoll(ptr + 1, NULL, 10) : -1;
+    }
+
+    return part;
+}
+
+static void handle_part_args(struct part_info *info, const char *key,
+                             int key_len, char **dest, int *dest_len)
+{
+    if (!strncmp(key, "URI=", key_len)) {
+        *dest     =        info->uri;
+        *dest_len = sizeof(info->uri);
+    } else if (!strncmp(key, "DURATION=", key_len)) {
+        *dest     =        info->duration;
+        *dest_len = sizeof(info->duration);
+    } else if (!strncmp(key, "INDEPENDENT=", key_len)) {
+        *dest     =        info->independent;
+        *dest_len = sizeof(info->independent);
+    } else if (!strncmp(key, "BYTERANGE=", key_len)) {
+        *dest     =        info->byterange;
+        *dest_len = sizeof(info->byterange);
+    } else if (!strncmp(key, "TYPE=", key_len)) {
+        *dest     =        info->type;
+        *dest_len = sizeof(info->type);
+    } else if (!strncmp(key, "BYTERANGE-START=", key_len)) {
+        *dest     =        info->byterange_start;
+        *dest_len = sizeof(info->byterange_start);
+    }
+}
+
 struct rendition_info {
     char type[16];
     char uri[MAX_URL_SIZE];
@@ -753,6 +857,7 @@ static int parse_playlist(HLSContext *c, const char *url,
     struct segment **prev_segments = NULL;
     int prev_n_segments = 0;
     int64_t prev_start_seq_no = -1;
+    int part_no = 0;
 
     if (is_http && !in && c->http_persistent && c->playlist_pb) {
         in = c->playlist_pb;
@@ -801,9 +906,12 @@ static int parse_playlist(HLSContext *c, const char *url,
         prev_n_segments = pls->n_segments;
         pls->segments = NULL;
         pls->n_segments = 0;
+        free_part_list(pls);
 
         pls->finished = 0;
         pls->type = PLS_TYPE_UNSPECIFIED;
+        pls->part_target = 0;
+        pls->can_block_reload = 0;
     }
     while (!avio_feof(in)) {
         ff_get_chomp_line(in, line, sizeof(line));
@@ -916,6 +1024,56 @@ static int parse_playlist(HLSContext *c, const char *url,
                                                 "invalid, it will be ignored");
                 continue;
             }
+        } else if (av_strstart(line, "#EXT-X-PART-INF:", &ptr)) {
+            ret = ensure_playlist(c, &pls, url);
+            if (ret < 0)
+                goto fail;
+            ptr = strstr(ptr, "PART-TARGET=");
+            if (ptr)
+                pls->part_target = atof(ptr + 12) * AV_TIME_BASE;
+        } else if (av_strstart(line, "#EXT-X-SERVER-CONTROL:", &ptr)) {
+            ret = ensure_playlist(c, &pls, url);
+            if (ret < 0)
+                goto fail;
+            pls->can_block_reload = !!strstr(ptr, "CAN-BLOCK-RELOAD=YES");
+        } else if (av_strstart(line, "#EXT-X-PART:", &ptr) ||
+                   av_strstart(line, "#EXT-X-PRELOAD-HINT:", &ptr)) {
+            struct part_info info = {{0}};
+            int is_hint = av_strstart(line, "#EXT-X-PRELOAD-HINT:", NULL);
+            struct segment *part;
+            ret = ensure_playlist(c, &pls, url);
+            if (ret < 0)
+                goto fail;
+            ff_parse_key_value(ptr, (ff_parse_key_val_cb) handle_part_args,
+                               &info);
+            /* Parts of encrypted playlists and hints for byte ranges of a
+             * growing resource are not supported, whole segments are read
+             * instead. */
+            if (key_type != KEY_NONE ||
+                (is_hint && (strcmp(info.type, "PART") || info.byterange_start[0])))
+                continue;
+            part = new_part(&info, url);
+            if (!part) {
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
+            part->seq_no       = pls->start_seq_no + pls->n_segments;
+            part->part_no      = part_no;
+            part->init_section = cur_init_section;
+            if (is_hint) {
+                if (pls->preload_hint)
+                    free_segment_dynarray(&pls->preload_hint, 1);
+                pls->preload_hint = part;
+            } else {
+                if (part->url_offset < 0) {
+                    /* the part follows the previous one in the same resource */
+                    struct segment *prev = pls->n_parts ? pls->parts[pls->n_parts - 1] : NULL;
+                    part->url_offset = prev && prev->size >= 0 && !strcmp(prev->url, part->url) ?
+                                       prev->url_offset + prev->size : 0;
+                }
+                dynarray_add(&pls->parts, &pls->n_parts, part);
+                part_no++;
+            }
         } else if (av_strstart(line, "#EXT-X-ENDLIST", &ptr)) {
             if (pls)
                 pls->finished = 1;
@@ -998,6 +1156,7 @@ static int parse_playlist(HLSContext *c, const char *url,
                 seg->key_type = key_type;
                 dynarray_add(&pls->segments, &pls->n_segments, seg);
                 is_segment = 0;
+                part_no = 0;
 
                 seg->size = seg_size;
                 if (seg_size >= 0) {
@@ -1047,14 +1206,70 @@ fail:
     return ret;
 }
 
+static int ll_active(HLSContext *c, struct playlist *pls)
+{
+    return c->low_latency && pls->part_target > 0;
+}
+
+static struct segment *find_part(struct playlist *pls, int64_t seq_no, int part_no)
+{
+    struct segment *hint = pls->preload_hint;
+
+    for (int i = pls->n_parts - 1; i >= 0; i--) {
+        struct segment *part = pls->parts[i];
+        if (part->seq_no == seq_no && part->part_no == part_no)
+            return part;
+        if (part->seq_no < seq_no)
+            break;
+    }
+    /* The server holds requests for hinted parts until they are complete,
+     * which only works over HTTP. */
+    if (hint && hint->seq_no == seq_no && hint->part_no == part_no &&
+        av_strstart(hint->url, "http", NULL))
+        return hint;
+    return NULL;
+}
+
 static struct segment *current_segment(struct playlist *pls)
 {
     int64_t n = pls->cur_seq_no - pls->start_seq_no;
+    if (pls->reading_part)
+        return find_part(pls, pls->cur_seq_no, pls->cur_part);
     if (n >= pls->n_segments)
         return NULL;
     return pls->segments[n];
 }
 
+/*
+ * Pick the next segment or part to read. Complete segments are read whole
+ * unless some of their parts were already read, the parts of the segment
+ * being produced are read as they are published.
+ */
+static struct segment *select_next_unit(HLSContext *c, struct playlist *pls)
+{
+    pls->reading_part = 0;
+    if (!ll_active(c, pls))
+        return current_segment(pls);
+
+    while (1) {
+        int64_t n = pls->cur_seq_no - pls->start_seq_no;
+        struct segment *part;
+
+        if (n < pls->n_segments && !pls->cur_part)
+            return pls->segments[n];
+        part = find_part(pls, pls->cur_seq_no, pls->cur_part);
+        if (part) {
+            pls->reading_part = 1;
+            return part;
+        }
+        if (n >= pls->n_segments)
+            return NULL;
+        /* all the listed parts of a complete segment were read */
+        pls->cur_seq_no++;
+        pls->cur_part = 0;
+    }
+}
+
 static struct segment *next_segment(struct playlist *pls)
 {
     int64_t n = pls->cur_seq_no - pls->start_seq_no + 1;
@@ -1072,7 +1287,12 @@ static int read_from_url(struct playlist *pls, struct segment *seg,
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, seg->size - pls->cur_seg_offset);
 
-    ret = avio_read(pls->input, buf, buf_size);
+    if (pls->reading_prefetched) {
+        ret = buf_size > 0 ? ff_segment_prefetch_read(pls->prefetch, buf, buf_size)
+                           : AVERROR_EOF;
+    } else {
+        ret = avio_read(pls->input, buf, buf_size);
+    }
     if (ret > 0)
         pls->cur_seg_offset += ret;
 
@@ -1420,6 +1640,33 @@ static int update_init_section(struct playlist *pls, struct segment *seg)
     return 0;
 }
 
+static int reload_playlist(HLSContext *c, struct playlist *pls)
+{
+    int64_t msn = pls->cur_seq_no;
+    int part_no = pls->cur_part;
+    char *url;
+    int ret;
+
+    if (!ll_active(c, pls) || !pls->can_block_reload ||
+        !av_strstart(pls->url, "http", NULL))
+        return parse_playlist(c, pls->url, pls, NULL);
+
+    /* Ask the server to hold the response until the next part we need is
+     * available. */
+    if (part_no && msn - pls->start_seq_no < pls->n_segments &&
+        !find_part(pls, msn, part_no)) {
+        msn++;
+        part_no = 0;
+    }
+    url = av_asprintf("%s%c_HLS_msn=%"PRId64"&_HLS_part=%d", pls->url,
+                      strchr(pls->url, '?') ? '&' : '?', msn, part_no);
+    if (!url)
+        return AVERROR(ENOMEM);
+    ret = parse_playlist(c, url, pls, NULL);
+    av_free(url);
+    return ret;
+}
+
 static int64_t default_reload_interval(struct playlist *pls)
 {
     return pls->n_segments > 0 ?
@@ -1473,6 +1720,43 @@ static int playlist_needed(struct playlist *pls)
     return 0;
 }
 
+/* Start the background download of the segments following the current one,
+ * for the plain HTTP segments of regular playlists. */
+static void prefetch_segments(HLSContext *c, struct playlist *pls)
+{
+    int ret;
+
+    if (!c->prefetch_segments || ll_active(c, pls))
+        return;
+
+    if (!pls->prefetch) {
+        ret = ff_segment_prefetch_alloc(&pls->prefetch, pls->parent,
+                                        c->prefetch_segments, c->prefetch_max_size);
+        if (ret < 0) {
+            av_log(pls->parent, AV_LOG_WARNING,
+                   "Segment prefetch unavailable: %s\n", av_err2str(ret));
+            c->prefetch_segments = 0;
+            return;
+        }
+    }
+
+    for (int i = 1; i <= c->prefetch_segments; i++) {
+        int64_t seq_no = pls->cur_seq_no + i - pls->start_seq_no;
+        struct segment *seg;
+
+        if (seq_no < 0 || seq_no >= pls->n_segments)
+            break;
+        seg = pls->segments[seq_no];
+        if (seg->key_type != KEY_NONE || !av_strstart(seg->url, "http", NULL))
+            continue;
+
+        ret = ff_segment_prefetch_start(pls->prefetch, pls->cur_seq_no + i, seg->url,
+                                        seg->url_offset, seg->size, c->avio_opts);
+        if (ret < 0)
+            break;
+    }
+}
+
 static int read_data(void *opaque, uint8_t *buf, int buf_size)
 {
     struct playlist *v = opaque;
@@ -1480,6 +1764,7 @@ static int read_data(void *opaque, uint8_t *buf, int buf_size)
     int ret;
     int just_opened = 0;
     int reload_count = 0;
+    int max_reload = c->max_reload;
     int segment_retries = 0;
     struct segment *seg;
 
@@ -1487,7 +1772,7 @@ restart:
     if (!v->needed)
         return AVERROR_EOF;
 
-    if (!v->input || (c->http_persistent && v->input_read_done)) {
+    if (!v->reading_prefetched && (!v->input || (c->http_persistent && v->input_read_done))) {
         int64_t reload_interval;
 
         /* Check that the playlist is still needed before opening a new
@@ -1503,14 +1788,22 @@ restart:
         /* If this is a live stream and the reload interval has elapsed since
          * the last playlist reload, reload the playlists now. */
         reload_interval = default_reload_interval(v);
+        max_reload = c->max_reload;
+        if (ll_active(c, v)) {
+            /* keep the time spent waiting for new data about the same */
+            int64_t factor = FFMAX(v->target_duration / v->part_target, 1);
+
+            reload_interval = v->part_target;
+            max_reload = FFMIN(max_reload, INT_MAX / factor) * factor;
+        }
 
 reload:
         reload_count++;
-        if (reload_count > c->max_reload)
+        if (reload_count > max_reload)
             return AVERROR_EOF;
         if (!v->finished &&
             av_gettime_relative() - v->last_load_time >= reload_interval) {
-            if ((ret = parse_playlist(c, v->url, v, NULL)) < 0) {
+            if ((ret = reload_playlist(c, v)) < 0) {
                 if (ret != AVERROR_EXIT)
                     av_log(v->parent, AV_LOG_WARNING, "Failed to reload playlist %d\n",
                            v->index);
@@ -1518,17 +1811,28 @@ reload:
             }
             /* If we need to reload the playlist again below (if
              * there's still no more segments), switch to a reload
-             * interval of half the target duration. */
-            reload_interval = v->target_duration / 2;
+             * interval of half the target duration. Low latency playlists
+             * are polled every half part target, or right away if the
+             * server holds the reload until the next part exists. */
+            if (!ll_active(c, v))
+                reload_interval = v->target_duration / 2;
+            else if (v->can_block_reload && av_strstart(v->url, "http", NULL) &&
+                     reload_count == 1)
+                reload_interval = 0;
+            else
+                reload_interval = v->part_target / 2;
         }
         if (v->cur_seq_no < v->start_seq_no) {
             av_log(v->parent, AV_LOG_WARNING,
                    "skipping %"PRId64" segments ahead, expired from playlists\n",
                    v->start_seq_no - v->cur_seq_no);
             v->cur_seq_no = v->start_seq_no;
+            v->cur_part   = 0;
         }
-        if (v->cur_seq_no > v->last_seq_no) {
+        if (v->cur_seq_no > v->last_seq_no ||
+            (v->cur_seq_no == v->last_seq_no && v->cur_part > v->last_part)) {
             v->last_seq_no = v->cur_seq_no;
+            v->last_part   = v->cur_part;
             v->m3u8_hold_counters = 0;
         } else if (v->last_seq_no == v->cur_seq_no) {
             v->m3u8_hold_counters++;
@@ -1538,7 +1842,8 @@ reload:
         } else {
             av_log(v->parent, AV_LOG_WARNING, "The m3u8 list sequence may have been wrapped.\n");
         }
-        if (v->cur_seq_no >= v->start_seq_no + v->n_segments) {
+        seg = select_next_unit(c, v);
+        if (!seg) {
             if (v->finished)
                 return AVERROR_EOF;
             while (av_gettime_relative() - v->last_load_time < reload_interval) {
@@ -1551,24 +1856,36 @@ reload:
         }
 
         v->input_read_done = 0;
-        seg = current_segment(v);
 
         /* load/update Media Initialization Section, if any */
         ret = update_init_section(v, seg);
         if (ret)
             return ret;
 
-        if (c->http_multiple == 1 && v->input_next_requested) {
+        if (c->http_multiple == 1 && v->input_next_requested && !v->reading_part) {
             FFSWAP(AVIOContext *, v->input, v->input_next);
             v->cur_seg_offset = 0;
             v->input_next_requested = 0;
             ret = 0;
+        } else if (v->prefetch && !v->reading_part &&
+                   ff_segment_prefetch_take(v->prefetch, v->cur_seq_no, seg->url)) {
+            av_log(v->parent, AV_LOG_VERBOSE, "HLS segment %"PRId64" of playlist %d "
+                   "read from the prefetched data\n", v->cur_seq_no, v->index);
+            v->reading_prefetched = 1;
+            v->cur_seg_offset = 0;
+            ret = 0;
         } else {
             ret = open_input(c, v, seg, &v->input);
         }
         if (ret < 0) {
             if (ff_check_interrupt(c->interrupt_callback))
                 return AVERROR_EXIT;
+            if (seg == v->preload_hint) {
+                /* the server did not hold the request, wait for the part
+                 * to be listed instead */
+                free_segment_dynarray(&v->preload_hint, 1);
+                goto reload;
+            }
             av_log(v->parent, AV_LOG_WARNING, "Failed to open segment %"PRId64" of playlist %d\n",
                    v->cur_seq_no,
                    v->index);
@@ -1576,7 +1893,10 @@ reload:
                 av_log(v->parent, AV_LOG_WARNING, "Segment %"PRId64" of playlist %d failed too many times, skipping\n",
                        v->cur_seq_no,
                        v->index);
-                v->cur_seq_no++;
+                if (v->reading_part)
+                    v->cur_part++;
+                else
+                    v->cur_seq_no++;
                 segment_retries = 0;
             } else {
                 segment_retries++;
@@ -1585,9 +1905,12 @@ reload:
         }
         segment_retries = 0;
         just_opened = 1;
+
+        if (!v->reading_part)
+            prefetch_segments(c, v);
     }
 
-    if (c->http_multiple == -1) {
+    if (c->http_multiple == -1 && v->input) {
         uint8_t *http_version_opt = NULL;
         int r = av_opt_get(v->input, "http_version", AV_OPT_SEARCH_CHILDREN, &http_version_opt);
         if (r >= 0) {
@@ -1596,8 +1919,8 @@ reload:
         }
     }
 
-    seg = next_segment(v);
-    if (c->http_multiple == 1 && !v->input_next_requested &&
+    seg = v->reading_part ? NULL : next_segment(v);
+    if (c->http_multiple == 1 && !v->input_next_requested && !c->prefetch_segments &&
         seg && seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         ret = open_input(c, v, seg, &v->input_next);
         if (ret < 0) {
@@ -1620,7 +1943,7 @@ reload:
     }
 
     seg = current_segment(v);
-    ret = read_from_url(v, seg, buf, buf_size);
+    ret = seg ? read_from_url(v, seg, buf, buf_size) : AVERROR_EOF;
     if (ret > 0) {
         if (just_opened && v->is_id3_timestamped != 0) {
             /* Intercept ID3 tags here, elementary audio streams are required
@@ -1630,13 +1953,22 @@ reload:
 
         return ret;
     }
-    if (c->http_persistent &&
+    if (c->http_persistent && seg &&
         seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         v->input_read_done = 1;
     } else {
         ff_format_io_close(v->parent, &v->input);
     }
-    v->cur_seq_no++;
+    if (v->reading_prefetched) {
+        ff_segment_prefetch_release(v->prefetch);
+        v->reading_prefetched = 0;
+    }
+    if (v->reading_part) {
+        v->cur_part++;
+    } else {
+        v->cur_seq_no++;
+        v->cur_part = 0;
+    }
 
     c->cur_seq_no = v->cur_seq_no;
 
@@ -1733,6 +2065,8 @@ static int64_t select_cur_seq_no(HLSContext *c, struct playlist *pls)
 {
     int64_t seq_no;
 
+    pls->cur_part = 0;
+
     if (!pls->finished && !c->first_packet &&
         av_gettime_relative() - pls->last_load_time >= default_reload_interval(pls))
         /* reload the playlist since it was suspended */
@@ -1756,6 +2090,18 @@ static int64_t select_cur_seq_no(HLSContext *c, struct playlist *pls)
              * require us to download a segment to inspect its timestamps. */
             return c->cur_seq_no;
 
+        /* Low latency playlists start at the last independent part, unless
+         * the playlist asks for a different start point. */
+        if (ll_active(c, pls) && !(pls->time_offset_flag && c->prefer_x_start)) {
+            for (int i = pls->n_parts - 1; i >= 0; i--) {
+                struct segment *part = pls->parts[i];
+                if (part->independent) {
+                    pls->cur_part = part->part_no;
+                    return part->seq_no;
+                }
+            }
+        }
+
         /* If this is a live stream, start live_start_index segments from the
          * start or end */
         if (c->live_start_index < 0)
@@ -1972,7 +2318,8 @@ static int hls_read_header(AVFormatContext *s)
     }
 
     for (i = 0; i < c->n_variants; i++) {
-        if (c->variants[i]->playlists[0]->n_segments == 0) {
+        if (!c->variants[i]->playlists[0]->n_segments &&
+            !c->variants[i]->playlists[0]->n_parts) {
             av_log(s, AV_LOG_WARNING, "Empty segment [%s]\n", c->variants[i]->playlists[0]->url);
             c->variants[i]->playlists[0]->broken = 1;
         }
@@ -2014,7 +2361,7 @@ static int hls_read_header(AVFormatContext *s)
     for (i = 0; i < c->n_playlists; i++) {
         struct playlist *pls = c->playlists[i];
 
-        if (pls->n_segments == 0)
+        if (!pls->n_segments && !pls->n_parts)
             continue;
 
         pls->cur_seq_no = select_cur_seq_no(c, pls);
@@ -2032,7 +2379,7 @@ static int hls_read_header(AVFormatContext *s)
         if (!(pls->ctx = avformat_alloc_context()))
             return AVERROR(ENOMEM);
 
-        if (pls->n_segments == 0)
+        if (!pls->n_segments && !pls->n_parts)
             continue;
 
         pls->index  = i;
@@ -2049,6 +2396,7 @@ static int hls_read_header(AVFormatContext *s)
         if (!pls->finished && pls->cur_seq_no == highest_cur_seq_no - 1 &&
             highest_cur_seq_no < pls->start_seq_no + pls->n_segments) {
             pls->cur_seq_no = highest_cur_seq_no;
+            pls->cur_part   = 0;
         }
 
         pls->read_buffer = av_malloc(INITIAL_BUFFER_SIZE);
@@ -2085,6 +2433,8 @@ static int hls_read_header(AVFormatContext *s)
             ff_format_io_close(pls->parent, &pls->input_next);
             pls->input_next = NULL;
             pls->input_next_requested = 0;
+            pls->reading_prefetched = 0;
+            ff_segment_prefetch_cancel(pls->prefetch);
             pls->cur_seg_offset = 0;
             pls->cur_init_section = NULL;
             /* Reset EOF flag */
@@ -2239,6 +2589,8 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
             pls->input_read_done = 0;
             ff_format_io_close(pls->parent, &pls->input_next);
             pls->input_next_requested = 0;
+            pls->reading_prefetched = 0;
+            ff_segment_prefetch_cancel(pls->prefetch);
             pls->needed = 0;
             changed = 1;
             av_log(s, AV_LOG_INFO, "No longer receiving playlist %d\n", i);
@@ -2495,6 +2847,10 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
         pls->input_read_done = 0;
         ff_format_io_close(pls->parent, &pls->input_next);
         pls->input_next_requested = 0;
+        pls->reading_prefetched = 0;
+        ff_segment_prefetch_cancel(pls->prefetch);
+        pls->cur_part = 0;
+        pls->reading_part = 0;
         av_packet_unref(pls->pkt);
         pb->eof_reached = 0;
         /* Clear any buffered data */
@@ -2587,6 +2943,12 @@ static const AVOption hls_options[] = {
         OFFSET(seg_format_opts), AV_OPT_TYPE_DICT, {.str = NULL}, 0, 0, FLAGS},
     {"seg_max_retry", "Maximum number of times to reload a segment on error.",
      OFFSET(seg_max_retry), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, FLAGS},
+    {"low_latency", "Use partial segments and blocking playlist reloads of low latency playlists",
+        OFFSET(low_latency), AV_OPT_TYPE_BOOL, {.i64 = 1}, 0, 1, FLAGS},
+    {"prefetch_segments", "Number of segments to download ahead in background threads",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 64, FLAGS},
+    {"prefetch_max_size", "Maximum memory used by the segments downloaded ahead, per playlist",
+        OFFSET(prefetch_max_size), AV_OPT_TYPE_INT64, {.i64 = 64 << 20}, 0, INT64_MAX, FLAGS},
     {NULL}
 };
 
@@ -73,6 +73,12 @@ typedef enum {
 #define BUFSIZE (16 * 1024)
 #define POSTFIX_PATTERN "_%d"
 
+typedef struct HLSPart {
+    char *filename;
+    double duration; /* in seconds */
+    int independent;
+} HLSPart;
+
 typedef struct HLSSegment {
     char filename[MAX_URL_SIZE];
     char sub_filename[MAX_URL_SIZE];
@@ -87,6 +93,9 @@ typedef struct HLSSegment {
     char key_uri[LINE_BUFFER_SIZE + 1];
     char iv_string[KEYSIZE*2 + 1];
 
+    HLSPart *parts; /* low latency mode partial segments */
+    int nb_parts;
+
     struct HLSSegment *next;
     double discont_program_date_time;
 } HLSSegment;
@@ -108,6 +117,8 @@ typedef enum HLSFlags {
     HLS_PERIODIC_REKEY = (1 << 12),
     HLS_INDEPENDENT_SEGMENTS = (1 << 13),
     HLS_I_FRAMES_ONLY = (1 << 14),
+    HLS_DELTA_UPDATE = (1 << 15),
+    HLS_CAN_BLOCK_RELOAD = (1 << 16),
 } HLSFlags;
 
 typedef enum {
@@ -144,6 +155,11 @@ typedef struct VariantStream {
     double duration;      // last segment duration computed so far, in seconds
     int64_t start_pos;    // last segment starting position
     int64_t size;         // last segment size
+    HLSPart *parts;       // partial segments of the current segment
+    int nb_parts;
+    int64_t part_start_pts;
+    int part_start_pos;   // position of the current part in the segment buffer
+    int part_independent;
     int nb_entries;
     int discontinuity_set;
     int discontinuity;
@@ -158,6 +174,7 @@ typedef struct VariantStream {
     char *vtt_basename;
     char *vtt_m3u8_name;
     char *m3u8_name;
+    char *delta_m3u8_name;
 
     double initial_prog_date_time;
     char current_segment_final_filename_fmt[MAX_URL_SIZE]; // when renaming segments
@@ -198,6 +215,7 @@ typedef struct HLSContext {
 
     int64_t time;          // Set by a private option.
     int64_t init_time;     // Set by a private option.
+    int64_t part_time;     // Set by a private option.
     int max_nb_segments;   // Set by a private option.
     int hls_delete_threshold; // Set by a private option.
     uint32_t flags;        // enum HLSFlags
@@ -570,6 +588,137 @@ static void reflush_dynbuf(VariantStream *vs, int *range_length)
     avio_write(vs->out, vs->temp_buffer, *range_length);
 }
 
+static int flush_init_file(AVFormatContext *s, VariantStream *vs)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *oc = vs->avf;
+    int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
+    int range_length;
+
+    range_length = avio_close_dyn_buf(oc->pb, &vs->init_buffer);
+    if (range_length <= 0)
+        return AVERROR(EINVAL);
+    avio_write(vs->out, vs->init_buffer, range_length);
+    if (!hls->resend_init_file)
+        av_freep(&vs->init_buffer);
+    vs->init_range_length = range_length;
+    avio_open_dyn_buf(&oc->pb);
+    vs->packets_written = 0;
+    vs->start_pos = range_length;
+    vs->part_start_pos = 0;
+    if (!byterange_mode) {
+        hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
+    }
+    return 0;
+}
+
+/* Partial segment files are named after their parent segment, with the part
+ * index inserted before the extension: out12.m4s -> out12.part3.m4s */
+static char *get_part_filename(HLSContext *hls, VariantStream *vs, int part)
+{
+    char *url = av_strdup(vs->avf->url);
+    char *filename, *ext, *base;
+    size_t len;
+
+    if (!url)
+        return NULL;
+    len = strlen(url);
+    if ((hls->flags & HLS_TEMP_FILE) && len > 4 && !strcmp(url + len - 4, ".tmp"))
+        url[len - 4] = '\0';
+
+    ext  = strrchr(url, '.');
+    base = strrchr(url, '/');
+    if (ext && (!base || ext > base)) {
+        *ext = '\0';
+        filename = av_asprintf("%s.part%d.%s", url, part, ext + 1);
+    } else {
+        filename = av_asprintf("%s.part%d", url, part);
+    }
+    av_free(url);
+    return filename;
+}
+
+static void hls_free_parts(HLSPart *parts, int nb_parts)
+{
+    for (int i = 0; i < nb_parts; i++)
+        av_freep(&parts[i].filename);
+    av_free(parts);
+}
+
+/**
+ * Write the data muxed since the last part as a new partial segment.
+ *
+ * @return 1 if a part was written, 0 if there was no data for it, or a
+ *         negative error code
+ */
+static int hls_write_part(AVFormatContext *s, VariantStream *vs, double duration)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *oc = vs->avf;
+    AVDictionary *options = NULL;
+    char *path = NULL, *filename = NULL;
+    const char *proto;
+    HLSPart *parts;
+    uint8_t *buf;
+    int size, use_temp_file, ret;
+
+    /* close the current CMAF chunk, the mov muxer appends it as a
+     * moof/mdat pair to the segment data collected in the dynamic buffer */
+    av_write_frame(oc, NULL);
+    size = avio_get_dyn_buf(oc->pb, &buf);
+    if (size <= vs->part_start_pos)
+        return 0;
+
+    path = get_part_filename(hls, vs, vs->nb_parts);
+    if (!path)
+        return AVERROR(ENOMEM);
+    proto = avio_find_protocol_name(path);
+    use_temp_file = proto && !strcmp(proto, "file") && (hls->flags & HLS_TEMP_FILE);
+    filename = use_temp_file ? av_asprintf("%s.tmp", path) : av_strdup(path);
+    if (!filename) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    set_http_options(s, &options, hls);
+    ret = hlsenc_io_open(s, &vs->out, filename, &options);
+    av_dict_free(&options);
+    if (ret < 0) {
+        av_log(s, hls->ignore_io_errors ? AV_LOG_WARNING : AV_LOG_ERROR,
+               "Failed to open file '%s'\n", filename);
+        if (!hls->ignore_io_errors)
+            goto fail;
+    } else {
+        avio_write(vs->out, buf + vs->part_start_pos, size - vs->part_start_pos);
+        if (hlsenc_io_close(s, &vs->out, filename) < 0)
+            av_log(s, AV_LOG_WARNING, "upload part '%s' failed\n", filename);
+        if (use_temp_file)
+            ff_rename(filename, path, s);
+    }
+
+    parts = av_realloc_array(vs->parts, vs->nb_parts + 1, sizeof(*vs->parts));
+    if (!parts) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    vs->parts = parts;
+    parts[vs->nb_parts].filename    = av_strdup(hls->use_localtime_mkdir ? path : av_basename(path));
+    parts[vs->nb_parts].duration    = duration;
+    parts[vs->nb_parts].independent = vs->part_independent;
+    if (!parts[vs->nb_parts].filename) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    vs->nb_parts++;
+    vs->part_start_pos = size;
+    ret = 1;
+
+fail:
+    av_free(filename);
+    av_free(path);
+    return ret;
+}
+
 static int hls_delete_file(HLSContext *hls, AVFormatContext *avf,
                            char *path, const char *proto)
 {
@@ -690,9 +839,24 @@ static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
             if (ret = hls_delete_file(hls, s, path.str, proto))
                 goto fail;
         }
+        for (int i = 0; i < segment->nb_parts; i++) {
+            av_bprint_clear(&path);
+            if (!hls->use_localtime_mkdir)
+                av_bprintf(&path, "%s/", dirname);
+            av_bprintf(&path, "%s", segment->parts[i].filename);
+
+            if (!av_bprint_is_complete(&path)) {
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
+
+            if (ret = hls_delete_file(hls, s, path.str, proto))
+                goto fail;
+        }
         av_bprint_clear(&path);
         previous_segment = segment;
         segment = previous_segment->next;
+        hls_free_parts(previous_segment->parts, previous_segment->nb_parts);
         av_freep(&previous_segment);
     }
 
@@ -1138,6 +1302,10 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
     en->next     = NULL;
     en->discont  = 0;
     en->discont_program_date_time = 0;
+    en->parts    = vs->parts;
+    en->nb_parts = vs->nb_parts;
+    vs->parts    = NULL;
+    vs->nb_parts = 0;
 
     if (vs->discontinuity) {
         en->discont = 1;
@@ -1171,8 +1339,10 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
             vs->old_segments = en;
             if ((ret = hls_delete_old_segments(s, hls, vs)) < 0)
                 return ret;
-        } else
+        } else {
+            hls_free_parts(en->parts, en->nb_parts);
             av_freep(&en);
+        }
     } else
         vs->nb_entries++;
 
@@ -1304,6 +1474,7 @@ static void hls_free_segments(HLSSegment *p)
     while (p) {
         en = p;
         p = p->next;
+        hls_free_parts(en->parts, en->nb_parts);
         av_freep(&en);
     }
 }
@@ -1532,6 +1703,128 @@ fail:
     return ret;
 }
 
+static void hls_write_low_latency_info(HLSContext *hls, AVIOContext *out,
+                                       int target_duration)
+{
+    double part_target = hls->part_time / (double)AV_TIME_BASE;
+
+    ff_hls_write_server_control(out, !!(hls->flags & HLS_CAN_BLOCK_RELOAD),
+                                3 * part_target,
+                                (hls->flags & HLS_DELTA_UPDATE) ? 6 * target_duration : 0);
+    ff_hls_write_part_inf(out, part_target);
+}
+
+static void hls_write_segment_parts(HLSContext *hls, AVIOContext *out,
+                                    const HLSPart *parts, int nb_parts)
+{
+    for (int i = 0; i < nb_parts; i++)
+        ff_hls_write_part(out, parts[i].duration, hls->baseurl,
+                          parts[i].filename, parts[i].independent);
+}
+
+/* List the parts of the segment being written, followed by a hint for the
+ * next part so that clients can request it before it is complete. */
+static int hls_write_pending_parts(HLSContext *hls, AVIOContext *out, VariantStream *vs)
+{
+    char *next_part;
+
+    hls_write_segment_parts(hls, out, vs->parts, vs->nb_parts);
+
+    next_part = get_part_filename(hls, vs, vs->nb_parts);
+    if (!next_part)
+        return AVERROR(ENOMEM);
+    ff_hls_write_preload_hint(out, hls->baseurl,
+                              hls->use_localtime_mkdir ? next_part : av_basename(next_part));
+    av_free(next_part);
+    return 0;
+}
+
+static double hls_playlist_duration(VariantStream *vs)
+{
+    double duration = 0;
+
+    for (HLSSegment *en = vs->segments; en; en = en->next)
+        duration += en->duration;
+    return duration;
+}
+
+/**
+ * Write the playlist delta update of a low latency playlist. The segments
+ * ending more than CAN-SKIP-UNTIL seconds before the end of the playlist are
+ * replaced by an EXT-X-SKIP tag; the server answers _HLS_skip=YES requests
+ * with this file.
+ */
+static int hls_write_delta_playlist(AVFormatContext *s, VariantStream *vs, int last,
+                                    int target_duration, int64_t sequence)
+{
+    HLSContext *hls = s->priv_data;
+    HLSSegment *en;
+    AVIOContext *out;
+    AVDictionary *options = NULL;
+    char temp_filename[MAX_URL_SIZE];
+    const char *proto = avio_find_protocol_name(vs->delta_m3u8_name);
+    int use_temp_file = proto && !strcmp(proto, "file");
+    double prog_date_time = vs->initial_prog_date_time;
+    double *prog_date_time_p = (hls->flags & HLS_PROGRAM_DATE_TIME) ? &prog_date_time : NULL;
+    double duration = hls_playlist_duration(vs);
+    double parts_start = duration - 3 * target_duration;
+    double remaining = duration, end = 0;
+    int skipped = 0;
+    int ret;
+
+    set_http_options(s, &options, hls);
+    snprintf(temp_filename, sizeof(temp_filename), use_temp_file ? "%s.tmp" : "%s", vs->delta_m3u8_name);
+    ret = hlsenc_io_open(s, &vs->out, temp_filename, &options);
+    av_dict_free(&options);
+    if (ret < 0)
+        return hls->ignore_io_errors ? 0 : ret;
+    out = vs->out;
+
+    for (en = vs->segments; en && remaining - en->duration >= 6 * target_duration; en = en->next) {
+        remaining -= en->duration;
+        end       += en->duration;
+        if (!en->discont_program_date_time)
+            prog_date_time += en->duration;
+        skipped++;
+    }
+
+    ff_hls_write_playlist_header(out, hls->version, hls->allowcache,
+                                 target_duration, sequence, hls->pl_type, 0);
+    hls_write_low_latency_info(hls, out, target_duration);
+    if (vs->has_video && (hls->flags & HLS_INDEPENDENT_SEGMENTS))
+        avio_printf(out, "#EXT-X-INDEPENDENT-SEGMENTS\n");
+    if (skipped)
+        ff_hls_write_skip(out, skipped);
+    ff_hls_write_init_file(out, vs->fmp4_init_filename, 0, 0, 0);
+
+    for (; en; en = en->next) {
+        end += en->duration;
+        if (end > parts_start)
+            hls_write_segment_parts(hls, out, en->parts, en->nb_parts);
+        ret = ff_hls_write_file_entry(out, en->discont, 0, en->duration,
+                                      hls->flags & HLS_ROUND_DURATIONS,
+                                      en->size, en->pos, hls->baseurl, en->filename,
+                                      en->discont_program_date_time ? &en->discont_program_date_time : prog_date_time_p,
+                                      0, 0, 0);
+        if (en->discont_program_date_time)
+            en->discont_program_date_time -= en->duration;
+        if (ret < 0)
+            av_log(s, AV_LOG_WARNING, "ff_hls_write_file_entry get error\n");
+    }
+
+    ret = 0;
+    if (!last)
+        ret = hls_write_pending_parts(hls, out, vs);
+    else if (!(hls->flags & HLS_OMIT_ENDLIST))
+        ff_hls_write_end_list(out);
+
+    if (hlsenc_io_close(s, &vs->out, temp_filename) < 0 && !hls->ignore_io_errors)
+        av_log(s, AV_LOG_WARNING, "upload delta playlist failed\n");
+    if (use_temp_file)
+        ff_rename(temp_filename, vs->delta_m3u8_name, s);
+    return ret;
+}
+
 static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
 {
     HLSContext *hls = s->priv_data;
@@ -1551,6 +1844,7 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     double prog_date_time = vs->initial_prog_date_time;
     double *prog_date_time_p = (hls->flags & HLS_PROGRAM_DATE_TIME) ? &prog_date_time : NULL;
     int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
+    double parts_start = 0, segments_end = 0;
 
     hls->version = 2;
     if (!(hls->flags & HLS_ROUND_DURATIONS)) {
@@ -1574,6 +1868,10 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
         hls->version = 7;
     }
 
+    if (hls->flags & HLS_DELTA_UPDATE) {
+        hls->version = 9;
+    }
+
     if (!is_file_proto && (hls->flags & HLS_TEMP_FILE) && !warned_non_file++)
         av_log(s, AV_LOG_ERROR, "Cannot use rename on non file protocol, this may lead to races and temporary partial files\n");
 
@@ -1591,10 +1889,17 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
         if (target_duration <= en->duration)
             target_duration = lrint(en->duration);
     }
+    if (hls->part_time > 0) {
+        /* the playlist is published before its first segment is complete */
+        target_duration = FFMAX(target_duration, lrint(hls->time / (double)AV_TIME_BASE));
+        parts_start = hls_playlist_duration(vs) - 3 * target_duration;
+    }
 
     vs->discontinuity_set = 0;
     ff_hls_write_playlist_header(byterange_mode ? hls->m3u8_out : vs->out, hls->version, hls->allowcache,
                                  target_duration, sequence, hls->pl_type, hls->flags & HLS_I_FRAMES_ONLY);
+    if (hls->part_time > 0)
+        hls_write_low_latency_info(hls, vs->out, target_duration);
 
     if ((hls->flags & HLS_DISCONT_START) && sequence==hls->start_sequence && vs->discontinuity_set==0) {
         avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "#EXT-X-DISCONTINUITY\n");
@@ -1619,6 +1924,11 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
                                    hls->flags & HLS_SINGLE_FILE, vs->init_range_length, 0);
         }
 
+        /* parts are only listed for the last three target durations */
+        segments_end += en->duration;
+        if (hls->part_time > 0 && segments_end > parts_start)
+            hls_write_segment_parts(hls, vs->out, en->parts, en->nb_parts);
+
         ret = ff_hls_write_file_entry(byterange_mode ? hls->m3u8_out : vs->out, en->discont, byterange_mode,
                                       en->duration, hls->flags & HLS_ROUND_DURATIONS,
                                       en->size, en->pos, hls->baseurl,
@@ -1632,6 +1942,13 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
         }
     }
 
+    if (hls->part_time > 0 && !last) {
+        if (!vs->segments)
+            ff_hls_write_init_file(vs->out, vs->fmp4_init_filename, 0, 0, 0);
+        if ((ret = hls_write_pending_parts(hls, vs->out, vs)) < 0)
+            goto fail;
+    }
+
     if (last && (hls->flags & HLS_OMIT_ENDLIST)==0)
         ff_hls_write_end_list(byterange_mode ? hls->m3u8_out : vs->out);
 
@@ -1673,6 +1990,8 @@ fail:
         if (vs->vtt_m3u8_name)
             ff_rename(temp_vtt_filename, vs->vtt_m3u8_name, s);
     }
+    if (ret >= 0 && vs->delta_m3u8_name)
+        ret = hls_write_delta_playlist(s, vs, last, target_duration, sequence);
     if (ret >= 0 && hls->master_pl_name)
         if (create_master_playlist(s, vs) < 0)
             av_log(s, AV_LOG_WARNING, "Master playlist creation failed\n");
@@ -2412,6 +2731,18 @@ static int64_t append_single_file(AVFormatContext *s, VariantStream *vs)
 
     return ret;
 }
+static int hls_update_playlist(AVFormatContext *s, VariantStream *vs)
+{
+    int ret;
+
+    if ((ret = hls_window(s, 0, vs)) < 0) {
+        av_log(s, AV_LOG_WARNING, "upload playlist failed, will retry with a new http session.\n");
+        ff_format_io_close(s, &vs->out);
+        ret = hls_window(s, 0, vs);
+    }
+    return ret;
+}
+
 static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
 {
     HLSContext *hls = s->priv_data;
@@ -2486,6 +2817,10 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
     if (is_ref_pkt) {
         if (vs->end_pts == AV_NOPTS_VALUE)
             vs->end_pts = pkt->pts;
+        if (vs->part_start_pts == AV_NOPTS_VALUE) {
+            vs->part_start_pts   = pkt->pts;
+            vs->part_independent = !vs->has_video || (pkt->flags & AV_PKT_FLAG_KEY);
+        }
         if (vs->new_start) {
             vs->new_start = 0;
             vs->duration = (double)(pkt->pts - vs->end_pts)
@@ -2514,21 +2849,17 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         avio_flush(oc->pb);
         if (hls->segment_type == SEGMENT_TYPE_FMP4) {
             if (!vs->init_range_length) {
-                range_length = avio_close_dyn_buf(oc->pb, &vs->init_buffer);
-                if (range_length <= 0)
-                    return AVERROR(EINVAL);
-                avio_write(vs->out, vs->init_buffer, range_length);
-                if (!hls->resend_init_file)
-                    av_freep(&vs->init_buffer);
-                vs->init_range_length = range_length;
-                avio_open_dyn_buf(&oc->pb);
-                vs->packets_written = 0;
-                vs->start_pos = range_length;
-                if (!byterange_mode) {
-                    hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
-                }
+                if ((ret = flush_init_file(s, vs)) < 0)
+                    return ret;
             }
         }
+        if (hls->part_time > 0) {
+            ret = hls_write_part(s, vs, (pkt->pts - vs->part_start_pts) * av_q2d(st->time_base));
+            if (ret < 0)
+                return ret;
+            vs->part_start_pts   = pkt->pts;
+            vs->part_independent = !vs->has_video || (pkt->flags & AV_PKT_FLAG_KEY);
+        }
         if (!byterange_mode) {
             if (vs->vtt_avf) {
                 hlsenc_io_close(s, &vs->vtt_avf->pb, vs->vtt_avf->url);
@@ -2606,6 +2937,7 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
             if (use_temp_file)
                 hls_rename_temp_file(s, oc);
         }
+        vs->part_start_pos = 0;
 
         old_filename = av_strdup(oc->url);
         if (!old_filename) {
@@ -2624,14 +2956,11 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         }
 
         // if we're building a VOD playlist, skip writing the manifest multiple times, and just wait until the end
-        if (hls->pl_type != PLAYLIST_TYPE_VOD) {
-            if ((ret = hls_window(s, 0, vs)) < 0) {
-                av_log(s, AV_LOG_WARNING, "upload playlist failed, will retry with a new http session.\n");
-                ff_format_io_close(s, &vs->out);
-                if ((ret = hls_window(s, 0, vs)) < 0) {
-                    av_freep(&old_filename);
-                    return ret;
-                }
+        // in low latency mode, wait for the next segment to be started so that it can be hinted
+        if (hls->pl_type != PLAYLIST_TYPE_VOD && !hls->part_time) {
+            if ((ret = hls_update_playlist(s, vs)) < 0) {
+                av_freep(&old_filename);
+                return ret;
             }
         }
 
@@ -2672,6 +3001,27 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         if (ret < 0) {
             return ret;
         }
+        if (hls->part_time > 0 && (ret = hls_update_playlist(s, vs)) < 0)
+            return ret;
+    } else if (hls->part_time > 0 && is_ref_pkt && vs->packets_written &&
+               av_compare_ts(pkt->pts - vs->part_start_pts + pkt->duration, st->time_base,
+                             hls->part_time, AV_TIME_BASE_Q) > 0) {
+        /* cut the part before this packet would make it longer than the
+         * advertised part target */
+        if (!vs->init_range_length) {
+            av_write_frame(oc, NULL); /* Write the moov */
+            if ((ret = flush_init_file(s, vs)) < 0)
+                return ret;
+        }
+        ret = hls_write_part(s, vs, (pkt->pts - vs->part_start_pts) * av_q2d(st->time_base));
+        if (ret < 0)
+            return ret;
+        if (ret > 0) {
+            vs->part_start_pts   = pkt->pts;
+            vs->part_independent = !vs->has_video || (pkt->flags & AV_PKT_FLAG_KEY);
+            if ((ret = hls_update_playlist(s, vs)) < 0)
+                return ret;
+        }
     }
 
     vs->packets_written++;
@@ -2704,6 +3054,7 @@ static void hls_deinit(AVFormatContext *s)
         av_freep(&vs->fmp4_init_filename);
         av_freep(&vs->vtt_basename);
         av_freep(&vs->vtt_m3u8_name);
+        av_freep(&vs->delta_m3u8_name);
 
         avformat_free_context(vs->vtt_avf);
         avformat_free_context(vs->avf);
@@ -2711,6 +3062,7 @@ static void hls_deinit(AVFormatContext *s)
             av_freep(&vs->init_buffer);
         hls_free_segments(vs->segments);
         hls_free_segments(vs->old_segments);
+        hls_free_parts(vs->parts, vs->nb_parts);
         av_freep(&vs->m3u8_name);
         av_freep(&vs->streams);
     }
@@ -2781,6 +3133,14 @@ static int hls_write_trailer(struct AVFormatContext *s)
                 }
             }
         }
+        if (hls->part_time > 0) {
+            double parts_duration = 0;
+            for (int j = 0; j < vs->nb_parts; j++)
+                parts_duration += vs->parts[j].duration;
+            ret = hls_write_part(s, vs, vs->duration + vs->dpp - parts_duration);
+            if (ret < 0)
+                goto failed;
+        }
         if (!(hls->flags & HLS_SINGLE_FILE)) {
             set_http_options(s, &options, hls);
             ret = hlsenc_io_open(s, &vs->out, filename, &options);
@@ -2959,6 +3319,32 @@ static int hls_init(AVFormatContext *s)
                "enabled together. Disabling 'independent_segments' flag\n");
     }
 
+    if (hls->part_time > 0) {
+        if (hls->segment_type != SEGMENT_TYPE_FMP4) {
+            av_log(s, AV_LOG_ERROR, "Partial segments require hls_segment_type fmp4\n");
+            return AVERROR(EINVAL);
+        }
+        if ((hls->flags & HLS_SINGLE_FILE) || hls->max_seg_size > 0 ||
+            hls->key_info_file || hls->encrypt || hls->pl_type == PLAYLIST_TYPE_VOD) {
+            av_log(s, AV_LOG_ERROR, "Partial segments are not supported with byte range, "
+                   "encrypted or VOD playlists\n");
+            return AVERROR_PATCHWELCOME;
+        }
+        if (hls->part_time >= hls->time) {
+            av_log(s, AV_LOG_ERROR, "hls_part_time must be smaller than hls_time\n");
+            return AVERROR(EINVAL);
+        }
+    } else {
+        if (hls->flags & HLS_DELTA_UPDATE) {
+            av_log(s, AV_LOG_WARNING, "delta_update requires hls_part_time, ignoring it\n");
+            hls->flags &= ~HLS_DELTA_UPDATE;
+        }
+        if (hls->flags & HLS_CAN_BLOCK_RELOAD) {
+            av_log(s, AV_LOG_WARNING, "can_block_reload requires hls_part_time, ignoring it\n");
+            hls->flags &= ~HLS_CAN_BLOCK_RELOAD;
+        }
+    }
+
     for (i = 0; i < hls->nb_varstreams; i++) {
         vs = &hls->var_streams[i];
 
@@ -2966,9 +3352,21 @@ static int hls_init(AVFormatContext *s)
         if (ret < 0)
             return ret;
 
+        if (hls->flags & HLS_DELTA_UPDATE) {
+            p = strrchr(vs->m3u8_name, '.');
+            if (p)
+                *p = '\0';
+            vs->delta_m3u8_name = av_asprintf("%s_delta.m3u8", vs->m3u8_name);
+            if (p)
+                *p = '.';
+            if (!vs->delta_m3u8_name)
+                return AVERROR(ENOMEM);
+        }
+
         vs->sequence  = hls->start_sequence;
         vs->start_pts = AV_NOPTS_VALUE;
         vs->end_pts   = AV_NOPTS_VALUE;
+        vs->part_start_pts = AV_NOPTS_VALUE;
         vs->current_segment_final_filename_fmt[0] = '\0';
         vs->initial_prog_date_time = initial_program_date_time;
 
@@ -3120,6 +3518,7 @@ static const AVOption options[] = {
     {"start_number",  "set first number in the sequence",        OFFSET(start_sequence),AV_OPT_TYPE_INT64,  {.i64 = 0},     0, INT64_MAX, E},
     {"hls_time",      "set segment length",                      OFFSET(time),          AV_OPT_TYPE_DURATION, {.i64 = 2000000}, 0, INT64_MAX, E},
     {"hls_init_time", "set segment length at init list",         OFFSET(init_time),     AV_OPT_TYPE_DURATION, {.i64 = 0},       0, INT64_MAX, E},
+    {"hls_part_time", "set partial segment length, enables low latency mode", OFFSET(part_time), AV_OPT_TYPE_DURATION, {.i64 = 0}, 0, INT64_MAX, E},
     {"hls_list_size", "set maximum number of playlist entries",  OFFSET(max_nb_segments),    AV_OPT_TYPE_INT,    {.i64 = 5},     0, INT_MAX, E},
     {"hls_delete_threshold", "set number of unreferenced segments to keep before deleting",  OFFSET(hls_delete_threshold),    AV_OPT_TYPE_INT,    {.i64 = 1},     1, INT_MAX, E},
     {"hls_vtt_options","set hls vtt list of options for the container format used for hls", OFFSET(vtt_format_options_str), AV_OPT_TYPE_STRING, {.str = NULL},  0, 0,    E},
@@ -3155,6 +3554,8 @@ static const AVOption options[] = {
     {"periodic_rekey", "reload keyinfo file periodically for re-keying", 0, AV_OPT_TYPE_CONST, {.i64 = HLS_PERIODIC_REKEY }, 0, UINT_MAX,   E, .unit = "flags"},
     {"independent_segments", "add EXT-X-INDEPENDENT-SEGMENTS, whenever applicable", 0, AV_OPT_TYPE_CONST, { .i64 = HLS_INDEPENDENT_SEGMENTS }, 0, UINT_MAX, E, .unit = "flags"},
     {"iframes_only", "add EXT-X-I-FRAMES-ONLY, whenever applicable", 0, AV_OPT_TYPE_CONST, { .i64 = HLS_I_FRAMES_ONLY }, 0, UINT_MAX, E, .unit = "flags"},
+    {"delta_update", "write playlist delta updates in low latency mode", 0, AV_OPT_TYPE_CONST, { .i64 = HLS_DELTA_UPDATE }, 0, UINT_MAX, E, .unit = "flags"},
+    {"can_block_reload", "advertise blocking playlist reload in low latency mode", 0, AV_OPT_TYPE_CONST, { .i64 = HLS_CAN_BLOCK_RELOAD }, 0, UINT_MAX, E, .unit = "flags"},
     {"strftime", "set filename expansion with strftime at segment creation", OFFSET(use_localtime), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, E },
     {"strftime_mkdir", "create last directory component in strftime-generated filename", OFFSET(use_localtime_mkdir), AV_OPT_TYPE_BOOL, {.i64 = 0 }, 0, 1, E },
     {"hls_playlist_type", "set the HLS playlist type", OFFSET(pl_type), AV_OPT_TYPE_INT, {.i64 = PLAYLIST_TYPE_NONE }, 0, PLAYLIST_TYPE_NB-1, E, .unit = "pl_type" },
@@ -123,6 +123,33 @@ void ff_hls_write_playlist_header(AVIOContext *out, int version, int allowcache,
     }
 }
 
+void ff_hls_write_server_control(AVIOContext *out, int can_block_reload,
+                                 double part_hold_back, double can_skip_until)
+{
+    if (!out)
+        return;
+    avio_printf(out, "#EXT-X-SERVER-CONTROL:");
+    if (can_block_reload)
+        avio_printf(out, "CAN-BLOCK-RELOAD=YES,");
+    if (can_skip_until > 0)
+        avio_printf(out, "CAN-SKIP-UNTIL=%f,", can_skip_until);
+    avio_printf(out, "PART-HOLD-BACK=%f\n", part_hold_back);
+}
+
+void ff_hls_write_part_inf(AVIOContext *out, double part_target)
+{
+    if (!out)
+        return;
+    avio_printf(out, "#EXT-X-PART-INF:PART-TARGET=%f\n", part_target);
+}
+
+void ff_hls_write_skip(AVIOContext *out, int skipped_segments)
+{
+    if (!out)
+        return;
+    avio_printf(out, "#EXT-X-SKIP:SKIPPED-SEGMENTS=%d\n", skipped_segments);
+}
+
 void ff_hls_write_init_file(AVIOContext *out, const char *filename,
                             int byterange_mode, int64_t size, int64_t pos)
 {
@@ -190,6 +217,27 @@ int ff_hls_write_file_entry(AVIOContext *out, int insert_discont,
     return 0;
 }
 
+void ff_hls_write_part(AVIOContext *out, double duration,
+                       const char *baseurl, const char *filename, int independent)
+{
+    if (!out || !filename)
+        return;
+    avio_printf(out, "#EXT-X-PART:DURATION=%f,URI=\"%s%s\"", duration,
+                baseurl ? baseurl : "", filename);
+    if (independent)
+        avio_printf(out, ",INDEPENDENT=YES");
+    avio_printf(out, "\n");
+}
+
+void ff_hls_write_preload_hint(AVIOContext *out, const char *baseurl,
+                               const char *filename)
+{
+    if (!out || !filename)
+        return;
+    avio_printf(out, "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"%s%s\"\n",
+                baseurl ? baseurl : "", filename);
+}
+
 void ff_hls_write_end_list(AVIOContext *out)
 {
     if (!out)
@@ -36,6 +36,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/time.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/thread.h"
 
 #include "avformat.h"
 #include "http.h"
@@ -55,6 +56,8 @@
 #define BUFFER_SIZE   (MAX_URL_SIZE + HTTP_HEADERS_SIZE)
 #define MAX_REDIRECTS 8
 #define MAX_CACHED_REDIRECTS 32
+#define MAX_POOLED_CONNECTIONS 16
+#define POOL_IDLE_TIMEOUT (10 * 1000000)
 #define HTTP_SINGLE   1
 #define HTTP_MUTLI    2
 #define MAX_DATE_LEN  19
@@ -84,6 +87,8 @@ typedef struct HTTPContext {
     char *headers;
     char *mime_type;
     char *http_version;
+    char *etag;
+    char *last_modified;
     char *user_agent;
     char *referer;
     char *content_type;
@@ -143,6 +148,22 @@ typedef struct HTTPContext {
     unsigned int retry_after;
     int reconnect_max_retries;
     int reconnect_delay_total_max;
+    int connection_pool;
+    /* A flag which indicates that the context is counted in pool_users. */
+    int pool_user;
+    char *pool_key;
+    uint64_t content_length;
+    /* Offset at which the body of the current response ends, UINT64_MAX if
+     * unknown. */
+    uint64_t body_end;
+    int64_t request_size;
+    /* A flag which indicates that the request was limited by request_size. */
+    int range_requests;
+    /* A flag which indicates that the request for the range starting at
+     * pipeline_off has been sent on the connection. */
+    int pipelined;
+    uint64_t pipeline_off;
+    int pipelining_failed;
 } HTTPContext;
 
 #define OFFSET(x) offsetof(HTTPContext, x)
@@ -162,6 +183,8 @@ static const AVOption options[] = {
     { "post_data", "set custom HTTP post data", OFFSET(post_data), AV_OPT_TYPE_BINARY, .flags = D | E },
     { "mime_type", "export the MIME type", OFFSET(mime_type), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
     { "http_version", "export the http response version", OFFSET(http_version), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "etag", "export the ETag of the response", OFFSET(etag), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
+    { "last_modified", "export the Last-Modified date of the response", OFFSET(last_modified), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT | AV_OPT_FLAG_READONLY },
     { "cookies", "set cookies to be sent in applicable future requests, use newline delimited Set-Cookie HTTP field value syntax", OFFSET(cookies), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, D },
     { "icy", "request ICY metadata", OFFSET(icy), AV_OPT_TYPE_BOOL, { .i64 = 1 }, 0, 1, D },
     { "icy_metadata_headers", "return ICY metadata headers", OFFSET(icy_metadata_headers), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, AV_OPT_FLAG_EXPORT },
@@ -188,12 +211,14 @@ static const AVOption options[] = {
     { "resource", "The resource requested by a client", OFFSET(resource), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
     { "reply_code", "The http status code to return to a client", OFFSET(reply_code), AV_OPT_TYPE_INT, { .i64 = 200}, INT_MIN, 599, E},
     { "short_seek_size", "Threshold to favor readahead over seek.", OFFSET(short_seek_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, D },
+    { "connection_pool", "share idle persistent connections between the HTTP contexts of the process", OFFSET(connection_pool), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D },
+    { "request_size", "split the reads in pipelined range requests of this size", OFFSET(request_size), AV_OPT_TYPE_INT64, { .i64 = 0 }, 0, INT64_MAX, D },
     { NULL }
 };
 
 static int http_connect(URLContext *h, const char *path, const char *local_path,
                         const char *hoststr, const char *auth,
-                        const char *proxyauth);
+                        const char *proxyauth, int send_only);
 static int http_read_header(URLContext *h);
 static int http_shutdown(URLContext *h, int flags);
 
@@ -207,7 +232,172 @@ void ff_http_init_auth_state(URLContext *dest, const URLContext *src)
            sizeof(HTTPAuthState));
 }
 
-static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
+typedef struct HTTPPoolEntry {
+    char *key;
+    AVIOInterruptCB interrupt_callback;
+    URLContext *hd;
+    int64_t idle_since;
+} HTTPPoolEntry;
+
+/* Idle persistent connections shared by the contexts of the process. A
+ * connection is only handed out for the same lower protocol URL and options,
+ * and the same interrupt callback since the lower protocol contexts keep
+ * using the one they were opened with. The pool is emptied when the last
+ * open context using it is closed, so that no connection outlives them. */
+static AVMutex pool_mutex = AV_MUTEX_INITIALIZER;
+static HTTPPoolEntry pool[MAX_POOLED_CONNECTIONS];
+static int nb_pooled;
+static int pool_users;
+
+/**
+ * Move the entries idle for longer than POOL_IDLE_TIMEOUT, or all of them
+ * if all is set, to expired. Must be called with pool_mutex locked.
+ *
+ * @return the number of entries moved
+ */
+static int pool_take_expired(HTTPPoolEntry *expired, int all)
+{
+    const int64_t now = av_gettime_relative();
+    int nb_expired = 0, n = 0;
+
+    for (int i = 0; i < nb_pooled; i++) {
+        if (all || now - pool[i].idle_since >= POOL_IDLE_TIMEOUT)
+            expired[nb_expired++] = pool[i];
+        else
+            pool[n++] = pool[i];
+    }
+    nb_pooled = n;
+    return nb_expired;
+}
+
+static void pool_close_entries(HTTPPoolEntry *entries, int nb_entries)
+{
+    for (int i = 0; i < nb_entries; i++) {
+        av_free(entries[i].key);
+        ffurl_close(entries[i].hd);
+    }
+}
+
+static void pool_add_user(HTTPContext *s)
+{
+    ff_mutex_lock(&pool_mutex);
+    pool_users++;
+    ff_mutex_unlock(&pool_mutex);
+    s->pool_user = 1;
+}
+
+static void pool_remove_user(HTTPContext *s)
+{
+    HTTPPoolEntry expired[MAX_POOLED_CONNECTIONS];
+    int nb_expired;
+
+    if (!s->pool_user)
+        return;
+    s->pool_user = 0;
+
+    ff_mutex_lock(&pool_mutex);
+    nb_expired = pool_take_expired(expired, !--pool_users);
+    ff_mutex_unlock(&pool_mutex);
+
+    pool_close_entries(expired, nb_expired);
+}
+
+static int connection_is_idle(URLContext *hd)
+{
+    struct pollfd p = { ffurl_get_file_handle(hd), POLLIN, 0 };
+
+    /* nothing may arrive on an idle connection, data or EOF mean that the
+     * server closed it */
+    return p.fd >= 0 && !poll(&p, 1, 0);
+}
+
+static URLContext *pool_get(const char *key, const AVIOInterruptCB *cb)
+{
+    for (;;) {
+        HTTPPoolEntry e = { 0 };
+        HTTPPoolEntry expired[MAX_POOLED_CONNECTIONS];
+        int nb_expired;
+
+        ff_mutex_lock(&pool_mutex);
+        nb_expired = pool_take_expired(expired, 0);
+        for (int i = nb_pooled - 1; i >= 0; i--) {
+            if (!strcmp(pool[i].key, key) &&
+                pool[i].interrupt_callback.callback == cb->callback &&
+                pool[i].interrupt_callback.opaque   == cb->opaque) {
+                e = pool[i];
+                memmove(&pool[i], &pool[i + 1], (nb_pooled - i - 1) * sizeof(*pool));
+                nb_pooled--;
+                break;
+            }
+        }
+        ff_mutex_unlock(&pool_mutex);
+
+        pool_close_entries(expired, nb_expired);
+        if (!e.hd)
+            return NULL;
+        av_free(e.key);
+        if (connection_is_idle(e.hd))
+            return e.hd;
+        ffurl_close(e.hd);
+    }
+}
+
+static void pool_put(URLContext **hd, const char *key, const AVIOInterruptCB *cb)
+{
+    HTTPPoolEntry expired[MAX_POOLED_CONNECTIONS + 1];
+    int nb_expired;
+    char *k = av_strdup(key);
+
+    if (!k) {
+        ffurl_closep(hd);
+        return;
+    }
+
+    ff_mutex_lock(&pool_mutex);
+    nb_expired = pool_take_expired(expired, 0);
+    if (nb_pooled == MAX_POOLED_CONNECTIONS) {
+        expired[nb_expired++] = pool[0];
+        memmove(&pool[0], &pool[1], (nb_pooled - 1) * sizeof(*pool));
+        nb_pooled--;
+    }
+    pool[nb_pooled++] = (HTTPPoolEntry){
+        .key                = k,
+        .interrupt_callback = *cb,
+        .hd                 = *hd,
+        .idle_since         = av_gettime_relative(),
+    };
+    ff_mutex_unlock(&pool_mutex);
+
+    *hd = NULL;
+    pool_close_entries(expired, nb_expired);
+}
+
+/* return non zero if the connection can carry another request */
+static int http_connection_reusable(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+
+    if (!s->hd || s->willclose || s->listen || s->pipelined ||
+        (h->flags & AVIO_FLAG_WRITE) || !s->end_header ||
+        s->buf_ptr != s->buf_end)
+        return 0;
+    if (s->chunksize != UINT64_MAX)
+        return s->chunkend;
+    return s->body_end != UINT64_MAX && s->off == s->body_end;
+}
+
+static void http_release_connection(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+
+    if (s->connection_pool && s->pool_key && http_connection_reusable(h))
+        pool_put(&s->hd, s->pool_key, &h->interrupt_callback);
+    else
+        ffurl_closep(&s->hd);
+}
+
+static int http_open_cnx_internal(URLContext *h, AVDictionary **options,
+                                  int send_only)
 {
     const char *path, *proxy_path, *lower_proto = "tcp", *local_path;
     char *env_http_proxy, *env_no_proxy;
@@ -218,6 +408,10 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
     char buf[1024], urlbuf[MAX_URL_SIZE];
     int port, use_proxy, err = 0;
     HTTPContext *s = h->priv_data;
+    /* only retry requests which can be sent again */
+    int reused = s->hd && !send_only && !s->post_data &&
+                 !(h->flags & AVIO_FLAG_WRITE);
+    uint64_t off = s->off;
 
     av_url_split(proto, sizeof(proto), auth, sizeof(auth),
                  hostname, sizeof(hostname), &port,
@@ -272,6 +466,23 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
 
     ff_url_join(buf, sizeof(buf), lower_proto, NULL, hostname, port, NULL);
 
+    if (!s->hd && s->connection_pool && !s->listen && !s->post_data &&
+        !(h->flags & AVIO_FLAG_WRITE)) {
+        char *opts = NULL;
+
+        err = av_dict_get_string(s->chained_options, &opts, '=', ',');
+        if (err < 0)
+            goto end;
+        av_freep(&s->pool_key);
+        s->pool_key = av_asprintf("%s %s", buf, opts ? opts : "");
+        av_free(opts);
+        if (!s->pool_key) {
+            err = AVERROR(ENOMEM);
+            goto end;
+        }
+        s->hd  = pool_get(s->pool_key, &h->interrupt_callback);
+        reused = !!s->hd;
+    }
     if (!s->hd) {
         err = ffurl_open_whitelist(&s->hd, buf, AVIO_FLAG_READ_WRITE,
                                    &h->interrupt_callback, options,
@@ -280,8 +491,24 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
 
 end:
     freeenv_utf8(env_http_proxy);
-    return err < 0 ? err : http_connect(
-        h, path, local_path, hoststr, auth, proxyauth);
+    if (err < 0)
+        return err;
+
+    if (reused)
+        s->line_count = 0;
+    err = http_connect(h, path, local_path, hoststr, auth, proxyauth, send_only);
+    if (err < 0 && err != AVERROR_EXIT && reused && !s->line_count) {
+        /* the server closed the persistent connection in the meantime */
+        av_log(h, AV_LOG_DEBUG, "Persistent connection to %s lost, reconnecting\n", buf);
+        ffurl_closep(&s->hd);
+        s->off = off;
+        err = ffurl_open_whitelist(&s->hd, buf, AVIO_FLAG_READ_WRITE,
+                                   &h->interrupt_callback, options,
+                                   h->protocol_whitelist, h->protocol_blacklist, h);
+        if (err >= 0)
+            err = http_connect(h, path, local_path, hoststr, auth, proxyauth, 0);
+    }
+    return err;
 }
 
 static int http_should_reconnect(HTTPContext *s, int err)
@@ -389,7 +616,7 @@ redo:
     cur_proxy_auth_type = s->auth_state.auth_type;
 
     off = s->off;
-    ret = http_open_cnx_internal(h, options);
+    ret = http_open_cnx_internal(h, options, 0);
     if (ret < 0) {
         if (!http_should_reconnect(s, ret) ||
             reconnect_delay > s->reconnect_delay_max ||
@@ -749,9 +976,12 @@ static int http_open(URLContext *h, const char *uri, int flags,
     if (s->listen) {
         return http_listen(h, uri, flags, options);
     }
+    if (s->connection_pool)
+        pool_add_user(s);
     ret = http_open_cnx(h, options);
 bail_out:
     if (ret < 0) {
+        pool_remove_user(s);
         av_dict_free(&s->chained_options);
         av_dict_free(&s->cookie_dict);
         av_dict_free(&s->redirect_cache);
@@ -1207,9 +1437,10 @@ static int process_line(URLContext *h, char *line, int line_count, int *parsed_h
         if (!av_strcasecmp(tag, "Location")) {
             if ((ret = parse_location(s, p)) < 0)
                 return ret;
-        } else if (!av_strcasecmp(tag, "Content-Length") &&
-                   s->filesize == UINT64_MAX) {
-            s->filesize = strtoull(p, NULL, 10);
+        } else if (!av_strcasecmp(tag, "Content-Length")) {
+            s->content_length = strtoull(p, NULL, 10);
+            if (s->filesize == UINT64_MAX)
+                s->filesize = s->content_length;
         } else if (!av_strcasecmp(tag, "Content-Range")) {
             parse_content_range(h, p);
         } else if (!av_strcasecmp(tag, "Accept-Ranges") &&
@@ -1238,6 +1469,12 @@ static int process_line(URLContext *h, char *line, int line_count, int *parsed_h
         } else if (!av_strcasecmp(tag, "Content-Type")) {
             av_free(s->mime_type);
             s->mime_type = av_get_token((const char **)&p, ";");
+        } else if (!av_strcasecmp(tag, "ETag")) {
+            av_free(s->etag);
+            s->etag = av_strdup(p);
+        } else if (!av_strcasecmp(tag, "Last-Modified")) {
+            av_free(s->last_modified);
+            s->last_modified = av_strdup(p);
         } else if (!av_strcasecmp(tag, "Set-Cookie")) {
             if (parse_cookie(s, p, &s->cookie_dict))
                 av_log(h, AV_LOG_WARNING, "Unable to parse '%s'\n", p);
@@ -1377,8 +1614,11 @@ static int http_read_header(URLContext *h)
     int err = 0, http_err = 0;
 
     av_freep(&s->new_location);
+    av_freep(&s->etag);
+    av_freep(&s->last_modified);
     s->expires = 0;
     s->chunksize = UINT64_MAX;
+    s->content_length = UINT64_MAX;
     s->filesize_from_content_range = UINT64_MAX;
 
     for (;;) {
@@ -1412,6 +1652,11 @@ static int http_read_header(URLContext *h)
     if (s->filesize_from_content_range != UINT64_MAX)
         s->filesize = s->filesize_from_content_range;
 
+    if (s->chunksize == UINT64_MAX && s->content_length != UINT64_MAX)
+        s->body_end = s->off + s->content_length;
+    else
+        s->body_end = UINT64_MAX;
+
     if (s->seekable == -1 && s->is_mediagateway && s->filesize == 2000000000)
         h->is_streamed = 1; /* we can in fact _not_ seek */
 
@@ -1455,17 +1700,19 @@ static void bprint_escaped_path(AVBPrint *bp, const char *path)
 
 static int http_connect(URLContext *h, const char *path, const char *local_path,
                         const char *hoststr, const char *auth,
-                        const char *proxyauth)
+                        const char *proxyauth, int send_only)
 {
     HTTPContext *s = h->priv_data;
     int post, err;
     AVBPrint request;
     char *authstr = NULL, *proxyauthstr = NULL;
-    uint64_t off = s->off;
+    uint64_t off = send_only ? s->pipeline_off : s->off;
     const char *method;
-    int send_expect_100 = 0;
+    int send_expect_100 = 0, range_requests = 0;
 
-    av_bprint_init_for_buffer(&request, s->buffer, sizeof(s->buffer));
+    /* the input buffer may still hold the current response when the request
+     * is pipelined */
+    av_bprint_init(&request, 0, sizeof(s->buffer));
 
     /* send http header */
     post = h->flags & AVIO_FLAG_WRITE;
@@ -1522,17 +1769,25 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
     // Note: we send the Range header on purpose, even when we're probing,
     // since it allows us to detect more reliably if a (non-conforming)
     // server supports seeking by analysing the reply headers.
-    if (!has_header(s->headers, "\r\nRange: ") && !post && (s->off > 0 || s->end_off || s->seekable != 0)) {
-        av_bprintf(&request, "Range: bytes=%"PRIu64"-", s->off);
-        if (s->end_off)
-            av_bprintf(&request, "%"PRId64, s->end_off - 1);
+    if (!has_header(s->headers, "\r\nRange: ") && !post && (off > 0 || s->end_off || s->seekable != 0)) {
+        uint64_t end = s->end_off;
+
+        if (s->request_size > 0 && (!end || end - off > s->request_size)) {
+            end            = off + s->request_size;
+            range_requests = 1;
+        }
+        av_bprintf(&request, "Range: bytes=%"PRIu64"-", off);
+        if (end)
+            av_bprintf(&request, "%"PRIu64, end - 1);
         av_bprintf(&request, "\r\n");
     }
     if (send_expect_100 && !has_header(s->headers, "\r\nExpect: "))
         av_bprintf(&request, "Expect: 100-continue\r\n");
 
     if (!has_header(s->headers, "\r\nConnection: "))
-        av_bprintf(&request, "Connection: %s\r\n", s->multiple_requests ? "keep-alive" : "close");
+        av_bprintf(&request, "Connection: %s\r\n",
+                   s->multiple_requests || s->connection_pool ||
+                   s->request_size > 0 ? "keep-alive" : "close");
 
     if (!has_header(s->headers, "\r\nHost: "))
         av_bprintf(&request, "Host: %s\r\n", hoststr);
@@ -1576,6 +1831,12 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
         if ((err = ffurl_write(s->hd, s->post_data, s->post_datalen)) < 0)
             goto done;
 
+    if (send_only) {
+        s->pipelined = 1;
+        err = 0;
+        goto done;
+    }
+
     /* init input buffer */
     s->buf_ptr          = s->buffer;
     s->buf_end          = s->buffer;
@@ -1586,6 +1847,8 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
     s->willclose        = 0;
     s->end_chunked_post = 0;
     s->end_header       = 0;
+    s->range_requests   = range_requests;
+    s->pipelined        = 0;
 #if CONFIG_ZLIB
     s->compressed       = 0;
 #endif
@@ -1608,11 +1871,57 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
 
     err = (off == s->off) ? 0 : -1;
 done:
+    av_bprint_finalize(&request, NULL);
     av_freep(&authstr);
     av_freep(&proxyauthstr);
     return err;
 }
 
+static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int force_reconnect);
+
+/* Read the response to the pipelined request, or request the next range if
+ * there is none. */
+static int http_next_range(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    uint64_t off = s->off;
+    int64_t ret;
+
+    if (s->pipelined) {
+        s->pipelined  = 0;
+        s->line_count = 0;
+        s->off        = 0;
+        s->filesize   = UINT64_MAX;
+        s->willclose  = 0;
+        s->end_header = 0;
+        ret = http_read_header(h);
+        if (ret >= 0 && s->http_code == 206 && s->off == off)
+            return 0;
+        av_log(h, AV_LOG_DEBUG,
+               "Invalid response to the pipelined request at %"PRIu64"\n", off);
+        s->off = off;
+    }
+
+    ret = http_seek_internal(h, off, SEEK_SET, 1);
+    if (ret < 0)
+        return ret;
+    return ret == off ? 0 : AVERROR(EIO);
+}
+
+static void http_pipeline_next_range(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    AVDictionary *options = NULL;
+    int ret;
+
+    s->pipeline_off = s->body_end;
+    ret = http_open_cnx_internal(h, &options, 1);
+    av_dict_free(&options);
+    if (ret < 0)
+        av_log(h, AV_LOG_DEBUG, "Could not pipeline the request at %"PRIu64": %s\n",
+               s->pipeline_off, av_err2str(ret));
+}
+
 static int http_buf_read(URLContext *h, uint8_t *buf, int size)
 {
     HTTPContext *s = h->priv_data;
@@ -1637,7 +1946,7 @@ static int http_buf_read(URLContext *h, uint8_t *buf, int size)
                    "Chunked encoding data size: %"PRIu64"\n",
                     s->chunksize);
 
-            if (!s->chunksize && s->multiple_requests) {
+            if (!s->chunksize && (s->multiple_requests || s->connection_pool)) {
                 http_get_line(s, line, sizeof(line)); // read empty chunk
                 s->chunkend = 1;
                 return 0;
@@ -1654,6 +1963,25 @@ static int http_buf_read(URLContext *h, uint8_t *buf, int size)
             }
         }
         size = FFMIN(size, s->chunksize);
+    } else if (s->range_requests && s->body_end != UINT64_MAX) {
+        uint64_t target_end = s->end_off ? s->end_off : s->filesize;
+
+        if (s->off >= s->body_end) {
+            int err;
+
+            if (s->off >= target_end)
+                return AVERROR_EOF;
+            if ((err = http_next_range(h)) < 0)
+                return err;
+        }
+        /* request the next range before this one is consumed, the bytes
+         * following the body belong to its response */
+        if (s->body_end != UINT64_MAX) {
+            if (!s->pipelined && !s->pipelining_failed && !s->willclose &&
+                s->body_end < target_end && s->pipeline_off != s->body_end)
+                http_pipeline_next_range(h);
+            size = FFMIN(size, s->body_end - s->off);
+        }
     }
 
     /* read bytes from input buffer first */
@@ -1720,8 +2048,6 @@ static int http_buf_read_compressed(URLContext *h, uint8_t *buf, int size)
 }
 #endif /* CONFIG_ZLIB */
 
-static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int force_reconnect);
-
 static int http_read_stream(URLContext *h, uint8_t *buf, int size)
 {
     HTTPContext *s = h->priv_data;
@@ -1745,6 +2071,16 @@ static int http_read_stream(URLContext *h, uint8_t *buf, int size)
         return http_buf_read_compressed(h, buf, size);
 #endif /* CONFIG_ZLIB */
     read_ret = http_buf_read(h, buf, size);
+    if (read_ret < 0 && read_ret != AVERROR_EXIT && s->pipelined) {
+        /* some servers drop the connection when a request arrives before
+         * they are done with the previous one */
+        av_log(h, AV_LOG_WARNING, "Connection lost with a pipelined request, "
+               "resuming at %"PRIu64" without pipelining.\n", s->off);
+        s->pipelining_failed = 1;
+        seek_ret = http_seek_internal(h, s->off, SEEK_SET, 1);
+        if (seek_ret >= 0)
+            read_ret = http_buf_read(h, buf, size);
+    }
     while (read_ret < 0) {
         uint64_t target = h->is_streamed ? 0 : s->off;
 
@@ -1948,7 +2284,9 @@ static int http_close(URLContext *h)
         ret = http_shutdown(h, h->flags);
 
     if (s->hd)
-        ffurl_closep(&s->hd);
+        http_release_connection(h);
+    pool_remove_user(s);
+    av_freep(&s->pool_key);
     av_dict_free(&s->chained_options);
     av_dict_free(&s->cookie_dict);
     av_dict_free(&s->redirect_cache);
@@ -1963,7 +2301,7 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
     URLContext *old_hd = s->hd;
     uint64_t old_off = s->off;
     uint8_t old_buf[BUFFER_SIZE];
-    int old_buf_size, ret;
+    int old_buf_size, ret, reusable = http_connection_reusable(h);
     AVDictionary *options = NULL;
 
     if (whence == AVSEEK_SIZE)
@@ -1995,6 +2333,14 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
             return s->off;
     }
 
+    /* the connection can carry the new request if the response was read
+     * entirely, unless the location changes back to another server */
+    if (reusable) {
+        if (s->connection_pool || strcmp(s->uri, s->location))
+            http_release_connection(h);
+        old_hd = NULL;
+    }
+
     /* if the location changed (redirect), revert to the original uri */
     if (strcmp(s->uri, s->location)) {
         char *new_uri;
@@ -2008,7 +2354,8 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
     /* we save the old context in case the seek fails */
     old_buf_size = s->buf_end - s->buf_ptr;
     memcpy(old_buf, s->buf_ptr, old_buf_size);
-    s->hd = NULL;
+    if (old_hd)
+        s->hd = NULL;
 
     /* if it fails, continue on old connection */
     if ((ret = http_open_cnx(h, &options)) < 0) {
@@ -2021,7 +2368,8 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
         return ret;
     }
     av_dict_free(&options);
-    ffurl_close(old_hd);
+    if (old_hd)
+        ffurl_close(old_hd);
     return off;
 }
 
@@ -0,0 +1,453 @@
+/*
+ * Background download of the next segments of HLS and DASH playlists
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Download of the segments following the one being read, each one in its own
+ * thread, into memory. The demuxer reads a segment while it is still being
+ * downloaded. The memory held by the downloads, including the one of the
+ * segment being read, is bounded: a download reaching the limit waits for
+ * its data to be read, and one which cannot start is dropped, the demuxer
+ * then opens the segment itself.
+ */
+
+#include "config.h"
+
+#include <limits.h>
+#include <stdatomic.h>
+#include <string.h>
+
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+
+#include "avio_internal.h"
+#include "internal.h"
+#include "segment_prefetch.h"
+#include "url.h"
+
+#if HAVE_THREADS
+
+#define MIN_ALLOC_SIZE (256 * 1024)
+#define MIN_GROW_SIZE  4096
+
+typedef struct PrefetchJob {
+    FFSegmentPrefetch *p;
+    int           active;       ///< the thread was started and not joined
+    atomic_int    abort;
+    int64_t       id;
+    char         *url;
+    AVDictionary *opts;
+    int64_t       size;
+    AVBufferRef  *data;
+    size_t        data_size;
+    int64_t       data_off;     ///< segment offset of the first byte of data
+    size_t        reserved;     ///< bytes accounted in FFSegmentPrefetch.used
+    size_t        read_pos;     ///< next byte returned by ff_segment_prefetch_read()
+    int           done;         ///< the download ended, protected by mutex
+    int           ret;
+    pthread_t     thread;
+} PrefetchJob;
+
+struct FFSegmentPrefetch {
+    AVFormatContext *s;
+    PrefetchJob     *jobs;
+    int              nb_jobs;
+    int64_t          max_size;
+
+    PrefetchJob     *taken;         ///< job of the segment being read
+
+    pthread_mutex_t  mutex;
+    pthread_cond_t   cond;          ///< signaled when a download progresses
+    int64_t          used;          ///< protected by mutex
+};
+
+static int prefetch_interrupt_cb(void *opaque)
+{
+    PrefetchJob *job = opaque;
+
+    return atomic_load(&job->abort) ||
+           ff_check_interrupt(&job->p->s->interrupt_callback);
+}
+
+static int reserve(PrefetchJob *job, size_t size)
+{
+    FFSegmentPrefetch *p = job->p;
+    int64_t extra = size - job->reserved;
+    int ret = 0;
+
+    /* the buffer may be moved, which must not happen while the reader
+     * copies from it */
+    pthread_mutex_lock(&p->mutex);
+    if (p->used + extra > p->max_size) {
+        ret = AVERROR(ENOSPC);
+    } else {
+        ret = av_buffer_realloc(&job->data, size);
+        if (ret >= 0) {
+            p->used      += extra;
+            job->reserved = size;
+        }
+    }
+    pthread_mutex_unlock(&p->mutex);
+    return ret;
+}
+
+/* drop the data already read, or grow the buffer within the memory limit,
+ * waiting for the segment to be read if neither is possible */
+static int make_room(PrefetchJob *job)
+{
+    FFSegmentPrefetch *p = job->p;
+    int ret;
+
+    pthread_mutex_lock(&p->mutex);
+    for (;;) {
+        const int64_t avail = p->max_size - p->used + job->reserved;
+
+        if (job->read_pos) {
+            job->data_size -= job->read_pos;
+            job->data_off  += job->read_pos;
+            memmove(job->data->data, job->data->data + job->read_pos, job->data_size);
+            job->read_pos = 0;
+            ret = 0;
+            break;
+        }
+        if (avail - (int64_t)job->reserved >= (job->reserved ? MIN_GROW_SIZE : 1)) {
+            const size_t size = FFMIN(FFMAX(2 * job->reserved, MIN_ALLOC_SIZE), avail);
+
+            ret = av_buffer_realloc(&job->data, size);
+            if (ret >= 0) {
+                p->used      += size - job->reserved;
+                job->reserved = size;
+            }
+            break;
+        }
+        if (!job->data_size || atomic_load(&job->abort)) {
+            ret = AVERROR(ENOSPC);
+            break;
+        }
+        pthread_cond_wait(&p->cond, &p->mutex);
+    }
+    pthread_mutex_unlock(&p->mutex);
+    return ret;
+}
+
+static void *prefetch_thread(void *arg)
+{
+    PrefetchJob *job = arg;
+    FFSegmentPrefetch *p = job->p;
+    const AVIOInterruptCB cb = { prefetch_interrupt_cb, job };
+    AVIOContext *pb = NULL;
+    int64_t expected;
+    int ret;
+
+    ff_thread_setname("seg-prefetch");
+
+    ret = ffio_open_whitelist(&pb, job->url, AVIO_FLAG_READ, &cb, &job->opts,
+                              p->s->protocol_whitelist, p->s->protocol_blacklist);
+    if (ret < 0)
+        goto end;
+
+    /* a segment larger than the limit is downloaded as it is read */
+    expected = job->size >= 0 ? job->size : avio_size(pb);
+    if (expected > 0 && (ret = reserve(job, expected)) < 0 && ret != AVERROR(ENOSPC))
+        goto end;
+
+    for (;;) {
+        if (job->size >= 0 && job->data_off + job->data_size >= job->size)
+            break;
+        if (job->data_size == job->reserved && (ret = make_room(job)) < 0)
+            break;
+
+        ret = avio_read(pb, job->data->data + job->data_size,
+                        FFMIN(job->reserved - job->data_size, INT_MAX));
+        if (ret == AVERROR_EOF || !ret) {
+            ret = 0;
+            break;
+        }
+        if (ret < 0)
+            break;
+        pthread_mutex_lock(&p->mutex);
+        job->data_size += ret;
+        pthread_cond_broadcast(&p->cond);
+        pthread_mutex_unlock(&p->mutex);
+    }
+
+end:
+    if (ret < 0 && ret != AVERROR_EXIT)
+        av_log(p->s, ret == AVERROR(ENOSPC) ? AV_LOG_VERBOSE : AV_LOG_WARNING,
+               "Could not prefetch segment %"PRId64" '%s': %s\n",
+               job->id, job->url, av_err2str(ret));
+    avio_closep(&pb);
+    pthread_mutex_lock(&p->mutex);
+    job->ret  = ret;
+    job->done = 1;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+    return NULL;
+}
+
+/* must be called after the thread was joined */
+static void job_release(PrefetchJob *job)
+{
+    FFSegmentPrefetch *p = job->p;
+
+    pthread_mutex_lock(&p->mutex);
+    p->used -= job->reserved;
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+
+    av_buffer_unref(&job->data);
+    av_freep(&job->url);
+    av_dict_free(&job->opts);
+    job->data_size = 0;
+    job->data_off  = 0;
+    job->reserved  = 0;
+    job->read_pos  = 0;
+    job->done      = 0;
+    job->active    = 0;
+    if (p->taken == job)
+        p->taken = NULL;
+}
+
+static void job_cancel(PrefetchJob *job)
+{
+    FFSegmentPrefetch *p = job->p;
+
+    atomic_store(&job->abort, 1);
+    pthread_mutex_lock(&p->mutex);
+    pthread_cond_broadcast(&p->cond);
+    pthread_mutex_unlock(&p->mutex);
+    pthread_join(job->thread, NULL);
+    job_release(job);
+}
+
+int ff_segment_prefetch_alloc(FFSegmentPrefetch **pp, AVFormatContext *s,
+                              int nb_segments, int64_t max_size)
+{
+    FFSegmentPrefetch *p;
+    int ret;
+
+    p = av_mallocz(sizeof(*p));
+    if (!p)
+        return AVERROR(ENOMEM);
+
+    p->jobs = av_calloc(nb_segments, sizeof(*p->jobs));
+    if (!p->jobs) {
+        av_free(p);
+        return AVERROR(ENOMEM);
+    }
+    ret = pthread_mutex_init(&p->mutex, NULL);
+    if (ret) {
+        av_free(p->jobs);
+        av_free(p);
+        return AVERROR(ret);
+    }
+    ret = pthread_cond_init(&p->cond, NULL);
+    if (ret) {
+        pthread_mutex_destroy(&p->mutex);
+        av_free(p->jobs);
+        av_free(p);
+        return AVERROR(ret);
+    }
+
+    for (int i = 0; i < nb_segments; i++)
+        p->jobs[i].p = p;
+    p->s        = s;
+    p->nb_jobs  = nb_segments;
+    p->max_size = max_size;
+
+    *pp = p;
+    return 0;
+}
+
+int ff_segment_prefetch_start(FFSegmentPrefetch *p, int64_t id, const char *url,
+                              int64_t offset, int64_t size, AVDictionary *opts)
+{
+    PrefetchJob *job = NULL;
+    int ret;
+
+    for (int i = 0; i < p->nb_jobs; i++) {
+        if (p->jobs[i].active && p->jobs[i].id == id)
+            return 0;
+        if (!p->jobs[i].active && !job)
+            job = &p->jobs[i];
+    }
+    if (!job)
+        return 0;
+
+    job->id   = id;
+    job->size = size;
+    job->ret  = 0;
+    atomic_store(&job->abort, 0);
+    job->url = av_strdup(url);
+    if (!job->url)
+        return AVERROR(ENOMEM);
+    /* the connections must not outlive the interrupt callback of the job */
+    if ((ret = av_dict_copy(&job->opts, opts, 0)) < 0 ||
+        (ret = av_dict_set(&job->opts, "connection_pool", "0", 0)) < 0)
+        goto fail;
+    if (size >= 0) {
+        /* try to restrict the HTTP request to the part we want */
+        if ((ret = av_dict_set_int(&job->opts, "offset", offset, 0)) < 0 ||
+            (ret = av_dict_set_int(&job->opts, "end_offset", offset + size, 0)) < 0)
+            goto fail;
+    }
+
+    ret = pthread_create(&job->thread, NULL, prefetch_thread, job);
+    if (ret) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    job->active = 1;
+    return 1;
+
+fail:
+    av_freep(&job->url);
+    av_dict_free(&job->opts);
+    return ret;
+}
+
+int ff_segment_prefetch_take(FFSegmentPrefetch *p, int64_t id, const char *url)
+{
+    PrefetchJob *found = NULL;
+
+    ff_segment_prefetch_release(p);
+
+    for (int i = 0; i < p->nb_jobs; i++) {
+        PrefetchJob *job = &p->jobs[i];
+
+        if (!job->active || job->id > id)
+            continue;
+        if (job->id < id || strcmp(job->url, url)) {
+            job_cancel(job);
+            continue;
+        }
+        found = job;
+    }
+    if (!found)
+        return 0;
+
+    /* only wait for the first bytes, the rest is read while downloading */
+    pthread_mutex_lock(&p->mutex);
+    while (!found->done && !found->data_size)
+        pthread_cond_wait(&p->cond, &p->mutex);
+    if (!found->done || found->ret >= 0)
+        p->taken = found;
+    pthread_mutex_unlock(&p->mutex);
+
+    if (!p->taken) {
+        pthread_join(found->thread, NULL);
+        job_release(found);
+        return 0;
+    }
+    return 1;
+}
+
+int ff_segment_prefetch_read(FFSegmentPrefetch *p, uint8_t *buf, int size)
+{
+    PrefetchJob *job = p->taken;
+    int ret;
+
+    if (!job)
+        return AVERROR_EOF;
+
+    pthread_mutex_lock(&p->mutex);
+    while (!job->done && job->read_pos == job->data_size)
+        pthread_cond_wait(&p->cond, &p->mutex);
+    ret = FFMIN(size, job->data_size - job->read_pos);
+    if (ret > 0) {
+        memcpy(buf, job->data->data + job->read_pos, ret);
+        job->read_pos += ret;
+        pthread_cond_broadcast(&p->cond);
+    } else {
+        ret = job->ret < 0 ? job->ret : AVERROR_EOF;
+    }
+    pthread_mutex_unlock(&p->mutex);
+
+    return ret;
+}
+
+void ff_segment_prefetch_release(FFSegmentPrefetch *p)
+{
+    if (p && p->taken)
+        job_cancel(p->taken);
+}
+
+void ff_segment_prefetch_cancel(FFSegmentPrefetch *p)
+{
+    if (!p)
+        return;
+
+    for (int i = 0; i < p->nb_jobs; i++)
+        if (p->jobs[i].active)
+            job_cancel(&p->jobs[i]);
+}
+
+void ff_segment_prefetch_free(FFSegmentPrefetch **pp)
+{
+    FFSegmentPrefetch *p = *pp;
+
+    if (!p)
+        return;
+
+    ff_segment_prefetch_cancel(p);
+    pthread_cond_destroy(&p->cond);
+    pthread_mutex_destroy(&p->mutex);
+    av_freep(&p->jobs);
+    av_freep(pp);
+}
+
+#else
+
+int ff_segment_prefetch_alloc(FFSegmentPrefetch **p, AVFormatContext *s,
+                              int nb_segments, int64_t max_size)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_segment_prefetch_start(FFSegmentPrefetch *p, int64_t id, const char *url,
+                              int64_t offset, int64_t size, AVDictionary *opts)
+{
+    return 0;
+}
+
+int ff_segment_prefetch_take(FFSegmentPrefetch *p, int64_t id, const char *url)
+{
+    return 0;
+}
+
+int ff_segment_prefetch_read(FFSegmentPrefetch *p, uint8_t *buf, int size)
+{
+    return AVERROR_EOF;
+}
+
+void ff_segment_prefetch_release(FFSegmentPrefetch *p)
+{
+}
+
+void ff_segment_prefetch_cancel(FFSegmentPrefetch *p)
+{
+}
+
+void ff_segment_prefetch_free(FFSegmentPrefetch **p)
+{
+}
+
+#endif /* HAVE_THREADS */
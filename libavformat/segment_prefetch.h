@@ -0,0 +1,93 @@
+/*
+ * Background download of the next segments of HLS and DASH playlists
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_SEGMENT_PREFETCH_H
+#define AVFORMAT_SEGMENT_PREFETCH_H
+
+#include <stdint.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/dict.h"
+
+#include "avformat.h"
+
+typedef struct FFSegmentPrefetch FFSegmentPrefetch;
+
+/**
+ * Allocate a prefetcher downloading up to nb_segments segments at once, each
+ * one in its own thread.
+ *
+ * The segments are opened with the protocol layer directly, with the
+ * protocol whitelist and blacklist of s, and the interrupt callback of s is
+ * called from the download threads.
+ *
+ * @param max_size maximum number of bytes held by the downloads, including
+ *                 the one of the segment being read until it is released
+ * @return 0 on success, AVERROR(ENOSYS) if threads are not available
+ */
+int ff_segment_prefetch_alloc(FFSegmentPrefetch **p, AVFormatContext *s,
+                              int nb_segments, int64_t max_size);
+
+/**
+ * Start downloading a segment in the background, unless it is already being
+ * downloaded or all the download slots are in use.
+ *
+ * @param id   sequence number of the segment
+ * @param size number of bytes to read from offset, -1 for the whole resource
+ * @param opts protocol options, not modified
+ * @return 1 if the download was started, 0 if not, a negative error code on
+ *         failure
+ */
+int ff_segment_prefetch_start(FFSegmentPrefetch *p, int64_t id, const char *url,
+                              int64_t offset, int64_t size, AVDictionary *opts);
+
+/**
+ * Take a segment to read it while it is downloaded, releasing the segment
+ * taken before. The downloads of the segments preceding id are cancelled.
+ * Only waits for the first bytes of the segment.
+ *
+ * @return 1 if the segment can be read with ff_segment_prefetch_read(), 0 if
+ *         it was not requested or the download failed, in which case the
+ *         caller must open it itself
+ */
+int ff_segment_prefetch_take(FFSegmentPrefetch *p, int64_t id, const char *url);
+
+/**
+ * Read the taken segment, waiting for its download if needed.
+ *
+ * @return number of bytes read, AVERROR_EOF at the end of the segment, or a
+ *         negative error code if the download failed
+ */
+int ff_segment_prefetch_read(FFSegmentPrefetch *p, uint8_t *buf, int size);
+
+/**
+ * Release the taken segment, cancelling its download if it is still in
+ * progress. Its data stops being accounted in max_size.
+ */
+void ff_segment_prefetch_release(FFSegmentPrefetch *p);
+
+/**
+ * Cancel all the downloads and release the taken segment, e.g. on seek.
+ */
+void ff_segment_prefetch_cancel(FFSegmentPrefetch *p);
+
+void ff_segment_prefetch_free(FFSegmentPrefetch **p);
+
+#endif /* AVFORMAT_SEGMENT_PREFETCH_H */
@@ -0,0 +1,420 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Play a low latency HLS stream from a minimal HTTP/1.1 server on the
+ * loopback interface, to check the reading of partial segments, of the
+ * EXT-X-PRELOAD-HINT part and the blocking playlist reloads.
+ *
+ * The server takes the segments and parts of a finished low latency playlist
+ * written by the hls muxer, and serves them as a live playlist which ends with
+ * the parts of an incomplete segment and a preload hint, without
+ * EXT-X-ENDLIST. The live edge moves forward when the client asks for a part
+ * which is not published yet, either with _HLS_msn/_HLS_part or by requesting
+ * the hinted part, as a server holding these requests would. EXT-X-ENDLIST is
+ * written once the last segment is complete.
+ *
+ * usage: hls_ll <directory of hls_ll.m3u8>
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/avstring.h"
+#include "libavutil/bprint.h"
+#include "libavutil/crc.h"
+#include "libavutil/file.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavformat/avformat.h"
+#include "libavformat/network.h"
+
+#define MAX_CONNS    8
+#define MAX_SEGMENTS 32
+#define MAX_PARTS    8
+
+/* the live edge the client starts at: segments before 8 complete, parts 0 and
+ * 1 of segment 8 published */
+#define START_SEGMENT 8
+#define START_PART    2
+
+typedef struct Segment {
+    char *inf;                  ///< EXTINF line and URI of the complete segment
+    char *parts[MAX_PARTS];     ///< EXT-X-PART lines
+    char *part_uris[MAX_PARTS];
+    int nb_parts;
+} Segment;
+
+typedef struct Server {
+    int listen_fd;
+    int port;
+    int stop;
+    const char *dir;
+    char *header;
+    Segment segments[MAX_SEGMENTS];
+    int nb_segments;
+    /* live edge: segments before cur_segment are complete, and the parts
+     * before cur_part of cur_segment are published */
+    int cur_segment;
+    int cur_part;
+    pthread_mutex_t mutex;
+} Server;
+
+typedef struct Conn {
+    int fd;
+    char buf[4096];
+    int len;
+} Conn;
+
+static int send_all(int fd, const char *buf, int len)
+{
+    while (len > 0) {
+        int ret = send(fd, buf, len, MSG_NOSIGNAL);
+        if (ret <= 0)
+            return -1;
+        buf += ret;
+        len -= ret;
+    }
+    return 0;
+}
+
+/* split the playlist written by the muxer into its header and segments */
+static int load_playlist(Server *srv)
+{
+    AVBPrint header;
+    char path[1024], *data, *line, *save = NULL;
+    Segment *seg;
+    size_t size;
+    uint8_t *buf;
+    int ret;
+
+    snprintf(path, sizeof(path), "%s/hls_ll.m3u8", srv->dir);
+    if ((ret = av_file_map(path, &buf, &size, 0, NULL)) < 0)
+        return ret;
+    data = av_strndup(buf, size);
+    av_file_unmap(buf, size);
+    if (!data)
+        return AVERROR(ENOMEM);
+
+    av_bprint_init(&header, 0, AV_BPRINT_SIZE_UNLIMITED);
+    seg = &srv->segments[0];
+    for (line = av_strtok(data, "\n", &save); line;
+         line = av_strtok(NULL, "\n", &save)) {
+        const char *uri;
+
+        if (av_strstart(line, "#EXT-X-PART:", NULL)) {
+            if (seg->nb_parts == MAX_PARTS || !(uri = strstr(line, "URI=\"")))
+                break;
+            seg->parts[seg->nb_parts]     = av_asprintf("%s\n", line);
+            seg->part_uris[seg->nb_parts] = av_strndup(uri + 5, strcspn(uri + 5, "\""));
+            seg->nb_parts++;
+        } else if (av_strstart(line, "#EXTINF:", NULL)) {
+            const char *seg_uri = av_strtok(NULL, "\n", &save);
+            if (!seg_uri)
+                break;
+            seg->inf = av_asprintf("%s\n%s\n", line, seg_uri);
+            if (++srv->nb_segments == MAX_SEGMENTS)
+                break;
+            seg++;
+        } else if (!srv->nb_segments && !seg->nb_parts &&
+                   !av_strstart(line, "#EXT-X-ENDLIST", NULL)) {
+            av_bprintf(&header, "%s\n", line);
+        }
+    }
+    av_free(data);
+
+    ret = av_bprint_finalize(&header, &srv->header);
+    if (ret < 0)
+        return ret;
+    return srv->nb_segments > START_SEGMENT ? 0 : AVERROR_INVALIDDATA;
+}
+
+/* move the live edge forward until the given part is published */
+static void publish(Server *srv, int segment, int part)
+{
+    while (srv->cur_segment < srv->nb_segments &&
+           (srv->cur_segment < segment ||
+            (srv->cur_segment == segment && srv->cur_part <= part))) {
+        if (srv->cur_part < srv->segments[srv->cur_segment].nb_parts) {
+            srv->cur_part++;
+        } else {
+            srv->cur_segment++;
+            srv->cur_part = 0;
+        }
+    }
+}
+
+static char *write_playlist(Server *srv)
+{
+    int s = srv->cur_segment, p = srv->cur_part;
+    const char *hint = NULL;
+    AVBPrint bp;
+    char *ret;
+
+    av_bprint_init(&bp, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprintf(&bp, "%s", srv->header);
+    for (int i = 0; i < srv->nb_segments && i <= s; i++) {
+        const Segment *seg = &srv->segments[i];
+        for (int j = 0; j < seg->nb_parts && (i < s || j < p); j++)
+            av_bprintf(&bp, "%s", seg->parts[j]);
+        if (i < s)
+            av_bprintf(&bp, "%s", seg->inf);
+    }
+
+    if (s < srv->nb_segments && p < srv->segments[s].nb_parts)
+        hint = srv->segments[s].part_uris[p];
+    else if (s + 1 < srv->nb_segments)
+        hint = srv->segments[s + 1].part_uris[0];
+    if (s == srv->nb_segments)
+        av_bprintf(&bp, "#EXT-X-ENDLIST\n");
+    else if (hint)
+        av_bprintf(&bp, "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"%s\"\n", hint);
+
+    if (av_bprint_finalize(&bp, &ret) < 0)
+        return NULL;
+    return ret;
+}
+
+static int send_response(int fd, const char *data, size_t size)
+{
+    char header[128];
+
+    if (!data) {
+        snprintf(header, sizeof(header),
+                 "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n");
+        return send_all(fd, header, strlen(header));
+    }
+    snprintf(header, sizeof(header),
+             "HTTP/1.1 200 OK\r\nContent-Length: %zu\r\n\r\n", size);
+    return send_all(fd, header, strlen(header)) < 0 ||
+           send_all(fd, data, size) < 0 ? -1 : 0;
+}
+
+static int handle_request(Server *srv, int fd, const char *path)
+{
+    const char *query = strchr(path, '?');
+    char file[1024];
+    uint8_t *buf;
+    size_t size;
+    int ret;
+
+    printf("GET %s\n", path);
+
+    if (av_strstart(path, "/live.m3u8", NULL)) {
+        int64_t msn;
+        int part;
+        char *playlist;
+
+        /* a blocking reload returns once the part asked for is published */
+        if (query && sscanf(query, "?_HLS_msn=%"SCNd64"&_HLS_part=%d", &msn, &part) == 2)
+            publish(srv, msn, part);
+        playlist = write_playlist(srv);
+        if (!playlist)
+            return -1;
+        ret = send_response(fd, playlist, strlen(playlist));
+        av_free(playlist);
+        return ret;
+    }
+
+    /* the hinted part is sent once it is complete */
+    for (int i = 0; i < srv->nb_segments; i++)
+        for (int j = 0; j < srv->segments[i].nb_parts; j++)
+            if (!strcmp(path + 1, srv->segments[i].part_uris[j]))
+                publish(srv, i, j);
+
+    snprintf(file, sizeof(file), "%s%.*s", srv->dir,
+             (int)(query ? query - path : strlen(path)), path);
+    if (strstr(path, "..") || av_file_map(file, &buf, &size, 0, NULL) < 0)
+        return send_response(fd, NULL, 0);
+    ret = send_response(fd, buf, size);
+    av_file_unmap(buf, size);
+    return ret;
+}
+
+/* answer all the complete requests in the buffer, 0 keeps the connection */
+static int handle_requests(Server *srv, Conn *c)
+{
+    char *end;
+
+    c->buf[c->len] = 0;
+    while ((end = strstr(c->buf, "\r\n\r\n"))) {
+        char path[1024];
+
+        if (sscanf(c->buf, "GET %1023s HTTP/1.1", path) != 1 ||
+            handle_request(srv, c->fd, path) < 0)
+            return -1;
+
+        c->len -= end + 4 - c->buf;
+        memmove(c->buf, end + 4, c->len + 1);
+    }
+    return c->len == sizeof(c->buf) - 1 ? -1 : 0;
+}
+
+static void *server_thread(void *arg)
+{
+    Server *srv = arg;
+    Conn conns[MAX_CONNS] = { 0 };
+    int nb_conns = 0;
+
+    for (;;) {
+        struct pollfd p[MAX_CONNS + 1] = { { srv->listen_fd, POLLIN, 0 } };
+        int stop;
+
+        pthread_mutex_lock(&srv->mutex);
+        stop = srv->stop;
+        pthread_mutex_unlock(&srv->mutex);
+        if (stop)
+            break;
+
+        for (int i = 0; i < nb_conns; i++)
+            p[i + 1] = (struct pollfd){ conns[i].fd, POLLIN, 0 };
+        if (poll(p, nb_conns + 1, 10) <= 0)
+            continue;
+
+        for (int i = nb_conns - 1; i >= 0; i--) {
+            Conn *c = &conns[i];
+            int ret;
+
+            if (!p[i + 1].revents)
+                continue;
+            ret = recv(c->fd, c->buf + c->len, sizeof(c->buf) - 1 - c->len, 0);
+            if (ret <= 0 || (c->len += ret, handle_requests(srv, c) < 0)) {
+                closesocket(c->fd);
+                *c = conns[--nb_conns];
+            }
+        }
+
+        if (p[0].revents && nb_conns < MAX_CONNS) {
+            int fd = accept(srv->listen_fd, NULL, NULL);
+            if (fd >= 0)
+                conns[nb_conns++] = (Conn){ .fd = fd };
+        }
+    }
+
+    for (int i = 0; i < nb_conns; i++)
+        closesocket(conns[i].fd);
+    return NULL;
+}
+
+static int server_start(Server *srv, pthread_t *thread)
+{
+    struct sockaddr_in addr = { 0 };
+    socklen_t addr_len = sizeof(addr);
+
+    srv->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (srv->listen_fd < 0)
+        return -1;
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(srv->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+        listen(srv->listen_fd, MAX_CONNS) ||
+        getsockname(srv->listen_fd, (struct sockaddr *)&addr, &addr_len))
+        return -1;
+    srv->port = ntohs(addr.sin_port);
+    pthread_mutex_init(&srv->mutex, NULL);
+    return pthread_create(thread, NULL, server_thread, srv);
+}
+
+static void server_free(Server *srv)
+{
+    av_freep(&srv->header);
+    for (int i = 0; i < MAX_SEGMENTS; i++) {
+        Segment *seg = &srv->segments[i];
+        av_freep(&seg->inf);
+        for (int j = 0; j < seg->nb_parts; j++) {
+            av_freep(&seg->parts[j]);
+            av_freep(&seg->part_uris[j]);
+        }
+    }
+}
+
+static int play(const char *url)
+{
+    const AVCRC *crc_table = av_crc_get_table(AV_CRC_32_IEEE_LE);
+    AVFormatContext *s = NULL;
+    AVPacket *pkt = av_packet_alloc();
+    int64_t first_pts = AV_NOPTS_VALUE, last_pts = AV_NOPTS_VALUE;
+    uint32_t crc = 0;
+    int nb_packets = 0, ret;
+
+    if (!pkt)
+        return AVERROR(ENOMEM);
+    ret = avformat_open_input(&s, url, NULL, NULL);
+    if (ret < 0)
+        goto end;
+
+    while ((ret = av_read_frame(s, pkt)) >= 0) {
+        if (first_pts == AV_NOPTS_VALUE)
+            first_pts = pkt->pts;
+        last_pts = pkt->pts;
+        crc = av_crc(crc_table, crc, pkt->data, pkt->size);
+        nb_packets++;
+        av_packet_unref(pkt);
+    }
+    printf("read %d packets, pts %"PRId64" to %"PRId64", crc 0x%08"PRIx32", %s\n",
+           nb_packets, first_pts, last_pts, crc,
+           ret == AVERROR_EOF ? "eof" : av_err2str(ret));
+    ret = 0;
+
+end:
+    avformat_close_input(&s);
+    av_packet_free(&pkt);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    Server srv = { .cur_segment = START_SEGMENT, .cur_part = START_PART };
+    pthread_t thread;
+    char url[64];
+    int ret;
+
+    if (argc < 2) {
+        fprintf(stderr, "usage: %s <directory of hls_ll.m3u8>\n", argv[0]);
+        return 1;
+    }
+    srv.dir = argv[1];
+    if (load_playlist(&srv) < 0) {
+        fprintf(stderr, "could not load %s/hls_ll.m3u8\n", srv.dir);
+        server_free(&srv);
+        return 1;
+    }
+
+    ff_network_init();
+    if (server_start(&srv, &thread) < 0) {
+        printf("could not start the server\n");
+        server_free(&srv);
+        return 1;
+    }
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/live.m3u8", srv.port);
+
+    ret = play(url);
+    if (ret < 0)
+        printf("could not play the stream: %s\n", av_err2str(ret));
+
+    pthread_mutex_lock(&srv.mutex);
+    srv.stop = 1;
+    pthread_mutex_unlock(&srv.mutex);
+    pthread_join(thread, NULL);
+    closesocket(srv.listen_fd);
+    pthread_mutex_destroy(&srv.mutex);
+    server_free(&srv);
+    ff_network_close();
+    return ret < 0;
+}
@@ -0,0 +1,336 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Read a resource from a minimal HTTP/1.1 server on the loopback interface
+ * to check the range requests split by request_size, their pipelining, the
+ * reuse and release of the connections of connection_pool, and seeking while
+ * the reads are done ahead by readahead_blocks.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+#include "libavformat/avio.h"
+#include "libavformat/network.h"
+
+#define FILE_SIZE   20000
+#define MAX_CONNS   8
+
+typedef struct Server {
+    int listen_fd;
+    int port;
+    int stop;
+    int nb_requests;
+    int nb_connections;
+    int nb_open;
+    pthread_mutex_t mutex;
+} Server;
+
+typedef struct Conn {
+    int fd;
+    char buf[4096];
+    int len;
+} Conn;
+
+static uint8_t data_byte(int i)
+{
+    return (i * 7 + i / 251) & 0xff;
+}
+
+static int send_all(int fd, const char *buf, int len)
+{
+    while (len > 0) {
+        int ret = send(fd, buf, len, MSG_NOSIGNAL);
+        if (ret <= 0)
+            return -1;
+        buf += ret;
+        len -= ret;
+    }
+    return 0;
+}
+
+/* answer all the complete requests in the buffer, 0 keeps the connection */
+static int handle_requests(Server *srv, Conn *c)
+{
+    char *end;
+
+    c->buf[c->len] = 0;
+    while ((end = strstr(c->buf, "\r\n\r\n"))) {
+        const char *range = strstr(c->buf, "\r\nRange: bytes=");
+        int start = 0, last = FILE_SIZE - 1, ret;
+        char header[256];
+        uint8_t *body;
+
+        if (range && range < end) {
+            char *p;
+            start = strtol(range + 15, &p, 10);
+            if (*p == '-' && p[1] >= '0' && p[1] <= '9')
+                last = FFMIN(strtol(p + 1, NULL, 10), FILE_SIZE - 1);
+            snprintf(header, sizeof(header),
+                     "HTTP/1.1 206 Partial Content\r\n"
+                     "Content-Range: bytes %d-%d/%d\r\n"
+                     "Content-Length: %d\r\n\r\n",
+                     start, last, FILE_SIZE, last - start + 1);
+        } else {
+            snprintf(header, sizeof(header),
+                     "HTTP/1.1 200 OK\r\nContent-Length: %d\r\n\r\n", FILE_SIZE);
+        }
+
+        /* counted before answering, for the client to see it once served */
+        pthread_mutex_lock(&srv->mutex);
+        srv->nb_requests++;
+        pthread_mutex_unlock(&srv->mutex);
+
+        body = av_malloc(last - start + 1);
+        if (!body)
+            return -1;
+        for (int i = start; i <= last; i++)
+            body[i - start] = data_byte(i);
+        ret = send_all(c->fd, header, strlen(header)) < 0 ||
+              send_all(c->fd, body, last - start + 1) < 0;
+        av_free(body);
+
+        c->len -= end + 4 - c->buf;
+        memmove(c->buf, end + 4, c->len + 1);
+        if (ret)
+            return -1;
+    }
+    return c->len == sizeof(c->buf) - 1 ? -1 : 0;
+}
+
+static void *server_thread(void *arg)
+{
+    Server *srv = arg;
+    Conn conns[MAX_CONNS] = { 0 };
+    int nb_conns = 0;
+    int64_t stop_time = 0;
+
+    for (;;) {
+        struct pollfd p[MAX_CONNS + 1] = { { srv->listen_fd, POLLIN, 0 } };
+        int stop;
+
+        pthread_mutex_lock(&srv->mutex);
+        srv->nb_open = nb_conns;
+        stop = srv->stop;
+        pthread_mutex_unlock(&srv->mutex);
+        /* wait a little for the client to close its connections */
+        if (stop && !stop_time)
+            stop_time = av_gettime_relative() + 2000000;
+        if (stop && (!nb_conns || av_gettime_relative() > stop_time))
+            break;
+
+        for (int i = 0; i < nb_conns; i++)
+            p[i + 1] = (struct pollfd){ conns[i].fd, POLLIN, 0 };
+        if (poll(p, nb_conns + 1, 10) <= 0)
+            continue;
+
+        for (int i = nb_conns - 1; i >= 0; i--) {
+            Conn *c = &conns[i];
+            int ret;
+
+            if (!p[i + 1].revents)
+                continue;
+            ret = recv(c->fd, c->buf + c->len, sizeof(c->buf) - 1 - c->len, 0);
+            if (ret <= 0 || (c->len += ret, handle_requests(srv, c) < 0)) {
+                closesocket(c->fd);
+                *c = conns[--nb_conns];
+            }
+        }
+
+        if (p[0].revents && nb_conns < MAX_CONNS) {
+            int fd = accept(srv->listen_fd, NULL, NULL);
+            if (fd >= 0) {
+                conns[nb_conns++] = (Conn){ .fd = fd };
+                pthread_mutex_lock(&srv->mutex);
+                srv->nb_connections++;
+                pthread_mutex_unlock(&srv->mutex);
+            }
+        }
+    }
+
+    for (int i = 0; i < nb_conns; i++)
+        closesocket(conns[i].fd);
+    return NULL;
+}
+
+static int server_start(Server *srv, pthread_t *thread)
+{
+    struct sockaddr_in addr = { 0 };
+    socklen_t addr_len = sizeof(addr);
+
+    srv->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (srv->listen_fd < 0)
+        return -1;
+    addr.sin_family      = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(srv->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+        listen(srv->listen_fd, MAX_CONNS) ||
+        getsockname(srv->listen_fd, (struct sockaddr *)&addr, &addr_len))
+        return -1;
+    srv->port = ntohs(addr.sin_port);
+    pthread_mutex_init(&srv->mutex, NULL);
+    return pthread_create(thread, NULL, server_thread, srv);
+}
+
+static void server_stats(Server *srv, int *requests, int *connections)
+{
+    /* wait for the server to see the connections closed, so that the
+     * pipelined requests whose answer was not read are counted */
+    for (int i = 0; i < 200; i++) {
+        int open;
+
+        pthread_mutex_lock(&srv->mutex);
+        open = srv->nb_open;
+        pthread_mutex_unlock(&srv->mutex);
+        if (!open)
+            break;
+        av_usleep(10000);
+    }
+
+    pthread_mutex_lock(&srv->mutex);
+    *requests    = srv->nb_requests;
+    *connections = srv->nb_connections;
+    srv->nb_requests = srv->nb_connections = 0;
+    pthread_mutex_unlock(&srv->mutex);
+}
+
+/* read [off, off + size) and compare it to the served data */
+static int read_range(AVIOContext *pb, int off, int size)
+{
+    uint8_t buf[1024];
+
+    if (avio_seek(pb, off, SEEK_SET) != off)
+        return -1;
+    while (size > 0) {
+        int len = avio_read(pb, buf, FFMIN(size, sizeof(buf)));
+        if (len <= 0)
+            return -1;
+        for (int i = 0; i < len; i++)
+            if (buf[i] != data_byte(off + i))
+                return -1;
+        off  += len;
+        size -= len;
+    }
+    return 0;
+}
+
+static int open_url(AVIOContext **pb, const char *url, const char *opts)
+{
+    AVDictionary *options = NULL;
+    int ret;
+
+    av_dict_parse_string(&options, opts, "=", ":", 0);
+    ret = avio_open2(pb, url, AVIO_FLAG_READ, NULL, &options);
+    av_dict_free(&options);
+    return ret;
+}
+
+/* with hold, a context is kept open meanwhile, like a demuxer playlist */
+static void test(Server *srv, const char *name, const char *url,
+                 const char *opts, const int *ranges, int nb_ranges,
+                 int nb_opens, int hold)
+{
+    AVIOContext *holder = NULL;
+    int requests, connections, ret = 0;
+
+    if (hold)
+        ret = open_url(&holder, url, opts);
+
+    for (int n = 0; n < nb_opens && ret >= 0; n++) {
+        AVIOContext *pb = NULL;
+
+        ret = open_url(&pb, url, opts);
+        for (int i = 0; i < nb_ranges && ret >= 0; i++)
+            ret = read_range(pb, ranges[2 * i], ranges[2 * i + 1]);
+        avio_closep(&pb);
+    }
+    avio_closep(&holder);
+
+    server_stats(srv, &requests, &connections);
+    printf("%s: %s, %d requests, %d connections\n", name,
+           ret < 0 ? "failed" : "ok", requests, connections);
+}
+
+/* the requests depend on how far the background reads got, so only the
+ * data is checked */
+static void test_readahead(Server *srv, const char *name, const char *url,
+                           const char *opts, const int *ranges, int nb_ranges)
+{
+    AVIOContext *pb = NULL;
+    int requests, connections, ret;
+
+    ret = open_url(&pb, url, opts);
+    for (int i = 0; i < nb_ranges && ret >= 0; i++)
+        ret = read_range(pb, ranges[2 * i], ranges[2 * i + 1]);
+    /* skips shorter than the blocks read ahead */
+    for (int off = 0; off < FILE_SIZE - 100 && ret >= 0; off += 700) {
+        if (avio_seek(pb, off, SEEK_SET) != off || avio_r8(pb) != data_byte(off))
+            ret = -1;
+    }
+    avio_closep(&pb);
+
+    server_stats(srv, &requests, &connections);
+    printf("%s: %s\n", name, ret < 0 ? "failed" : "ok");
+}
+
+int main(void)
+{
+    static const int whole[]    = { 0, FILE_SIZE };
+    static const int seeks[]    = { 0, 6000, 12000, 3000, 2000, 500 };
+    static const int back[]     = { 0, 3000, 9000, 2000, 1000, 4000,
+                                    15000, 1000, 4000, 16000 };
+    Server srv = { 0 };
+    pthread_t thread;
+    char url[64];
+    int open;
+
+    ff_network_init();
+    if (server_start(&srv, &thread) < 0) {
+        printf("could not start the server\n");
+        return 1;
+    }
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/file", srv.port);
+
+    test(&srv, "single request", url, "", whole, 1, 1, 0);
+    test(&srv, "request_size", url, "request_size=4096", whole, 1, 1, 0);
+    test(&srv, "request_size seeks", url, "request_size=4096", seeks, 3, 1, 0);
+    test(&srv, "request_size tail", url, "request_size=6000",
+         (const int[]){ 15000, 5000 }, 1, 1, 0);
+    test(&srv, "connection_pool", url, "connection_pool=1", whole, 1, 3, 1);
+    test_readahead(&srv, "readahead_blocks seeks", url,
+                   "readahead_blocks=4", back, 5);
+    test_readahead(&srv, "readahead_blocks request_size seeks", url,
+                   "readahead_blocks=4:request_size=4096", back, 5);
+
+    pthread_mutex_lock(&srv.mutex);
+    srv.stop = 1;
+    pthread_mutex_unlock(&srv.mutex);
+    pthread_join(thread, NULL);
+    open = srv.nb_open;
+    printf("connections left open: %d\n", open);
+
+    closesocket(srv.listen_fd);
+    pthread_mutex_destroy(&srv.mutex);
+    ff_network_close();
+    return 0;
+}
@@ -0,0 +1,164 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Download segments given as data: URIs, which have no known size, to check
+ * the reading of a segment during its download and the memory accounting
+ * used by the prefetch_segments and prefetch_fragments demuxer options.
+ */
+
+#include <stdio.h>
+
+#include "libavutil/base64.h"
+#include "libavformat/segment_prefetch.c"
+
+#define KB 1024
+
+static uint8_t data_byte(int i)
+{
+    return (i * 7 + i / 251) & 0xff;
+}
+
+static char *data_uri(int size)
+{
+    static const char prefix[] = "data:application/octet-stream;base64,";
+    uint8_t *data = av_malloc(size);
+    char *uri = av_malloc(sizeof(prefix) + AV_BASE64_SIZE(size));
+
+    if (!data || !uri) {
+        av_free(data);
+        av_free(uri);
+        return NULL;
+    }
+    for (int i = 0; i < size; i++)
+        data[i] = data_byte(i);
+    memcpy(uri, prefix, sizeof(prefix));
+    av_base64_encode(uri + sizeof(prefix) - 1, AV_BASE64_SIZE(size), data, size);
+    av_free(data);
+    return uri;
+}
+
+static int64_t used(FFSegmentPrefetch *p)
+{
+    int64_t ret;
+
+    pthread_mutex_lock(&p->mutex);
+    ret = p->used;
+    pthread_mutex_unlock(&p->mutex);
+    return ret;
+}
+
+/* wait for the end of all the downloads */
+static void wait_done(FFSegmentPrefetch *p)
+{
+    pthread_mutex_lock(&p->mutex);
+    for (int i = 0; i < p->nb_jobs; i++)
+        while (p->jobs[i].active && !p->jobs[i].done)
+            pthread_cond_wait(&p->cond, &p->mutex);
+    pthread_mutex_unlock(&p->mutex);
+}
+
+/* read the taken segment and compare it, checking the memory limit */
+static int read_segment(FFSegmentPrefetch *p, int size)
+{
+    uint8_t buf[10000];
+    int pos = 0, ret;
+
+    while ((ret = ff_segment_prefetch_read(p, buf, sizeof(buf))) > 0) {
+        for (int i = 0; i < ret; i++)
+            if (buf[i] != data_byte(pos + i))
+                return -1;
+        pos += ret;
+        if (used(p) > p->max_size)
+            return -1;
+    }
+    return ret == AVERROR_EOF && pos == size ? 0 : -1;
+}
+
+static void test(AVFormatContext *s, const char *name, int64_t max_size,
+                 int size, int nb_segments)
+{
+    FFSegmentPrefetch *p = NULL;
+    char *uri = data_uri(size);
+    int ret;
+
+    if (!uri || ff_segment_prefetch_alloc(&p, s, nb_segments, max_size) < 0)
+        goto end;
+    for (int i = 1; i <= nb_segments; i++)
+        ff_segment_prefetch_start(p, i, uri, 0, -1, NULL);
+
+    /* the segments before the one taken are cancelled */
+    if (!ff_segment_prefetch_take(p, nb_segments, uri)) {
+        printf("%s: not prefetched\n", name);
+        goto end;
+    }
+    ret = read_segment(p, size);
+    printf("%s: %s, accounted %d", name, ret < 0 ? "failed" : "ok", used(p) > 0);
+    ff_segment_prefetch_release(p);
+    printf(", after release %"PRId64"\n", used(p));
+
+end:
+    ff_segment_prefetch_free(&p);
+    av_free(uri);
+}
+
+/* the segment being read keeps its memory until it is released */
+static void test_accounting(AVFormatContext *s)
+{
+    FFSegmentPrefetch *p = NULL;
+    char *uri = data_uri(768 * KB);
+    int ret;
+
+    if (!uri || ff_segment_prefetch_alloc(&p, s, 2, 1024 * KB) < 0)
+        goto end;
+
+    ff_segment_prefetch_start(p, 1, uri, 0, -1, NULL);
+    ff_segment_prefetch_take(p, 1, uri);
+    wait_done(p);
+    ff_segment_prefetch_start(p, 2, uri, 0, -1, NULL);
+    wait_done(p);
+    ret = ff_segment_prefetch_take(p, 2, uri);
+    printf("accounting: prefetched while the previous segment is read %d", ret);
+
+    /* nothing is taken anymore */
+    ff_segment_prefetch_start(p, 3, uri, 0, -1, NULL);
+    wait_done(p);
+    ret = ff_segment_prefetch_take(p, 3, uri);
+    printf(", after its release %d\n", ret);
+
+end:
+    ff_segment_prefetch_free(&p);
+    av_free(uri);
+}
+
+int main(void)
+{
+    AVFormatContext *s = avformat_alloc_context();
+
+    if (!s)
+        return 1;
+
+    test(s, "whole segment", 4096 * KB, 1000 * KB, 1);
+    test(s, "memory limit", 512 * KB, 3000 * KB, 1);
+    test(s, "skipped segments", 4096 * KB, 300 * KB, 3);
+    test(s, "small limit", 16 * KB, 300 * KB, 1);
+    test_accounting(s);
+
+    avformat_free_context(s);
+    return 0;
+}
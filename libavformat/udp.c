@@ -26,6 +26,7 @@
 
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+#define _GNU_SOURCE     /* Needed for recvmmsg() and sendmmsg() with glibc */
 
 #include "avformat.h"
 #include "libavutil/avassert.h"
@@ -77,6 +78,8 @@
 #define UDP_RX_BUF_SIZE 393216
 #define UDP_MAX_PKT_SIZE 65536
 #define UDP_HEADER_SIZE 8
+#define UDP_DEFAULT_BATCH_SIZE 32
+#define UDP_MAX_BATCH_SIZE 1024
 
 typedef struct UDPContext {
     const AVClass *class;
@@ -115,6 +118,25 @@ typedef struct UDPContext {
     char *sources;
     char *block;
     IPSourceFilters filters;
+
+    int batch_size;             ///< max number of datagrams per system call
+#if HAVE_RECVMMSG
+    struct mmsghdr *rx_msgs;
+    struct iovec *rx_iov;
+    struct sockaddr_storage *rx_addrs;
+    uint8_t *rx_buf;
+    int rx_msg_size;            ///< size of the buffer of each datagram of the batch
+    int rx_grow;                ///< a datagram was truncated, grow the buffers
+    int rx_nb_msgs;             ///< number of datagrams in the last received batch
+    int rx_msg_idx;             ///< next datagram of the batch returned by udp_read()
+#endif
+    uint8_t *tx_buf;            ///< packets sent together by the tx thread
+    int tx_buf_size;
+    int *tx_lens;
+#if HAVE_SENDMMSG
+    struct mmsghdr *tx_msgs;
+    struct iovec *tx_iov;
+#endif
 } UDPContext;
 
 #define OFFSET(x) offsetof(UDPContext, x)
@@ -139,6 +161,7 @@ static const AVOption options[] = {
     { "timeout",        "set raise error timeout, in microseconds (only in read mode)",OFFSET(timeout),         AV_OPT_TYPE_INT,  {.i64 = 0}, 0, INT_MAX, D },
     { "sources",        "Source list",                                     OFFSET(sources),        AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",          "Block list",                                      OFFSET(block),          AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
+    { "batch_size",     "Max number of datagrams received or sent per system call", OFFSET(batch_size), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, UDP_MAX_BATCH_SIZE, .flags = D|E },
     { NULL }
 };
 
@@ -478,6 +501,101 @@ static int udp_get_file_handle(URLContext *h)
     return s->udp_fd;
 }
 
+static void udp_free_batches(UDPContext *s)
+{
+#if HAVE_RECVMMSG
+    av_freep(&s->rx_msgs);
+    av_freep(&s->rx_iov);
+    av_freep(&s->rx_addrs);
+    av_freep(&s->rx_buf);
+#endif
+#if HAVE_SENDMMSG
+    av_freep(&s->tx_msgs);
+    av_freep(&s->tx_iov);
+#endif
+    av_freep(&s->tx_buf);
+    av_freep(&s->tx_lens);
+}
+
+#if HAVE_RECVMMSG
+/**
+ * Allocate the receive batch with msg_size bytes per datagram.
+ */
+static int udp_alloc_rx_batch(UDPContext *s, int msg_size)
+{
+    av_freep(&s->rx_buf);
+    if (!s->rx_msgs) {
+        s->rx_msgs  = av_calloc(s->batch_size, sizeof(*s->rx_msgs));
+        s->rx_iov   = av_calloc(s->batch_size, sizeof(*s->rx_iov));
+        s->rx_addrs = av_calloc(s->batch_size, sizeof(*s->rx_addrs));
+    }
+    s->rx_buf = av_malloc_array(s->batch_size, msg_size);
+    if (!s->rx_msgs || !s->rx_iov || !s->rx_addrs || !s->rx_buf)
+        return AVERROR(ENOMEM);
+    s->rx_msg_size = msg_size;
+
+    for (int i = 0; i < s->batch_size; i++) {
+        s->rx_iov[i].iov_base = s->rx_buf + i * msg_size;
+        s->rx_iov[i].iov_len  = msg_size;
+        s->rx_msgs[i].msg_hdr.msg_name   = &s->rx_addrs[i];
+        s->rx_msgs[i].msg_hdr.msg_iov    = &s->rx_iov[i];
+        s->rx_msgs[i].msg_hdr.msg_iovlen = 1;
+    }
+    return 0;
+}
+
+/**
+ * Receive up to batch_size datagrams with a single system call.
+ *
+ * If recvmmsg() turns out not to be supported by the kernel, batching is
+ * disabled and AVERROR(EAGAIN) is returned, so that the caller retries with
+ * recvfrom().
+ *
+ * @return the number of datagrams received or a negative error code
+ */
+static int udp_recv_batch(URLContext *h, int flags)
+{
+    UDPContext *s = h->priv_data;
+    int ret;
+
+    for (int i = 0; i < s->batch_size; i++)
+        s->rx_msgs[i].msg_hdr.msg_namelen = sizeof(s->rx_addrs[i]);
+
+    ret = recvmmsg(s->udp_fd, s->rx_msgs, s->batch_size, flags, NULL);
+    if (ret < 0) {
+        ret = ff_neterrno();
+        if (ret == AVERROR(ENOSYS)) {
+            av_log(h, AV_LOG_VERBOSE, "recvmmsg() not supported, "
+                   "receiving one datagram per call\n");
+            s->batch_size = 1;
+            ret = AVERROR(EAGAIN);
+        }
+        return ret;
+    }
+
+    if (s->rx_msg_size < UDP_MAX_PKT_SIZE)
+        for (int i = 0; i < ret; i++)
+            if (s->rx_msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+                s->rx_grow = 1;
+    return ret;
+}
+
+/**
+ * The buffers are sized after pkt_size. Once a bigger datagram has been
+ * truncated, grow them to the largest datagram size. This must only be
+ * called after all the datagrams of the last batch have been consumed.
+ */
+static int udp_grow_rx_batch(URLContext *h)
+{
+    UDPContext *s = h->priv_data;
+
+    av_log(h, AV_LOG_WARNING, "Datagram larger than pkt_size (%d) truncated, "
+           "increase pkt_size to avoid this\n", s->rx_msg_size);
+    s->rx_grow = 0;
+    return udp_alloc_rx_batch(s, UDP_MAX_PKT_SIZE);
+}
+#endif
+
 #if HAVE_PTHREAD_CANCEL
 static void *circular_buffer_task_rx( void *_URLContext)
 {
@@ -495,7 +613,7 @@ static void *circular_buffer_task_rx( void *_URLContext)
         goto end;
     }
     while(1) {
-        int len;
+        int len, nb_msgs;
         struct sockaddr_storage addr;
         socklen_t addr_len = sizeof(addr);
 
@@ -504,35 +622,65 @@ static void *circular_buffer_task_rx( void *_URLContext)
            see "General Information" / "Thread Cancelation Overview"
            in Single Unix. */
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
-        len = recvfrom(s->udp_fd, s->tmp+4, sizeof(s->tmp)-4, 0, (struct sockaddr *)&addr, &addr_len);
+#if HAVE_RECVMMSG
+        if (s->batch_size > 1) {
+            /* wait for one datagram, then take all the queued ones */
+            nb_msgs = udp_recv_batch(h, MSG_WAITFORONE);
+        } else
+#endif
+        {
+            len = recvfrom(s->udp_fd, s->tmp+4, sizeof(s->tmp)-4, 0, (struct sockaddr *)&addr, &addr_len);
+            nb_msgs = len < 0 ? ff_neterrno() : 1;
+        }
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
         pthread_mutex_lock(&s->mutex);
-        if (len < 0) {
-            if (ff_neterrno() != AVERROR(EAGAIN) && ff_neterrno() != AVERROR(EINTR)) {
-                s->circular_buffer_error = ff_neterrno();
+        if (nb_msgs < 0) {
+            if (nb_msgs != AVERROR(EAGAIN) && nb_msgs != AVERROR(EINTR)) {
+                s->circular_buffer_error = nb_msgs;
                 goto end;
             }
             continue;
         }
-        if (ff_ip_check_source_lists(&addr, &s->filters))
-            continue;
-        AV_WL32(s->tmp, len);
 
-        if (av_fifo_can_write(s->fifo) < len + 4) {
-            /* No Space left */
-            if (s->overrun_nonfatal) {
-                av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
-                        "Surviving due to overrun_nonfatal option\n");
+        for (int i = 0; i < nb_msgs; i++) {
+            struct sockaddr_storage *src_addr = &addr;
+            const uint8_t *data = s->tmp + 4;
+            uint8_t tmp[4];
+
+#if HAVE_RECVMMSG
+            if (s->batch_size > 1) {
+                src_addr = &s->rx_addrs[i];
+                data     = s->rx_iov[i].iov_base;
+                len      = s->rx_msgs[i].msg_len;
+            }
+#endif
+            if (ff_ip_check_source_lists(src_addr, &s->filters))
                 continue;
-            } else {
-                av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
-                        "To avoid, increase fifo_size URL option. "
-                        "To survive in such case, use overrun_nonfatal option\n");
-                s->circular_buffer_error = AVERROR(EIO);
-                goto end;
+            AV_WL32(tmp, len);
+
+            if (av_fifo_can_write(s->fifo) < len + 4) {
+                /* No Space left */
+                if (s->overrun_nonfatal) {
+                    av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
+                            "Surviving due to overrun_nonfatal option\n");
+                    continue;
+                } else {
+                    av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
+                            "To avoid, increase fifo_size URL option. "
+                            "To survive in such case, use overrun_nonfatal option\n");
+                    s->circular_buffer_error = AVERROR(EIO);
+                    goto end;
+                }
             }
+            av_fifo_write(s->fifo, tmp, 4);
+            av_fifo_write(s->fifo, data, len);
         }
-        av_fifo_write(s->fifo, s->tmp, len + 4);
+#if HAVE_RECVMMSG
+        if (s->rx_grow && (nb_msgs = udp_grow_rx_batch(h)) < 0) {
+            s->circular_buffer_error = nb_msgs;
+            goto end;
+        }
+#endif
         pthread_cond_signal(&s->cond);
     }
 
@@ -542,6 +690,83 @@ end:
     return NULL;
 }
 
+/**
+ * Send nb_pkts packets stored back to back in buf.
+ *
+ * @return 0 on success or a negative error code
+ */
+static int udp_send_packets(URLContext *h, const uint8_t *buf,
+                            const int *lens, int nb_pkts)
+{
+    UDPContext *s = h->priv_data;
+    int ret;
+
+#if HAVE_SENDMMSG
+    if (nb_pkts > 1) {
+        struct mmsghdr *msgs = s->tx_msgs;
+        struct iovec *iov = s->tx_iov;
+        const uint8_t *p = buf;
+
+        for (int i = 0; i < nb_pkts; i++) {
+            iov[i].iov_base = (void *)p;
+            iov[i].iov_len  = lens[i];
+            msgs[i].msg_hdr = (struct msghdr) {
+                .msg_name    = s->is_connected ? NULL : &s->dest_addr,
+                .msg_namelen = s->is_connected ? 0    : s->dest_addr_len,
+                .msg_iov     = &iov[i],
+                .msg_iovlen  = 1,
+            };
+            p += lens[i];
+        }
+
+        for (int i = 0; i < nb_pkts;) {
+            ret = sendmmsg(s->udp_fd, msgs + i, nb_pkts - i, 0);
+            if (ret >= 0) {
+                i += ret;
+                continue;
+            }
+            ret = ff_neterrno();
+            if (ret == AVERROR(ENOSYS)) {
+                av_log(h, AV_LOG_VERBOSE, "sendmmsg() not supported, "
+                       "sending one datagram per call\n");
+                s->batch_size = 1;
+                for (; i < nb_pkts; i++)
+                    if ((ret = udp_send_packets(h, msgs[i].msg_hdr.msg_iov->iov_base,
+                                                &lens[i], 1)) < 0)
+                        return ret;
+                return 0;
+            }
+            if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR))
+                return ret;
+        }
+        return 0;
+    }
+#endif
+
+    for (int i = 0; i < nb_pkts; i++) {
+        int len = lens[i];
+
+        while (len) {
+            av_assert0(len > 0);
+            if (!s->is_connected) {
+                ret = sendto (s->udp_fd, buf, len, 0,
+                            (struct sockaddr *) &s->dest_addr,
+                            s->dest_addr_len);
+            } else
+                ret = send(s->udp_fd, buf, len, 0);
+            if (ret >= 0) {
+                len -= ret;
+                buf += ret;
+            } else {
+                ret = ff_neterrno();
+                if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR))
+                    return ret;
+            }
+        }
+    }
+    return 0;
+}
+
 static void *circular_buffer_task_tx( void *_URLContext)
 {
     URLContext *h = _URLContext;
@@ -563,72 +788,66 @@ static void *circular_buffer_task_tx( void *_URLContext)
     }
 
     for(;;) {
-        int len;
-        const uint8_t *p;
+        int len, ret, nb_pkts = 0, size = 0;
         uint8_t tmp[4];
-        int64_t timestamp;
-
-        len = av_fifo_can_read(s->fifo);
+        int64_t timestamp, delay = 0;
 
-        while (len<4) {
+        while (av_fifo_can_read(s->fifo) < 4) {
             if (s->close_req)
                 goto end;
             pthread_cond_wait(&s->cond, &s->mutex);
-            len = av_fifo_can_read(s->fifo);
         }
 
-        av_fifo_read(s->fifo, tmp, 4);
-        len = AV_RL32(tmp);
-
-        av_assert0(len >= 0);
-        av_assert0(len <= sizeof(s->tmp));
+        /* Take the first queued packet and the following ones which are
+         * already due, so that they are sent with a single system call. */
+        do {
+            av_fifo_peek(s->fifo, tmp, 4, 0);
+            len = AV_RL32(tmp);
+
+            av_assert0(len >= 0);
+            av_assert0(len <= sizeof(s->tmp));
+
+            if (nb_pkts && size + len > s->tx_buf_size)
+                break;
+
+            if (s->bitrate) {
+                timestamp = av_gettime_relative();
+                if (timestamp < target_timestamp) {
+                    if (nb_pkts)
+                        break;
+                    delay = target_timestamp - timestamp;
+                    if (delay > max_delay) {
+                        delay = max_delay;
+                        start_timestamp = timestamp + delay;
+                        sent_bits = 0;
+                    }
+                } else {
+                    if (timestamp - burst_interval > target_timestamp) {
+                        start_timestamp = timestamp - burst_interval;
+                        sent_bits = 0;
+                    }
+                }
+                sent_bits += len * 8;
+                target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
+            }
 
-        av_fifo_read(s->fifo, s->tmp, len);
+            av_fifo_drain2(s->fifo, 4);
+            av_fifo_read(s->fifo, s->tx_buf + size, len);
+            s->tx_lens[nb_pkts++] = len;
+            size += len;
+        } while (nb_pkts < s->batch_size && av_fifo_can_read(s->fifo) >= 4);
 
         pthread_mutex_unlock(&s->mutex);
 
-        if (s->bitrate) {
-            timestamp = av_gettime_relative();
-            if (timestamp < target_timestamp) {
-                int64_t delay = target_timestamp - timestamp;
-                if (delay > max_delay) {
-                    delay = max_delay;
-                    start_timestamp = timestamp + delay;
-                    sent_bits = 0;
-                }
-                av_usleep(delay);
-            } else {
-                if (timestamp - burst_interval > target_timestamp) {
-                    start_timestamp = timestamp - burst_interval;
-                    sent_bits = 0;
-                }
-            }
-            sent_bits += len * 8;
-            target_timestamp = start_timestamp + sent_bits * 1000000 / s->bitrate;
-        }
+        if (delay)
+            av_usleep(delay);
 
-        p = s->tmp;
-        while (len) {
-            int ret;
-            av_assert0(len > 0);
-            if (!s->is_connected) {
-                ret = sendto (s->udp_fd, p, len, 0,
-                            (struct sockaddr *) &s->dest_addr,
-                            s->dest_addr_len);
-            } else
-                ret = send(s->udp_fd, p, len, 0);
-            if (ret >= 0) {
-                len -= ret;
-                p   += ret;
-            } else {
-                ret = ff_neterrno();
-                if (ret != AVERROR(EAGAIN) && ret != AVERROR(EINTR)) {
-                    pthread_mutex_lock(&s->mutex);
-                    s->circular_buffer_error = ret;
-                    pthread_mutex_unlock(&s->mutex);
-                    return NULL;
-                }
-            }
+        ret = udp_send_packets(h, s->tx_buf, s->tx_lens, nb_pkts);
+        if (ret < 0) {
+            pthread_mutex_lock(&s->mutex);
+            s->circular_buffer_error = ret;
+            pthread_mutex_unlock(&s->mutex);
+            return NULL;
         }
 
         pthread_mutex_lock(&s->mutex);
@@ -755,9 +974,24 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             s->timeout = strtol(buf, NULL, 10);
         if (is_output && av_find_info_tag(buf, sizeof(buf), "broadcast", p))
             s->is_broadcast = strtol(buf, NULL, 10);
+        if (av_find_info_tag(buf, sizeof(buf), "batch_size", p)) {
+            s->batch_size = strtol(buf, NULL, 10);
+            if (s->batch_size < 1 || s->batch_size > UDP_MAX_BATCH_SIZE) {
+                av_log(h, AV_LOG_ERROR, "batch_size(%d) should be in range [1,%d]\n",
+                       s->batch_size, UDP_MAX_BATCH_SIZE);
+                ret = AVERROR(EINVAL);
+                goto fail;
+            }
+        }
     }
     /* handling needed to support options picking from both AVOption and URL */
     s->circular_buffer_size *= 188;
+    /* Only batch by default when the socket is read by the circular buffer
+     * thread: callers of udp_read() may poll the socket, which does not see
+     * the datagrams already received in a batch. */
+    if (s->batch_size < 0)
+        s->batch_size = s->circular_buffer_size && HAVE_PTHREAD_CANCEL ?
+                        UDP_DEFAULT_BATCH_SIZE : 1;
     if (flags & AVIO_FLAG_WRITE) {
         h->max_packet_size = s->pkt_size;
     } else {
@@ -921,6 +1155,16 @@ static int udp_open(URLContext *h, const char *uri, int flags)
 
     s->udp_fd = udp_fd;
 
+#if HAVE_RECVMMSG
+    if (!is_output && s->batch_size > 1) {
+        /* the buffers are grown if bigger datagrams are received */
+        int msg_size = s->pkt_size > 0 ? FFMIN(s->pkt_size, UDP_MAX_PKT_SIZE)
+                                       : UDP_MAX_PKT_SIZE;
+        if ((ret = udp_alloc_rx_batch(s, msg_size)) < 0)
+            goto fail;
+    }
+#endif
+
 #if HAVE_PTHREAD_CANCEL
     /*
       Create thread in case of:
@@ -940,6 +1184,26 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             ret = AVERROR(ENOMEM);
             goto fail;
         }
+        if (is_output) {
+            /* room for a batch of packets of the configured size,
+             * and for at least one of the largest possible size */
+            s->tx_buf_size = FFMAX(sizeof(s->tmp),
+                                   s->batch_size * av_clip(s->pkt_size, 0, UDP_MAX_PKT_SIZE));
+            s->tx_buf  = av_malloc(s->tx_buf_size);
+            s->tx_lens = av_calloc(s->batch_size, sizeof(*s->tx_lens));
+            if (!s->tx_buf || !s->tx_lens) {
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
+#if HAVE_SENDMMSG
+            s->tx_msgs = av_calloc(s->batch_size, sizeof(*s->tx_msgs));
+            s->tx_iov  = av_calloc(s->batch_size, sizeof(*s->tx_iov));
+            if (!s->tx_msgs || !s->tx_iov) {
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
+#endif
+        }
         ret = pthread_mutex_init(&s->mutex, NULL);
         if (ret != 0) {
             av_log(h, AV_LOG_ERROR, "pthread_mutex_init failed : %s\n", strerror(ret));
@@ -974,6 +1238,7 @@ static int udp_open(URLContext *h, const char *uri, int flags)
         closesocket(udp_fd);
     av_fifo_freep2(&s->fifo);
     ff_ip_reset_filters(&s->filters);
+    udp_free_batches(s);
     return ret;
 }
 
@@ -1038,6 +1303,34 @@ static int udp_read(URLContext *h, uint8_t *buf, int size)
     }
 #endif
 
+#if HAVE_RECVMMSG
+    if (s->batch_size > 1) {
+        const struct mmsghdr *msg;
+
+        if (s->rx_msg_idx >= s->rx_nb_msgs) {
+            if (s->rx_grow && (ret = udp_grow_rx_batch(h)) < 0)
+                return ret;
+            if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
+                ret = ff_network_wait_fd(s->udp_fd, 0);
+                if (ret < 0)
+                    return ret;
+            }
+            ret = udp_recv_batch(h, 0);
+            if (ret < 0)
+                return ret;
+            s->rx_nb_msgs = ret;
+            s->rx_msg_idx = 0;
+        }
+
+        msg = &s->rx_msgs[s->rx_msg_idx++];
+        if (ff_ip_check_source_lists(msg->msg_hdr.msg_name, &s->filters))
+            return AVERROR(EINTR);
+        ret = FFMIN(msg->msg_len, size);
+        memcpy(buf, msg->msg_hdr.msg_iov->iov_base, ret);
+        return ret;
+    }
+#endif
+
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd(s->udp_fd, 0);
         if (ret < 0)
@@ -1143,6 +1436,7 @@ static int udp_close(URLContext *h)
     closesocket(s->udp_fd);
     av_fifo_freep2(&s->fifo);
     ff_ip_reset_filters(&s->filters);
+    udp_free_batches(s);
     return 0;
 }
 
@@ -24,6 +24,8 @@
 #ifndef AVFORMAT_URL_H
 #define AVFORMAT_URL_H
 
+#include <stdatomic.h>
+
 #include "avio.h"
 
 #include "libavutil/dict.h"
@@ -46,6 +48,10 @@ typedef struct URLContext {
     const char *protocol_whitelist;
     const char *protocol_blacklist;
     int min_packet_size;        /**< if non zero, the stream is packetized with this min packet size */
+    int readahead_blocks;       /**< number of blocks read ahead in a background thread by the AVIOContext */
+    AVIOInterruptCB readahead_interrupt_callback; /**< callback of the caller, when interrupt_callback is wrapped for read-ahead */
+    atomic_int readahead_abort; /**< set to interrupt the read-ahead thread blocked in the protocol */
+    int max_io_buffer_size;     /**< size the AVIOContext read buffer may grow to on sequential access */
 } URLContext;
 
 typedef struct URLProtocol {
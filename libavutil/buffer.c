@@ -16,10 +16,22 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#define _DEFAULT_SOURCE /* for MADV_HUGEPAGE, MAP_ANONYMOUS and syscall() */
+
 #include <stdatomic.h>
 #include <stdint.h>
 #include <string.h>
 
+#include "config.h"
+
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
+#if HAVE_MADVISE && defined(__linux__)
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
 #include "avassert.h"
 #include "buffer_internal.h"
 #include "common.h"
@@ -38,6 +50,7 @@ static AVBufferRef *buffer_create(AVBuffer *buf, uint8_t *data, size_t size,
     buf->opaque   = opaque;
 
     atomic_init(&buf->refcount, 1);
+    atomic_init(&buf->account, 0);
 
     buf->flags = flags;
 
@@ -100,6 +113,144 @@ AVBufferRef *av_buffer_allocz(size_t size)
     return ret;
 }
 
+#if HAVE_MMAP && defined(MAP_ANONYMOUS)
+#define HUGEPAGE_SIZE (2 << 20)
+
+/* place the pages of a mapping on the NUMA node the calling thread runs on
+ * now; they are not migrated when the buffer is used from other nodes later */
+static void bind_to_local_node(void *data, size_t size)
+{
+#if HAVE_MADVISE && defined(__linux__) && defined(SYS_getcpu) && defined(SYS_mbind)
+    /* MPOL_PREFERRED from linux/mempolicy.h, falls back to other nodes
+     * when the preferred one is out of memory */
+    const int mpol_preferred = 1;
+    unsigned cpu, node;
+    unsigned long nodemask;
+
+    if (syscall(SYS_getcpu, &cpu, &node, NULL) < 0 || node >= sizeof(nodemask) * 8)
+        return;
+    nodemask = 1UL << node;
+    syscall(SYS_mbind, data, size, mpol_preferred, &nodemask,
+            sizeof(nodemask) * 8 + 1, 0);
+#endif
+}
+
+static void buffer_hugepages_free(void *opaque, uint8_t *data)
+{
+    munmap(data, (size_t)(uintptr_t)opaque);
+}
+#endif
+
+AVBufferRef *av_buffer_alloc_hugepages(size_t size)
+{
+#if HAVE_MMAP && defined(MAP_ANONYMOUS)
+    AVBufferRef *ret;
+    uint8_t *map, *data;
+    size_t len;
+
+    /* smaller buffers would waste too much of their only huge page */
+    if (size < HUGEPAGE_SIZE - HUGEPAGE_SIZE / 8)
+        return av_buffer_allocz(size);
+
+    len = FFALIGN(size, HUGEPAGE_SIZE);
+    if (len < size || len > SIZE_MAX - HUGEPAGE_SIZE)
+        return NULL;
+
+    /* round up to whole huge pages only when that wastes less than 1/8 of
+     * the mapping, otherwise the part after the last whole huge page is
+     * backed by normal pages */
+    if (len - size > len / 8) {
+        long page_size = sysconf(_SC_PAGESIZE);
+        len = FFALIGN(size, page_size > 0 ? page_size : 4096);
+    }
+
+    /* over-allocate and trim the mapping, so that it starts on a huge page
+     * boundary and can be backed by huge pages entirely */
+    map = mmap(NULL, len + HUGEPAGE_SIZE, PROT_READ | PROT_WRITE,
+               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (map == MAP_FAILED)
+        return av_buffer_allocz(size);
+    data = (uint8_t *)FFALIGN((uintptr_t)map, HUGEPAGE_SIZE);
+    if (data > map)
+        munmap(map, data - map);
+    munmap(data + len, map + HUGEPAGE_SIZE - data);
+
+#if HAVE_MADVISE && defined(MADV_HUGEPAGE)
+    madvise(data, len, MADV_HUGEPAGE);
+#endif
+    bind_to_local_node(data, len);
+
+    ret = av_buffer_create(data, size, buffer_hugepages_free,
+                           (void *)(uintptr_t)len, 0);
+    if (!ret)
+        munmap(data, len);
+    return ret;
+#else
+    return av_buffer_allocz(size);
+#endif
+}
+
+AVBufferAccount *av_buffer_account_alloc(void)
+{
+    AVBufferAccount *account = av_mallocz(sizeof(*account));
+    if (!account)
+        return NULL;
+
+    atomic_init(&account->refcount, 1);
+    atomic_init(&account->live, 0);
+    atomic_init(&account->peak, 0);
+
+    return account;
+}
+
+AVBufferAccount *av_buffer_account_ref(AVBufferAccount *account)
+{
+    atomic_fetch_add_explicit(&account->refcount, 1, memory_order_relaxed);
+    return account;
+}
+
+void av_buffer_account_unref(AVBufferAccount **paccount)
+{
+    AVBufferAccount *account = *paccount;
+
+    if (!account)
+        return;
+    *paccount = NULL;
+
+    if (atomic_fetch_sub_explicit(&account->refcount, 1, memory_order_acq_rel) == 1)
+        av_free(account);
+}
+
+void av_buffer_account_get(const AVBufferAccount *account,
+                           int64_t *live, int64_t *peak)
+{
+    AVBufferAccount *a = (AVBufferAccount *)account;
+
+    if (live)
+        *live = atomic_load_explicit(&a->live, memory_order_relaxed);
+    if (peak)
+        *peak = atomic_load_explicit(&a->peak, memory_order_relaxed);
+}
+
+static void account_update(AVBufferAccount *account, int64_t delta)
+{
+    int64_t live = atomic_fetch_add_explicit(&account->live, delta,
+                                             memory_order_relaxed) + delta;
+    int64_t peak = atomic_load_explicit(&account->peak, memory_order_relaxed);
+
+    while (live > peak &&
+           !atomic_compare_exchange_weak_explicit(&account->peak, &peak, live,
+                                                  memory_order_relaxed,
+                                                  memory_order_relaxed))
+        ;
+}
+
+static AVBufferAccount *buffer_get_account(const AVBuffer *b)
+{
+    return (AVBufferAccount *)atomic_load_explicit(&((AVBuffer *)b)->account,
+                                                   memory_order_relaxed);
+}
+
 AVBufferRef *av_buffer_ref(const AVBufferRef *buf)
 {
     AVBufferRef *ret = av_mallocz(sizeof(*ret));
@@ -130,9 +281,17 @@ static void buffer_replace(AVBufferRef **dst, AVBufferRef **src)
         /* b->free below might already free the structure containing *b,
          * so we have to read the flag now to avoid use-after-free. */
         int free_avbuffer = !(b->flags_internal & BUFFER_FLAG_NO_FREE);
+        AVBufferAccount *account = buffer_get_account(b);
+        size_t size = b->size;
+
         b->free(b->opaque, b->data);
         if (free_avbuffer)
             av_free(b);
+
+        if (account) {
+            account_update(account, -(int64_t)size);
+            av_buffer_account_unref(&account);
+        }
     }
 }
 
@@ -174,6 +333,7 @@ int av_buffer_make_writable(AVBufferRef **pbuf)
         return AVERROR(ENOMEM);
 
     memcpy(newbuf->data, buf->data, buf->size);
+    av_buffer_account_add(newbuf, buffer_get_account(buf->buffer));
 
     buffer_replace(pbuf, &newbuf);
 
@@ -183,6 +343,7 @@ int av_buffer_make_writable(AVBufferRef **pbuf)
 int av_buffer_realloc(AVBufferRef **pbuf, size_t size)
 {
     AVBufferRef *buf = *pbuf;
+    AVBufferAccount *account;
     uint8_t *tmp;
     int ret;
 
@@ -216,6 +377,7 @@ int av_buffer_realloc(AVBufferRef **pbuf, size_t size)
             return ret;
 
         memcpy(new->data, buf->data, FFMIN(size, buf->size));
+        av_buffer_account_add(new, buffer_get_account(buf->buffer));
 
         buffer_replace(pbuf, &new);
         return 0;
@@ -225,6 +387,10 @@ int av_buffer_realloc(AVBufferRef **pbuf, size_t size)
     if (!tmp)
         return AVERROR(ENOMEM);
 
+    account = buffer_get_account(buf->buffer);
+    if (account)
+        account_update(account, (int64_t)size - (int64_t)buf->buffer->size);
+
     buf->buffer->data = buf->data = tmp;
     buf->buffer->size = buf->size = size;
     return 0;
@@ -293,14 +459,29 @@ AVBufferPool *av_buffer_pool_init(size_t size, AVBufferRef* (*alloc)(size_t size
     return pool;
 }
 
+static void pool_free_entry(AVBufferPool *pool, BufferPoolEntry *buf)
+{
+    buf->free(buf->opaque, buf->data);
+    av_free(buf);
+
+    if (pool->account)
+        account_update(pool->account, -(int64_t)pool->size);
+}
+
 static void buffer_pool_flush(AVBufferPool *pool)
 {
+    for (int i = 0; i < BUFFER_POOL_CACHE_SIZE; i++) {
+        BufferPoolEntry *buf = (BufferPoolEntry *)
+            atomic_exchange_explicit(&pool->cache[i], 0, memory_order_acquire);
+        if (buf)
+            pool_free_entry(pool, buf);
+    }
+
     while (pool->pool) {
         BufferPoolEntry *buf = pool->pool;
         pool->pool = buf->next;
 
-        buf->free(buf->opaque, buf->data);
-        av_freep(&buf);
+        pool_free_entry(pool, buf);
     }
 }
 
@@ -312,6 +493,7 @@ static void buffer_pool_free(AVBufferPool *pool)
 {
     buffer_pool_flush(pool);
     ff_mutex_destroy(&pool->mutex);
+    av_buffer_account_unref(&pool->account);
 
     if (pool->pool_free)
         pool->pool_free(pool->opaque);
@@ -336,15 +518,52 @@ void av_buffer_pool_uninit(AVBufferPool **ppool)
         buffer_pool_free(pool);
 }
 
-static void pool_release_buffer(void *opaque, uint8_t *data)
+static BufferPoolEntry *pool_cache_get(AVBufferPool *pool)
 {
-    BufferPoolEntry *buf = opaque;
-    AVBufferPool *pool = buf->pool;
+    for (int i = 0; i < BUFFER_POOL_CACHE_SIZE; i++) {
+        if (atomic_load_explicit(&pool->cache[i], memory_order_relaxed)) {
+            BufferPoolEntry *buf = (BufferPoolEntry *)
+                atomic_exchange_explicit(&pool->cache[i], 0, memory_order_acquire);
+            if (buf)
+                return buf;
+        }
+    }
+    return NULL;
+}
+
+static int pool_cache_put(AVBufferPool *pool, BufferPoolEntry *buf)
+{
+    for (int i = 0; i < BUFFER_POOL_CACHE_SIZE; i++) {
+        uintptr_t expected = 0;
+        if (!atomic_load_explicit(&pool->cache[i], memory_order_relaxed) &&
+            atomic_compare_exchange_strong_explicit(&pool->cache[i], &expected,
+                                                    (uintptr_t)buf,
+                                                    memory_order_release,
+                                                    memory_order_relaxed))
+            return 1;
+    }
+    return 0;
+}
+
+/* return a free entry to the pool, preferably without taking the mutex */
+static void pool_put_entry(AVBufferPool *pool, BufferPoolEntry *buf)
+{
+    if (pool_cache_put(pool, buf))
+        return;
 
     ff_mutex_lock(&pool->mutex);
     buf->next = pool->pool;
     pool->pool = buf;
     ff_mutex_unlock(&pool->mutex);
+    atomic_fetch_add_explicit(&pool->nb_locked_release, 1, memory_order_relaxed);
+}
+
+static void pool_release_buffer(void *opaque, uint8_t *data)
+{
+    BufferPoolEntry *buf = opaque;
+    AVBufferPool *pool = buf->pool;
+
+    pool_put_entry(pool, buf);
 
     if (atomic_fetch_sub_explicit(&pool->refcount, 1, memory_order_acq_rel) == 1)
         buffer_pool_free(pool);
@@ -378,29 +597,42 @@ static AVBufferRef *pool_alloc_buffer(AVBufferPool *pool)
     ret->buffer->opaque = buf;
     ret->buffer->free   = pool_release_buffer;
 
+    if (pool->account)
+        account_update(pool->account, pool->size);
+
     return ret;
 }
 
 AVBufferRef *av_buffer_pool_get(AVBufferPool *pool)
 {
-    AVBufferRef *ret;
+    AVBufferRef *ret = NULL;
     BufferPoolEntry *buf;
 
-    ff_mutex_lock(&pool->mutex);
-    buf = pool->pool;
+    buf = pool_cache_get(pool);
+    if (!buf) {
+        ff_mutex_lock(&pool->mutex);
+        buf = pool->pool;
+        if (buf) {
+            pool->pool = buf->next;
+            buf->next = NULL;
+        } else {
+            ret = pool_alloc_buffer(pool);
+            if (ret)
+                atomic_fetch_add_explicit(&pool->nb_alloc, 1, memory_order_relaxed);
+        }
+        ff_mutex_unlock(&pool->mutex);
+        atomic_fetch_add_explicit(&pool->nb_locked_get, 1, memory_order_relaxed);
+    }
+
     if (buf) {
         memset(&buf->buffer, 0, sizeof(buf->buffer));
         ret = buffer_create(&buf->buffer, buf->data, pool->size,
                             pool_release_buffer, buf, 0);
-        if (ret) {
-            pool->pool = buf->next;
-            buf->next = NULL;
+        if (ret)
             buf->buffer.flags_internal |= BUFFER_FLAG_NO_FREE;
-        }
-    } else {
-        ret = pool_alloc_buffer(pool);
+        else
+            pool_put_entry(pool, buf);
     }
-    ff_mutex_unlock(&pool->mutex);
 
     if (ret)
         atomic_fetch_add_explicit(&pool->refcount, 1, memory_order_relaxed);
@@ -414,3 +646,52 @@ void *av_buffer_pool_buffer_get_opaque(const AVBufferRef *ref)
     av_assert0(buf);
     return buf->opaque;
 }
+
+void av_buffer_pool_get_stats(const AVBufferPool *pool, unsigned *nb_alloc,
+                              unsigned *nb_locked_get,
+                              unsigned *nb_locked_release)
+{
+    AVBufferPool *p = (AVBufferPool *)pool;
+
+    if (nb_alloc)
+        *nb_alloc = atomic_load_explicit(&p->nb_alloc, memory_order_relaxed);
+    if (nb_locked_get)
+        *nb_locked_get = atomic_load_explicit(&p->nb_locked_get,
+                                              memory_order_relaxed);
+    if (nb_locked_release)
+        *nb_locked_release = atomic_load_explicit(&p->nb_locked_release,
+                                                  memory_order_relaxed);
+}
+
+void av_buffer_pool_set_account(AVBufferPool *pool, AVBufferAccount *account)
+{
+    if (!account)
+        return;
+
+    av_buffer_account_unref(&pool->account);
+    pool->account = av_buffer_account_ref(account);
+}
+
+void av_buffer_account_add(const AVBufferRef *buf, AVBufferAccount *account)
+{
+    AVBuffer *b = buf->buffer;
+    uintptr_t expected = 0;
+
+    if (!account || buffer_get_account(b))
+        return;
+    /* the pool is charged for its buffers already */
+    if (b->free == pool_release_buffer &&
+        ((BufferPoolEntry *)b->opaque)->pool->account)
+        return;
+
+    av_buffer_account_ref(account);
+    if (!atomic_compare_exchange_strong_explicit(&b->account, &expected,
+                                                 (uintptr_t)account,
+                                                 memory_order_relaxed,
+                                                 memory_order_relaxed)) {
+        /* charged concurrently by another thread */
+        av_buffer_account_unref(&account);
+        return;
+    }
+    account_update(account, b->size);
+}
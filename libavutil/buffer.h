@@ -107,6 +107,22 @@ AVBufferRef *av_buffer_alloc(size_t size);
  */
 AVBufferRef *av_buffer_allocz(size_t size);
 
+/**
+ * Same as av_buffer_allocz(), except that large buffers are mapped directly
+ * from the system, aligned to and advised for transparent huge pages, and
+ * placed on the NUMA node of the calling thread where supported. Small
+ * buffers, and systems without support, use av_buffer_allocz().
+ *
+ * This is meant to be used as the alloc callback of av_buffer_pool_init()
+ * for large, long-lived buffers such as video frames, where it reduces TLB
+ * misses. The NUMA node is chosen once, when the buffer is allocated; a
+ * pooled buffer stays there when it is later reused by threads running on
+ * other nodes. Allocations are rounded up to multiples of 2 MiB only when
+ * this wastes less than 1/8 of the mapping; otherwise the tail of the
+ * buffer is backed by normal pages.
+ */
+AVBufferRef *av_buffer_alloc_hugepages(size_t size);
+
 /**
  * Always treat the buffer as read-only, even when it has only one
  * reference.
@@ -214,6 +230,76 @@ int av_buffer_realloc(AVBufferRef **buf, size_t size);
  */
 int av_buffer_replace(AVBufferRef **dst, const AVBufferRef *src);
 
+/**
+ * @}
+ */
+
+/**
+ * @defgroup lavu_bufferaccount AVBufferAccount
+ * @ingroup lavu_data
+ *
+ * @{
+ * AVBufferAccount attributes the memory of AVBuffers to an owner, e.g. a
+ * codec, filter or format context, and tracks how much of it is currently
+ * allocated and the highest amount that was allocated at any time.
+ *
+ * An account is reference counted. Every buffer and pool charged to it holds
+ * a reference, so an account stays valid until the last buffer charged to it
+ * is freed, even after its creator dropped its own reference. All the
+ * functions below are thread-safe.
+ */
+
+/**
+ * The AVBufferAccount struct is opaque, see the functions below.
+ */
+typedef struct AVBufferAccount AVBufferAccount;
+
+/**
+ * Allocate a new, empty account.
+ *
+ * @return the account, with a reference count of 1, or NULL on failure
+ */
+AVBufferAccount *av_buffer_account_alloc(void);
+
+/**
+ * Create a new reference to an account.
+ *
+ * @return account
+ */
+AVBufferAccount *av_buffer_account_ref(AVBufferAccount *account);
+
+/**
+ * Release a reference to an account and set the pointer to NULL. The account
+ * is freed when the last reference to it is released.
+ */
+void av_buffer_account_unref(AVBufferAccount **account);
+
+/**
+ * Charge the memory of the buffer referenced by buf to an account. The
+ * account stays charged until the buffer is freed, i.e. until its last
+ * reference is released. A buffer is only ever charged to one account: this
+ * function does nothing if the buffer is already charged to an account,
+ * including buffers of pools set up with av_buffer_pool_set_account().
+ *
+ * The charge follows the buffer through av_buffer_realloc() and
+ * av_buffer_make_writable().
+ *
+ * @param account the account to charge; may be NULL, in which case this
+ *                function does nothing
+ */
+void av_buffer_account_add(const AVBufferRef *buf, AVBufferAccount *account);
+
+/**
+ * Get the memory usage of an account.
+ *
+ * @param live if not NULL, set to the number of bytes currently charged to
+ *             the account
+ * @param peak if not NULL, set to the highest number of bytes that were
+ *             charged to the account at any time
+ */
+void av_buffer_account_get(const AVBufferAccount *account,
+                           int64_t *live, int64_t *peak);
+
 /**
  * @}
  */
@@ -315,6 +401,44 @@ AVBufferRef *av_buffer_pool_get(AVBufferPool *pool);
  */
 void *av_buffer_pool_buffer_get_opaque(const AVBufferRef *ref);
 
+/**
+ * Charge all the buffers allocated by the pool to an account. The account is
+ * charged with the size of every buffer the pool holds, whether it is
+ * currently in use or not, until the buffer is freed together with the pool.
+ *
+ * Buffers returned by the pool cannot be charged to another account with
+ * av_buffer_account_add() afterwards.
+ *
+ * This must be called before the first av_buffer_pool_get() on the pool.
+ *
+ * @param account the account to charge, a new reference to it is taken by the
+ *                pool; may be NULL, in which case this function does nothing
+ */
+void av_buffer_pool_set_account(AVBufferPool *pool, AVBufferAccount *account);
+
+/**
+ * Get the contention statistics of a pool, counted since its creation.
+ *
+ * Gets and releases are served from a small lock-free cache of free buffers
+ * and only fall back to the pool mutex when the cache is empty or full,
+ * respectively. A high number of locked gets or releases compared to the
+ * number of buffers used means that more buffers are in flight at once than
+ * the cache can hold.
+ *
+ * The values are read without synchronization with the other threads using
+ * the pool, so they may be slightly out of date.
+ *
+ * @param nb_alloc          if non-NULL, set to the number of buffers the pool
+ *                          allocated
+ * @param nb_locked_get     if non-NULL, set to the number of
+ *                          av_buffer_pool_get() calls which took the mutex
+ * @param nb_locked_release if non-NULL, set to the number of buffers returned
+ *                          to the pool which took the mutex
+ */
+void av_buffer_pool_get_stats(const AVBufferPool *pool, unsigned *nb_alloc,
+                              unsigned *nb_locked_get,
+                              unsigned *nb_locked_release);
+
 /**
  * @}
  */
@@ -35,6 +35,17 @@
  */
 #define BUFFER_FLAG_NO_FREE       (1 << 1)
 
+struct AVBufferAccount {
+    /**
+     * number of references held by the users of the account and
+     * by the buffers and pools charged to it
+     */
+    atomic_uint refcount;
+
+    atomic_int_least64_t live;
+    atomic_int_least64_t peak;
+};
+
 struct AVBuffer {
     uint8_t *data; /**< data described by this buffer */
     size_t size; /**< size of data in bytes */
@@ -63,6 +74,12 @@ struct AVBuffer {
      * A combination of BUFFER_FLAG_*
      */
     int flags_internal;
+
+    /**
+     * The AVBufferAccount the buffer is charged to, if any. Holds a reference
+     * to the account, which is released when the buffer is freed.
+     */
+    atomic_uintptr_t account;
 };
 
 typedef struct BufferPoolEntry {
@@ -85,10 +102,33 @@ typedef struct BufferPoolEntry {
     AVBuffer buffer;
 } BufferPoolEntry;
 
+/**
+ * Number of free entries kept in the lock-free cache of a pool.
+ */
+#define BUFFER_POOL_CACHE_SIZE 16
+
 struct AVBufferPool {
     AVMutex mutex;
     BufferPoolEntry *pool;
 
+    /*
+     * Lock-free cache in front of the mutex protected list above. Each slot
+     * is either 0 or holds a free BufferPoolEntry. Entries are moved in and
+     * out of the slots with atomic exchanges, so that an entry is owned by
+     * exactly one slot or thread at any time. The list is only used when
+     * all the slots are empty (on get) or full (on release).
+     */
+    atomic_uintptr_t cache[BUFFER_POOL_CACHE_SIZE];
+
+    /*
+     * Contention statistics: the number of gets and releases that had to
+     * take the mutex, and the number of buffers allocated by the pool.
+     * See av_buffer_pool_get_stats().
+     */
+    atomic_uint nb_locked_get;
+    atomic_uint nb_locked_release;
+    atomic_uint nb_alloc;
+
     /*
      * This is used to track when the pool is to be freed.
      * The pointer to the pool itself held by the caller is considered to
@@ -100,6 +140,12 @@ struct AVBufferPool {
      */
     atomic_uint refcount;
 
+    /*
+     * Account charged with the memory of all the buffers held by the pool,
+     * whether they are in use or not.
+     */
+    AVBufferAccount *account;
+
     size_t size;
     void *opaque;
     AVBufferRef* (*alloc)(size_t size);
@@ -20,8 +20,14 @@
 
 #include "config.h"
 
+#include <string.h>
+
+#include "avassert.h"
+#include "error.h"
+#include "macros.h"
 #include "mem.h"
 #include "thread.h"
+#include "time.h"
 
 #include "executor.h"
 
@@ -57,7 +63,30 @@ struct AVExecutor {
     AVCond cond;
     int die;
 
-    AVTask *tasks;
+    // one queue per priority level, each sorted by cb.priority_higher
+    AVTask *tasks[AV_EXECUTOR_PRIORITY_NB];
+    AVExecutorStats stats[AV_EXECUTOR_PRIORITY_NB];
+    // wait times are only measured once they were asked for, to keep the
+    // clock out of the locked sections otherwise
+    int stats_wait_time;
+    // time of the last change to stats[].nb_pending
+    int64_t stats_time[AV_EXECUTOR_PRIORITY_NB];
+
+    /**
+     * Executors whose tasks are run by our threads. For a standalone
+     * executor, this only contains the executor itself.
+     */
+    AVExecutor **clients;
+    int nb_clients;
+    // index of the client to look at first when picking the next task
+    int next_client;
+    // signalled when a task of a detaching client finishes
+    AVCond detach_cond;
+
+    // for clients, the shared executor they are attached to
+    AVExecutor *shared;
+    // number of our tasks currently being run, protected by shared->lock
+    int nb_running;
 };
 
 static AVTask* remove_task(AVTask **prev, AVTask *t)
@@ -73,19 +102,65 @@ static void add_task(AVTask **prev, AVTask *t)
     *prev   = t;
 }
 
-static int run_one_task(AVExecutor *e, void *lc)
+/**
+ * Account for a change of the number of pending tasks by diff. The total wait
+ * time is the integral of the queue length over time, which needs no per-task
+ * timestamps.
+ */
+static void update_stats(AVExecutor *c, int priority, int diff)
 {
-    AVTaskCallbacks *cb = &e->cb;
-    AVTask **prev;
+    AVExecutorStats *st = &c->stats[priority];
 
-    for (prev = &e->tasks; *prev && !cb->ready(*prev, cb->user_data); prev = &(*prev)->next)
-        /* nothing */;
-    if (*prev) {
-        AVTask *t = remove_task(prev, *prev);
-        ff_mutex_unlock(&e->lock);
-        cb->run(t, lc, cb->user_data);
-        ff_mutex_lock(&e->lock);
-        return 1;
+    if (c->stats_wait_time) {
+        const int64_t now = av_gettime_relative();
+
+        if (st->nb_pending)
+            st->wait_time += st->nb_pending * (now - c->stats_time[priority]);
+        c->stats_time[priority] = now;
+    }
+
+    st->nb_pending += diff;
+    if (diff > 0) {
+        st->nb_queued++;
+        st->max_pending = FFMAX(st->max_pending, st->nb_pending);
+    } else if (diff < 0) {
+        st->nb_run++;
+    }
+}
+
+/**
+ * Run one ready task, must be called with e->lock held. Higher priority levels
+ * are always looked at first. Within a level, the clients are visited in
+ * round-robin order, so that no client can starve the others.
+ */
+static int run_one_task(AVExecutor *e, int thread_idx)
+{
+    for (int priority = AV_EXECUTOR_PRIORITY_NB - 1; priority >= 0; priority--) {
+        for (int i = 0; i < e->nb_clients; i++) {
+            const int idx = (e->next_client + i) % e->nb_clients;
+            AVExecutor   *c = e->clients[idx];
+            AVTaskCallbacks *cb = &c->cb;
+            void *lc = c->local_contexts + thread_idx * cb->local_context_size;
+            AVTask **prev;
+
+            for (prev = &c->tasks[priority]; *prev && !cb->ready(*prev, cb->user_data); prev = &(*prev)->next)
+                /* nothing */;
+            if (*prev) {
+                AVTask *t = remove_task(prev, *prev);
+
+                update_stats(c, priority, -1);
+                e->next_client = (idx + 1) % e->nb_clients;
+                c->nb_running++;
+
+                ff_mutex_unlock(&e->lock);
+                cb->run(t, lc, cb->user_data);
+                ff_mutex_lock(&e->lock);
+
+                if (!--c->nb_running && c->die)
+                    ff_cond_broadcast(&e->detach_cond);
+                return 1;
+            }
+        }
     }
     return 0;
 }
@@ -95,13 +170,12 @@ static void *executor_worker_task(void *data)
 {
     ThreadInfo *ti = (ThreadInfo*)data;
     AVExecutor *e  = ti->e;
-    void *lc       = e->local_contexts + (ti - e->threads) * e->cb.local_context_size;
 
     ff_mutex_lock(&e->lock);
     while (1) {
         if (e->die) break;
 
-        if (!run_one_task(e, lc)) {
+        if (!run_one_task(e, ti - e->threads)) {
             //no task in one loop
             ff_cond_wait(&e->cond, &e->lock);
         }
@@ -123,32 +197,46 @@ static void executor_free(AVExecutor *e, const int has_lock, const int has_cond)
         for (int i = 0; i < e->thread_count; i++)
             executor_thread_join(e->threads[i].thread, NULL);
     }
-    if (has_cond)
+    if (has_cond) {
         ff_cond_destroy(&e->cond);
+        ff_cond_destroy(&e->detach_cond);
+    }
     if (has_lock)
         ff_mutex_destroy(&e->lock);
 
     av_free(e->threads);
     av_free(e->local_contexts);
+    av_free(e->clients);
 
     av_free(e);
 }
 
-AVExecutor* av_executor_alloc(const AVTaskCallbacks *cb, int thread_count)
+static int callbacks_valid(const AVTaskCallbacks *cb)
+{
+    return cb && cb->user_data && cb->ready && cb->run && cb->priority_higher;
+}
+
+static AVExecutor *executor_alloc(const AVTaskCallbacks *cb, int thread_count)
 {
     AVExecutor *e;
     int has_lock = 0, has_cond = 0;
-    if (!cb || !cb->user_data || !cb->ready || !cb->run || !cb->priority_higher)
-        return NULL;
 
     e = av_mallocz(sizeof(*e));
     if (!e)
         return NULL;
-    e->cb = *cb;
 
-    e->local_contexts = av_calloc(thread_count, e->cb.local_context_size);
-    if (!e->local_contexts)
-        goto free_executor;
+    if (cb) {
+        e->cb = *cb;
+
+        e->local_contexts = av_calloc(thread_count, e->cb.local_context_size);
+        if (!e->local_contexts)
+            goto free_executor;
+
+        e->clients = av_malloc(sizeof(*e->clients));
+        if (!e->clients)
+            goto free_executor;
+        e->clients[e->nb_clients++] = e;
+    }
 
     e->threads = av_calloc(thread_count, sizeof(*e->threads));
     if (!e->threads)
@@ -156,6 +244,10 @@ AVExecutor* av_executor_alloc(const AVTaskCallbacks *cb, int thread_count)
 
     has_lock = !ff_mutex_init(&e->lock, NULL);
     has_cond = !ff_cond_init(&e->cond, NULL);
+    if (has_cond && ff_cond_init(&e->detach_cond, NULL)) {
+        ff_cond_destroy(&e->cond);
+        has_cond = 0;
+    }
 
     if (!has_lock || !has_cond)
         goto free_executor;
@@ -173,31 +265,150 @@ free_executor:
     return NULL;
 }
 
+AVExecutor* av_executor_alloc(const AVTaskCallbacks *cb, int thread_count)
+{
+    if (!callbacks_valid(cb))
+        return NULL;
+
+    return executor_alloc(cb, thread_count);
+}
+
+AVExecutor *av_executor_alloc_shared(int thread_count)
+{
+    return executor_alloc(NULL, thread_count);
+}
+
+AVExecutor *av_executor_attach(AVExecutor *shared, const AVTaskCallbacks *cb)
+{
+    AVExecutor *c, **clients;
+
+    if (!shared || shared->shared || !callbacks_valid(cb))
+        return NULL;
+
+    c = av_mallocz(sizeof(*c));
+    if (!c)
+        return NULL;
+
+    c->cb     = *cb;
+    c->shared = shared;
+
+    // one local context per shared thread, or one for running the tasks
+    // inline without threads
+    c->local_contexts = av_calloc(FFMAX(shared->thread_count, 1), c->cb.local_context_size);
+    if (!c->local_contexts)
+        goto fail;
+
+    ff_mutex_lock(&shared->lock);
+    clients = av_realloc_array(shared->clients, shared->nb_clients + 1,
+                               sizeof(*shared->clients));
+    if (clients) {
+        shared->clients = clients;
+        shared->clients[shared->nb_clients++] = c;
+    }
+    ff_mutex_unlock(&shared->lock);
+
+    if (!clients)
+        goto fail;
+
+    return c;
+fail:
+    av_free(c->local_contexts);
+    av_free(c);
+    return NULL;
+}
+
+static void executor_detach(AVExecutor *c)
+{
+    AVExecutor *e = c->shared;
+
+    ff_mutex_lock(&e->lock);
+
+    for (int i = 0; i < e->nb_clients; i++) {
+        if (e->clients[i] == c) {
+            memmove(e->clients + i, e->clients + i + 1,
+                    (e->nb_clients - i - 1) * sizeof(*e->clients));
+            e->nb_clients--;
+            break;
+        }
+    }
+    if (e->next_client >= e->nb_clients)
+        e->next_client = 0;
+
+    // wait for the tasks already picked up by the shared threads
+    c->die = 1;
+    while (c->nb_running)
+        ff_cond_wait(&e->detach_cond, &e->lock);
+
+    ff_mutex_unlock(&e->lock);
+
+    av_free(c->local_contexts);
+    av_free(c);
+}
+
 void av_executor_free(AVExecutor **executor)
 {
     if (!executor || !*executor)
         return;
-    executor_free(*executor, 1, 1);
+    if ((*executor)->shared)
+        executor_detach(*executor);
+    else
+        executor_free(*executor, 1, 1);
     *executor = NULL;
 }
 
 void av_executor_execute(AVExecutor *e, AVTask *t)
 {
-    AVTaskCallbacks *cb = &e->cb;
+    av_executor_execute_priority(e, t, AV_EXECUTOR_PRIORITY_NORMAL);
+}
+
+void av_executor_execute_priority(AVExecutor *c, AVTask *t,
+                                  enum AVExecutorPriority priority)
+{
+    AVExecutor *e = c->shared ? c->shared : c;
+    AVTaskCallbacks *cb = &c->cb;
     AVTask **prev;
 
+    av_assert0(priority >= 0 && priority < AV_EXECUTOR_PRIORITY_NB);
+
     ff_mutex_lock(&e->lock);
     if (t) {
-        for (prev = &e->tasks; *prev && cb->priority_higher(*prev, t); prev = &(*prev)->next)
+        for (prev = &c->tasks[priority]; *prev && cb->priority_higher(*prev, t); prev = &(*prev)->next)
             /* nothing */;
         add_task(prev, t);
+        update_stats(c, priority, 1);
     }
     ff_cond_signal(&e->cond);
     ff_mutex_unlock(&e->lock);
 
 #if !HAVE_THREADS
     // We are running in a single-threaded environment, so we must handle all tasks ourselves
-    while (run_one_task(e, e->local_contexts))
+    ff_mutex_lock(&e->lock);
+    while (run_one_task(e, 0))
         /* nothing */;
+    ff_mutex_unlock(&e->lock);
 #endif
 }
+
+int av_executor_get_stats(AVExecutor *c, enum AVExecutorPriority priority,
+                          AVExecutorStats *stats)
+{
+    AVExecutor *e = c->shared ? c->shared : c;
+
+    if (priority < 0 || priority >= AV_EXECUTOR_PRIORITY_NB)
+        return AVERROR(EINVAL);
+
+    ff_mutex_lock(&e->lock);
+    if (!c->stats_wait_time) {
+        const int64_t now = av_gettime_relative();
+
+        for (int i = 0; i < AV_EXECUTOR_PRIORITY_NB; i++)
+            c->stats_time[i] = now;
+        c->stats_wait_time = 1;
+    }
+    // bring the wait time up to date without changing the queue
+    update_stats(c, priority, 0);
+    *stats = c->stats[priority];
+    ff_mutex_unlock(&e->lock);
+
+    return 0;
+}
@@ -21,6 +21,8 @@
 #ifndef AVUTIL_EXECUTOR_H
 #define AVUTIL_EXECUTOR_H
 
+#include <stdint.h>
+
 typedef struct AVExecutor AVExecutor;
 typedef struct AVTask AVTask;
 
@@ -28,6 +30,35 @@ struct AVTask {
     AVTask *next;
 };
 
+/**
+ * Priority levels of tasks. Ready tasks of a higher level are always run
+ * before any task of a lower level; within a level, tasks are ordered by
+ * AVTaskCallbacks.priority_higher.
+ */
+enum AVExecutorPriority {
+    AV_EXECUTOR_PRIORITY_LOW,       ///< speculative work
+    AV_EXECUTOR_PRIORITY_NORMAL,    ///< used by av_executor_execute()
+    AV_EXECUTOR_PRIORITY_HIGH,      ///< work on the critical path
+    AV_EXECUTOR_PRIORITY_NB         ///< Not part of ABI
+};
+
+/**
+ * Queue statistics of one priority level of an executor.
+ */
+typedef struct AVExecutorStats {
+    uint64_t nb_queued;     ///< number of tasks added
+    uint64_t nb_run;        ///< number of tasks taken out of the queue to run
+    uint64_t nb_pending;    ///< number of tasks currently queued
+    uint64_t max_pending;   ///< highest value nb_pending ever had
+    /**
+     * Total time in microseconds the tasks spent queued, including waiting
+     * to become ready, since the first call to av_executor_get_stats() on
+     * the executor. Divide by the tasks run over the same period to get the
+     * mean wait time, which is exact whenever nb_pending is 0.
+     */
+    int64_t  wait_time;
+} AVExecutorStats;
+
 typedef struct AVTaskCallbacks {
     void *user_data;
 
@@ -51,8 +82,31 @@ typedef struct AVTaskCallbacks {
  */
 AVExecutor* av_executor_alloc(const AVTaskCallbacks *callbacks, int thread_count);
 
+/**
+ * Alloc an executor that can be shared by several users, e.g. all decoders in
+ * a process. It only provides the worker threads, tasks are added through
+ * clients created with av_executor_attach().
+ * @param thread_count worker thread number
+ * @return return the executor
+ */
+AVExecutor* av_executor_alloc_shared(int thread_count);
+
+/**
+ * Attach a client to a shared executor. The client has its own callbacks and
+ * task list, and is used with av_executor_execute() like an executor returned
+ * by av_executor_alloc(). The worker threads of the shared executor pick ready
+ * tasks from all the attached clients in round-robin order.
+ * @param shared executor returned by av_executor_alloc_shared()
+ * @param callbacks callback structure for the client's tasks
+ * @return return the client, to be freed with av_executor_free()
+ */
+AVExecutor* av_executor_attach(AVExecutor *shared, const AVTaskCallbacks *callbacks);
+
 /**
  * Free executor
+ * For a client created with av_executor_attach(), this detaches it from the
+ * shared executor, waiting for its tasks that are currently running to finish.
+ * A shared executor must only be freed after all of its clients.
  * @param e  pointer to executor
  */
 void av_executor_free(AVExecutor **e);
@@ -64,4 +118,24 @@ void av_executor_free(AVExecutor **e);
  */
 void av_executor_execute(AVExecutor *e, AVTask *t);
 
+/**
+ * Add task to executor with the given priority level
+ * @param e pointer to executor
+ * @param t pointer to task. If NULL, it will wakeup one work thread
+ * @param priority priority level of the task
+ */
+void av_executor_execute_priority(AVExecutor *e, AVTask *t,
+                                  enum AVExecutorPriority priority);
+
+/**
+ * Get the queue statistics of one priority level
+ * @param e pointer to executor, for clients of a shared executor only the
+ *          client's own tasks are counted
+ * @param priority priority level to get the statistics for
+ * @param stats the statistics are written here
+ * @return 0 on success, a negative AVERROR code on failure
+ */
+int av_executor_get_stats(AVExecutor *e, enum AVExecutorPriority priority,
+                          AVExecutorStats *stats);
+
 #endif //AVUTIL_EXECUTOR_H
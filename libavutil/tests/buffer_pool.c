@@ -0,0 +1,195 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Multi-threaded av_buffer_pool_get()/av_buffer_unref() benchmark. Every
+ * thread repeatedly takes a few buffers from a shared pool, stamps them
+ * with its own id, checks that nobody else wrote to them and gives them
+ * back, so that a buffer handed out twice is detected. The memory of the
+ * pool is charged to an AVBufferAccount, which must be balanced at the end.
+ *
+ * usage: buffer_pool [nb_threads [nb_iterations [nb_held]]]
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/buffer.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#define BUF_SIZE 4096
+#define MAX_HELD 64
+
+typedef struct ThreadContext {
+    pthread_t     thread;
+    AVBufferPool *pool;
+    int           id;
+    int           nb_iterations;
+    int           nb_held;
+    int           ret;
+} ThreadContext;
+
+static void *thread_main(void *arg)
+{
+    ThreadContext *t = arg;
+    AVBufferRef *bufs[MAX_HELD];
+
+    for (int i = 0; i < t->nb_iterations; i++) {
+        for (int j = 0; j < t->nb_held; j++) {
+            bufs[j] = av_buffer_pool_get(t->pool);
+            if (!bufs[j]) {
+                t->ret = 1;
+                while (j--)
+                    av_buffer_unref(&bufs[j]);
+                return NULL;
+            }
+            memset(bufs[j]->data, t->id, 64);
+        }
+        for (int j = 0; j < t->nb_held; j++) {
+            for (int k = 0; k < 64; k++) {
+                if (bufs[j]->data[k] != (uint8_t)t->id) {
+                    t->ret = 2;
+                    break;
+                }
+            }
+            av_buffer_unref(&bufs[j]);
+        }
+        if (t->ret)
+            return NULL;
+    }
+    return NULL;
+}
+
+/* charge a single buffer and follow it through reallocation */
+static int test_account_add(void)
+{
+    AVBufferAccount *account = av_buffer_account_alloc();
+    AVBufferRef *buf = NULL, *ref;
+    int64_t live, peak;
+    int ret = 0;
+
+    if (!account || av_buffer_realloc(&buf, 100) < 0)
+        goto fail;
+    av_buffer_account_add(buf, account);
+    av_buffer_account_add(buf, account); /* no double charge */
+    if (av_buffer_realloc(&buf, 1000) < 0)
+        goto fail;
+
+    /* a copy is made for a buffer which is not writable */
+    ref = av_buffer_ref(buf);
+    if (!ref || av_buffer_realloc(&buf, 500) < 0) {
+        av_buffer_unref(&ref);
+        goto fail;
+    }
+    av_buffer_account_get(account, &live, &peak);
+    ret |= live != 1500 || peak != 1500;
+    av_buffer_unref(&ref);
+    av_buffer_unref(&buf);
+
+    av_buffer_account_get(account, &live, &peak);
+    ret |= live != 0 || peak != 1500;
+    av_buffer_account_unref(&account);
+    if (ret)
+        fprintf(stderr, "account mismatch\n");
+    return ret;
+fail:
+    av_buffer_unref(&buf);
+    av_buffer_account_unref(&account);
+    return 1;
+}
+
+int main(int argc, char **argv)
+{
+    int nb_threads    = argc > 1 ? strtol(argv[1], NULL, 0) : 4;
+    int nb_iterations = argc > 2 ? strtol(argv[2], NULL, 0) : 100000;
+    int nb_held       = argc > 3 ? strtol(argv[3], NULL, 0) : 2;
+    ThreadContext *threads;
+    AVBufferPool *pool;
+    AVBufferAccount *account;
+    int64_t t, live, peak;
+    unsigned nb_alloc, nb_locked_get, nb_locked_release;
+    int ret = 0;
+
+    if (nb_threads < 1 || nb_iterations < 1 || nb_held < 1 || nb_held > MAX_HELD) {
+        fprintf(stderr, "usage: %s [nb_threads [nb_iterations [nb_held]]]\n", argv[0]);
+        return 1;
+    }
+
+    if (test_account_add())
+        return 1;
+
+    threads = calloc(nb_threads, sizeof(*threads));
+    pool    = av_buffer_pool_init(BUF_SIZE, NULL);
+    account = av_buffer_account_alloc();
+    if (!threads || !pool || !account) {
+        free(threads);
+        av_buffer_pool_uninit(&pool);
+        av_buffer_account_unref(&account);
+        return 1;
+    }
+    av_buffer_pool_set_account(pool, account);
+
+    t = av_gettime_relative();
+    for (int i = 0; i < nb_threads; i++) {
+        threads[i].pool          = pool;
+        threads[i].id            = i + 1;
+        threads[i].nb_iterations = nb_iterations;
+        threads[i].nb_held       = nb_held;
+        if (pthread_create(&threads[i].thread, NULL, thread_main, &threads[i])) {
+            nb_threads = i;
+            ret = 1;
+            break;
+        }
+    }
+    for (int i = 0; i < nb_threads; i++) {
+        pthread_join(threads[i].thread, NULL);
+        if (threads[i].ret) {
+            fprintf(stderr, "thread %d failed: %s\n", i,
+                    threads[i].ret == 1 ? "allocation failure" : "buffer shared between threads");
+            ret = 1;
+        }
+    }
+    t = av_gettime_relative() - t;
+
+    printf("%d threads, %d buffers held: %.1f ns per get/release pair\n",
+           nb_threads, nb_held,
+           t * 1000.0 / ((double)nb_threads * nb_iterations * nb_held));
+    av_buffer_pool_get_stats(pool, &nb_alloc, &nb_locked_get, &nb_locked_release);
+    printf("allocated %u, locked gets %u, locked releases %u\n",
+           nb_alloc, nb_locked_get, nb_locked_release);
+
+    av_buffer_account_get(account, &live, &peak);
+    if (live != (int64_t)nb_alloc * BUF_SIZE || peak != live) {
+        fprintf(stderr, "pool account mismatch: %"PRId64"/%"PRId64"\n", live, peak);
+        ret = 1;
+    }
+
+    av_buffer_pool_uninit(&pool);
+    av_buffer_account_get(account, &live, NULL);
+    if (live) {
+        fprintf(stderr, "%"PRId64" bytes still charged after uninit\n", live);
+        ret = 1;
+    }
+    av_buffer_account_unref(&account);
+    free(threads);
+
+    return ret;
+}
@@ -248,6 +248,7 @@ static const struct {
         { "fixed_dsp", checkasm_check_fixed_dsp },
         { "float_dsp", checkasm_check_float_dsp },
         { "av_tx",     checkasm_check_av_tx },
+        { "pixelutils", checkasm_check_pixelutils },
 #endif
     { NULL }
 };
@@ -0,0 +1,92 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with FFmpeg; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdint.h>
+
+#include "libavutil/mem_internal.h"
+#include "libavutil/pixelutils.h"
+
+#include "checkasm.h"
+
+#define WIDTH  96
+#define HEIGHT 64
+#define ITERATIONS 16
+
+static const char *const align_names[] = { "", "_a1", "_a2" };
+
+static void fill_random(uint8_t *buf, int size)
+{
+    for (int i = 0; i < size; i++)
+        buf[i] = rnd();
+}
+
+static void check_sad(int n, int aligned)
+{
+    LOCAL_ALIGNED_32(uint8_t, src1, [WIDTH * HEIGHT]);
+    LOCAL_ALIGNED_32(uint8_t, src2, [WIDTH * HEIGHT]);
+    const int size = 1 << n;
+    av_pixelutils_sad_fn sad = av_pixelutils_get_sad_fn(n, n, aligned, NULL);
+
+    declare_func_emms(AV_CPU_FLAG_MMX, int, const uint8_t *src1, ptrdiff_t stride1,
+                      const uint8_t *src2, ptrdiff_t stride2);
+
+    if (!sad)
+        return;
+
+    if (check_func(sad, "sad_%dx%d%s", size, size, align_names[aligned])) {
+        fill_random(src1, WIDTH * HEIGHT);
+        fill_random(src2, WIDTH * HEIGHT);
+
+        for (int i = 0; i < ITERATIONS; i++) {
+            int x1 = rnd() % (WIDTH  - size + 1);
+            int y1 = rnd() % (HEIGHT - size + 1);
+            int x2 = rnd() % (WIDTH  - size + 1);
+            int y2 = rnd() % (HEIGHT - size + 1);
+            const uint8_t *p1, *p2;
+            int res_ref, res_new;
+
+            /* the blocks the aligned variants expect */
+            if (aligned >= 1)
+                x1 &= ~(size - 1);
+            if (aligned >= 2)
+                x2 &= ~(size - 1);
+            p1 = src1 + y1 * WIDTH + x1;
+            p2 = src2 + y2 * WIDTH + x2;
+
+            res_ref = call_ref(p1, WIDTH, p2, WIDTH);
+            res_new = call_new(p1, WIDTH, p2, WIDTH);
+            if (res_ref != res_new) {
+                fail();
+                fprintf(stderr, "sad_%dx%d%s: %d != %d\n", size, size,
+                        align_names[aligned], res_ref, res_new);
+                break;
+            }
+        }
+
+        bench_new(src1, WIDTH, src2 + 3 * WIDTH + (aligned < 2 ? 3 : 0), WIDTH);
+    }
+}
+
+void checkasm_check_pixelutils(void)
+{
+    for (int aligned = 0; aligned < 3; aligned++)
+        for (int n = 1; n <= 5; n++)
+            check_sad(n, aligned);
+
+    report("sad");
+}
@@ -327,6 +327,9 @@ fate-filter-untile: CMD = framecrc -lavfi testsrc2=d=1:r=2,untile=2x2
 FATE_FILTER-$(call FILTERFRAMECRC, TESTSRC2 UNTILE) += fate-filter-untile-yuv422p
 fate-filter-untile-yuv422p: CMD = framecrc -lavfi testsrc2=d=1:r=2,format=yuv422p,untile=2x2
 
+FATE_FILTER-$(call FILTERFRAMECRC, TESTSRC2 FORMAT EXPOSURE SETPARAMS TONEMAP SCALE) += fate-filter-tonemap-lut
+fate-filter-tonemap-lut: CMD = framecrc -lavfi "sws_flags=+accurate_rnd+bitexact;testsrc2=r=2:d=2,scale,format=gbrpf32,exposure=2,setparams=color_trc=linear:colorspace=bt709,tonemap=hable:peak=4:lut=1,scale,format=gbrp"
+
 FATE_FILTER_VSYNTH_PGMYUV-$(CONFIG_UNSHARP_FILTER) += fate-filter-unsharp
 fate-filter-unsharp: CMD = framecrc -c:v pgmyuv -i $(SRC) -vf unsharp=11:11:-1.5:11:11:-1.5
 
@@ -685,6 +688,12 @@ FATE_METADATA_FILTER-$(call ALLYES, $(CROPDETECT_DEPS)) += fate-filter-metadata-
 fate-filter-metadata-cropdetect2: SRC = $(TARGET_SAMPLES)/filter/cropdetect2.mp4
 fate-filter-metadata-cropdetect2: CMD = run $(FILTER_METADATA_COMMAND) "sws_flags=+accurate_rnd+bitexact;movie='$(SRC)',mestimate,cropdetect=mode=mvedges,metadata=mode=print"
 
+CROPDETECT_LAVFI_DEPS = LAVFI_INDEV TESTSRC2_FILTER COLOR_FILTER OVERLAY_FILTER FORMAT_FILTER CROPDETECT_FILTER SCALE_FILTER
+FATE_METADATA_FILTER-$(call ALLYES, $(CROPDETECT_LAVFI_DEPS)) += fate-filter-metadata-cropdetect-interval
+fate-filter-metadata-cropdetect-interval: CMD = run $(FILTER_METADATA_COMMAND) "sws_flags=+accurate_rnd+bitexact;color=s=240x180:r=5:d=2[bg];testsrc2=s=160x120:r=5:d=2[fg];[bg][fg]overlay=x=4*n:y=2*n:eval=frame,format=rgba,cropdetect=round=2:interval=3"
+FATE_METADATA_FILTER-$(call ALLYES, $(CROPDETECT_LAVFI_DEPS)) += fate-filter-metadata-cropdetect-subsample
+fate-filter-metadata-cropdetect-subsample: CMD = run $(FILTER_METADATA_COMMAND) "sws_flags=+accurate_rnd+bitexact;color=s=240x180:r=5:d=2[bg];testsrc2=s=160x120:r=5:d=2[fg];[bg][fg]overlay=x=4*n:y=2*n:eval=frame,format=yuv420p,cropdetect=round=2:reset=1:subsample=4"
+
 FREEZEDETECT_DEPS = LAVFI_INDEV MPTESTSRC_FILTER SCALE_FILTER FREEZEDETECT_FILTER
 FATE_METADATA_FILTER-$(call ALLYES, $(FREEZEDETECT_DEPS)) += fate-filter-metadata-freezedetect
 fate-filter-metadata-freezedetect: CMD = run $(FILTER_METADATA_COMMAND) "sws_flags=+accurate_rnd+bitexact;mptestsrc=r=25:d=10:m=51,freezedetect"
@@ -252,6 +252,14 @@ FATE_HEVC_FFPROBE-$(call DEMDEC, MOV, HEVC) += fate-hevc-dv-rpu
 fate-hevc-two-first-slice: CMD = threads=2 framemd5 -i $(TARGET_SAMPLES)/hevc/two_first_slice.mp4 -sws_flags bitexact -t 00:02.00 -an
 FATE_HEVC-$(call FRAMEMD5, MOV, HEVC) += fate-hevc-two-first-slice
 
+# WPP rows decoded by slice threads within frames decoded by frame threads,
+# the output must not differ from the one of the single threaded decoding
+HEVC_WPP_THREADS_SAMPLES = WPP_A_ericsson_MAIN_2 WPP_D_ericsson_MAIN_2 WPP_F_ericsson_MAIN_2
+FATE_HEVC_WPP_THREADS = $(addprefix fate-hevc-wpp-threads-, $(HEVC_WPP_THREADS_SAMPLES))
+$(FATE_HEVC_WPP_THREADS): CMD = threads=4 thread_type=frame+slice framecrc -wpp_threads 2 -i $(TARGET_SAMPLES)/hevc-conformance/$(subst fate-hevc-wpp-threads-,,$(@)).bit -pix_fmt yuv420p
+$(FATE_HEVC_WPP_THREADS): REF = $(SRC_PATH)/tests/ref/fate/hevc-conformance-$(subst fate-hevc-wpp-threads-,,$(@))
+FATE_HEVC-$(call FRAMECRC, HEVC, HEVC, HEVC_PARSER) += $(FATE_HEVC_WPP_THREADS)
+
 fate-hevc-cabac-tudepth: CMD = framecrc -i $(TARGET_SAMPLES)/hevc/cbf_cr_cb_TUDepth_4_circle.h265 -pix_fmt yuv444p
 FATE_HEVC-$(call FRAMECRC, HEVC, HEVC) += fate-hevc-cabac-tudepth
 
@@ -109,6 +109,29 @@ FATE_HLSENC_PROBE-$(call ALLYES, HLS_DEMUXER EAC3_DEMUXER) += fate-hls-fmp4_ac3
 fate-hls-fmp4_ac3: tests/data/hls_fmp4_ac3.m3u8
 fate-hls-fmp4_ac3: CMD = probeaudiostream $(TARGET_PATH)/tests/data/now_ac3.mp4
 
+tests/data/hls_ll.m3u8: TAG = GEN
+tests/data/hls_ll.m3u8: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+	-f lavfi -i "aevalsrc=cos(2*PI*t)*sin(2*PI*(440+4*t)*t):d=20" -map 0 -codec:a mp2fixed -flags +bitexact \
+	-f hls -hls_segment_type fmp4 -hls_fmp4_init_filename hls_ll_init.mp4 -hls_list_size 0 \
+	-hls_time 2 -hls_part_time 0.5 -hls_flags delta_update+can_block_reload \
+	-hls_segment_filename $(TARGET_PATH)/tests/data/hls_ll_%d.m4s \
+	$(TARGET_PATH)/tests/data/hls_ll.m3u8 2>/dev/null
+
+FATE_HLSENC_LL-$(call ALLYES, HLS_MUXER MP4_MUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER) += fate-hls-ll
+fate-hls-ll: tests/data/hls_ll.m3u8
+fate-hls-ll: CMD = cat $(TARGET_PATH)/tests/data/hls_ll.m3u8 $(TARGET_PATH)/tests/data/hls_ll_delta.m3u8
+
+FATE_HLSENC_LL-$(call ALLYES, HLS_MUXER MP4_MUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER HLS_DEMUXER MOV_DEMUXER FRAMECRC_MUXER) += fate-hls-ll-demux
+fate-hls-ll-demux: tests/data/hls_ll.m3u8
+fate-hls-ll-demux: CMD = framecrc -flags +bitexact -i $(TARGET_PATH)/tests/data/hls_ll.m3u8 -c copy
+
+FATE_HLSENC_LL_LIVE-$(HAVE_PTHREADS) += fate-hls-ll-live
+FATE_HLSENC_LL-$(call ALLYES, HLS_MUXER MP4_MUXER AEVALSRC_FILTER LAVFI_INDEV MP2FIXED_ENCODER HLS_DEMUXER MOV_DEMUXER HTTP_PROTOCOL) += $(FATE_HLSENC_LL_LIVE-yes)
+fate-hls-ll-live: tests/data/hls_ll.m3u8 libavformat/tests/hls_ll$(EXESUF)
+fate-hls-ll-live: CMD = run libavformat/tests/hls_ll$(EXESUF) $(TARGET_PATH)/tests/data
+
 FATE_SAMPLES_FFMPEG += $(FATE_HLSENC-yes)
 FATE_SAMPLES_FFMPEG_FFPROBE += $(FATE_HLSENC_PROBE-yes)
-fate-hlsenc: $(FATE_HLSENC-yes) $(FATE_HLSENC_PROBE-yes)
+FATE_FFMPEG += $(FATE_HLSENC_LL-yes)
+fate-hlsenc: $(FATE_HLSENC-yes) $(FATE_HLSENC_PROBE-yes) $(FATE_HLSENC_LL-yes)
@@ -0,0 +1,243 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Benchmark for the amix filter. Mixes 2 to 32 generated inputs, once with a
+ * single thread and once with the given number of threads, reports the speed
+ * of both runs in input samples mixed per second and checks that their output
+ * is identical.
+ *
+ * usage: amix_bench [nb_threads [nb_frames [nb_channels [sample_fmt]]]]
+ *
+ * e.g. amix_bench 8 1000 16 fltp
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/channel_layout.h"
+#include "libavutil/error.h"
+#include "libavutil/frame.h"
+#include "libavutil/md5.h"
+#include "libavutil/mem.h"
+#include "libavutil/samplefmt.h"
+#include "libavutil/time.h"
+
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+#include "libavfilter/buffersrc.h"
+
+#define MAX_INPUTS  32
+#define SAMPLE_RATE 48000
+#define FRAME_SIZE  1024
+
+static AVFrame *generate_frame(int input, int nb_channels,
+                               enum AVSampleFormat sample_fmt)
+{
+    AVFrame *frame = av_frame_alloc();
+    const int planar    = av_sample_fmt_is_planar(sample_fmt);
+    const int nb_planes = planar ? nb_channels : 1;
+    const int nb        = planar ? FRAME_SIZE : FRAME_SIZE * nb_channels;
+
+    if (!frame)
+        return NULL;
+    frame->format      = sample_fmt;
+    frame->sample_rate = SAMPLE_RATE;
+    frame->nb_samples  = FRAME_SIZE;
+    av_channel_layout_default(&frame->ch_layout, nb_channels);
+    if (av_frame_get_buffer(frame, 0) < 0) {
+        av_frame_free(&frame);
+        return NULL;
+    }
+
+    for (int p = 0; p < nb_planes; p++) {
+        for (int i = 0; i < nb; i++) {
+            double v = ((i * 7919 + p * 131 + input * 1009) % 2001 - 1000) / 1000.0;
+
+            if (av_get_packed_sample_fmt(sample_fmt) == AV_SAMPLE_FMT_DBL)
+                ((double *)frame->extended_data[p])[i] = v;
+            else
+                ((float *)frame->extended_data[p])[i] = v;
+        }
+    }
+    return frame;
+}
+
+static void frame_md5(struct AVMD5 *md5, const AVFrame *frame)
+{
+    const int planar    = av_sample_fmt_is_planar(frame->format);
+    const int nb_planes = planar ? frame->ch_layout.nb_channels : 1;
+    const int size      = frame->nb_samples * av_get_bytes_per_sample(frame->format) *
+                          (planar ? 1 : frame->ch_layout.nb_channels);
+
+    for (int p = 0; p < nb_planes; p++)
+        av_md5_update(md5, frame->extended_data[p], size);
+}
+
+static int run(AVFrame **frames, int nb_inputs, int nb_frames, int nb_threads,
+               uint8_t *digest, int64_t *time)
+{
+    AVFilterGraph *graph;
+    AVFilterContext *src[MAX_INPUTS], *mix, *sink;
+    struct AVMD5 *md5;
+    AVFrame *out;
+    char layout[64], args[256];
+    int ret;
+
+    graph = avfilter_graph_alloc();
+    out   = av_frame_alloc();
+    md5   = av_md5_alloc();
+    if (!graph || !out || !md5) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    graph->nb_threads = nb_threads;
+
+    av_channel_layout_describe(&frames[0]->ch_layout, layout, sizeof(layout));
+    snprintf(args, sizeof(args),
+             "time_base=1/%d:sample_rate=%d:sample_fmt=%s:channel_layout=%s",
+             SAMPLE_RATE, SAMPLE_RATE, av_get_sample_fmt_name(frames[0]->format),
+             layout);
+    for (int i = 0; i < nb_inputs; i++) {
+        char name[16];
+
+        snprintf(name, sizeof(name), "in%d", i);
+        ret = avfilter_graph_create_filter(&src[i], avfilter_get_by_name("abuffer"),
+                                           name, args, NULL, graph);
+        if (ret < 0)
+            goto end;
+    }
+
+    snprintf(args, sizeof(args), "inputs=%d", nb_inputs);
+    ret = avfilter_graph_create_filter(&mix, avfilter_get_by_name("amix"),
+                                       "mix", args, NULL, graph);
+    if (ret < 0)
+        goto end;
+    ret = avfilter_graph_create_filter(&sink, avfilter_get_by_name("abuffersink"),
+                                       "out", NULL, NULL, graph);
+    if (ret < 0)
+        goto end;
+
+    for (int i = 0; i < nb_inputs; i++) {
+        ret = avfilter_link(src[i], 0, mix, i);
+        if (ret < 0)
+            goto end;
+    }
+    ret = avfilter_link(mix, 0, sink, 0);
+    if (ret < 0)
+        goto end;
+    ret = avfilter_graph_config(graph, NULL);
+    if (ret < 0)
+        goto end;
+
+    av_md5_init(md5);
+    *time = 0;
+    for (int n = 0; n <= nb_frames; n++) {
+        int64_t t = av_gettime_relative();
+
+        for (int i = 0; i < nb_inputs; i++) {
+            if (n < nb_frames)
+                frames[i]->pts = (int64_t)n * FRAME_SIZE;
+            ret = av_buffersrc_add_frame_flags(src[i], n < nb_frames ? frames[i] : NULL,
+                                               AV_BUFFERSRC_FLAG_KEEP_REF);
+            if (ret < 0)
+                goto end;
+        }
+
+        while (1) {
+            ret = av_buffersink_get_frame(sink, out);
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+                break;
+            if (ret < 0)
+                goto end;
+
+            *time += av_gettime_relative() - t;
+            frame_md5(md5, out);
+            av_frame_unref(out);
+            t = av_gettime_relative();
+        }
+        *time += av_gettime_relative() - t;
+    }
+    av_md5_final(md5, digest);
+    ret = 0;
+
+end:
+    av_freep(&md5);
+    av_frame_free(&out);
+    avfilter_graph_free(&graph);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    static const int nb_inputs[] = { 2, 4, 8, 16, 32 };
+    int nb_threads      = argc > 1 ? strtol(argv[1], NULL, 0) : 0;
+    int nb_frames       = argc > 2 ? strtol(argv[2], NULL, 0) : 1000;
+    int nb_channels     = argc > 3 ? strtol(argv[3], NULL, 0) : 16;
+    const char *fmt     = argc > 4 ? argv[4] : "fltp";
+    enum AVSampleFormat sample_fmt = av_get_sample_fmt(fmt);
+    enum AVSampleFormat packed     = av_get_packed_sample_fmt(sample_fmt);
+    AVFrame *frames[MAX_INPUTS] = { NULL };
+    int ret = 0, mismatch = 0;
+
+    if (nb_frames <= 0 || nb_channels <= 0 ||
+        (packed != AV_SAMPLE_FMT_FLT && packed != AV_SAMPLE_FMT_DBL)) {
+        fprintf(stderr, "usage: %s [nb_threads [nb_frames [nb_channels [flt|fltp|dbl|dblp]]]]\n",
+                argv[0]);
+        return 1;
+    }
+
+    for (int i = 0; i < MAX_INPUTS; i++) {
+        frames[i] = generate_frame(i, nb_channels, sample_fmt);
+        if (!frames[i]) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+    }
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(nb_inputs); i++) {
+        const double samples = (double)nb_inputs[i] * nb_channels * nb_frames * FRAME_SIZE;
+        uint8_t digest[2][16];
+        int64_t time[2];
+
+        for (int j = 0; j < 2; j++) {
+            ret = run(frames, nb_inputs[i], nb_frames, j ? nb_threads : 1,
+                      digest[j], &time[j]);
+            if (ret < 0)
+                goto end;
+        }
+
+        printf("%2d inputs: single thread %.3fs, %.1f Msamples/s, "
+               "threaded %.3fs, %.1f Msamples/s, output %s\n", nb_inputs[i],
+               time[0] / 1e6, time[0] ? samples / time[0] : 0.0,
+               time[1] / 1e6, time[1] ? samples / time[1] : 0.0,
+               memcmp(digest[0], digest[1], sizeof(digest[0])) ? "differs" : "identical");
+        mismatch |= !!memcmp(digest[0], digest[1], sizeof(digest[0]));
+    }
+
+end:
+    for (int i = 0; i < MAX_INPUTS; i++)
+        av_frame_free(&frames[i]);
+
+    if (ret < 0) {
+        fprintf(stderr, "Benchmark failed: %s\n", av_err2str(ret));
+        return 1;
+    }
+    return mismatch;
+}
@@ -0,0 +1,269 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Benchmark for slice threaded video filters. Runs a filtergraph on the
+ * same generated frames once with a single thread and once with the given
+ * number of threads, reports the speed of both runs and checks that their
+ * output is identical.
+ *
+ * usage: filter_slice_bench <filtergraph> [nb_threads [nb_frames [size [pix_fmt]]]]
+ *
+ * e.g. filter_slice_bench "drawtext=fontfile=font.ttf:text=test:fontsize=200" 8 100 3840x2160
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/error.h"
+#include "libavutil/frame.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/md5.h"
+#include "libavutil/mem.h"
+#include "libavutil/pixdesc.h"
+#include "libavutil/time.h"
+
+#include "libavfilter/avfilter.h"
+#include "libavfilter/buffersink.h"
+#include "libavfilter/buffersrc.h"
+
+static int generate_frames(AVFrame ***frames, int nb_frames,
+                           const char *size, const char *pix_fmt)
+{
+    AVFilterGraph *graph;
+    AVFilterContext *sink;
+    AVFilterInOut *inputs;
+    char desc[256];
+    int ret, nb = 0;
+
+    graph  = avfilter_graph_alloc();
+    inputs = avfilter_inout_alloc();
+    *frames = av_calloc(nb_frames, sizeof(**frames));
+    if (!graph || !inputs || !*frames) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    ret = avfilter_graph_create_filter(&sink, avfilter_get_by_name("buffersink"),
+                                       "out", NULL, NULL, graph);
+    if (ret < 0)
+        goto end;
+
+    inputs->name       = av_strdup("out");
+    inputs->filter_ctx = sink;
+    if (!inputs->name) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    snprintf(desc, sizeof(desc), "testsrc2=size=%s:rate=25,format=%s", size, pix_fmt);
+    ret = avfilter_graph_parse_ptr(graph, desc, &inputs, NULL, NULL);
+    if (ret < 0)
+        goto end;
+    ret = avfilter_graph_config(graph, NULL);
+    if (ret < 0)
+        goto end;
+
+    for (; nb < nb_frames; nb++) {
+        (*frames)[nb] = av_frame_alloc();
+        if (!(*frames)[nb]) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        ret = av_buffersink_get_frame(sink, (*frames)[nb]);
+        if (ret < 0)
+            goto end;
+    }
+
+end:
+    avfilter_inout_free(&inputs);
+    avfilter_graph_free(&graph);
+    return ret;
+}
+
+static void frame_md5(struct AVMD5 *md5, const AVFrame *frame, uint8_t *digest)
+{
+    const AVPixFmtDescriptor *desc = av_pix_fmt_desc_get(frame->format);
+    const int nb_planes = av_pix_fmt_count_planes(frame->format);
+
+    av_md5_init(md5);
+    for (int p = 0; p < nb_planes; p++) {
+        const int linesize = av_image_get_linesize(frame->format, frame->width, p);
+        const int h = p == 1 || p == 2 ?
+                      AV_CEIL_RSHIFT(frame->height, desc->log2_chroma_h) : frame->height;
+
+        for (int y = 0; y < h; y++)
+            av_md5_update(md5, frame->data[p] + y * frame->linesize[p], linesize);
+    }
+    av_md5_final(md5, digest);
+}
+
+static int run(const char *filters, AVFrame **frames, int nb_frames,
+               int nb_threads, uint8_t (*digests)[16], int64_t *time)
+{
+    AVFilterGraph *graph;
+    AVFilterContext *src, *sink;
+    AVFilterInOut *inputs, *outputs;
+    struct AVMD5 *md5;
+    AVFrame *out;
+    char args[256];
+    int ret, nb_out = 0;
+
+    graph   = avfilter_graph_alloc();
+    inputs  = avfilter_inout_alloc();
+    outputs = avfilter_inout_alloc();
+    out     = av_frame_alloc();
+    md5     = av_md5_alloc();
+    if (!graph || !inputs || !outputs || !out || !md5) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    graph->nb_threads = nb_threads;
+
+    snprintf(args, sizeof(args),
+             "video_size=%dx%d:pix_fmt=%d:time_base=1/25:pixel_aspect=1/1:"
+             "colorspace=%d:range=%d",
+             frames[0]->width, frames[0]->height, frames[0]->format,
+             frames[0]->colorspace, frames[0]->color_range);
+    ret = avfilter_graph_create_filter(&src, avfilter_get_by_name("buffer"),
+                                       "in", args, NULL, graph);
+    if (ret < 0)
+        goto end;
+    ret = avfilter_graph_create_filter(&sink, avfilter_get_by_name("buffersink"),
+                                       "out", NULL, NULL, graph);
+    if (ret < 0)
+        goto end;
+
+    outputs->name       = av_strdup("in");
+    outputs->filter_ctx = src;
+    inputs->name        = av_strdup("out");
+    inputs->filter_ctx  = sink;
+    if (!outputs->name || !inputs->name) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    ret = avfilter_graph_parse_ptr(graph, filters, &inputs, &outputs, NULL);
+    if (ret < 0)
+        goto end;
+    ret = avfilter_graph_config(graph, NULL);
+    if (ret < 0)
+        goto end;
+
+    *time = 0;
+    for (int i = 0; i <= nb_frames; i++) {
+        int64_t t = av_gettime_relative();
+
+        ret = av_buffersrc_add_frame_flags(src, i < nb_frames ? frames[i] : NULL,
+                                           AV_BUFFERSRC_FLAG_KEEP_REF);
+        if (ret < 0)
+            goto end;
+
+        while (1) {
+            ret = av_buffersink_get_frame(sink, out);
+            if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+                break;
+            if (ret < 0)
+                goto end;
+
+            *time += av_gettime_relative() - t;
+            if (nb_out < nb_frames)
+                frame_md5(md5, out, digests[nb_out]);
+            nb_out++;
+            av_frame_unref(out);
+            t = av_gettime_relative();
+        }
+        *time += av_gettime_relative() - t;
+    }
+    ret = nb_out;
+
+end:
+    av_freep(&md5);
+    av_frame_free(&out);
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    avfilter_graph_free(&graph);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    const char *filters = argc > 1 ? argv[1] : NULL;
+    int nb_threads      = argc > 2 ? strtol(argv[2], NULL, 0) : 0;
+    int nb_frames       = argc > 3 ? strtol(argv[3], NULL, 0) : 100;
+    const char *size    = argc > 4 ? argv[4] : "3840x2160";
+    const char *pix_fmt = argc > 5 ? argv[5] : "yuv420p";
+    uint8_t (*digests[2])[16] = { NULL };
+    AVFrame **frames = NULL;
+    int64_t time[2];
+    int nb_out[2], ret = 0, mismatch = -1;
+
+    if (!filters || nb_frames <= 0) {
+        fprintf(stderr, "usage: %s <filtergraph> [nb_threads [nb_frames [size [pix_fmt]]]]\n",
+                argv[0]);
+        return 1;
+    }
+
+    digests[0] = av_calloc(nb_frames, sizeof(*digests[0]));
+    digests[1] = av_calloc(nb_frames, sizeof(*digests[1]));
+    if (!digests[0] || !digests[1]) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    ret = generate_frames(&frames, nb_frames, size, pix_fmt);
+    if (ret < 0)
+        goto end;
+
+    for (int i = 0; i < 2; i++) {
+        ret = nb_out[i] = run(filters, frames, nb_frames, i ? nb_threads : 1,
+                              digests[i], &time[i]);
+        if (ret < 0)
+            goto end;
+
+        printf("%s: %d frames in %.3fs, %.2f fps\n",
+               i ? "threaded     " : "single thread", nb_out[i], time[i] / 1e6,
+               time[i] ? nb_out[i] * 1e6 / time[i] : 0.0);
+    }
+
+    if (nb_out[0] != nb_out[1])
+        mismatch = FFMIN(nb_out[0], nb_out[1]);
+    for (int i = 0; i < FFMIN(nb_out[0], nb_frames) && mismatch < 0; i++)
+        if (memcmp(digests[0][i], digests[1][i], sizeof(digests[0][i])))
+            mismatch = i;
+
+    if (mismatch >= 0)
+        printf("output differs from frame %d on\n", mismatch);
+    else
+        printf("output identical\n");
+    ret = 0;
+
+end:
+    for (int i = 0; frames && i < nb_frames; i++)
+        av_frame_free(&frames[i]);
+    av_freep(&frames);
+    av_freep(&digests[0]);
+    av_freep(&digests[1]);
+
+    if (ret < 0) {
+        fprintf(stderr, "Benchmark failed: %s\n", av_err2str(ret));
+        return 1;
+    }
+    return mismatch >= 0;
+}
@@ -0,0 +1,158 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Decode+scale throughput benchmark for av_buffer_alloc_hugepages(). The
+ * first video stream of the input is decoded and every frame is scaled into
+ * a buffer taken from a pool, once with the default allocator and once with
+ * huge pages for both the decoder frames (AV_CODEC_FLAG2_HUGEPAGES) and the
+ * scaled frames.
+ *
+ * usage: hugepage_bench <input file> <dst width> <dst height> [<threads>]
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "decode_simple.h"
+
+#include "libavutil/buffer.h"
+#include "libavutil/error.h"
+#include "libavutil/imgutils.h"
+#include "libavutil/time.h"
+
+#include "libavcodec/avcodec.h"
+
+#include "libswscale/swscale.h"
+
+#define DST_FORMAT AV_PIX_FMT_YUV420P
+
+typedef struct PrivData {
+    struct SwsContext *scaler;
+    AVBufferPool      *pool;
+    int                width, height;
+    int                nb_frames;
+} PrivData;
+
+static int process_frame(DecodeContext *dc, AVFrame *frame)
+{
+    PrivData *pd = dc->opaque;
+    uint8_t *dst[4];
+    int linesize[4];
+    AVBufferRef *buf;
+    int ret;
+
+    if (!frame)
+        return 0;
+
+    if (!pd->scaler) {
+        pd->scaler = sws_getContext(frame->width, frame->height, frame->format,
+                                    pd->width, pd->height, DST_FORMAT,
+                                    SWS_BILINEAR, NULL, NULL, NULL);
+        if (!pd->scaler)
+            return AVERROR(ENOMEM);
+    }
+
+    buf = av_buffer_pool_get(pd->pool);
+    if (!buf)
+        return AVERROR(ENOMEM);
+
+    ret = av_image_fill_arrays(dst, linesize, buf->data, DST_FORMAT,
+                               pd->width, pd->height, 64);
+    if (ret >= 0)
+        ret = sws_scale(pd->scaler, (const uint8_t **)frame->data, frame->linesize,
+                        0, frame->height, dst, linesize);
+    av_buffer_unref(&buf);
+    if (ret < 0)
+        return ret;
+
+    pd->nb_frames++;
+    return 0;
+}
+
+static int run(const char *filename, int width, int height, int threads,
+               int hugepages)
+{
+    PrivData pd = { .width = width, .height = height };
+    DecodeContext dc;
+    int64_t t;
+    int size, ret;
+
+    size = av_image_get_buffer_size(DST_FORMAT, width, height, 64);
+    if (size < 0)
+        return size;
+
+    pd.pool = av_buffer_pool_init(size, hugepages ? av_buffer_alloc_hugepages : NULL);
+    if (!pd.pool)
+        return AVERROR(ENOMEM);
+
+    ret = ds_open(&dc, filename, 0);
+    if (ret < 0) {
+        fprintf(stderr, "Error opening the file\n");
+        goto end;
+    }
+
+    dc.process_frame = process_frame;
+    dc.opaque        = &pd;
+
+    dc.decoder->thread_count = threads;
+    if (hugepages)
+        dc.decoder->flags2 |= AV_CODEC_FLAG2_HUGEPAGES;
+
+    t = av_gettime_relative();
+    ret = ds_run(&dc);
+    t = av_gettime_relative() - t;
+
+    if (ret >= 0)
+        printf("%-9s: %d frames in %.3fs, %.2f fps\n",
+               hugepages ? "hugepages" : "default", pd.nb_frames, t / 1e6,
+               t ? pd.nb_frames * 1e6 / t : 0.0);
+
+    ds_free(&dc);
+end:
+    sws_freeContext(pd.scaler);
+    av_buffer_pool_uninit(&pd.pool);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    int width, height, threads;
+    int ret = 0;
+
+    if (argc < 4) {
+        fprintf(stderr,
+                "Usage: %s <input file> <dst width> <dst height> [<threads>]\n",
+                argv[0]);
+        return 0;
+    }
+
+    width   = strtol(argv[2], NULL, 0);
+    height  = strtol(argv[3], NULL, 0);
+    threads = argc > 4 ? strtol(argv[4], NULL, 0) : 0;
+
+    for (int hugepages = 0; hugepages < 2 && ret >= 0; hugepages++)
+        ret = run(argv[1], width, height, threads, hugepages);
+
+    if (ret < 0) {
+        fprintf(stderr, "Benchmark failed: %s\n", av_err2str(ret));
+        return 1;
+    }
+    return 0;
+}
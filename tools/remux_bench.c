@@ -0,0 +1,170 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Remux throughput benchmark for the file protocol. The input is remuxed
+ * into the output with plain read(), with io_uring and with io_uring and
+ * O_DIRECT. The cached pages of the input are dropped before every pass when
+ * possible, so that all the passes read from the storage.
+ *
+ * usage: remux_bench <input file> <output file> [<uring depth> [<uring block size>]]
+ */
+
+#include "config.h"
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#if HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "libavutil/dict.h"
+#include "libavutil/error.h"
+#include "libavutil/mathematics.h"
+#include "libavutil/time.h"
+
+#include "libavformat/avformat.h"
+
+static void drop_cache(const char *filename)
+{
+#if HAVE_UNISTD_H && defined(POSIX_FADV_DONTNEED)
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0)
+        return;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+#endif
+}
+
+static int remux(const char *in, const char *out, AVDictionary **opts,
+                 int64_t *bytes)
+{
+    AVFormatContext *ic = NULL, *oc = NULL;
+    AVPacket *pkt = av_packet_alloc();
+    int ret;
+
+    if (!pkt)
+        return AVERROR(ENOMEM);
+
+    ret = avformat_open_input(&ic, in, NULL, opts);
+    if (ret < 0)
+        goto end;
+    ret = avformat_find_stream_info(ic, NULL);
+    if (ret < 0)
+        goto end;
+
+    ret = avformat_alloc_output_context2(&oc, NULL, NULL, out);
+    if (ret < 0)
+        goto end;
+
+    for (unsigned i = 0; i < ic->nb_streams; i++) {
+        AVStream *st = avformat_new_stream(oc, NULL);
+        if (!st) {
+            ret = AVERROR(ENOMEM);
+            goto end;
+        }
+        ret = avcodec_parameters_copy(st->codecpar, ic->streams[i]->codecpar);
+        if (ret < 0)
+            goto end;
+        st->codecpar->codec_tag = 0;
+        st->time_base = ic->streams[i]->time_base;
+    }
+
+    if (!(oc->oformat->flags & AVFMT_NOFILE)) {
+        ret = avio_open(&oc->pb, out, AVIO_FLAG_WRITE);
+        if (ret < 0)
+            goto end;
+    }
+    ret = avformat_write_header(oc, NULL);
+    if (ret < 0)
+        goto end;
+
+    while ((ret = av_read_frame(ic, pkt)) >= 0) {
+        av_packet_rescale_ts(pkt, ic->streams[pkt->stream_index]->time_base,
+                             oc->streams[pkt->stream_index]->time_base);
+        pkt->pos = -1;
+        ret = av_interleaved_write_frame(oc, pkt);
+        if (ret < 0)
+            goto end;
+    }
+    if (ret != AVERROR_EOF)
+        goto end;
+
+    ret = av_write_trailer(oc);
+    *bytes = avio_size(ic->pb);
+
+end:
+    av_packet_free(&pkt);
+    if (oc && !(oc->oformat->flags & AVFMT_NOFILE))
+        avio_closep(&oc->pb);
+    avformat_free_context(oc);
+    avformat_close_input(&ic);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    static const struct {
+        const char *name;
+        const char *io_uring, *direct;
+    } modes[] = {
+        { "read",            "0", "0" },
+        { "io_uring",        "1", "0" },
+        { "io_uring+direct", "1", "1" },
+    };
+    int ret = 0;
+
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s <input file> <output file> "
+                "[<uring depth> [<uring block size>]]\n", argv[0]);
+        return 1;
+    }
+
+    av_log_set_level(AV_LOG_ERROR);
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(modes) && ret >= 0; i++) {
+        AVDictionary *opts = NULL;
+        int64_t bytes = 0, t;
+
+        av_dict_set(&opts, "io_uring", modes[i].io_uring, 0);
+        av_dict_set(&opts, "direct",   modes[i].direct,   0);
+        if (argc > 3)
+            av_dict_set(&opts, "uring_depth",      argv[3], 0);
+        if (argc > 4)
+            av_dict_set(&opts, "uring_block_size", argv[4], 0);
+
+        drop_cache(argv[1]);
+
+        t   = av_gettime_relative();
+        ret = remux(argv[1], argv[2], &opts, &bytes);
+        t   = av_gettime_relative() - t;
+        av_dict_free(&opts);
+
+        if (ret >= 0)
+            printf("%-16s: %"PRId64" bytes in %.3fs, %.1f MB/s\n", modes[i].name,
+                   bytes, t / 1e6, t ? bytes / (double)t : 0.0);
+    }
+
+    if (ret < 0) {
+        fprintf(stderr, "Benchmark failed: %s\n", av_err2str(ret));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,184 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Microbenchmark for the fftools ThreadQueue, comparing the mutex-based and
+ * the lock-free implementation.
+ *
+ * usage: thread_queue_bench [nb_producers [nb_packets [queue_size]]]
+ *
+ * Every producer thread sends nb_packets packets on its own stream, a single
+ * consumer thread receives them all.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "libavcodec/packet.h"
+
+#include "libavutil/avassert.h"
+#include "libavutil/error.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "fftools/objpool.h"
+#include "fftools/thread_queue.h"
+
+typedef struct Producer {
+    pthread_t    thread;
+    ThreadQueue *tq;
+    unsigned     stream_idx;
+    unsigned     nb_packets;
+    int          ret;
+} Producer;
+
+static void pkt_move(void *dst, void *src)
+{
+    av_packet_move_ref(dst, src);
+}
+
+static void *producer_thread(void *arg)
+{
+    Producer *p = arg;
+    AVPacket *pkt = av_packet_alloc();
+
+    if (!pkt) {
+        p->ret = AVERROR(ENOMEM);
+        return NULL;
+    }
+
+    for (unsigned i = 0; i < p->nb_packets; i++) {
+        pkt->pts = i;
+        p->ret = tq_send(p->tq, p->stream_idx, pkt);
+        if (p->ret < 0)
+            break;
+    }
+    tq_send_finish(p->tq, p->stream_idx);
+
+    av_packet_free(&pkt);
+    return NULL;
+}
+
+static int run(unsigned flags, unsigned nb_producers, unsigned nb_packets,
+               unsigned queue_size)
+{
+    Producer *producers = NULL;
+    ThreadQueue *tq = NULL;
+    ObjPool *op;
+    AVPacket *pkt = NULL;
+    int64_t *next_pts = NULL;
+    int64_t t;
+    uint64_t nb_received = 0;
+    int ret = 0, stream_idx;
+
+    op = objpool_alloc_packets();
+    if (!op)
+        return AVERROR(ENOMEM);
+
+    tq = tq_alloc(nb_producers, queue_size, op, pkt_move, flags);
+    if (!tq) {
+        objpool_free(&op);
+        return AVERROR(ENOMEM);
+    }
+
+    producers = av_calloc(nb_producers, sizeof(*producers));
+    next_pts  = av_calloc(nb_producers, sizeof(*next_pts));
+    pkt       = av_packet_alloc();
+    if (!producers || !next_pts || !pkt) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+
+    t = av_gettime_relative();
+
+    for (unsigned i = 0; i < nb_producers; i++) {
+        Producer *p = &producers[i];
+
+        p->tq         = tq;
+        p->stream_idx = i;
+        p->nb_packets = nb_packets;
+
+        ret = pthread_create(&p->thread, NULL, producer_thread, p);
+        av_assert0(!ret);
+    }
+
+    while (1) {
+        ret = tq_receive(tq, &stream_idx, pkt);
+        if (ret == AVERROR_EOF && stream_idx < 0)
+            break;
+        if (ret < 0)
+            continue;
+
+        // packets of each stream must arrive in order
+        av_assert0(pkt->pts == next_pts[stream_idx]);
+        next_pts[stream_idx]++;
+        nb_received++;
+
+        av_packet_unref(pkt);
+    }
+    ret = 0;
+
+    for (unsigned i = 0; i < nb_producers; i++) {
+        pthread_join(producers[i].thread, NULL);
+        if (producers[i].ret < 0)
+            ret = producers[i].ret;
+    }
+
+    t = av_gettime_relative() - t;
+
+    av_assert0(nb_received == (uint64_t)nb_producers * nb_packets);
+
+    printf("%-9s %u producer(s), queue size %u: %"PRIu64" packets in %.3fs, "
+           "%.0f packets/s\n", (flags & THREAD_QUEUE_LOCKLESS) ? "lockless" : "mutex",
+           nb_producers, queue_size, nb_received, t / 1e6,
+           t ? nb_received * 1e6 / t : 0.0);
+
+end:
+    av_packet_free(&pkt);
+    av_freep(&next_pts);
+    av_freep(&producers);
+    tq_free(&tq);
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned nb_producers = argc > 1 ? strtoul(argv[1], NULL, 0) : 4;
+    unsigned nb_packets   = argc > 2 ? strtoul(argv[2], NULL, 0) : 1000000;
+    unsigned queue_size   = argc > 3 ? strtoul(argv[3], NULL, 0) : 8;
+    int ret;
+
+    if (!nb_producers || !queue_size) {
+        fprintf(stderr, "usage: %s [nb_producers [nb_packets [queue_size]]]\n",
+                argv[0]);
+        return 1;
+    }
+
+    ret = run(0, nb_producers, nb_packets, queue_size);
+    if (ret >= 0)
+        ret = run(THREAD_QUEUE_LOCKLESS, nb_producers, nb_packets, queue_size);
+
+    if (ret < 0) {
+        fprintf(stderr, "Benchmark failed: %s\n", av_err2str(ret));
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,171 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Loopback throughput benchmark for the UDP protocol. A sender thread sends
+ * MPEG-TS sized datagrams to 127.0.0.1 as fast as the tx thread of the udp
+ * protocol allows, while the main thread receives them, once without and
+ * once with recvmmsg()/sendmmsg() batching, for both the direct and the
+ * circular buffer receive paths.
+ *
+ * usage: udp_bench [nb_packets [batch_size [port]]]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "libavutil/dict.h"
+#include "libavutil/error.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "libavformat/avformat.h"
+#include "libavformat/avio.h"
+
+#define PKT_SIZE 1316
+
+typedef struct Sender {
+    pthread_t   thread;
+    const char *url;
+    int         batch_size;
+    unsigned    nb_packets;
+    int         ret;
+} Sender;
+
+static void *sender_thread(void *arg)
+{
+    Sender *s = arg;
+    AVIOContext *pb = NULL;
+    AVDictionary *opts = NULL;
+    uint8_t pkt[PKT_SIZE] = { 0 };
+
+    /* a bitrate far above what loopback achieves makes the tx thread send
+     * every queued packet right away */
+    av_dict_set_int(&opts, "pkt_size",   PKT_SIZE, 0);
+    av_dict_set_int(&opts, "bitrate",    100000000000LL, 0);
+    av_dict_set_int(&opts, "batch_size", s->batch_size, 0);
+    s->ret = avio_open2(&pb, s->url, AVIO_FLAG_WRITE, NULL, &opts);
+    av_dict_free(&opts);
+    if (s->ret < 0)
+        return NULL;
+
+    for (unsigned i = 0; i < s->nb_packets; i++) {
+        avio_write(pb, pkt, sizeof(pkt));
+        /* the tx fifo is full, give the tx thread some time */
+        while (pb->error == AVERROR(ENOMEM)) {
+            pb->error = 0;
+            av_usleep(100);
+            avio_write(pb, pkt, sizeof(pkt));
+        }
+        if (pb->error < 0) {
+            s->ret = pb->error;
+            break;
+        }
+    }
+    avio_flush(pb);
+
+    avio_closep(&pb);
+    return NULL;
+}
+
+static int run(int port, int fifo, int batch_size, unsigned nb_packets)
+{
+    AVIOContext *pb = NULL;
+    AVDictionary *opts = NULL;
+    Sender sender = { 0 };
+    uint8_t buf[65536];
+    char url[64];
+    uint64_t nb_received = 0;
+    int64_t t = 0, last = 0;
+    int ret;
+
+    av_dict_set_int(&opts, "buffer_size",      4 << 20, 0);
+    av_dict_set_int(&opts, "fifo_size",        fifo ? 7 * 4096 : 0, 0);
+    av_dict_set_int(&opts, "overrun_nonfatal", 1, 0);
+    av_dict_set_int(&opts, "timeout",          500000, 0);
+    av_dict_set_int(&opts, "batch_size",       batch_size, 0);
+    snprintf(url, sizeof(url), "udp://:%d", port);
+    ret = avio_open2(&pb, url, AVIO_FLAG_READ, NULL, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+
+    snprintf(url, sizeof(url), "udp://127.0.0.1:%d", port);
+    sender.url        = url;
+    sender.batch_size = batch_size;
+    sender.nb_packets = nb_packets;
+    ret = pthread_create(&sender.thread, NULL, sender_thread, &sender);
+    if (ret) {
+        avio_closep(&pb);
+        return AVERROR(ret);
+    }
+
+    while (nb_received < nb_packets) {
+        ret = avio_read_partial(pb, buf, sizeof(buf));
+        if (ret < 0)
+            break;
+        last = av_gettime_relative();
+        if (!t)
+            t = last;
+        nb_received += ret / PKT_SIZE;
+    }
+    t = last - t;
+
+    pthread_join(sender.thread, NULL);
+    avio_closep(&pb);
+    if (sender.ret < 0)
+        return sender.ret;
+    if (ret < 0 && ret != AVERROR(ETIMEDOUT) && ret != AVERROR_EOF)
+        return ret;
+
+    printf("%-6s batch %4d: %"PRIu64"/%u packets in %.3fs, %.0f packets/s, %.1f Mbit/s\n",
+           fifo ? "fifo" : "direct", batch_size, nb_received, nb_packets, t / 1e6,
+           t ? nb_received * 1e6 / t : 0.0, t ? nb_received * PKT_SIZE * 8.0 / t : 0.0);
+
+    return 0;
+}
+
+int main(int argc, char **argv)
+{
+    unsigned nb_packets = argc > 1 ? strtoul(argv[1], NULL, 0) : 200000;
+    int batch_size      = argc > 2 ? strtol(argv[2], NULL, 0) : 32;
+    int port            = argc > 3 ? strtol(argv[3], NULL, 0) : 23456;
+    int ret = 0;
+
+    if (!nb_packets || batch_size < 1 || port <= 0) {
+        fprintf(stderr, "usage: %s [nb_packets [batch_size [port]]]\n", argv[0]);
+        return 1;
+    }
+
+    avformat_network_init();
+
+    for (int fifo = 0; fifo < 2 && ret >= 0; fifo++) {
+        ret = run(port, fifo, 1, nb_packets);
+        if (ret >= 0)
+            ret = run(port, fifo, batch_size, nb_packets);
+    }
+
+    avformat_network_deinit();
+
+    if (ret < 0) {
+        fprintf(stderr, "Benchmark failed: %s\n", av_err2str(ret));
+        return 1;
+    }
+    return 0;
+}